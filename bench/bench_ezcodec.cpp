@@ -0,0 +1,660 @@
+// Kernel and pipeline benchmark. Times every transform size, each SIMD
+// kernel table, the quantizer, block splitting, the .ezc writers and
+// readers, and in-memory encode/decode across image sizes and thread
+// counts, then prints a table and optionally writes JSON that a later run
+// can be compared against:
+//
+//   ezcodec_bench [--quick] [--json results.json] [--baseline base.json]
+//                 [--tolerance 10] [--threads 1,2,4] [--filter substring]
+//
+// With --baseline, every result shared with the baseline is printed with
+// its change, and the exit status is 1 if any got worse by more than the
+// tolerance (percent).
+
+#include "ezcodec/BlockPlane.h"
+#include "ezcodec/Codec.h"
+#include "ezcodec/ColorConversion.h"
+#include "ezcodec/DCT.h"
+#include "ezcodec/EzcFormat.h"
+#include "ezcodec/Kernels.h"
+#include "ezcodec/Picture.h"
+#include "ezcodec/Quantization.h"
+#include "ezcodec/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// How a result is measured; decides which direction is a regression
+enum class Unit {
+    NsPerBlock,   // lower is better
+    MPixelsPerS,  // higher is better
+    Efficiency    // parallel speed-up / threads, higher is better
+};
+
+const char* unitName(Unit unit) {
+    switch (unit) {
+        case Unit::NsPerBlock:  return "ns/block";
+        case Unit::MPixelsPerS: return "MP/s";
+        default:                return "efficiency";
+    }
+}
+
+bool parseUnit(const std::string& text, Unit& unit) {
+    for (Unit candidate : {Unit::NsPerBlock, Unit::MPixelsPerS, Unit::Efficiency}) {
+        if (text == unitName(candidate)) {
+            unit = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Result {
+    std::string name;
+    Unit unit;
+    double value;
+};
+
+struct Settings {
+    double minSeconds = 0.2; // per timing run
+    int repeats = 3;         // best of
+    std::vector<size_t> threadCounts;
+    std::string filter;
+};
+
+// Keeps computed values alive so the compiler cannot drop the work
+volatile uint64_t sink = 0;
+
+template<typename T>
+void consume(const T* data, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i += 61) {
+        sum += static_cast<uint64_t>(data[i]);
+    }
+    sink = sink + sum;
+}
+
+class Bench {
+public:
+    explicit Bench(const Settings& settings) : settings(settings) {}
+
+    [[nodiscard]] bool wants(const std::string& name) const {
+        return settings.filter.empty() || name.find(settings.filter) != std::string::npos;
+    }
+
+    // Best seconds per call of fn() over the repeats, each run calling it
+    // until minSeconds have passed
+    template<typename F>
+    double secondsPerCall(F&& fn) const {
+        double best = 1e30;
+        for (int r = 0; r < settings.repeats; r++) {
+            size_t calls = 0;
+            const auto start = std::chrono::steady_clock::now();
+            double elapsed = 0.0;
+            do {
+                fn();
+                calls++;
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } while (elapsed < settings.minSeconds);
+            best = std::min(best, elapsed / static_cast<double>(calls));
+        }
+        return best;
+    }
+
+    // fn() processes `blocks` blocks per call
+    template<typename F>
+    void perBlock(const std::string& name, size_t blocks, F&& fn) {
+        if (wants(name)) {
+            add(name, Unit::NsPerBlock, secondsPerCall(fn) * 1e9 / static_cast<double>(blocks));
+        }
+    }
+
+    // fn() processes `pixels` pixels per call; returns the MP/s
+    template<typename F>
+    double perPixel(const std::string& name, size_t pixels, F&& fn) {
+        if (!wants(name)) {
+            return 0.0;
+        }
+        const double rate = static_cast<double>(pixels) / 1e6 / secondsPerCall(fn);
+        add(name, Unit::MPixelsPerS, rate);
+        return rate;
+    }
+
+    void add(const std::string& name, Unit unit, double value) {
+        results.push_back({name, unit, value});
+        std::printf("  %-44s %12.3f %s\n", name.c_str(), value, unitName(unit));
+        std::fflush(stdout);
+    }
+
+    [[nodiscard]] const std::vector<Result>& all() const { return results; }
+    [[nodiscard]] const Settings& config() const { return settings; }
+
+private:
+    Settings settings;
+    std::vector<Result> results;
+};
+
+// Smooth gradient with some texture, like a photo
+std::vector<uint8_t> makeImage(size_t width, size_t height, int channels) {
+    std::vector<uint8_t> pixels(width * height * channels);
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            for (int c = 0; c < channels; c++) {
+                const size_t texture = ((x * 7 + y * 13) ^ (x >> 3) * (c + 1)) % 29;
+                pixels[(y * width + x) * channels + c] =
+                    static_cast<uint8_t>((x + y * 2 + c * 40 + texture) % 256);
+            }
+        }
+    }
+    return pixels;
+}
+
+std::string sizeName(TxSize size) {
+    const int dim = getTxDimension(size);
+    return std::to_string(dim) + "x" + std::to_string(dim);
+}
+
+// DCT::forwardDCT / inverseDCT through the generic Block interface
+template<TxSize Size>
+void benchDCTSize(Bench& bench) {
+    constexpr size_t SAMPLES = 64 * 1024;
+    const size_t count = SAMPLES / getTxElementCount(Size);
+    BlockPlane<double, Size> pixels(static_cast<int>(count), 1);
+    BlockPlane<double, Size> coefficients(static_cast<int>(count), 1);
+    BlockPlane<double, Size> restored(static_cast<int>(count), 1);
+    for (size_t i = 0; i < SAMPLES; i++) {
+        pixels.data()[i] = static_cast<double>((i * 37) % 256);
+    }
+
+    bench.perBlock("dct/forward/" + sizeName(Size), count, [&] {
+        for (size_t b = 0; b < count; b++) {
+            DCT::forwardDCT(pixels[b], coefficients[b]);
+        }
+        consume(coefficients.data(), SAMPLES);
+    });
+    bench.perBlock("dct/inverse/" + sizeName(Size), count, [&] {
+        for (size_t b = 0; b < count; b++) {
+            DCT::inverseDCT(coefficients[b], restored[b]);
+        }
+        consume(restored.data(), SAMPLES);
+    });
+}
+
+void benchDCT(Bench& bench) {
+    std::printf("\n[DCT]\n");
+    benchDCTSize<TxSize::TX_4x4>(bench);
+    benchDCTSize<TxSize::TX_8x8>(bench);
+    benchDCTSize<TxSize::TX_16x16>(bench);
+    benchDCTSize<TxSize::TX_32x32>(bench);
+}
+
+// Every Kernels8x8 table this CPU can run, plus the fixed-point transform
+void benchKernels(Bench& bench) {
+    std::printf("\n[Kernels]\n");
+    constexpr size_t COUNT = 1024;
+    std::vector<uint16_t> pixels(COUNT * 64);
+    std::vector<int16_t> coefficients(COUNT * 64);
+    std::vector<int16_t> quantized(COUNT * 64);
+    std::vector<int16_t> restored(COUNT * 64);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = static_cast<uint16_t>((i * 37 + (i >> 6) * 11) % 256);
+    }
+    const QuantTable table = Quantization::makeQuantTable(75);
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        const Kernels8x8* kernels = kernels8x8For(level);
+        if (!kernels) {
+            continue;
+        }
+        const std::string prefix = std::string("kernels/") + kernels->name + "/";
+        kernels->forwardDCT(pixels.data(), coefficients.data());
+        bench.perBlock(prefix + "forward_dct", COUNT, [&] {
+            for (size_t b = 0; b < COUNT; b++) {
+                kernels->forwardDCT(pixels.data() + b * 64, coefficients.data() + b * 64);
+            }
+            consume(coefficients.data(), coefficients.size());
+        });
+        bench.perBlock(prefix + "quantize", COUNT, [&] {
+            for (size_t b = 0; b < COUNT; b++) {
+                kernels->quantize(coefficients.data() + b * 64, quantized.data() + b * 64,
+                                  table.steps().data(), table.reciprocals());
+            }
+            consume(quantized.data(), quantized.size());
+        });
+        bench.perBlock(prefix + "dequantize", COUNT, [&] {
+            for (size_t b = 0; b < COUNT; b++) {
+                kernels->dequantize(quantized.data() + b * 64, coefficients.data() + b * 64, table.steps().data());
+            }
+            consume(coefficients.data(), coefficients.size());
+        });
+        bench.perBlock(prefix + "inverse_dct", COUNT, [&] {
+            for (size_t b = 0; b < COUNT; b++) {
+                kernels->inverseDCT(coefficients.data() + b * 64, restored.data() + b * 64);
+            }
+            consume(restored.data(), restored.size());
+        });
+        bench.perBlock(prefix + "inverse_dct_lowband", COUNT, [&] {
+            for (size_t b = 0; b < COUNT; b++) {
+                kernels->inverseDCTLowBand(coefficients.data() + b * 64, restored.data() + b * 64);
+            }
+            consume(restored.data(), restored.size());
+        });
+    }
+
+    bench.perBlock("kernels/fixed-point/forward_dct", COUNT, [&] {
+        for (size_t b = 0; b < COUNT; b++) {
+            DCT::forwardDCT8x8Fixed(pixels.data() + b * 64, coefficients.data() + b * 64);
+        }
+        consume(coefficients.data(), coefficients.size());
+    });
+    bench.perBlock("kernels/fixed-point/inverse_dct", COUNT, [&] {
+        for (size_t b = 0; b < COUNT; b++) {
+            DCT::inverseDCT8x8Fixed(coefficients.data() + b * 64, restored.data() + b * 64);
+        }
+        consume(restored.data(), restored.size());
+    });
+}
+
+// The generic per-block Quantization templates
+void benchQuantization(Bench& bench) {
+    std::printf("\n[Quantization]\n");
+    constexpr int COUNT = 1024;
+    BlockPlane<int16_t, TxSize::TX_8x8> coefficients(COUNT, 1);
+    BlockPlane<int16_t, TxSize::TX_8x8> quantized(COUNT, 1);
+    BlockPlane<int16_t, TxSize::TX_8x8> restored(COUNT, 1);
+    for (size_t i = 0; i < static_cast<size_t>(COUNT) * 64; i++) {
+        coefficients.data()[i] = static_cast<int16_t>(static_cast<int>((i * 97) % 1024) - 512);
+    }
+
+    bench.perBlock("quantization/quantize", COUNT, [&] {
+        for (size_t b = 0; b < COUNT; b++) {
+            Quantization::quantize(coefficients[b], quantized[b], 75);
+        }
+        consume(quantized.data(), quantized.size() * 64);
+    });
+    const QuantTable table = Quantization::makeQuantTable(75);
+    bench.perBlock("quantization/quantize_table", COUNT, [&] {
+        for (size_t b = 0; b < COUNT; b++) {
+            Quantization::quantize(coefficients[b], quantized[b], table);
+        }
+        consume(quantized.data(), quantized.size() * 64);
+    });
+    bench.perBlock("quantization/dequantize", COUNT, [&] {
+        for (size_t b = 0; b < COUNT; b++) {
+            Quantization::dequantize(quantized[b], restored[b], 75);
+        }
+        consume(restored.data(), restored.size() * 64);
+    });
+}
+
+// Color conversion kernels, per pixel
+void benchColor(Bench& bench) {
+    std::printf("\n[Color]\n");
+    constexpr size_t WIDTH = 4096;
+    const std::vector<uint8_t> rgb = makeImage(WIDTH, 1, 3);
+    std::vector<uint8_t> y(WIDTH);
+    std::vector<uint8_t> cb(WIDTH);
+    std::vector<uint8_t> cr(WIDTH);
+    std::vector<uint8_t> out(WIDTH * 3);
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        const ColorKernels* kernels = colorKernelsFor(level);
+        if (!kernels) {
+            continue;
+        }
+        const std::string prefix = std::string("color/") + kernels->name + "/";
+        bench.perPixel(prefix + "rgb_to_ycbcr", WIDTH, [&] {
+            kernels->rgbToYCbCr(rgb.data(), y.data(), cb.data(), cr.data(), WIDTH);
+            consume(cr.data(), WIDTH);
+        });
+        bench.perPixel(prefix + "ycbcr_to_rgb", WIDTH, [&] {
+            kernels->yCbCrToRgb(y.data(), cb.data(), cr.data(), out.data(), WIDTH);
+            consume(out.data(), out.size());
+        });
+        bench.perPixel(prefix + "upsample_2x", WIDTH, [&] {
+            kernels->upsampleRow2x(cb.data(), cr.data(), out.data(), WIDTH);
+            consume(out.data(), WIDTH);
+        });
+    }
+}
+
+// Writes a binary PGM stb_image can load
+bool writePgm(const std::string& path, const std::vector<uint8_t>& pixels, size_t width, size_t height) {
+    std::ofstream out(path, std::ios::binary);
+    out << "P5\n" << width << " " << height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(width * height));
+    return static_cast<bool>(out);
+}
+
+// Picture block access (a copied plane vs. strided views) and the .ezc
+// writers and readers, through files in the temporary directory
+void benchFormat(Bench& bench, const std::string& tempDir) {
+    std::printf("\n[Format]\n");
+    constexpr size_t SIZE = 1024;
+    const size_t pixels = SIZE * SIZE;
+    const std::string pgmPath = tempDir + "/bench_input.pgm";
+    const std::string ezcPath = tempDir + "/bench.ezc";
+    if (!writePgm(pgmPath, makeImage(SIZE, SIZE, 1), SIZE, SIZE)) {
+        std::fprintf(stderr, "Cannot write %s\n", pgmPath.c_str());
+        return;
+    }
+
+    Picture picture(pgmPath.c_str());
+    bench.perPixel("picture/split_into_blocks", pixels, [&] {
+        const auto blocks = picture.splitIntoBlocks<uint16_t, TxSize::TX_8x8>();
+        consume(blocks.data(), blocks.size() * 64);
+    });
+    bench.perPixel("picture/block_views", pixels, [&] {
+        alignas(32) uint16_t samples[64];
+        for (int y = 0; y < picture.blockCountY(); y++) {
+            for (int x = 0; x < picture.blockCountX(); x++) {
+                picture.blockView(x, y).copyTo(samples);
+                consume(samples, 64);
+            }
+        }
+    });
+
+    // Quantized coefficients of the real image
+    EzcHeader header;
+    header.width = SIZE;
+    header.height = SIZE;
+    header.quality = 75;
+    header.blockCountX = SIZE / 8;
+    header.blockCountY = SIZE / 8;
+    BlockPlane8x8i16 quantized(static_cast<int>(header.blockCountX), static_cast<int>(header.blockCountY));
+    {
+        const Kernels8x8& kernels = kernels8x8();
+        const QuantTable table = Quantization::makeQuantTable(header.quality);
+        alignas(32) uint16_t samples[64];
+        alignas(32) int16_t coefficients[64];
+        for (size_t b = 0; b < quantized.size(); b++) {
+            picture.blockView(static_cast<int>(b % header.blockCountX), static_cast<int>(b / header.blockCountX))
+                .copyTo(samples);
+            kernels.forwardDCT(samples, coefficients);
+            kernels.quantize(coefficients, quantized.data() + b * 64, table.steps().data(), table.reciprocals());
+        }
+    }
+
+    struct Layout {
+        const char* name;
+        uint8_t version;
+        uint8_t flags;
+        uint32_t sliceRows;
+    };
+    const Layout layouts[] = {
+        {"v1", EZC_VERSION_RAW, 0, 0},
+        {"v2", EZC_VERSION_HUFFMAN, EZC_FLAG_SLICED, 16},
+        {"v3", EZC_VERSION_STRIPED, EZC_FLAG_SLICED, 16},
+    };
+    for (const Layout& layout : layouts) {
+        header.version = layout.version;
+        header.flags = layout.flags;
+        header.sliceRows = layout.sliceRows;
+        const std::string prefix = std::string("ezc/") + layout.name + "/";
+        bench.perPixel(prefix + "write", pixels, [&] {
+            writeEzc(ezcPath, header, quantized);
+        });
+        EzcHeader readHeader;
+        BlockPlane8x8i16 readBlocks;
+        bench.perPixel(prefix + "read", pixels, [&] {
+            readEzc(ezcPath, readHeader, readBlocks);
+            consume(readBlocks.data(), readBlocks.size() * 64);
+        });
+    }
+
+    std::remove(pgmPath.c_str());
+    std::remove(ezcPath.c_str());
+}
+
+// In-memory Encoder/Decoder at several sizes and thread counts, with the
+// parallel efficiency relative to one thread
+void benchEndToEnd(Bench& bench) {
+    std::printf("\n[End-to-end]\n");
+    struct Case {
+        const char* name;
+        ChromaFormat chroma;
+        int channels;
+    };
+    const Case cases[] = {
+        {"gray", ChromaFormat::Gray, 1},
+        {"420", ChromaFormat::YCbCr420, 3},
+    };
+    const size_t sizes[] = {256, 1024, 2048};
+
+    for (const Case& c : cases) {
+        for (size_t size : sizes) {
+            const std::vector<uint8_t> source = makeImage(size, size, c.channels);
+            const size_t pixels = size * size;
+            ImageView image;
+            image.pixels = source.data();
+            image.width = static_cast<uint32_t>(size);
+            image.height = static_cast<uint32_t>(size);
+            image.channels = c.channels;
+
+            EncodeOptions options;
+            options.quality = 75;
+            options.chroma = c.chroma;
+            const std::string prefix = std::string("codec/") + c.name + "/" + std::to_string(size) + "/";
+
+            double encodeBase = 0.0;
+            double decodeBase = 0.0;
+            for (size_t threads : bench.config().threadCounts) {
+                ThreadPool::setSharedThreads(threads);
+                Encoder encoder(options);
+                Decoder decoder;
+                std::vector<uint8_t> bytes;
+                std::vector<uint8_t> decoded;
+                ImageInfo info;
+                encoder.encode(image, bytes);
+
+                const std::string suffix = "t" + std::to_string(threads);
+                const double encodeRate = bench.perPixel(prefix + "encode/" + suffix, pixels, [&] {
+                    encoder.encode(image, bytes);
+                });
+                const double decodeRate = bench.perPixel(prefix + "decode/" + suffix, pixels, [&] {
+                    decoder.decode(bytes.data(), bytes.size(), decoded, info);
+                });
+
+                if (threads == bench.config().threadCounts.front()) {
+                    encodeBase = encodeRate / static_cast<double>(threads);
+                    decodeBase = decodeRate / static_cast<double>(threads);
+                } else {
+                    // Throughput per thread relative to the first count
+                    if (encodeBase > 0.0) {
+                        bench.add(prefix + "encode/" + suffix + "/efficiency", Unit::Efficiency,
+                                  encodeRate / (encodeBase * static_cast<double>(threads)));
+                    }
+                    if (decodeBase > 0.0) {
+                        bench.add(prefix + "decode/" + suffix + "/efficiency", Unit::Efficiency,
+                                  decodeRate / (decodeBase * static_cast<double>(threads)));
+                    }
+                }
+            }
+        }
+    }
+    ThreadPool::setSharedThreads(0);
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    out << "{\n";
+    out << "  \"simd\": \"" << kernels8x8().name << "\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"results\": [\n";
+    // One result per line, so baselines diff cleanly
+    for (size_t i = 0; i < results.size(); i++) {
+        char value[64];
+        std::snprintf(value, sizeof(value), "%.4f", results[i].value);
+        out << "    {\"name\": \"" << results[i].name << "\", \"unit\": \"" << unitName(results[i].unit)
+            << "\", \"value\": " << value << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Reads the "results" lines of a file written by writeJson()
+bool readJson(const std::string& path, std::map<std::string, Result>& results) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    auto field = [](const std::string& line, const std::string& key, std::string& value) {
+        const std::string marker = "\"" + key + "\": ";
+        const size_t start = line.find(marker);
+        if (start == std::string::npos) {
+            return false;
+        }
+        size_t begin = start + marker.size();
+        size_t end = 0;
+        if (line[begin] == '"') {
+            begin++;
+            end = line.find('"', begin);
+        } else {
+            end = line.find_first_of(",}", begin);
+        }
+        if (end == std::string::npos) {
+            return false;
+        }
+        value = line.substr(begin, end - begin);
+        return true;
+    };
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string name;
+        std::string unit;
+        std::string value;
+        Result result;
+        if (field(line, "name", name) && field(line, "unit", unit) && field(line, "value", value) &&
+            parseUnit(unit, result.unit)) {
+            result.name = name;
+            result.value = std::strtod(value.c_str(), nullptr);
+            results[name] = result;
+        }
+    }
+    return true;
+}
+
+// Prints the change of every result against the baseline; returns the
+// number that got worse by more than `tolerance` percent
+int compare(const std::vector<Result>& results, const std::map<std::string, Result>& baseline,
+            double tolerance) {
+    std::printf("\n[Baseline]\n");
+    int regressions = 0;
+    for (const Result& result : results) {
+        const auto found = baseline.find(result.name);
+        if (found == baseline.end() || found->second.unit != result.unit || found->second.value <= 0.0) {
+            continue;
+        }
+        // Positive = better, in percent
+        const double before = found->second.value;
+        const double change = result.unit == Unit::NsPerBlock ? (before / result.value - 1.0) * 100.0
+                                                              : (result.value / before - 1.0) * 100.0;
+        const bool regressed = change < -tolerance;
+        regressions += regressed ? 1 : 0;
+        std::printf("  %-44s %12.3f -> %12.3f %s  %+7.1f%%%s\n", result.name.c_str(), before,
+                    result.value, unitName(result.unit), change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+std::vector<size_t> parseThreadCounts(const std::string& text) {
+    std::vector<size_t> counts;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        const size_t count = std::strtoul(item.c_str(), nullptr, 10);
+        if (count > 0) {
+            counts.push_back(count);
+        }
+    }
+    return counts;
+}
+
+void printUsage(const char* progName) {
+    std::printf("Usage: %s [--quick] [--json <out.json>] [--baseline <base.json>] [--tolerance <percent>]\n"
+                "       [--threads <n,n,...>] [--filter <substring>]\n", progName);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--quick") {
+            settings.minSeconds = 0.02;
+            settings.repeats = 1;
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            settings.threadCounts = parseThreadCounts(argv[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            settings.filter = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // 1, 2, 4, ... up to the hardware threads by default
+    if (settings.threadCounts.empty()) {
+        const size_t hardwareThreads = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+        for (size_t threads = 1; threads < hardwareThreads; threads *= 2) {
+            settings.threadCounts.push_back(threads);
+        }
+        settings.threadCounts.push_back(hardwareThreads);
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!baselinePath.empty() && !readJson(baselinePath, baseline)) {
+        std::fprintf(stderr, "Cannot read baseline: %s\n", baselinePath.c_str());
+        return 1;
+    }
+
+    std::printf("EzCodec benchmark (kernels: %s, %u hardware threads)\n", kernels8x8().name,
+                std::thread::hardware_concurrency());
+
+    Bench bench(settings);
+    benchDCT(bench);
+    benchKernels(bench);
+    benchQuantization(bench);
+    benchColor(bench);
+    benchFormat(bench, std::filesystem::temp_directory_path().string());
+    benchEndToEnd(bench);
+
+    if (!jsonPath.empty()) {
+        if (!writeJson(jsonPath, bench.all())) {
+            std::fprintf(stderr, "Cannot write %s\n", jsonPath.c_str());
+            return 1;
+        }
+        std::printf("\nWrote %s\n", jsonPath.c_str());
+    }
+
+    if (!baseline.empty()) {
+        const int regressions = compare(bench.all(), baseline, tolerance);
+        std::printf("%d regression(s) beyond %.1f%%\n", regressions, tolerance);
+        return regressions > 0 ? 1 : 0;
+    }
+    return 0;
+}
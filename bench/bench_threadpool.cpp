@@ -0,0 +1,138 @@
+// ThreadPool contention benchmark: compares the shared-queue and the
+// work-stealing schedulers on parallelFor() calls made of many tiny chunks,
+// where scheduling overhead rather than the work itself dominates. The
+// enqueue-per-task baseline submits every chunk (and every nested inner
+// chunk) as its own enqueue() on the mutex-protected shared queue, the way
+// work was scheduled before parallelFor() existed.
+//
+//   ezcodec_bench_threadpool [maxThreads]
+
+#include "ezcodec/ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t FLAT_ITEMS = 200000;
+constexpr size_t NESTED_OUTER = 256;
+constexpr size_t NESTED_INNER = 256;
+constexpr int REPEATS = 3;
+
+// A few nanoseconds of work the compiler cannot drop
+void tinyWork(size_t index, std::atomic<uint64_t>& sink) {
+    uint64_t x = index * 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < 8; i++) {
+        x ^= x >> 29;
+        x *= 0xBF58476D1CE4E5B9ull;
+    }
+    if (x == 0) {
+        sink.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<class F>
+double bestSeconds(F&& run) {
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+const char* schedulerName(ThreadPool::Scheduler scheduler) {
+    return scheduler == ThreadPool::Scheduler::WorkStealing ? "work-stealing" : "shared-queue";
+}
+
+// One enqueue() and one future per item
+void flatEnqueue(ThreadPool& pool, std::atomic<uint64_t>& sink) {
+    std::vector<std::future<void>> futures;
+    futures.reserve(FLAT_ITEMS);
+    for (size_t i = 0; i < FLAT_ITEMS; i++) {
+        futures.push_back(pool.enqueue([i, &sink] { tinyWork(i, sink); }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+}
+
+// Every outer task enqueues its inner tasks. Outer tasks hand their futures
+// back instead of waiting on them, since a worker blocked on a task queued
+// behind it would deadlock the FIFO queue.
+void nestedEnqueue(ThreadPool& pool, std::atomic<uint64_t>& sink) {
+    std::vector<std::future<std::vector<std::future<void>>>> outerFutures;
+    outerFutures.reserve(NESTED_OUTER);
+    for (size_t outer = 0; outer < NESTED_OUTER; outer++) {
+        outerFutures.push_back(pool.enqueue([outer, &pool, &sink] {
+            std::vector<std::future<void>> innerFutures;
+            innerFutures.reserve(NESTED_INNER);
+            for (size_t inner = 0; inner < NESTED_INNER; inner++) {
+                innerFutures.push_back(pool.enqueue([outer, inner, &sink] {
+                    tinyWork(outer * NESTED_INNER + inner, sink);
+                }));
+            }
+            return innerFutures;
+        }));
+    }
+    for (auto& outerFuture : outerFutures) {
+        for (auto& innerFuture : outerFuture.get()) {
+            innerFuture.get();
+        }
+    }
+}
+
+void printRow(const char* name, size_t threads, double flat, double nested) {
+    std::printf("%-16s %8zu %16.0f %16.0f\n", name, threads,
+                FLAT_ITEMS / flat, (NESTED_OUTER * NESTED_INNER) / nested);
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = 64;
+    if (argc > 1) {
+        maxThreads = std::strtoul(argv[1], nullptr, 10);
+    }
+
+    std::atomic<uint64_t> sink{0};
+
+    std::printf("%-16s %8s %16s %16s\n", "scheduler", "threads", "flat chunks/s", "nested chunks/s");
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        {
+            ThreadPool pool(threads, ThreadPool::Scheduler::SharedQueue);
+            double flat = bestSeconds([&] { flatEnqueue(pool, sink); });
+            double nested = bestSeconds([&] { nestedEnqueue(pool, sink); });
+            printRow("enqueue-per-task", threads, flat, nested);
+        }
+
+        for (auto scheduler : {ThreadPool::Scheduler::SharedQueue, ThreadPool::Scheduler::WorkStealing}) {
+            ThreadPool pool(threads, scheduler);
+
+            double flat = bestSeconds([&] {
+                pool.parallelFor(0, FLAT_ITEMS, 1, [&](size_t begin, size_t) {
+                    tinyWork(begin, sink);
+                });
+            });
+
+            double nested = bestSeconds([&] {
+                pool.parallelFor(0, NESTED_OUTER, 1, [&](size_t outer, size_t) {
+                    pool.parallelFor(0, NESTED_INNER, 1, [&](size_t inner, size_t) {
+                        tinyWork(outer * NESTED_INNER + inner, sink);
+                    });
+                });
+            });
+
+            printRow(schedulerName(scheduler), threads, flat, nested);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ezcodec/Codec.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Batch coding of many files in one process. Images are processed by a
+// fixed number of slots on the shared thread pool; each slot takes the
+// next file, loads it, transforms it (itself split across the pool) and
+// writes the result, then moves on, reusing one Encoder or Decoder for
+// every file. While one slot waits on the disk or the PNG codec, the
+// others keep the cores busy with their own images, so reading, compute
+// and writing overlap across files.
+struct BatchOptions {
+    EncodeOptions encode;   // encode only; file options apply to every output
+    size_t maxInFlight = 0; // images open at once, 0 = one per pool thread (also the upper limit)
+};
+
+// Files to code from `source`: the matching files of a directory (images
+// stb_image reads for encode, .ezc for decode; not recursive, sorted by
+// name), or else a text file listing one path per line. Returns false,
+// after printing why, when the source cannot be read or lists nothing.
+bool collectBatchInputs(const std::string& source, bool decode, std::vector<std::string>& inputs);
+
+// Encode every input to <outputDir>/<stem>.ezc, creating the directory if
+// needed. A failed file is reported and skipped. Returns 0 when every file
+// was coded, non-zero otherwise.
+int encodeBatch(const std::vector<std::string>& inputs,
+                const std::string& outputDir,
+                const BatchOptions& options);
+
+// Decode every input to <outputDir>/<stem>.png (gray or RGB)
+int decodeBatch(const std::vector<std::string>& inputs,
+                const std::string& outputDir,
+                const BatchOptions& options);
@@ -4,6 +4,8 @@
 #include <stdexcept>
 #include <algorithm>
 #include <type_traits>
+#include <utility>
+#include <cstdint>
 
 enum class TxSize {
     TX_4x4   = 16,
@@ -34,6 +36,13 @@ struct is_numeric {
 template<typename T>
 inline constexpr bool is_numeric_v = is_numeric<T>::value;
 
+// Element type and transform size of any block-like type (Block, BlockView)
+template<typename B>
+using block_element_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<B&>()[0])>>;
+
+template<typename B>
+inline constexpr TxSize block_size_v = std::remove_reference_t<B>::block_size_type;
+
 template<
     typename T = uint16_t,
     TxSize Size = TxSize::TX_8x8,
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ezcodec/Block.h"
+#include "ezcodec/EntropyCoding.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Transform sizes of one plane coded with adaptive block sizes. The plane's
+// 8x8 block grid is tiled with superblocks of 4x4 cells (32x32 pixels),
+// each split as a quadtree: a 32x32 node is one transform or four 16x16
+// nodes, a 16x16 node one transform or four 8x8 cells, and a cell one 8x8
+// transform or four 4x4 ones. Nodes that reach past the grid are always
+// split.
+//
+// Every transform is coded as one 64-coefficient unit, so the entropy
+// coder, the 8x8 quantizer tables and the dequantize kernels apply
+// unchanged. Units are stored in the raster order of the cell at the
+// top-left of their node; the other cells of a 16x16 or 32x32 node carry
+// nothing. A 16x16 or 32x32 node keeps only the 8x8 lowest frequencies of
+// its DCT (the rest is zeroed out, as in VVC), scaled by 8 / dim so the
+// values match an 8x8 DCT of the same content. A cell of four 4x4
+// transforms interleaves them: coefficient (u, v) of the sub-block in row
+// a, column b goes to unit position (2v + a, 2u + b), scaled by 2.
+class BlockPartition {
+public:
+    // Cells along each side of a superblock
+    static constexpr size_t SUPERBLOCK_CELLS = 4;
+
+    BlockPartition() = default;
+
+    // Every cell an 8x8 transform
+    BlockPartition(size_t cellsX, size_t cellsY);
+
+    [[nodiscard]] size_t cellsX() const { return width; }
+    [[nodiscard]] size_t cellsY() const { return height; }
+
+    // Transform covering cell (x, y); TX_4x4 for a cell of four 4x4 ones
+    [[nodiscard]] TxSize size(size_t x, size_t y) const { return sizes[y * width + x]; }
+
+    // True when cell (x, y) is the top-left cell of its transform, i.e.
+    // carries a coded unit
+    [[nodiscard]] bool isCoded(size_t x, size_t y) const {
+        const size_t cells = cellsOf(size(x, y));
+        return x % cells == 0 && y % cells == 0;
+    }
+
+    // Coded units in cell rows [rowBegin, rowEnd)
+    [[nodiscard]] size_t codedCount(size_t rowBegin, size_t rowEnd) const;
+
+    // True when a node `cells` cells wide at cell (x, y) lies inside the grid
+    [[nodiscard]] bool fits(size_t x, size_t y, size_t cells) const {
+        return x + cells <= width && y + cells <= height;
+    }
+
+    // Make the node at cell (x, y) one transform of `size`, covering
+    // cellsOf(size) cells each way; (x, y) must be aligned to it
+    void set(size_t x, size_t y, TxSize size);
+
+    // Quadtree split flags, one bit per node that fits (1 = split),
+    // depth first with superblocks and children in raster order
+    void serialize(BitWriter& writer) const;
+
+    // Rebuild the partition of a cellsX x cellsY grid from serialize()
+    // bits. Returns false when the reader runs out of bits.
+    bool deserialize(BitReader& reader, size_t cellsX, size_t cellsY);
+
+    bool operator==(const BlockPartition& other) const {
+        return width == other.width && height == other.height && sizes == other.sizes;
+    }
+    bool operator!=(const BlockPartition& other) const { return !(*this == other); }
+
+    // Cells along each side of a transform (1 for TX_4x4 and TX_8x8)
+    [[nodiscard]] static size_t cellsOf(TxSize size) {
+        return size == TxSize::TX_4x4 ? 1 : static_cast<size_t>(getTxDimension(size)) / 8;
+    }
+
+    // Pixels along each side of the node a transform codes (8 for TX_4x4)
+    [[nodiscard]] static size_t nodeDimension(TxSize size) { return cellsOf(size) * 8; }
+
+    // Forward transform of a TX_4x4, TX_16x16 or TX_32x32 node into its
+    // unit, before quantization (8x8 cells use the block kernels).
+    // `samples` holds the nodeDimension() x nodeDimension() pixels row by
+    // row. Returns the squared error the unit leaves out: the energy of the
+    // coefficients a 16x16 or 32x32 node zeroes out.
+    static double forwardUnit(TxSize size, const uint16_t* samples, int16_t* unit);
+
+    // Inverse of forwardUnit() on dequantized coefficients: the node's
+    // pixels, rounded but not clamped
+    static void inverseUnit(TxSize size, const int16_t* unit, int16_t* samples);
+
+    // Factor from unit values to the node's orthonormal DCT coefficients
+    [[nodiscard]] static double unitScale(TxSize size) {
+        return size == TxSize::TX_4x4 ? 0.5 : static_cast<double>(cellsOf(size));
+    }
+
+private:
+    void writeNode(BitWriter& writer, size_t x, size_t y, size_t cells) const;
+    void readNode(BitReader& reader, size_t x, size_t y, size_t cells);
+
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<TxSize> sizes;
+};
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "ezcodec/Block.h"
+#include "ezcodec/Trace.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Non-owning view of one block stored elsewhere (usually in a BlockPlane).
+// Mirrors the Block element-access API so the DCT and quantization
+// templates accept either. T may be const for read-only views.
+template<typename T = uint16_t, TxSize Size = TxSize::TX_8x8>
+class BlockView {
+public:
+    static constexpr TxSize block_size_type = Size;
+    static constexpr size_t block_element_count = getTxElementCount(Size);
+    static constexpr int block_dimension = getTxDimension(Size);
+
+    BlockView(T* ptr, int x, int y)
+        : data(ptr)
+        , blockX(x)
+        , blockY(y) {}
+
+    // Read-only view of a mutable view
+    template<typename U = T, typename = std::enable_if_t<!std::is_const_v<U>>>
+    operator BlockView<const U, Size>() const {
+        return BlockView<const U, Size>(data, blockX, blockY);
+    }
+
+    [[nodiscard]] T& operator[](size_t index) const {
+        return data[index];
+    }
+
+    [[nodiscard]] T& at(size_t index) const {
+        if (index >= block_element_count) {
+            throw std::out_of_range("Block index out of range");
+        }
+        return data[index];
+    }
+
+    [[nodiscard]] T& at(size_t row, size_t col) const {
+        if (row >= block_dimension || col >= block_dimension) {
+            throw std::out_of_range("Block coordinates out of range");
+        }
+        return data[row * block_dimension + col];
+    }
+
+    [[nodiscard]] int getBlockX() const { return blockX; }
+    [[nodiscard]] int getBlockY() const { return blockY; }
+
+    [[nodiscard]] constexpr size_t size() const { return block_element_count; }
+    [[nodiscard]] constexpr int dimension() const { return block_dimension; }
+    [[nodiscard]] constexpr TxSize sizeType() const { return block_size_type; }
+
+    [[nodiscard]] T* getData() const { return data; }
+
+    void fill(std::remove_const_t<T> value) const {
+        std::fill_n(data, block_element_count, value);
+    }
+
+private:
+    T* data;
+    int blockX;
+    int blockY;
+};
+
+// Read-only, non-owning view of one block inside an image stored row by
+// row, `stride` elements apart, such as the stbi_load buffer of a Picture:
+// elements are read in place, nothing is copied. A block on the right or
+// bottom border that reaches past the image repeats its last column and
+// row (edge replication); interior blocks read every element directly.
+// Element access returns values, so the DCT templates take it as a source
+// block like Block and BlockView.
+template<typename T = unsigned char, TxSize Size = TxSize::TX_8x8>
+class StridedBlockView {
+public:
+    static constexpr TxSize block_size_type = Size;
+    static constexpr size_t block_element_count = getTxElementCount(Size);
+    static constexpr int block_dimension = getTxDimension(Size);
+
+    // Block (blockX, blockY) of the block grid of a width x height image
+    // at `pixels`; the block must start inside the image
+    StridedBlockView(const T* pixels, size_t width, size_t height, size_t stride, int blockX, int blockY)
+        : origin(pixels + static_cast<size_t>(blockY) * block_dimension * stride +
+                 static_cast<size_t>(blockX) * block_dimension)
+        , stride(stride)
+        , lastCol(std::min<size_t>(block_dimension, width - static_cast<size_t>(blockX) * block_dimension) - 1)
+        , lastRow(std::min<size_t>(block_dimension, height - static_cast<size_t>(blockY) * block_dimension) - 1)
+        , blockX(blockX)
+        , blockY(blockY) {}
+
+    [[nodiscard]] T operator[](size_t index) const {
+        return value(index / block_dimension, index % block_dimension);
+    }
+
+    [[nodiscard]] T at(size_t index) const {
+        if (index >= block_element_count) {
+            throw std::out_of_range("Block index out of range");
+        }
+        return (*this)[index];
+    }
+
+    [[nodiscard]] T at(size_t row, size_t col) const {
+        if (row >= block_dimension || col >= block_dimension) {
+            throw std::out_of_range("Block coordinates out of range");
+        }
+        return value(row, col);
+    }
+
+    // True when the block reaches past the right or bottom edge
+    [[nodiscard]] bool isBorder() const {
+        return lastCol + 1 < block_dimension || lastRow + 1 < block_dimension;
+    }
+
+    // All elements in row-major order into `dst`: whole rows for interior
+    // blocks, replicated edges for border ones
+    template<typename U>
+    void copyTo(U* dst) const {
+        if (!isBorder()) {
+            for (size_t row = 0; row < block_dimension; row++) {
+                std::copy_n(origin + row * stride, block_dimension, dst + row * block_dimension);
+            }
+            return;
+        }
+        for (size_t row = 0; row < block_dimension; row++) {
+            const T* source = origin + std::min(row, lastRow) * stride;
+            U* out = dst + row * block_dimension;
+            std::copy_n(source, lastCol + 1, out);
+            std::fill(out + lastCol + 1, out + block_dimension, static_cast<U>(source[lastCol]));
+        }
+    }
+
+    [[nodiscard]] int getBlockX() const { return blockX; }
+    [[nodiscard]] int getBlockY() const { return blockY; }
+
+    [[nodiscard]] constexpr size_t size() const { return block_element_count; }
+    [[nodiscard]] constexpr int dimension() const { return block_dimension; }
+    [[nodiscard]] constexpr TxSize sizeType() const { return block_size_type; }
+
+private:
+    [[nodiscard]] T value(size_t row, size_t col) const {
+        return origin[std::min(row, lastRow) * stride + std::min(col, lastCol)];
+    }
+
+    const T* origin;
+    size_t stride;
+    size_t lastCol;
+    size_t lastRow;
+    int blockX;
+    int blockY;
+};
+
+// All blocks of an image in one contiguous, cache-line aligned buffer,
+// block after block in raster order (blockY-major). Block i starts at
+// data() + i * block_element_count, so the v1 .ezc payload layout and the
+// in-memory layout are the same.
+template<
+    typename T = uint16_t,
+    TxSize Size = TxSize::TX_8x8,
+    typename = std::enable_if_t<is_numeric_v<T>>
+>
+class BlockPlane {
+public:
+    static constexpr TxSize block_size_type = Size;
+    static constexpr size_t block_element_count = getTxElementCount(Size);
+    static constexpr int block_dimension = getTxDimension(Size);
+    static constexpr size_t alignment = 64;
+
+    using View = BlockView<T, Size>;
+    using ConstView = BlockView<const T, Size>;
+
+    BlockPlane() = default;
+
+    BlockPlane(int blockCountX, int blockCountY) {
+        resize(blockCountX, blockCountY);
+    }
+
+    BlockPlane(const BlockPlane&) = delete;
+    BlockPlane& operator=(const BlockPlane&) = delete;
+    BlockPlane(BlockPlane&& other) noexcept
+        : buffer(std::move(other.buffer))
+        , capacity(std::exchange(other.capacity, 0))
+        , countX(std::exchange(other.countX, 0))
+        , countY(std::exchange(other.countY, 0)) {}
+
+    BlockPlane& operator=(BlockPlane&& other) noexcept {
+        if (this != &other) {
+            buffer = std::move(other.buffer);
+            capacity = std::exchange(other.capacity, 0);
+            countX = std::exchange(other.countX, 0);
+            countY = std::exchange(other.countY, 0);
+        }
+        return *this;
+    }
+
+    ~BlockPlane() = default;
+
+    // Zero-filled storage for blockCountX * blockCountY blocks. Reuses the
+    // existing buffer when it is large enough.
+    void resize(int blockCountX, int blockCountY) {
+        countX = blockCountX;
+        countY = blockCountY;
+        const size_t elements = blockCount() * block_element_count;
+        if (elements > capacity) {
+            buffer.reset(static_cast<T*>(::operator new[](elements * sizeof(T),
+                                                          std::align_val_t{alignment})));
+            capacity = elements;
+            Trace::count(Trace::Counter::Allocations);
+            Trace::count(Trace::Counter::AllocatedBytes, elements * sizeof(T));
+        }
+        std::fill_n(buffer.get(), elements, T{});
+    }
+
+    [[nodiscard]] View operator[](size_t index) {
+        return View(buffer.get() + index * block_element_count,
+                    static_cast<int>(index % countX), static_cast<int>(index / countX));
+    }
+
+    [[nodiscard]] ConstView operator[](size_t index) const {
+        return ConstView(buffer.get() + index * block_element_count,
+                         static_cast<int>(index % countX), static_cast<int>(index / countX));
+    }
+
+    [[nodiscard]] View at(int blockX, int blockY) {
+        if (blockX < 0 || blockY < 0 || blockX >= countX || blockY >= countY) {
+            throw std::out_of_range("Block coordinates out of range");
+        }
+        return (*this)[static_cast<size_t>(blockY) * countX + blockX];
+    }
+
+    [[nodiscard]] ConstView at(int blockX, int blockY) const {
+        if (blockX < 0 || blockY < 0 || blockX >= countX || blockY >= countY) {
+            throw std::out_of_range("Block coordinates out of range");
+        }
+        return (*this)[static_cast<size_t>(blockY) * countX + blockX];
+    }
+
+    [[nodiscard]] size_t size() const { return blockCount(); }
+    [[nodiscard]] bool empty() const { return blockCount() == 0; }
+    [[nodiscard]] int blockCountX() const { return countX; }
+    [[nodiscard]] int blockCountY() const { return countY; }
+
+    [[nodiscard]] T* data() { return buffer.get(); }
+    [[nodiscard]] const T* data() const { return buffer.get(); }
+
+private:
+    struct AlignedDelete {
+        void operator()(T* p) const {
+            ::operator delete[](p, std::align_val_t{alignment});
+        }
+    };
+
+    [[nodiscard]] size_t blockCount() const {
+        return static_cast<size_t>(countX) * static_cast<size_t>(countY);
+    }
+
+    std::unique_ptr<T[], AlignedDelete> buffer;
+    size_t capacity = 0;
+    int countX = 0;
+    int countY = 0;
+};
+
+// Common plane type aliases
+using BlockPlane8x8i16  = BlockPlane<int16_t, TxSize::TX_8x8>;
+using BlockPlane8x8ui16 = BlockPlane<uint16_t, TxSize::TX_8x8>;
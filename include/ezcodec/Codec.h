@@ -1,14 +1,195 @@
 #pragma once
 
+#include "ezcodec/ColorConversion.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+struct EncodeOptions {
+    int  quality    = 50;    // 1-100
+    bool fixedPoint = false; // integer-only transform, bit-exact on every host
+    int  sliceRows  = 16;    // block rows per independently decodable slice, 0 = one bitstream
+    bool atomicWrite = false; // write to a temporary file, then rename over the output
+    bool sync        = false; // fsync the output before returning
+    // Gray codes the luma of the image only. The YCbCr formats code Y, Cb
+    // and Cr planes, the chroma planes with the JPEG chrominance table and
+    // subsampled as named; sliceRows 0 then means one slice per plane.
+    ChromaFormat chroma = ChromaFormat::Gray;
+    // Byte budget instead of a fixed quality: the highest quality whose
+    // file fits in targetSize bytes, or in targetBpp bits per pixel, is
+    // searched for on the DCT coefficients, which are computed only once.
+    // If even quality 1 does not fit, the image is coded at quality 1.
+    // targetSize wins when both are set; 0 means off. Not for streaming.
+    uint64_t targetSize = 0;
+    double   targetBpp  = 0.0;
+    // Custom base quantization tables instead of the JPEG ones: 64 step
+    // sizes in row-major order for luma and gray, optionally followed by 64
+    // for chroma (else the luma table is used for both). They are scaled
+    // by quality like the JPEG tables, so quality 50 uses them as given,
+    // and the scaled tables are stored in the file.
+    std::vector<uint16_t> quantTables;
+    // Pick the transform size per region instead of 8x8 everywhere: each
+    // 32x32 superblock is split as a quadtree into 32x32, 16x16, 8x8 and
+    // 4x4 transforms by a rate-distortion cost at the coding quality, so
+    // flat areas take one large transform and edges small ones. The
+    // partition is stored in the file. Not with fixedPoint or streaming;
+    // sliceRows is rounded up to a multiple of 4, and such files decode
+    // only at full size (no region, scaled or streaming decode).
+    bool adaptiveBlocks = false;
+};
 
 // Encode a PNG image to .ezc format.
 // Returns 0 on success, non-zero on failure.
+int encode(const std::string& inputPng,
+           const std::string& outputEzc,
+           const EncodeOptions& options);
+
 int encode(const std::string& inputPng,
            const std::string& outputEzc,
            int quality);
 
-// Decode an .ezc file back to a PNG image.
+// Decode an .ezc file back to a PNG image. Files written with
+// EncodeOptions::fixedPoint are decoded with the matching integer transform.
+// Color files give an RGB PNG, with the chroma planes upsampled first.
 // Returns 0 on success, non-zero on failure.
 int decode(const std::string& inputEzc,
            const std::string& outputPng);
+
+// Blocks per inverse transform path. Decoding picks the path from the
+// extent of each block's non-zero coefficients: a constant fill for
+// DC-only blocks, a transform of the 4x4 low-frequency inputs when nothing
+// outside them is set, and the full 8x8 transform otherwise.
+struct InverseTransformCounts {
+    uint64_t dcOnly  = 0;
+    uint64_t lowBand = 0;
+    uint64_t full    = 0;
+};
+
+// Totals over all decodes in this process (decode(), decodeRegion() and
+// decodeStream(); decodeScaled() has its own reduced transforms)
+InverseTransformCounts inverseTransformCounts();
+
+// Decode an .ezc file at 1/denominator of its size (denominator 1, 2, 4
+// or 8) for thumbnails and previews. Each block goes through a 4x4, 2x2 or
+// 1x1 inverse transform of its low-frequency coefficients, so no
+// full-resolution image is ever built; 1/8 uses the DC coefficient alone.
+// The output is ceil(width / denominator) x ceil(height / denominator);
+// color files scale every plane, then upsample the chroma.
+// Returns 0 on success, non-zero on failure.
+int decodeScaled(const std::string& inputEzc,
+                 const std::string& outputPng,
+                 int denominator);
+
+// Crop rectangle in pixels
+struct Region {
+    uint32_t x      = 0;
+    uint32_t y      = 0;
+    uint32_t width  = 0;
+    uint32_t height = 0;
+};
+
+// Decode only the part of an .ezc file inside `region` (clipped to the
+// image) and write it as a PNG of the crop size. Only the blocks that
+// intersect the crop are dequantized and inverse-transformed, and only the
+// slices that contain them are read. Pixels are identical to the same crop
+// of a full decode(). Gray files only.
+// Returns 0 on success, non-zero on failure.
+int decodeRegion(const std::string& inputEzc,
+                 const std::string& outputPng,
+                 const Region& region);
+
+// Streaming variants for images larger than memory. encodeStream() reads an
+// 8-bit binary PGM strip by strip (EncodeOptions::sliceRows block rows per
+// strip, at least one) and writes a version 3 .ezc file; decodeStream()
+// writes any .ezc file back to PGM the same way. Only a batch of strips is
+// held in memory at a time. Both are gray only.
+int encodeStream(const std::string& inputPgm,
+                 const std::string& outputEzc,
+                 const EncodeOptions& options);
+
+int decodeStream(const std::string& inputEzc,
+                 const std::string& outputPgm);
+
+// 8-bit pixels in memory: `channels` interleaved samples per pixel (1 =
+// gray, 3 = RGB), rows `stride` bytes apart (0 = width * channels)
+struct ImageView {
+    const uint8_t* pixels = nullptr;
+    uint32_t width    = 0;
+    uint32_t height   = 0;
+    int      channels = 1;
+    size_t   stride   = 0;
+};
+
+// What Decoder::decode() produced
+struct ImageInfo {
+    uint32_t width    = 0;
+    uint32_t height   = 0;
+    int      channels = 0; // 1 for gray files, 3 for color
+    int      quality  = 0;
+    ChromaFormat chroma = ChromaFormat::Gray;
+};
+
+// In-memory encoder for services that code many images: pixels in, .ezc
+// bytes out, with no files and nothing printed. The quantization tables,
+// coefficient planes, color planes and entropy coder buffers are kept
+// between calls, so once it has seen an image of a given size, encoding
+// another one allocates nothing beyond growing `out`. Work runs on the
+// shared thread pool. One Encoder must not be used by two threads at once;
+// use one per thread instead.
+class Encoder {
+public:
+    explicit Encoder(const EncodeOptions& options = {});
+    ~Encoder();
+
+    Encoder(Encoder&&) noexcept;
+    Encoder& operator=(Encoder&&) noexcept;
+
+    [[nodiscard]] const EncodeOptions& options() const;
+    void setOptions(const EncodeOptions& options);
+
+    // Replace the contents of `out` with the .ezc file of `image`, byte
+    // for byte what encode() would write (version 2, so at most 65535
+    // pixels per side). Gray images are coded as gray whatever
+    // options.chroma says; RGB images use options.chroma, where Gray
+    // keeps only the luma. The file options (atomicWrite, sync) are
+    // ignored. Returns false, after printing why to std::cerr, on invalid
+    // input or when the coded payload passes the 4 GiB of version 2.
+    bool encode(const ImageView& image, std::vector<uint8_t>& out);
+
+    // Quality the last encode() coded with: options.quality, or the
+    // quality found for options.targetSize / targetBpp
+    [[nodiscard]] int lastQuality() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+// In-memory decoder, the counterpart of Encoder: .ezc bytes in, pixels
+// out. The slice table, reconstruction tables and chroma planes are kept
+// between calls. Same threading rules as Encoder.
+class Decoder {
+public:
+    Decoder();
+    ~Decoder();
+
+    Decoder(Decoder&&) noexcept;
+    Decoder& operator=(Decoder&&) noexcept;
+
+    // Decode a complete .ezc file (any version) into `pixels`, resized to
+    // info.width * info.height * info.channels: gray for gray files,
+    // interleaved RGB for color ones. The bytes are only read during the
+    // call. Returns false, after printing why to std::cerr, on invalid or
+    // corrupt data.
+    bool decode(const uint8_t* data, size_t size, std::vector<uint8_t>& pixels, ImageInfo& info);
+
+    // Blocks per inverse transform path in the last decode()
+    [[nodiscard]] InverseTransformCounts lastCounts() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
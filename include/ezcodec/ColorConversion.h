@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ezcodec/Kernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plane layout of an image. Gray images are a single luma plane; color
+// images are coded as Y, Cb and Cr planes with the chroma planes optionally
+// subsampled (JPEG naming: 4:2:2 halves their width, 4:2:0 their width and
+// height).
+enum class ChromaFormat {
+    Gray,
+    YCbCr444,
+    YCbCr422,
+    YCbCr420
+};
+
+// Chroma subsampling factors (1 or 2) of a format
+[[nodiscard]] int chromaFactorX(ChromaFormat format);
+[[nodiscard]] int chromaFactorY(ChromaFormat format);
+
+[[nodiscard]] const char* chromaFormatName(ChromaFormat format);
+
+// Row kernels for color conversion, one set per SimdLevel like Kernels8x8.
+// The conversion is full-range BT.601 YCbCr as in JFIF, computed with
+// 14-bit fixed-point coefficients and saturated to [0, 255]; every level
+// produces exactly the same bytes.
+struct ColorKernels {
+    SimdLevel level;
+    const char* name;
+
+    // `count` interleaved RGB pixels -> separate Y, Cb and Cr rows
+    void (*rgbToYCbCr)(const uint8_t* rgb, uint8_t* y, uint8_t* cb, uint8_t* cr, size_t count);
+
+    // Separate Y, Cb and Cr rows -> `count` interleaved RGB pixels
+    void (*yCbCrToRgb)(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count);
+
+    // One output row of 2x chroma upsampling with triangular ("fancy")
+    // filters. `nearRow` is the chroma row closest to the output row and
+    // `farRow` the next closest (the same row for horizontal-only
+    // upsampling); each holds (dstCount + 1) / 2 samples. Vertically the
+    // rows are weighted 3:1, horizontally each output sample weights its
+    // own column 3:1 against the neighbour on its side, with edge samples
+    // repeated.
+    void (*upsampleRow2x)(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst, size_t dstCount);
+};
+
+// Kernels for the detected SIMD level (see detectSimdLevel())
+[[nodiscard]] const ColorKernels& colorKernels();
+
+// Kernels for a specific level, or nullptr when it is not available
+[[nodiscard]] const ColorKernels* colorKernelsFor(SimdLevel level);
+
+// Whole-image conversions on the shared thread pool.
+//
+// rgbToPlanes() converts interleaved RGB into a full-size Y plane and Cb/Cr
+// planes of ceil(width / factorX) x ceil(height / factorY) samples, each
+// the mean of the pixels it covers; source rows are `stride` bytes apart.
+// planesToRgb() upsamples the chroma planes back and converts to
+// interleaved RGB.
+void rgbToPlanes(const uint8_t* rgb, size_t width, size_t height, size_t stride, ChromaFormat format,
+                 std::vector<uint8_t>& y, std::vector<uint8_t>& cb, std::vector<uint8_t>& cr);
+
+void planesToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+                 size_t width, size_t height, ChromaFormat format, uint8_t* rgb);
@@ -1,12 +1,130 @@
 #pragma once
 
 #include "ezcodec/Block.h"
+#include "ezcodec/DCTBasis.h"
 #include <cmath>
+#include <utility>
 
 class DCT {
 public:
-    template<typename SrcT, typename DstT, TxSize Size>
-    static void forwardDCT(const Block<SrcT, Size>& srcBlock, Block<DstT, Size>& dstBlock) {
+    // Forward 2D DCT-II with orthonormal scaling. Blocks can be Block or
+    // BlockView of any numeric type with matching sizes.
+    // TX_8x8 goes through the factorized AAN transform; other sizes use the
+    // separable matrix transform with a compile-time basis.
+    template<typename SrcBlock, typename DstBlock>
+    static void forwardDCT(const SrcBlock& srcBlock, DstBlock&& dstBlock) {
+        constexpr TxSize Size = block_size_v<SrcBlock>;
+        static_assert(block_size_v<DstBlock> == Size, "Source and destination block sizes must match");
+        using DstT = block_element_t<DstBlock>;
+        if constexpr (Size == TxSize::TX_8x8) {
+            double in[64];
+            double out[64];
+            for (size_t i = 0; i < 64; i++) {
+                in[i] = static_cast<double>(srcBlock[i]);
+            }
+            forwardDCT8x8(in, out);
+            for (size_t i = 0; i < 64; i++) {
+                dstBlock[i] = static_cast<DstT>(out[i]);
+            }
+        } else {
+            constexpr size_t count = getTxElementCount(Size);
+            double in[count];
+            double out[count];
+            for (size_t i = 0; i < count; i++) {
+                in[i] = static_cast<double>(srcBlock[i]);
+            }
+            separableForwardDCT<Size>(in, out);
+            for (size_t i = 0; i < count; i++) {
+                dstBlock[i] = static_cast<DstT>(out[i]);
+            }
+        }
+    }
+
+    // Inverse 2D DCT (DCT-III) with orthonormal scaling.
+    template<typename SrcBlock, typename DstBlock>
+    static void inverseDCT(const SrcBlock& srcBlock, DstBlock&& dstBlock) {
+        constexpr TxSize Size = block_size_v<SrcBlock>;
+        static_assert(block_size_v<DstBlock> == Size, "Source and destination block sizes must match");
+        using DstT = block_element_t<DstBlock>;
+        if constexpr (Size == TxSize::TX_8x8) {
+            double in[64];
+            double out[64];
+            for (size_t i = 0; i < 64; i++) {
+                in[i] = static_cast<double>(srcBlock[i]);
+            }
+            inverseDCT8x8(in, out);
+            for (size_t i = 0; i < 64; i++) {
+                dstBlock[i] = static_cast<DstT>(out[i]);
+            }
+        } else {
+            constexpr size_t count = getTxElementCount(Size);
+            double in[count];
+            double out[count];
+            for (size_t i = 0; i < count; i++) {
+                in[i] = static_cast<double>(srcBlock[i]);
+            }
+            separableInverseDCT<Size>(in, out);
+            for (size_t i = 0; i < count; i++) {
+                dstBlock[i] = static_cast<DstT>(out[i]);
+            }
+        }
+    }
+
+    // Separable row-column transforms using DCTBasis<Size>: 2 * dim^3
+    // multiply-adds per block and no cos calls at run time. Each dot
+    // product is unrolled for the transform size. Buffers are dim*dim
+    // doubles in row-major order.
+    template<TxSize Size>
+    static void separableForwardDCT(const double* in, double* out) {
+        using Basis = DCTBasis<Size>;
+        constexpr int dim = Basis::dim;
+        const double* basis = Basis::matrix.data();
+
+        // Rows: temp[y][u] = sum_x in[y][x] * B[u][x]
+        double temp[Basis::count];
+        for (int y = 0; y < dim; y++) {
+            for (int u = 0; u < dim; u++) {
+                temp[y * dim + u] = dot<dim, 1>(in + y * dim, basis + u * dim);
+            }
+        }
+
+        // Columns: out[v][u] = sum_y B[v][y] * temp[y][u]
+        for (int v = 0; v < dim; v++) {
+            for (int u = 0; u < dim; u++) {
+                out[v * dim + u] = dot<dim, dim>(basis + v * dim, temp + u);
+            }
+        }
+    }
+
+    template<TxSize Size>
+    static void separableInverseDCT(const double* in, double* out) {
+        using Basis = DCTBasis<Size>;
+        constexpr int dim = Basis::dim;
+        const double* basisT = Basis::transposed.data();
+
+        // Rows: temp[v][x] = sum_u in[v][u] * B[u][x]
+        double temp[Basis::count];
+        for (int v = 0; v < dim; v++) {
+            for (int x = 0; x < dim; x++) {
+                temp[v * dim + x] = dot<dim, 1>(in + v * dim, basisT + x * dim);
+            }
+        }
+
+        // Columns: out[y][x] = sum_v B[v][y] * temp[v][x]
+        for (int y = 0; y < dim; y++) {
+            for (int x = 0; x < dim; x++) {
+                out[y * dim + x] = dot<dim, dim>(basisT + y * dim, temp + x);
+            }
+        }
+    }
+
+    // Direct O(n^4) evaluation of the DCT definition. Kept as the accuracy
+    // reference for the fast transforms.
+    template<typename SrcBlock, typename DstBlock>
+    static void referenceForwardDCT(const SrcBlock& srcBlock, DstBlock&& dstBlock) {
+        constexpr TxSize Size = block_size_v<SrcBlock>;
+        static_assert(block_size_v<DstBlock> == Size, "Source and destination block sizes must match");
+        using DstT = block_element_t<DstBlock>;
         constexpr int dim = getTxDimension(Size);
         constexpr size_t count = getTxElementCount(Size);
 
@@ -30,8 +148,11 @@ public:
         }
     }
 
-    template<typename SrcT, typename DstT, TxSize Size>
-    static void inverseDCT(const Block<SrcT, Size>& srcBlock, Block<DstT, Size>& dstBlock) {
+    template<typename SrcBlock, typename DstBlock>
+    static void referenceInverseDCT(const SrcBlock& srcBlock, DstBlock&& dstBlock) {
+        constexpr TxSize Size = block_size_v<SrcBlock>;
+        static_assert(block_size_v<DstBlock> == Size, "Source and destination block sizes must match");
+        using DstT = block_element_t<DstBlock>;
         constexpr int dim = getTxDimension(Size);
         constexpr size_t count = getTxElementCount(Size);
 
@@ -55,7 +176,76 @@ public:
         }
     }
 
+    // Factorized 8x8 transforms (Arai-Agui-Nakajima), row pass then column
+    // pass, 5 multiplies per 1D forward transform and 5 per inverse.
+    //
+    // Accuracy: the results differ from the reference implementation only
+    // by floating-point rounding (< 1e-9 relative). After conversion to an
+    // integer type a coefficient or pixel can therefore differ from the
+    // reference by at most 1, which is the documented tolerance. Existing
+    // .ezc files decode unchanged within that tolerance.
+    //
+    // All buffers are 64 doubles in row-major order.
+    static void forwardDCT8x8(const double* in, double* out);
+    static void inverseDCT8x8(const double* in, double* out);
+
+    // AAN kernels without the output/input scaling. forwardDCT8x8Raw()
+    // yields coefficient i multiplied by 1 / aanForwardScale()[i];
+    // inverseDCT8x8Prescaled() expects coefficient i already multiplied
+    // by aanInverseScale()[i]. Folding those factors into the quantization
+    // table (see Quantization::makeFoldedQuantTable) saves the 64 scaling
+    // multiplies per block.
+    static void forwardDCT8x8Raw(const double* in, double* out);
+    static void inverseDCT8x8Prescaled(const double* in, double* out);
+
+    [[nodiscard]] static const double* aanForwardScale();
+    [[nodiscard]] static const double* aanInverseScale();
+
+    // Fixed-point 8x8 transforms for the bit-exact pipeline. Integer
+    // arithmetic only: 13-bit basis constants (the 8x8 DCTBasis scaled by
+    // 2^13 and rounded), 2 extra fraction bits between the column and row
+    // passes, and every descale rounds half up, i.e. floor(x / 2^n + 1/2).
+    // Results are saturated to int16_t. Output is identical on every host
+    // and compiler; coefficients stay within 1-2 of forwardDCT8x8().
+    static void forwardDCT8x8Fixed(const uint16_t* src, int16_t* dst);
+    static void inverseDCT8x8Fixed(const int16_t* src, int16_t* dst);
+
+    // Sparse 8x8 inverse transforms for the common case of blocks with few
+    // non-zero coefficients after quantization.
+    //
+    // DC only: every output pixel is the same value. inverseDCT8x8DCOnly()
+    // is exact with the SIMD kernels and within 1 of the scalar AAN path;
+    // inverseDCT8x8DCOnlyFixed() is bit-exact with inverseDCT8x8Fixed().
+    static int16_t inverseDCT8x8DCOnly(int16_t dc);
+    static int16_t inverseDCT8x8DCOnlyFixed(int16_t dc);
+
+    // Low band: all non-zero coefficients lie in the top-left 4x4 corner,
+    // and only those 16 inputs are read. inverseDCT8x8LowBand() is the
+    // scalar float kernel behind Kernels8x8::inverseDCTLowBand;
+    // inverseDCT8x8LowBandFixed() is bit-exact with inverseDCT8x8Fixed().
+    static void inverseDCT8x8LowBand(const int16_t* src, int16_t* dst);
+    static void inverseDCT8x8LowBandFixed(const int16_t* src, int16_t* dst);
+
+    // Reduced-size inverse transforms for scaled decoding. From the
+    // low-frequency dim x dim corner of 64 dequantized coefficients (row
+    // stride 8), reconstruct a dim x dim block approximating the 8x8 block
+    // downscaled by 8 / dim; dim is 4, 2 or 1. At dim 1 this is the block
+    // mean from the DC coefficient alone. Integer arithmetic with the
+    // fixed-point rounding, so the output is identical on every host.
+    static void inverseDCT8x8Scaled(const int16_t* src, int16_t* dst, int dim);
+
 private:
+    // a[0..N) contiguous, b[0..N) with a fixed stride
+    template<int N, int StrideB>
+    static double dot(const double* a, const double* b) {
+        return dotUnrolled<StrideB>(a, b, std::make_index_sequence<N>{});
+    }
+
+    template<int StrideB, size_t... I>
+    static double dotUnrolled(const double* a, const double* b, std::index_sequence<I...>) {
+        return ((a[I] * b[I * StrideB]) + ...);
+    }
+
     static constexpr double PI = 3.14159265358979323846;
 
     static double c(int i) {
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ezcodec/Block.h"
+#include <array>
+#include <cstddef>
+
+namespace dct_detail {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Newton iteration; only used on small positive constants.
+constexpr double constexprSqrt(double x) {
+    double guess = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; i++) {
+        guess = 0.5 * (guess + x / guess);
+    }
+    return guess;
+}
+
+// Taylor series for |x| <= pi/2, accurate to double precision there.
+constexpr double cosTaylor(double x) {
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= -x * x / ((2.0 * n - 1.0) * (2.0 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+// cos(m * pi / (2 * dim)), reduced exactly on the integer numerator so
+// the series is only ever evaluated within the first quadrant.
+constexpr double cosQuarterTurns(int m, int dim) {
+    const int period = 4 * dim;
+    m %= period;
+    if (m < 0) {
+        m += period;
+    }
+
+    double sign = 1.0;
+    if (m > 2 * dim) {
+        m = period - m;
+    }
+    if (m > dim) {
+        m = 2 * dim - m;
+        sign = -1.0;
+    }
+    if (m == dim) {
+        return 0.0;
+    }
+    return sign * cosTaylor(m * kPi / (2.0 * dim));
+}
+
+} // namespace dct_detail
+
+// Orthonormal DCT-II basis matrix for a transform size, generated at
+// compile time. matrix[k * dim + n] = s(k) * cos((2n + 1) * k * pi / (2 * dim))
+// with s(0) = sqrt(1/dim) and s(k) = sqrt(2/dim).
+template<TxSize Size>
+struct DCTBasis {
+    static constexpr int dim = getTxDimension(Size);
+    static constexpr size_t count = getTxElementCount(Size);
+
+    static constexpr std::array<double, count> make() {
+        std::array<double, count> m{};
+        const double s0 = dct_detail::constexprSqrt(1.0 / dim);
+        const double sk = dct_detail::constexprSqrt(2.0 / dim);
+        for (int k = 0; k < dim; k++) {
+            for (int n = 0; n < dim; n++) {
+                m[k * dim + n] = (k == 0 ? s0 : sk) *
+                                 dct_detail::cosQuarterTurns((2 * n + 1) * k, dim);
+            }
+        }
+        return m;
+    }
+
+    static constexpr std::array<double, count> makeTransposed() {
+        const std::array<double, count> m = make();
+        std::array<double, count> t{};
+        for (int k = 0; k < dim; k++) {
+            for (int n = 0; n < dim; n++) {
+                t[n * dim + k] = m[k * dim + n];
+            }
+        }
+        return t;
+    }
+
+    static constexpr std::array<double, count> matrix = make();
+    static constexpr std::array<double, count> transposed = makeTransposed();
+};
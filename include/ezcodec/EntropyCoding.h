@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Raster index of the k-th coefficient of an 8x8 block in zigzag order
+inline constexpr std::array<uint8_t, 64> ZIGZAG_8x8 = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// MSB-first bit writer appending to a byte vector
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& output)
+        : out(output) {}
+
+    // Append the low `count` bits of `bits` (count <= 32)
+    void put(uint32_t bits, int count) {
+        accumulator = (accumulator << count) | (bits & ((uint64_t{1} << count) - 1));
+        pending += count;
+        while (pending >= 8) {
+            pending -= 8;
+            out.push_back(static_cast<uint8_t>(accumulator >> pending));
+        }
+    }
+
+    // Pad the last byte with zero bits
+    void flush() {
+        if (pending > 0) {
+            out.push_back(static_cast<uint8_t>(accumulator << (8 - pending)));
+            pending = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t accumulator = 0;
+    int pending = 0;
+};
+
+// MSB-first bit reader over a byte range. Reading past the end yields zero
+// bits and sets overrun().
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size)
+        : next(data)
+        , end(data + size)
+        , totalBits(static_cast<uint64_t>(size) * 8) {}
+
+    // Next `count` bits without consuming them (1 <= count <= 32)
+    uint32_t peek(int count) {
+        if (available < count) {
+            refill();
+        }
+        return static_cast<uint32_t>(buffer >> (64 - count));
+    }
+
+    void skip(int count) {
+        if (available < count) {
+            refill();
+        }
+        buffer <<= count;
+        available -= count;
+        consumed += static_cast<uint64_t>(count);
+    }
+
+    uint32_t get(int count) {
+        if (count == 0) {
+            return 0;
+        }
+        uint32_t bits = peek(count);
+        skip(count);
+        return bits;
+    }
+
+    [[nodiscard]] bool overrun() const { return consumed > totalBits; }
+
+private:
+    void refill() {
+        while (available <= 56) {
+            const uint64_t byte = (next < end) ? *next++ : 0;
+            buffer |= byte << (56 - available);
+            available += 8;
+        }
+    }
+
+    const uint8_t* next;
+    const uint8_t* end;
+    uint64_t totalBits;
+    uint64_t consumed = 0;
+    uint64_t buffer = 0;
+    int available = 0;
+};
+
+// Canonical Huffman code with codes of at most 16 bits, described like a
+// JPEG DHT segment: the number of codes of each length plus the symbols in
+// code order.
+class HuffmanTable {
+public:
+    static constexpr int MAX_CODE_LENGTH = 16;
+    static constexpr size_t MAX_SYMBOLS = 512;
+
+    HuffmanTable() = default;
+
+    // Length-limited code optimized for the given symbol frequencies
+    // (JPEG Annex K.2 procedure). Symbols with zero frequency get no code.
+    static HuffmanTable fromFrequencies(const std::vector<uint32_t>& frequencies);
+
+    // Table from serialized counts and symbols. Returns false when they do
+    // not describe a valid prefix code.
+    bool assign(const std::array<uint16_t, MAX_CODE_LENGTH>& lengthCounts,
+                const std::vector<uint16_t>& codeSymbols);
+
+    // Serialized form: 16 little-endian uint16 counts, then the symbols as
+    // little-endian uint16.
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t*& data, const uint8_t* end);
+
+    void encode(BitWriter& writer, uint16_t symbol) const {
+        writer.put(codes[symbol], codeLengths[symbol]);
+    }
+
+    // Returns the decoded symbol, or -1 for an invalid code
+    int decode(BitReader& reader) const {
+        const uint32_t lookahead = reader.peek(LOOKUP_BITS);
+        const uint32_t entry = lookup[lookahead];
+        if (entry != 0) {
+            reader.skip(static_cast<int>(entry >> 16));
+            return static_cast<int>(entry & 0xFFFF);
+        }
+        return decodeSlow(reader);
+    }
+
+    [[nodiscard]] bool hasCode(uint16_t symbol) const {
+        return symbol < MAX_SYMBOLS && codeLengths[symbol] != 0;
+    }
+
+    // Length in bits of the code of `symbol`, 0 if it has none
+    [[nodiscard]] int codeLength(uint16_t symbol) const {
+        return codeLengths[symbol];
+    }
+
+    // Bytes a serialized table takes at the least (no symbols)
+    static constexpr size_t MIN_SERIALIZED_SIZE = 2 * MAX_CODE_LENGTH;
+
+    // Bytes serialize() appends
+    [[nodiscard]] size_t serializedSize() const {
+        return 2 * (MAX_CODE_LENGTH + codeSymbols.size());
+    }
+
+    [[nodiscard]] const std::array<uint16_t, MAX_CODE_LENGTH>& counts() const { return lengthCounts; }
+    [[nodiscard]] const std::vector<uint16_t>& symbols() const { return codeSymbols; }
+
+private:
+    static constexpr int LOOKUP_BITS = 9;
+
+    bool build();
+    int decodeSlow(BitReader& reader) const;
+
+    std::array<uint16_t, MAX_CODE_LENGTH> lengthCounts{};
+    std::vector<uint16_t> codeSymbols;
+
+    // Encoding: code and length per symbol
+    std::array<uint16_t, MAX_SYMBOLS> codes{};
+    std::array<uint8_t, MAX_SYMBOLS> codeLengths{};
+
+    // Decoding: (length << 16 | symbol) for codes of up to LOOKUP_BITS bits,
+    // indexed by the next LOOKUP_BITS bits; 0 means "longer code".
+    std::vector<uint32_t> lookup;
+    // Canonical decoding of longer codes, per length (JPEG F.2.2.3)
+    std::array<int32_t, MAX_CODE_LENGTH + 1> maxCode{};
+    std::array<int32_t, MAX_CODE_LENGTH + 1> valueOffset{};
+};
+
+// Coefficient coding of quantized 8x8 blocks, in the style of baseline
+// JPEG: coefficients in zigzag order, the DC coefficient coded as the
+// difference from the previous block, AC coefficients as (zero run,
+// magnitude category) symbols followed by the magnitude bits.
+//
+// Symbols: DC category 0..16; AC (run << 5) | category with run 0..15 and
+// category 1..16, plus EOB (0) and ZRL (15 << 5, sixteen zeros). Categories
+// go up to 16 so every int16_t value and DC difference is representable.
+class EntropyCoder {
+public:
+    static constexpr uint16_t EOB = 0;
+    static constexpr uint16_t ZRL = 15 << 5;
+
+    struct Statistics {
+        std::vector<uint32_t> dc = std::vector<uint32_t>(HuffmanTable::MAX_SYMBOLS, 0);
+        std::vector<uint32_t> ac = std::vector<uint32_t>(HuffmanTable::MAX_SYMBOLS, 0);
+    };
+
+    // Count the symbols `count` consecutive blocks (64 coefficients each,
+    // raster order) would produce. The DC predictor starts at zero.
+    static void gatherStatistics(const int16_t* blocks, size_t count, Statistics& stats);
+
+    // Bits encodeBlocks() writes, before padding to a whole byte, for
+    // blocks whose symbols were counted into `stats`
+    static uint64_t codedBits(const Statistics& stats,
+                              const HuffmanTable& dcTable, const HuffmanTable& acTable);
+
+    // Code `count` consecutive blocks, appending whole bytes to `out`.
+    // Every symbol used must have a code in the tables.
+    static void encodeBlocks(const int16_t* blocks, size_t count,
+                             const HuffmanTable& dcTable, const HuffmanTable& acTable,
+                             std::vector<uint8_t>& out);
+
+    // Decode `count` blocks written by encodeBlocks(). Returns false on
+    // corrupt or truncated input.
+    static bool decodeBlocks(const uint8_t* data, size_t size,
+                             const HuffmanTable& dcTable, const HuffmanTable& acTable,
+                             int16_t* blocks, size_t count);
+};
@@ -1,28 +1,296 @@
 #pragma once
 
 #include <string>
-#include <vector>
 #include <cstdint>
-#include "ezcodec/Block.h"
+#include <vector>
+#include "ezcodec/BlockPartition.h"
+#include "ezcodec/BlockPlane.h"
+#include "ezcodec/ColorConversion.h"
+#include "ezcodec/EntropyCoding.h"
+#include "ezcodec/MappedFile.h"
+#include "ezcodec/OutputFile.h"
+#include "ezcodec/Quantization.h"
+
+// Bitstream versions. v1 stores 64 raw little-endian int16_t per block;
+// v2 entropy-codes them (see EntropyCoding.h) with per-image Huffman
+// tables. Both use a 16-byte header with 16-bit dimensions. v3 is the
+// streaming layout for very large images: a 32-byte header with 32-bit
+// dimensions, slices that each carry their own Huffman tables, and a
+// footer of 64-bit slice end offsets, so it can be written in one pass.
+// Readers accept all three.
+//
+// Color images are coded as three planes (Y, Cb, Cr) in every version. The
+// header describes the image and luma plane; the chroma planes follow from
+// the flags. v1 concatenates the planes, v2 stores a second pair of
+// Huffman tables for chroma and one slice index over all planes, and v3
+// simply has more slices. Slices never span two planes.
+//
+// With EZC_FLAG_QUANT_TABLES the header is followed by the quantizer step
+// sizes the file was coded with: 64 little-endian uint16_t in row-major
+// order for luma, then 64 for chroma in color files. Without it the steps
+// are the JPEG tables scaled by the header quality.
+//
+// EZC_FLAG_ADAPTIVE_BLOCKS (v2 only) codes each plane with the transform
+// sizes of a BlockPartition. Those tables are followed by the partitions:
+// a uint32 byte count, then the split flags of every plane in one MSB-first
+// bit string. blockDim stays 8, the grid the partition refines; each
+// transform is one unit of 64 coefficients, and a slice (a multiple of 4
+// block rows) holds only the coded units of its rows.
+constexpr uint8_t EZC_VERSION_RAW      = 1;
+constexpr uint8_t EZC_VERSION_HUFFMAN  = 2;
+constexpr uint8_t EZC_VERSION_STRIPED  = 3;
+constexpr uint8_t EZC_VERSION_LATEST   = EZC_VERSION_HUFFMAN;
+
+// EzcHeader::flags bits (stored in the formerly reserved header byte)
+constexpr uint8_t EZC_FLAG_FIXED_POINT = 0x01; // integer-only bit-exact transform
+constexpr uint8_t EZC_FLAG_SLICED      = 0x02; // payload split into block-row slices (always set in v3)
+constexpr uint8_t EZC_FLAG_COLOR       = 0x04; // Y, Cb and Cr planes (sliced in v2)
+constexpr uint8_t EZC_FLAG_CHROMA_H2   = 0x08; // chroma planes at half width
+constexpr uint8_t EZC_FLAG_CHROMA_V2   = 0x10; // chroma planes at half height (needs _H2)
+constexpr uint8_t EZC_FLAG_QUANT_TABLES = 0x20; // step tables stored after the header
+constexpr uint8_t EZC_FLAG_ADAPTIVE_BLOCKS = 0x40; // 4x4 to 32x32 transforms, partition stored
+constexpr uint8_t EZC_KNOWN_FLAGS      = EZC_FLAG_FIXED_POINT | EZC_FLAG_SLICED | EZC_FLAG_COLOR |
+                                         EZC_FLAG_CHROMA_H2 | EZC_FLAG_CHROMA_V2 |
+                                         EZC_FLAG_QUANT_TABLES | EZC_FLAG_ADAPTIVE_BLOCKS;
+
+// Flag bits for a plane layout (0 for gray)
+[[nodiscard]] uint8_t ezcChromaFlags(ChromaFormat format);
+
+// Size and block grid of one coded plane
+struct EzcPlane {
+    uint32_t width       = 0;
+    uint32_t height      = 0;
+    uint32_t blockCountX = 0;
+    uint32_t blockCountY = 0;
+};
 
+// Dimensions are 32-bit in memory; v1/v2 files can store up to 65535.
 struct EzcHeader {
-    uint8_t  version     = 1;
-    uint16_t width       = 0;
-    uint16_t height      = 0;
+    uint8_t  version     = EZC_VERSION_LATEST;
+    uint32_t width       = 0;
+    uint32_t height      = 0;
     uint8_t  quality     = 50;
     uint8_t  blockDim    = 8;
-    uint16_t blockCountX = 0;
-    uint16_t blockCountY = 0;
+    uint32_t blockCountX = 0;
+    uint32_t blockCountY = 0;
+    uint8_t  flags       = 0;
+    // Block rows per slice when EZC_FLAG_SLICED is set. Each slice is an
+    // independently decodable bitstream (the DC predictor restarts) and
+    // its end offset is stored in an index, so slices can be decoded in
+    // parallel.
+    uint32_t sliceRows   = 0;
+    // Step sizes stored in the file when EZC_FLAG_QUANT_TABLES is set:
+    // luma, then chroma (color files only). Ignored without the flag.
+    std::array<QuantTable::Steps, 2> quantSteps{};
+    // Transform sizes of every plane with EZC_FLAG_ADAPTIVE_BLOCKS, each
+    // over the block grid of header.plane(i). Ignored without the flag.
+    std::vector<BlockPartition> partitions;
+
+    [[nodiscard]] ChromaFormat chromaFormat() const;
+
+    // Quantizer of one plane: the stored steps with EZC_FLAG_QUANT_TABLES,
+    // otherwise the JPEG luminance (plane 0) or chrominance table at
+    // `quality`
+    [[nodiscard]] QuantTable quantTable(size_t index) const;
+
+    // 1 for gray images, 3 for color
+    [[nodiscard]] size_t planeCount() const;
+
+    // Plane 0 is the image itself (blockCountX x blockCountY); chroma
+    // planes are ceil(width / 2) wide when subsampled horizontally and
+    // ceil(height / 2) high when subsampled vertically
+    [[nodiscard]] EzcPlane plane(size_t index) const;
 };
 
-// Write quantized blocks to an .ezc file.
-// Returns true on success.
+// Write quantized blocks to an .ezc file in the bitstream version given by
+// header.version. The file is assembled in a buffer and written with a few
+// large writes; fileOptions selects atomic replacement and fsync.
+// Returns true on success, and false (after printing why) when a version 2
+// payload passes the 4 GiB its 32-bit offsets can address; version 3 has
+// no such limit.
 bool writeEzc(const std::string& path,
               const EzcHeader& header,
-              const std::vector<Block8x8i16>& quantizedBlocks);
+              const BlockPlane8x8i16& quantizedBlocks,
+              const OutputFile::Options& fileOptions = {});
 
-// Read an .ezc file into header + quantized blocks.
+// Multi-plane variant: one BlockPlane per header.planeCount(), each sized
+// to match header.plane(i). With EZC_FLAG_ADAPTIVE_BLOCKS each slice's
+// units are packed at the start of its block range, in coding order, and
+// the rest of the range is unused.
+bool writeEzc(const std::string& path,
+              const EzcHeader& header,
+              const std::vector<BlockPlane8x8i16>& planes,
+              const OutputFile::Options& fileOptions = {});
+
+// Scratch reused by writeEzcBuffer(): slice list, per-slice symbol counts
+// and entropy-coded payloads. Keeping one per caller makes repeated writes
+// of similar images allocation-free.
+struct EzcWriteBuffers {
+    struct Slice {
+        size_t plane;
+        const int16_t* blocks;
+        size_t count;
+    };
+
+    std::vector<const BlockPlane8x8i16*> planes;
+    std::vector<Slice> slices;
+    std::vector<EntropyCoder::Statistics> sliceStats;
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<uint8_t> tables;
+};
+
+// In-memory variant of writeEzc(): replaces the contents of `out` with the
+// complete file, byte for byte what writeEzc() would store. Version 1 and 2
+// only (version 3 is written strip by strip with EzcStripWriter).
+// Returns true on success; fails like writeEzc() above 4 GiB of payload.
+bool writeEzcBuffer(std::vector<uint8_t>& out,
+                    const EzcHeader& header,
+                    const std::vector<BlockPlane8x8i16>& planes,
+                    EzcWriteBuffers& buffers);
+
+// Size estimation for rate control. collectEzcSlices() fills
+// buffers.slices with the slices writeEzcBuffer() would code for planes of
+// this shape (same checks, version 2 only for the estimate). Once
+// buffers.sliceStats holds the symbol counts of each of those slices
+// (EntropyCoder::gatherStatistics() of the quantized blocks),
+// ezcCodedSize() returns the exact size of the file in bytes, without
+// entropy coding anything, or UINT64_MAX when the payload would pass the
+// 4 GiB version 2 limit.
+bool collectEzcSlices(const EzcHeader& header,
+                      const std::vector<BlockPlane8x8i16>& planes,
+                      EzcWriteBuffers& buffers);
+uint64_t ezcCodedSize(const EzcHeader& header, const EzcWriteBuffers& buffers);
+
+// Read an .ezc file into header + quantized blocks (an EzcReader plus a
+// copy or decode of every slice). For color files this is the luma plane.
 // Returns true on success.
 bool readEzc(const std::string& path,
              EzcHeader& header,
-             std::vector<Block8x8i16>& quantizedBlocks);
+             BlockPlane8x8i16& quantizedBlocks);
+
+// Read every plane of an .ezc file
+bool readEzc(const std::string& path,
+             EzcHeader& header,
+             std::vector<BlockPlane8x8i16>& planes);
+
+// Sequential v3 writer for images processed strip by strip. Slices must be
+// written in order, header.sliceRows block rows each (the last one may be
+// shorter); only the slice index is kept in memory.
+class EzcStripWriter {
+public:
+    // header.version must be EZC_VERSION_STRIPED
+    bool open(const std::string& path,
+              const EzcHeader& header,
+              const OutputFile::Options& fileOptions = {});
+
+    // Entropy-code one slice with its own optimized Huffman tables. Does
+    // not touch the writer, so slices can be encoded in parallel.
+    static void encodeSlice(const int16_t* blocks, size_t count, std::vector<uint8_t>& out);
+
+    bool writeSlice(const std::vector<uint8_t>& encoded);
+
+    // Write the slice index and commit the file. Fails unless every slice
+    // of the image was written.
+    bool finish();
+
+private:
+    OutputFile out;
+    EzcHeader fileHeader;
+    size_t expectedSlices = 0;
+    uint64_t sliceBytes = 0;
+    std::vector<uint64_t> sliceEnds;
+};
+
+// Memory-mapped .ezc reader. open() validates the header, the Huffman
+// tables and the slice index without touching the coefficient payload;
+// coefficients are then read straight from the mapped pages (or the
+// caller's buffer, with openBuffer()). For v1 files they are exposed in
+// place, with no copy. v1 files have no slice index,
+// so every block row is reported as one slice.
+//
+// Slices are numbered across planes in file order (all luma slices, then
+// Cb, then Cr); slicePlane() tells which plane one belongs to.
+class EzcReader {
+public:
+    // Returns false (after printing why) if the file is missing or invalid
+    bool open(const std::string& path);
+
+    // Same for a complete .ezc file already in memory. The bytes are not
+    // copied and must outlive the reader's use of them.
+    bool openBuffer(const uint8_t* data, size_t size);
+
+    [[nodiscard]] const EzcHeader& header() const { return fileHeader; }
+
+    [[nodiscard]] size_t sliceCount() const { return sliceTotal; }
+    [[nodiscard]] size_t sliceRows() const { return rowsPerSlice; }
+
+    [[nodiscard]] size_t slicePlane(size_t slice) const { return slices[slice].plane; }
+
+    // Blocks [first, first + count) in raster order of its plane make up
+    // the slice
+    void sliceBlocks(size_t slice, size_t& first, size_t& count) const;
+
+    // Units of 64 coefficients the slice codes: its block count, or with
+    // EZC_FLAG_ADAPTIVE_BLOCKS the transforms of its block rows
+    [[nodiscard]] size_t sliceUnits(size_t slice) const { return slices[slice].units; }
+
+    // True when the coefficients can be used in place (v1 file on a
+    // little-endian host)
+    [[nodiscard]] bool hasInPlaceBlocks() const { return inPlace != nullptr; }
+
+    // In-place view of one luma block; requires hasInPlaceBlocks()
+    [[nodiscard]] BlockView<const int16_t, TxSize::TX_8x8> block(size_t index) const {
+        return BlockView<const int16_t, TxSize::TX_8x8>(
+            inPlace + index * 64,
+            static_cast<int>(index % fileHeader.blockCountX),
+            static_cast<int>(index / fileHeader.blockCountX));
+    }
+
+    // Coefficients of one slice, 64 per unit (block). Points into the mapping when
+    // the blocks are in place, otherwise decodes into `scratch`. Returns
+    // nullptr for corrupt data. Safe to call from several threads with
+    // different scratch buffers.
+    //
+    // Only the first `blockLimit` units of the slice are guaranteed to be
+    // valid; entropy decoding stops there.
+    const int16_t* sliceCoefficients(size_t slice, std::vector<int16_t>& scratch,
+                                     size_t blockLimit = SIZE_MAX) const;
+
+    // Copy or decode the first min(sliceUnits(), blockLimit) units of one
+    // slice into dst
+    bool readSlice(size_t slice, int16_t* dst, size_t blockLimit = SIZE_MAX) const;
+
+private:
+    bool parse(const uint8_t* data, size_t size);
+
+    // Plane and block range of one slice and the units it codes. `offset`
+    // is the index of its first block counting the blocks of earlier
+    // planes too.
+    struct Slice {
+        size_t plane;
+        size_t first;
+        size_t count;
+        size_t units;
+        size_t offset;
+    };
+
+    MappedFile file;
+    EzcHeader fileHeader;
+
+    size_t rowsPerSlice = 1;
+    size_t sliceTotal = 0;
+    std::vector<Slice> slices;
+
+    // v1: raw little-endian coefficients
+    const uint8_t* rawBlocks = nullptr;
+    const int16_t* inPlace = nullptr;
+
+    // v2/v3: per-slice payload ranges; v2 tables for luma and chroma (v3
+    // slices carry their own)
+    HuffmanTable dcTable;
+    HuffmanTable acTable;
+    HuffmanTable chromaDCTable;
+    HuffmanTable chromaACTable;
+    const uint8_t* payload = nullptr;
+    std::vector<uint64_t> sliceEnds;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// Instruction set levels the 8x8 kernels are built for.
+enum class SimdLevel {
+    Scalar = 0,
+    SSE41  = 1,
+    AVX2   = 2
+};
+
+// One set of 8x8 block kernels. All buffers hold 64 values in row-major
+// order and may be unaligned.
+struct Kernels8x8 {
+    SimdLevel level;
+    const char* name;
+
+    // Pixels -> orthonormal DCT coefficients, truncated toward zero.
+    void (*forwardDCT)(const uint16_t* src, int16_t* dst);
+
+    // DCT coefficients -> pixel values, truncated toward zero (not clamped).
+    void (*inverseDCT)(const int16_t* src, int16_t* dst);
+
+    // inverseDCT() for blocks whose non-zero coefficients all lie in the
+    // top-left 4x4 corner. Only those 16 inputs enter the arithmetic, half
+    // the multiply-adds of the full transform. The SIMD variants give the
+    // same result as their inverseDCT(); the scalar one is within 1.
+    void (*inverseDCTLowBand)(const int16_t* src, int16_t* dst);
+
+    // Same rounding as Quantization::quantize (half away from zero).
+    // steps and reciprocals are QuantTable::steps() and
+    // QuantTable::reciprocals() of one table: each quotient is a multiply
+    // by the reciprocal and a shift, exactly equal to the division.
+    void (*quantize)(const int16_t* src, int16_t* dst, const uint16_t* steps, const uint32_t* reciprocals);
+
+    // Same wrap-around as Quantization::dequantize for int16_t blocks.
+    void (*dequantize)(const int16_t* src, int16_t* dst, const uint16_t* steps);
+};
+
+// Highest level supported by both this build and the running CPU
+// (queried with cpuid). The EZCODEC_SIMD environment variable
+// ("scalar", "sse4.1", "avx2") can lower it.
+[[nodiscard]] SimdLevel detectSimdLevel();
+
+// Kernels for the detected level, selected once on first use.
+[[nodiscard]] const Kernels8x8& kernels8x8();
+
+// Kernels for a specific level, or nullptr when that level is not compiled
+// in or not supported by the CPU.
+[[nodiscard]] const Kernels8x8* kernels8x8For(SimdLevel level);
+
+[[nodiscard]] const char* simdLevelName(SimdLevel level);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. Uses mmap (MapViewOfFile on Windows) so
+// the bytes are read straight from the page cache; falls back to reading
+// the file into memory where mapping is not available.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Returns false if the file cannot be opened or read
+    bool open(const std::string& path);
+    void close();
+
+    [[nodiscard]] const uint8_t* data() const { return bytes; }
+    [[nodiscard]] size_t size() const { return length; }
+    [[nodiscard]] bool isMapped() const { return mapping != nullptr; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+
+    // Start of the mapping, or nullptr when the bytes live in `fallback`
+    void* mapping = nullptr;
+    std::vector<uint8_t> fallback;
+};
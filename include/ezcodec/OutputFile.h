@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Buffered binary file writer that issues few large write() calls instead
+// of one stream call per value. Optionally writes to a temporary file that
+// replaces the destination only in commit(), and can fsync before
+// returning so the data is durable.
+class OutputFile {
+public:
+    struct Options {
+        // Write to "<path>.tmp-<pid>-<n>" and rename it over `path` on
+        // commit(); readers never see a partially written file
+        bool atomicReplace = false;
+        // fsync the file (and, with atomicReplace, its directory) on commit()
+        bool sync = false;
+    };
+
+    static constexpr size_t BUFFER_SIZE = size_t{1} << 20;
+
+    OutputFile() = default;
+    ~OutputFile();
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    // Returns false (after printing why) if the file cannot be created
+    bool open(const std::string& path, const Options& options);
+
+    // Buffered; writes larger than the buffer go straight to the file
+    bool write(const void* data, size_t size);
+
+    // Flush, sync and rename as requested. Without a successful commit()
+    // the destructor discards a temporary file.
+    bool commit();
+
+private:
+    bool flushBuffer();
+    bool writeAll(const uint8_t* data, size_t size);
+    void discard();
+
+    int fd = -1;
+    std::string finalPath;
+    std::string writePath;
+    Options options;
+    std::vector<uint8_t> buffer;
+    bool failed = false;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ezcodec/OutputFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Row-by-row reader for binary 8-bit PGM (P5) files, for images too large
+// to load at once.
+class PgmReader {
+public:
+    PgmReader() = default;
+    ~PgmReader();
+
+    PgmReader(const PgmReader&) = delete;
+    PgmReader& operator=(const PgmReader&) = delete;
+
+    // Opens the file and parses the header. Returns false (after printing
+    // why) for missing files and anything but 8-bit P5 with maxval 255.
+    bool open(const std::string& path);
+
+    [[nodiscard]] uint32_t width() const { return imageWidth; }
+    [[nodiscard]] uint32_t height() const { return imageHeight; }
+
+    // Read the next `rows` rows (width() bytes each) into dst
+    bool readRows(uint8_t* dst, size_t rows);
+
+private:
+    std::FILE* file = nullptr;
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+};
+
+// Row-by-row writer for binary 8-bit PGM (P5) files
+class PgmWriter {
+public:
+    bool open(const std::string& path, uint32_t width, uint32_t height,
+              const OutputFile::Options& fileOptions = {});
+
+    // Append `rows` rows of width bytes each
+    bool writeRows(const uint8_t* src, size_t rows);
+
+    // Commit the file; fails unless every row was written
+    bool finish();
+
+private:
+    OutputFile out;
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    uint64_t rowsWritten = 0;
+};
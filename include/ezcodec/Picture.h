@@ -1,12 +1,13 @@
 #pragma once
 
-#include <vector>
 #include <memory>
-#include "ezcodec/Block.h"
+#include "ezcodec/BlockPlane.h"
 
 class Picture {
 public:
-    Picture(const char* filename);
+    // channels: 1 loads the image as grayscale, 3 as interleaved RGB.
+    // Only grayscale pictures have block views.
+    explicit Picture(const char* filename, int channels = 1);
     ~Picture();
 
     [[nodiscard]] inline unsigned char* getData() const {
@@ -21,6 +22,10 @@ public:
         return height;
     }
 
+    [[nodiscard]] inline int getChannels() const {
+        return channels;
+    }
+
     [[nodiscard]] inline int getBitdepth() const {
         return bitdepth;
     }
@@ -29,45 +34,41 @@ public:
         return (data != nullptr && width > 0 && height > 0 && bitdepth > 0);
     }
 
-    [[nodiscard]] std::vector<Block8x8ui16>& getBlocks() {
-        return dataBlocks;
+    // Blocks of `Size` along each side of the grayscale image, the last
+    // ones partial when the size is not a multiple of the block
+    template<TxSize Size = TxSize::TX_8x8>
+    [[nodiscard]] int blockCountX() const {
+        return (width + getTxDimension(Size) - 1) / getTxDimension(Size);
     }
 
-    [[nodiscard]] const std::vector<Block8x8ui16>& getBlocks() const {
-        return dataBlocks;
+    template<TxSize Size = TxSize::TX_8x8>
+    [[nodiscard]] int blockCountY() const {
+        return (height + getTxDimension(Size) - 1) / getTxDimension(Size);
     }
 
-    template<typename T, TxSize Size>
-    [[nodiscard]] std::vector<Block<T, Size>> splitIntoBlocks() const {
-        constexpr int blockDim = getTxDimension(Size);
-        const int blockCountX = (width + blockDim - 1) / blockDim;
-        const int blockCountY = (height + blockDim - 1) / blockDim;
-
-        std::vector<Block<T, Size>> blocks;
-        blocks.reserve(blockCountX * blockCountY);
-
-        int blockY = 0;
-        for (int by = 0; by < height; by += blockDim, blockY++) {
-            int blockX = 0;
-            for (int bx = 0; bx < width; bx += blockDim, blockX++) {
-                blocks.emplace_back(blockX, blockY);
-                auto& block = blocks.back();
-
-                for (int row = 0; row < blockDim; row++) {
-                    for (int col = 0; col < blockDim; col++) {
-                        int imgX = bx + col;
-                        int imgY = by + row;
+    // Zero-copy view of block (blockX, blockY) of a grayscale picture, read
+    // straight from the loaded pixels; border blocks replicate the last
+    // column and row
+    template<TxSize Size = TxSize::TX_8x8>
+    [[nodiscard]] StridedBlockView<unsigned char, Size> blockView(int blockX, int blockY) const {
+        return StridedBlockView<unsigned char, Size>(data, static_cast<size_t>(width), static_cast<size_t>(height),
+                                                     static_cast<size_t>(width), blockX, blockY);
+    }
 
-                        if (imgX < width && imgY < height) {
-                            block.at(row, col) = static_cast<T>(data[imgY * width + imgX]);
-                        } else {
-                            block.at(row, col) = T{};
-                        }
-                    }
-                }
+    // Copy of every block of a grayscale picture into a new plane, for
+    // callers that need the blocks contiguous; the codec reads blockView()s
+    // or the pixels instead
+    template<typename T, TxSize Size>
+    [[nodiscard]] BlockPlane<T, Size> splitIntoBlocks() const {
+        const int countX = blockCountX<Size>();
+        const int countY = blockCountY<Size>();
+        BlockPlane<T, Size> blocks(countX, countY);
+        for (int blockY = 0; blockY < countY; blockY++) {
+            for (int blockX = 0; blockX < countX; blockX++) {
+                blockView<Size>(blockX, blockY).copyTo(
+                    blocks.data() + (static_cast<size_t>(blockY) * countX + blockX) * getTxElementCount(Size));
             }
         }
-
         return blocks;
     }
 
@@ -75,10 +76,8 @@ private:
     int width = 0;
     int height = 0;
     int bitdepth = 0;
+    int channels = 1;
 
-    // Raw image data in [0, 255] range from stbi_load (grayscale)
+    // Raw image data in [0, 255] range from stbi_load (grayscale or RGB)
     unsigned char* data = nullptr;
-
-    // Image split into 8x8 pixel blocks on load
-    std::vector<Block8x8ui16> dataBlocks;
 };
@@ -2,6 +2,53 @@
 
 #include "ezcodec/Block.h"
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <type_traits>
+
+// Quantizer for one 8x8 table: the step sizes and their fixed-point
+// reciprocals, computed once per table so quantizing a coefficient is a
+// multiply and a shift instead of a division. Built from a quality by
+// Quantization::makeQuantTable(), or straight from stored step sizes (the
+// custom tables of an .ezc file).
+class QuantTable {
+public:
+    using Steps = std::array<uint16_t, 64>;
+
+    static constexpr uint16_t MAX_STEP = 32767;
+
+    // reciprocal = ceil(2^31 / step). For |value| <= 32768 the rounded
+    // numerator |value| + step / 2 is below 2^16 and the reciprocal is too
+    // large by less than step / 2^31, so the product shifted right by 31
+    // is exactly the integer quotient (numerator / step).
+    static constexpr int RECIPROCAL_SHIFT = 31;
+
+    // Every step 1
+    QuantTable();
+
+    // Steps outside [1, MAX_STEP] are clamped
+    explicit QuantTable(const Steps& steps);
+
+    [[nodiscard]] const Steps& steps() const { return stepSizes; }
+    [[nodiscard]] const uint32_t* reciprocals() const { return reciprocalValues.data(); }
+
+    // Same rounding as Quantization::quantize (half away from zero);
+    // `value` must be in the int16_t range
+    [[nodiscard]] int16_t quantize(int value, size_t index) const {
+        const uint64_t numerator = static_cast<uint32_t>(std::abs(value)) + stepSizes[index] / 2;
+        const int quotient = static_cast<int>((numerator * reciprocalValues[index]) >> RECIPROCAL_SHIFT);
+        return static_cast<int16_t>(value < 0 ? -quotient : quotient);
+    }
+
+    bool operator==(const QuantTable& other) const { return stepSizes == other.stepSizes; }
+    bool operator!=(const QuantTable& other) const { return !(*this == other); }
+
+private:
+    alignas(32) Steps stepSizes;
+    alignas(32) std::array<uint32_t, 64> reciprocalValues;
+};
 
 class Quantization {
 public:
@@ -17,36 +64,97 @@ public:
         72, 92, 95, 98, 112, 100, 103,  99
     };
 
+    // Standard JPEG chrominance quantization table (Annex K), used for the
+    // Cb and Cr planes of color images
+    static constexpr std::array<int, 64> JPEG_CHROMINANCE_QUANTIZATION_TABLE = {
+        17, 18, 24, 47, 99, 99, 99, 99,
+        18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99,
+        47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99
+    };
+
+    // Which base table a plane is quantized with
+    enum class Component {
+        Luma,  // JPEG_LUMINANCE_QUANTIZATION_TABLE (gray images, Y)
+        Chroma // JPEG_CHROMINANCE_QUANTIZATION_TABLE (Cb, Cr)
+    };
+
     // Quantize a block of DCT coefficients
     // srcBlock - block with DCT coefficients (int16_t or float)
     // dstBlock - block for quantized coefficients (int16_t)
     // quality  - compression quality (1-100, where 100 = minimum compression)
-    template<typename SrcT, typename DstT, TxSize Size>
-    static void quantize(const Block<SrcT, Size>& srcBlock,
-                        Block<DstT, Size>& dstBlock,
-                        int quality = 50);
+    template<typename SrcBlock, typename DstBlock>
+    static void quantize(const SrcBlock& srcBlock,
+                         DstBlock&& dstBlock,
+                         int quality = 50);
+
+    // Quantize an 8x8 block with a prebuilt table: a multiply and a shift
+    // per integer coefficient. The quality overload rebuilds its steps and
+    // divides on every call, so loops over many blocks should use this one.
+    template<typename SrcBlock, typename DstBlock>
+    static void quantize(const SrcBlock& srcBlock,
+                         DstBlock&& dstBlock,
+                         const QuantTable& table);
 
     // Dequantize a block
     // srcBlock - block with quantized coefficients
     // dstBlock - block for recovered DCT coefficients
-    template<typename SrcT, typename DstT, TxSize Size>
-    static void dequantize(const Block<SrcT, Size>& srcBlock,
-                          Block<DstT, Size>& dstBlock,
-                          int quality = 50);
+    template<typename SrcBlock, typename DstBlock>
+    static void dequantize(const SrcBlock& srcBlock,
+                           DstBlock&& dstBlock,
+                           int quality = 50);
+
+    // Quality-scaled 8x8 step sizes, as used by quantize()/dequantize().
+    // Feeds the Kernels8x8 dequantize kernel.
+    static std::array<uint16_t, 64> makeStepTable(int quality, Component component = Component::Luma);
+
+    // The same steps with their reciprocals, for the Kernels8x8 quantize
+    // kernel and the QuantTable overload of quantize()
+    static QuantTable makeQuantTable(int quality, Component component = Component::Luma);
+
+    // A custom base table scaled by quality like the JPEG ones; quality
+    // 50 keeps it unchanged
+    static QuantTable makeQuantTable(int quality, const QuantTable::Steps& baseTable);
+
+    // Per-coefficient multipliers with the AAN scaling folded in.
+    // makeFoldedQuantTable() maps raw DCT::forwardDCT8x8Raw output straight
+    // to quantizer units (scale / step); makeFoldedDequantTable() maps
+    // quantized values straight to DCT::inverseDCT8x8Prescaled input
+    // (step * scale).
+    using FoldedTable = std::array<double, 64>;
+    static FoldedTable makeFoldedQuantTable(int quality, Component component = Component::Luma);
+    static FoldedTable makeFoldedDequantTable(int quality, Component component = Component::Luma);
+
+    // Quantize raw AAN coefficients using a folded table.
+    // Rounds half away from zero, like quantize().
+    template<typename DstBlock>
+    static void quantizeFolded(const double* rawCoefficients,
+                               DstBlock&& dstBlock,
+                               const FoldedTable& table);
+
+    // Dequantize into prescaled AAN input using a folded table.
+    template<typename SrcBlock>
+    static void dequantizeFolded(const SrcBlock& srcBlock,
+                                 double* prescaledCoefficients,
+                                 const FoldedTable& table);
 
 private:
     // Calculate scaling factor based on quality
     static int getScaleFactor(int quality);
-
-    // Get quantization table value scaled by quality
-    static int getQuantizationValue(int index, int quality);
 };
 
 // Template method implementations
-template<typename SrcT, typename DstT, TxSize Size>
-void Quantization::quantize(const Block<SrcT, Size>& srcBlock,
-                           Block<DstT, Size>& dstBlock,
-                           int quality) {
+template<typename SrcBlock, typename DstBlock>
+void Quantization::quantize(const SrcBlock& srcBlock,
+                            DstBlock&& dstBlock,
+                            int quality) {
+    constexpr TxSize Size = block_size_v<SrcBlock>;
+    static_assert(block_size_v<DstBlock> == Size, "Source and destination block sizes must match");
+    using DstT = block_element_t<DstBlock>;
     constexpr size_t elementCount = getTxElementCount(Size);
 
     // For sizes other than 8x8, use simple scalar quantization
@@ -59,21 +167,50 @@ void Quantization::quantize(const Block<SrcT, Size>& srcBlock,
         return;
     }
 
-    // Quantization for 8x8 blocks using the JPEG table
+    // Quantization for 8x8 blocks using the JPEG table. A one-off block
+    // divides by the steps; building the reciprocals would cost more.
+    const std::array<uint16_t, 64> steps = makeStepTable(quality);
     for (size_t i = 0; i < elementCount; i++) {
-        int quantValue = getQuantizationValue(static_cast<int>(i), quality);
+        const int step = steps[i];
         dstBlock[i] = static_cast<DstT>(
             (srcBlock[i] >= 0)
-                ? (srcBlock[i] + quantValue / 2) / quantValue
-                : (srcBlock[i] - quantValue / 2) / quantValue
+                ? (srcBlock[i] + step / 2) / step
+                : (srcBlock[i] - step / 2) / step
         );
     }
 }
 
-template<typename SrcT, typename DstT, TxSize Size>
-void Quantization::dequantize(const Block<SrcT, Size>& srcBlock,
-                             Block<DstT, Size>& dstBlock,
-                             int quality) {
+template<typename SrcBlock, typename DstBlock>
+void Quantization::quantize(const SrcBlock& srcBlock,
+                            DstBlock&& dstBlock,
+                            const QuantTable& table) {
+    static_assert(block_size_v<SrcBlock> == TxSize::TX_8x8 && block_size_v<DstBlock> == TxSize::TX_8x8,
+                  "Quantization tables are 8x8 only");
+    using SrcT = block_element_t<SrcBlock>;
+    using DstT = block_element_t<DstBlock>;
+
+    for (size_t i = 0; i < 64; i++) {
+        if constexpr (std::is_integral_v<SrcT> && sizeof(SrcT) <= sizeof(int16_t)) {
+            dstBlock[i] = static_cast<DstT>(table.quantize(srcBlock[i], i));
+        } else {
+            // Wider and floating-point inputs keep the division
+            const int step = table.steps()[i];
+            dstBlock[i] = static_cast<DstT>(
+                (srcBlock[i] >= 0)
+                    ? (srcBlock[i] + step / 2) / step
+                    : (srcBlock[i] - step / 2) / step
+            );
+        }
+    }
+}
+
+template<typename SrcBlock, typename DstBlock>
+void Quantization::dequantize(const SrcBlock& srcBlock,
+                              DstBlock&& dstBlock,
+                              int quality) {
+    constexpr TxSize Size = block_size_v<SrcBlock>;
+    static_assert(block_size_v<DstBlock> == Size, "Source and destination block sizes must match");
+    using DstT = block_element_t<DstBlock>;
     constexpr size_t elementCount = getTxElementCount(Size);
 
     if constexpr (Size != TxSize::TX_8x8) {
@@ -86,8 +223,29 @@ void Quantization::dequantize(const Block<SrcT, Size>& srcBlock,
     }
 
     // Dequantization for 8x8 blocks
+    const std::array<uint16_t, 64> steps = makeStepTable(quality);
     for (size_t i = 0; i < elementCount; i++) {
-        int quantValue = getQuantizationValue(static_cast<int>(i), quality);
-        dstBlock[i] = static_cast<DstT>(srcBlock[i] * quantValue);
+        dstBlock[i] = static_cast<DstT>(srcBlock[i] * static_cast<int>(steps[i]));
+    }
+}
+
+template<typename DstBlock>
+void Quantization::quantizeFolded(const double* rawCoefficients,
+                                  DstBlock&& dstBlock,
+                                  const FoldedTable& table) {
+    static_assert(block_size_v<DstBlock> == TxSize::TX_8x8, "Folded tables are 8x8 only");
+    using DstT = block_element_t<DstBlock>;
+    for (size_t i = 0; i < 64; i++) {
+        dstBlock[i] = static_cast<DstT>(std::round(rawCoefficients[i] * table[i]));
+    }
+}
+
+template<typename SrcBlock>
+void Quantization::dequantizeFolded(const SrcBlock& srcBlock,
+                                    double* prescaledCoefficients,
+                                    const FoldedTable& table) {
+    static_assert(block_size_v<SrcBlock> == TxSize::TX_8x8, "Folded tables are 8x8 only");
+    for (size_t i = 0; i < 64; i++) {
+        prescaledCoefficients[i] = static_cast<double>(srcBlock[i]) * table[i];
     }
 }
@@ -9,12 +9,41 @@
 #include <future>
 #include <memory>
 #include <stdexcept>
+#include <atomic>
+#include <exception>
+#include <algorithm>
 
 class ThreadPool {
 public:
-    ThreadPool(size_t numThreads);
+    enum class Scheduler {
+        // One FIFO queue behind a mutex, shared by all workers
+        SharedQueue,
+        // Per-worker lock-free deques with randomized stealing. parallelFor()
+        // splits ranges recursively and never allocates per task.
+        WorkStealing
+    };
+
+    ThreadPool(size_t numThreads, Scheduler scheduler = Scheduler::SharedQueue);
     ~ThreadPool();
 
+    // Process-wide work-stealing pool, created on first use and kept for
+    // the lifetime of the process. By default it has
+    // hardware_concurrency() - 1 workers (at least one) because
+    // parallelFor() callers work alongside them.
+    static ThreadPool& shared();
+
+    // Replace the shared pool with one where `threads` threads work on
+    // each parallelFor() call (threads - 1 workers plus the caller);
+    // 0 restores the default. EZCODEC_THREADS=n sets the size the pool
+    // starts with. One thread means no workers: the caller runs every
+    // chunk, and enqueue() runs tasks before returning. Only call while
+    // nothing runs on the shared pool, e.g. at start-up or between
+    // benchmark runs.
+    static void setSharedThreads(size_t threads);
+
+    [[nodiscard]] size_t size() const { return workers.size(); }
+    [[nodiscard]] Scheduler getScheduler() const { return scheduler; }
+
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::invoke_result<F, Args...>::type> {
@@ -26,19 +55,64 @@ public:
         );
 
         std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            if (stop) {
-                throw std::runtime_error("enqueue on stopped ThreadPool");
-            }
+        post([task]() { (*task)(); });
+        return res;
+    }
 
-            tasks.emplace([task]() { (*task)(); });
+    // Calls fn(chunkBegin, chunkEnd) for consecutive chunks of at most
+    // `grain` indices covering [begin, end), and returns once all of them
+    // have run. The calling thread processes chunks too, so nested calls
+    // from inside a worker cannot deadlock. Completion is tracked with a
+    // single counter rather than one future per chunk. The first exception
+    // thrown by fn is rethrown here after the remaining chunks finish.
+    template<class F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F&& fn) {
+        if (begin >= end) {
+            return;
+        }
+
+        using Fn = std::remove_reference_t<F>;
+        ParallelForRange range;
+        range.begin = begin;
+        range.end = end;
+        range.grain = std::max<size_t>(grain, 1);
+        range.context = const_cast<void*>(static_cast<const void*>(&fn));
+        range.invoke = [](void* context, size_t chunkBegin, size_t chunkEnd) {
+            (*static_cast<Fn*>(context))(chunkBegin, chunkEnd);
+        };
+
+        if (scheduler == Scheduler::WorkStealing) {
+            parallelForStealing(range);
+        } else {
+            parallelForShared(range);
         }
-        condition.notify_one();
-        return res;
     }
 
 private:
+    // Type-erased parallelFor() arguments
+    struct ParallelForRange {
+        size_t begin = 0;
+        size_t end = 0;
+        size_t grain = 1;
+        void* context = nullptr;
+        void (*invoke)(void*, size_t, size_t) = nullptr;
+    };
+
+    // Work-stealing internals (deques, injection queue, sleep state),
+    // defined in ThreadPool.cpp.
+    struct StealingState;
+
+    void parallelForShared(const ParallelForRange& range);
+    void parallelForStealing(const ParallelForRange& range);
+    void workerLoop(size_t index);
+    void stealingWorkerLoop(size_t index);
+
+    // Queue a task without a future
+    void post(std::function<void()> task);
+
+    Scheduler scheduler;
+    std::unique_ptr<StealingState> stealing;
+
     std::vector<std::thread> workers;
     std::queue<std::function<void()>> tasks;
 
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Built-in instrumentation of the codec: stage timers, per-worker busy and
+// idle time, pool queue depth, bytes read and written and buffer
+// allocations. Off by default, and then every hook costs one relaxed load
+// and a branch. Trace::start() turns it on; after the work,
+// printStats() summarizes what was recorded and writeChromeTrace() saves
+// the timeline in the Chrome trace-event format (chrome://tracing,
+// Perfetto). Events go to per-thread buffers, so recording threads do not
+// contend with each other.
+class Trace {
+public:
+    enum class Counter {
+        BytesRead,
+        BytesWritten,
+        Allocations,    // plane, pixel and scratch buffers the codec (re)allocated
+        AllocatedBytes,
+        Count
+    };
+
+    // Totals of one stage over every thread
+    struct Stage {
+        std::string name;
+        uint64_t calls = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+    };
+
+    // Time one pool worker spent running tasks during the session; workers
+    // that ran nothing are not listed
+    struct Worker {
+        std::string name;
+        uint64_t busyNs = 0;
+        uint64_t idleNs = 0;
+        uint64_t tasks = 0;
+    };
+
+    [[nodiscard]] static bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Clear everything recorded so far and start recording. Call while no
+    // other thread is recording, e.g. before a command runs.
+    static void start();
+    // Stop recording; the data stays available for the reports
+    static void stop();
+
+    // Nanoseconds since start()
+    [[nodiscard]] static uint64_t now();
+
+    static void count(Counter counter, uint64_t value = 1) {
+        if (enabled()) {
+            add(counter, value);
+        }
+    }
+    // Counts the allocation if `buffer` has to grow to hold `size` elements;
+    // call before resizing it
+    template<typename T>
+    static void countGrowth(const std::vector<T>& buffer, size_t size) {
+        if (enabled() && size > buffer.capacity()) {
+            add(Counter::Allocations, 1);
+            add(Counter::AllocatedBytes, size * sizeof(T));
+        }
+    }
+    // Adds the size of the file at `path` to `counter`, for files written
+    // or read by a library that does not report it
+    static void countFile(Counter counter, const std::string& path);
+
+    // A stage that ran from `begin` to `end` (now() values) on this thread.
+    // `name` must outlive the session (a string literal).
+    static void record(const char* name, uint64_t begin, uint64_t end, const std::string& detail = {});
+    // A pool task that ran on this worker thread from `begin` to `end`
+    static void workerBusy(uint64_t begin, uint64_t end);
+    // Ranges waiting in the pool queues right now
+    static void queueDepth(int64_t depth);
+
+    // Name of the calling thread in reports, e.g. "worker 3"; threads that
+    // never set one are "thread <n>"
+    static void setThreadName(const std::string& name);
+
+    [[nodiscard]] static uint64_t counter(Counter counter);
+    [[nodiscard]] static std::vector<Stage> stages();
+    [[nodiscard]] static std::vector<Worker> workers();
+
+    // Human-readable summary of the session
+    static void printStats(std::ostream& out);
+    // Chrome trace-event JSON; returns false if the file cannot be written
+    static bool writeChromeTrace(const std::string& path);
+
+private:
+    static void add(Counter counter, uint64_t value);
+
+    inline static std::atomic<bool> active{false};
+};
+
+// Records the enclosing scope as a stage called `name` (a string literal)
+// when tracing is on. `detail`, e.g. the file being coded, is attached to
+// the event in the trace.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : name(name)
+        , begin(Trace::enabled() ? Trace::now() : NOT_RECORDING) {}
+
+    TraceScope(const char* name, std::string_view detail)
+        : TraceScope(name) {
+        if (begin != NOT_RECORDING) {
+            this->detail.assign(detail.data(), detail.size());
+        }
+    }
+
+    ~TraceScope() {
+        if (begin != NOT_RECORDING && Trace::enabled()) {
+            Trace::record(name, begin, Trace::now(), detail);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    static constexpr uint64_t NOT_RECORDING = ~uint64_t{0};
+
+    const char* name;
+    uint64_t begin;
+    std::string detail;
+};
@@ -0,0 +1,252 @@
+#include "ezcodec/Batch.h"
+#include "ezcodec/Picture.h"
+#include "ezcodec/MappedFile.h"
+#include "ezcodec/OutputFile.h"
+#include "ezcodec/ThreadPool.h"
+#include "ezcodec/Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+
+#include "stb/stb_image_write.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Extensions collectBatchInputs() picks from a directory for encoding
+const char* const IMAGE_EXTENSIONS[] = {
+    ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif", ".pgm", ".ppm", ".pnm"
+};
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+bool isBatchInput(const fs::path& path, bool decode) {
+    const std::string extension = lowercase(path.extension().string());
+    if (decode) {
+        return extension == ".ezc";
+    }
+    return std::find(std::begin(IMAGE_EXTENSIONS), std::end(IMAGE_EXTENSIONS), extension) !=
+           std::end(IMAGE_EXTENSIONS);
+}
+
+// Output path of every input: <outputDir>/<stem><extension>. Fails on two
+// inputs that would write the same file.
+bool makeOutputPaths(const std::vector<std::string>& inputs, const std::string& outputDir,
+                     const char* extension, std::vector<std::string>& outputs) {
+    std::error_code error;
+    fs::create_directories(outputDir, error);
+    if (error || !fs::is_directory(outputDir)) {
+        std::cerr << "Cannot create output directory: " << outputDir << std::endl;
+        return false;
+    }
+
+    std::set<std::string> seen;
+    outputs.clear();
+    for (const std::string& input : inputs) {
+        const std::string output = (fs::path(outputDir) / fs::path(input).stem()).string() + extension;
+        if (!seen.insert(output).second) {
+            std::cerr << "Two inputs would both write " << output << std::endl;
+            return false;
+        }
+        outputs.push_back(output);
+    }
+    return true;
+}
+
+// Per-run totals, updated by the slots
+struct BatchTotals {
+    std::atomic<size_t> done{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<uint64_t> pixels{0};
+    std::atomic<uint64_t> codedBytes{0};
+};
+
+// Runs process(slot, input) for every input on `slots` pool tasks that
+// each pull the next unclaimed file, so at most `slots` images are in
+// flight. Returns the number of slots used.
+template<typename Process>
+size_t runSlots(size_t inputCount, size_t maxInFlight, size_t slotLimit, Process&& process) {
+    const size_t threads = ThreadPool::shared().size() + 1;
+    const size_t slots = std::min({maxInFlight == 0 ? threads : maxInFlight, inputCount, slotLimit});
+    std::atomic<size_t> next{0};
+    ThreadPool::shared().parallelFor(0, slots, 1, [&](size_t slotBegin, size_t slotEnd) {
+        for (size_t slot = slotBegin; slot < slotEnd; slot++) {
+            for (size_t i = next++; i < inputCount; i = next++) {
+                process(slot, i);
+            }
+        }
+    });
+    return slots;
+}
+
+void printSummary(const char* verb, size_t total, const BatchTotals& totals, size_t slots,
+                  std::chrono::steady_clock::time_point start) {
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << verb << " " << totals.done << " of " << total << " files (" << slots
+              << " in flight) in " << seconds << " s";
+    if (seconds > 0.0) {
+        std::cout << ", " << static_cast<double>(totals.pixels) / 1e6 / seconds << " MP/s";
+    }
+    std::cout << ", " << totals.codedBytes << " .ezc bytes" << std::endl;
+}
+
+} // namespace
+
+bool collectBatchInputs(const std::string& source, bool decode, std::vector<std::string>& inputs) {
+    inputs.clear();
+    std::error_code error;
+    if (fs::is_directory(source, error)) {
+        for (const auto& entry : fs::directory_iterator(source, error)) {
+            if (entry.is_regular_file(error) && isBatchInput(entry.path(), decode)) {
+                inputs.push_back(entry.path().string());
+            }
+        }
+        std::sort(inputs.begin(), inputs.end());
+    } else {
+        std::ifstream list(source);
+        if (!list) {
+            std::cerr << "Cannot read batch input: " << source << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                inputs.push_back(line);
+            }
+        }
+    }
+
+    if (error) {
+        std::cerr << "Cannot read batch input: " << source << " (" << error.message() << ")" << std::endl;
+        return false;
+    }
+    if (inputs.empty()) {
+        std::cerr << "No " << (decode ? ".ezc files" : "images") << " found in " << source << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int encodeBatch(const std::vector<std::string>& inputs,
+                const std::string& outputDir,
+                const BatchOptions& options) {
+    std::vector<std::string> outputs;
+    if (!makeOutputPaths(inputs, outputDir, ".ezc", outputs)) {
+        return 1;
+    }
+
+    const bool color = options.encode.chroma != ChromaFormat::Gray;
+    OutputFile::Options fileOptions;
+    fileOptions.atomicReplace = options.encode.atomicWrite;
+    fileOptions.sync          = options.encode.sync;
+
+    // One Encoder and output buffer per slot, reused for all of its files
+    const size_t slotLimit = ThreadPool::shared().size() + 1;
+    std::vector<Encoder> encoders;
+    std::vector<std::vector<uint8_t>> buffers(slotLimit);
+    for (size_t slot = 0; slot < slotLimit; slot++) {
+        encoders.emplace_back(options.encode);
+    }
+
+    BatchTotals totals;
+    const auto start = std::chrono::steady_clock::now();
+    const size_t slots = runSlots(inputs.size(), options.maxInFlight, slotLimit, [&](size_t slot, size_t i) {
+        TraceScope stage("batch.encode_file", inputs[i]);
+        Picture picture(inputs[i].c_str(), color ? 3 : 1);
+        if (!picture.isValid()) {
+            std::cerr << "Failed to load image: " << inputs[i] << std::endl;
+            totals.failed++;
+            return;
+        }
+
+        ImageView image;
+        image.pixels   = picture.getData();
+        image.width    = static_cast<uint32_t>(picture.getWidth());
+        image.height   = static_cast<uint32_t>(picture.getHeight());
+        image.channels = picture.getChannels();
+        std::vector<uint8_t>& bytes = buffers[slot];
+        if (!encoders[slot].encode(image, bytes)) {
+            std::cerr << "Failed to encode: " << inputs[i] << std::endl;
+            totals.failed++;
+            return;
+        }
+
+        TraceScope writeStage("ezc.write", outputs[i]);
+        OutputFile out;
+        if (!out.open(outputs[i], fileOptions) || !out.write(bytes.data(), bytes.size()) || !out.commit()) {
+            std::cerr << "Failed to write output file: " << outputs[i] << std::endl;
+            totals.failed++;
+            return;
+        }
+        totals.done++;
+        totals.pixels += static_cast<uint64_t>(image.width) * image.height;
+        totals.codedBytes += bytes.size();
+    });
+
+    printSummary("Encoded", inputs.size(), totals, slots, start);
+    return totals.failed > 0 ? 1 : 0;
+}
+
+int decodeBatch(const std::vector<std::string>& inputs,
+                const std::string& outputDir,
+                const BatchOptions& options) {
+    std::vector<std::string> outputs;
+    if (!makeOutputPaths(inputs, outputDir, ".png", outputs)) {
+        return 1;
+    }
+
+    const size_t slotLimit = ThreadPool::shared().size() + 1;
+    std::vector<Decoder> decoders(slotLimit);
+    std::vector<std::vector<uint8_t>> buffers(slotLimit);
+
+    BatchTotals totals;
+    const auto start = std::chrono::steady_clock::now();
+    const size_t slots = runSlots(inputs.size(), options.maxInFlight, slotLimit, [&](size_t slot, size_t i) {
+        TraceScope stage("batch.decode_file", inputs[i]);
+        MappedFile file;
+        if (!file.open(inputs[i])) {
+            std::cerr << "Failed to read input file: " << inputs[i] << std::endl;
+            totals.failed++;
+            return;
+        }
+
+        std::vector<uint8_t>& pixels = buffers[slot];
+        ImageInfo info;
+        if (!decoders[slot].decode(file.data(), file.size(), pixels, info)) {
+            std::cerr << "Failed to decode: " << inputs[i] << std::endl;
+            totals.failed++;
+            return;
+        }
+
+        const int width = static_cast<int>(info.width);
+        TraceScope writeStage("decode.write_png", outputs[i]);
+        if (!stbi_write_png(outputs[i].c_str(), width, static_cast<int>(info.height), info.channels,
+                            pixels.data(), width * info.channels)) {
+            std::cerr << "Failed to write PNG: " << outputs[i] << std::endl;
+            totals.failed++;
+            return;
+        }
+        Trace::countFile(Trace::Counter::BytesWritten, outputs[i]);
+        totals.done++;
+        totals.pixels += static_cast<uint64_t>(info.width) * info.height;
+        totals.codedBytes += file.size();
+    });
+
+    printSummary("Decoded", inputs.size(), totals, slots, start);
+    return totals.failed > 0 ? 1 : 0;
+}
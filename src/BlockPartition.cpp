@@ -0,0 +1,250 @@
+#include "ezcodec/BlockPartition.h"
+#include "ezcodec/DCT.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+int16_t toUnitValue(double value) {
+    return static_cast<int16_t>(std::clamp(std::lround(value), -32768L, 32767L));
+}
+
+// Transform of the node `cells` cells wide (1 = 8x8 cell, 2, 4)
+TxSize sizeOfCells(size_t cells) {
+    switch (cells) {
+        case 4:  return TxSize::TX_32x32;
+        case 2:  return TxSize::TX_16x16;
+        default: return TxSize::TX_8x8;
+    }
+}
+
+// Low 8x8 corner of the orthonormal DCT of a dim x dim node, scaled by
+// 8 / dim. Only the 8 lowest rows and columns of the basis enter the
+// arithmetic. Returns the energy of everything outside the corner.
+template<TxSize Size>
+double forwardCorner(const uint16_t* samples, int16_t* unit) {
+    using Basis = DCTBasis<Size>;
+    constexpr int dim = Basis::dim;
+    const double* basis = Basis::matrix.data();
+
+    // Rows: temp[y][u] = sum_x in[y][x] * B[u][x], u < 8
+    double temp[dim * 8];
+    double energy = 0.0;
+    for (int y = 0; y < dim; y++) {
+        const uint16_t* row = samples + y * dim;
+        for (int x = 0; x < dim; x++) {
+            energy += static_cast<double>(row[x]) * row[x];
+        }
+        for (int u = 0; u < 8; u++) {
+            double sum = 0.0;
+            for (int x = 0; x < dim; x++) {
+                sum += row[x] * basis[u * dim + x];
+            }
+            temp[y * 8 + u] = sum;
+        }
+    }
+
+    // Columns: out[v][u] = sum_y B[v][y] * temp[y][u], v < 8
+    constexpr double scale = 8.0 / dim;
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            double sum = 0.0;
+            for (int y = 0; y < dim; y++) {
+                sum += basis[v * dim + y] * temp[y * 8 + u];
+            }
+            energy -= sum * sum;
+            unit[v * 8 + u] = toUnitValue(sum * scale);
+        }
+    }
+    return std::max(energy, 0.0);
+}
+
+// Inverse of forwardCorner() with every coefficient outside the corner zero
+template<TxSize Size>
+void inverseCorner(const int16_t* unit, int16_t* samples) {
+    using Basis = DCTBasis<Size>;
+    constexpr int dim = Basis::dim;
+    constexpr double scale = dim / 8.0;
+    const double* basis = Basis::matrix.data();
+
+    // Rows: temp[v][x] = sum_u in[v][u] * B[u][x], u < 8
+    double temp[8 * dim];
+    for (int v = 0; v < 8; v++) {
+        for (int x = 0; x < dim; x++) {
+            double sum = 0.0;
+            for (int u = 0; u < 8; u++) {
+                sum += unit[v * 8 + u] * basis[u * dim + x];
+            }
+            temp[v * dim + x] = sum * scale;
+        }
+    }
+
+    // Columns: out[y][x] = sum_v B[v][y] * temp[v][x], v < 8
+    for (int y = 0; y < dim; y++) {
+        for (int x = 0; x < dim; x++) {
+            double sum = 0.0;
+            for (int v = 0; v < 8; v++) {
+                sum += basis[v * dim + y] * temp[v * dim + x];
+            }
+            samples[y * dim + x] = toUnitValue(sum);
+        }
+    }
+}
+
+// The four 4x4 DCTs of an 8x8 cell, interleaved into one unit
+void forwardQuad(const uint16_t* samples, int16_t* unit) {
+    for (int a = 0; a < 2; a++) {
+        for (int b = 0; b < 2; b++) {
+            double in[16];
+            double out[16];
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    in[y * 4 + x] = samples[(4 * a + y) * 8 + 4 * b + x];
+                }
+            }
+            DCT::separableForwardDCT<TxSize::TX_4x4>(in, out);
+            for (int v = 0; v < 4; v++) {
+                for (int u = 0; u < 4; u++) {
+                    unit[(2 * v + a) * 8 + 2 * u + b] = toUnitValue(out[v * 4 + u] * 2.0);
+                }
+            }
+        }
+    }
+}
+
+void inverseQuad(const int16_t* unit, int16_t* samples) {
+    for (int a = 0; a < 2; a++) {
+        for (int b = 0; b < 2; b++) {
+            double in[16];
+            double out[16];
+            for (int v = 0; v < 4; v++) {
+                for (int u = 0; u < 4; u++) {
+                    in[v * 4 + u] = unit[(2 * v + a) * 8 + 2 * u + b] * 0.5;
+                }
+            }
+            DCT::separableInverseDCT<TxSize::TX_4x4>(in, out);
+            for (int y = 0; y < 4; y++) {
+                for (int x = 0; x < 4; x++) {
+                    samples[(4 * a + y) * 8 + 4 * b + x] = toUnitValue(out[y * 4 + x]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+BlockPartition::BlockPartition(size_t cellsX, size_t cellsY)
+    : width(cellsX)
+    , height(cellsY)
+    , sizes(cellsX * cellsY, TxSize::TX_8x8) {}
+
+size_t BlockPartition::codedCount(size_t rowBegin, size_t rowEnd) const {
+    size_t count = 0;
+    for (size_t y = rowBegin; y < rowEnd; y++) {
+        for (size_t x = 0; x < width; x++) {
+            count += isCoded(x, y) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+void BlockPartition::set(size_t x, size_t y, TxSize size) {
+    const size_t cells = cellsOf(size);
+    for (size_t cy = y; cy < std::min(y + cells, height); cy++) {
+        std::fill_n(sizes.begin() + static_cast<std::ptrdiff_t>(cy * width + x),
+                    std::min(cells, width - x), size);
+    }
+}
+
+void BlockPartition::writeNode(BitWriter& writer, size_t x, size_t y, size_t cells) const {
+    if (x >= width || y >= height) {
+        return;
+    }
+    if (cells == 1) {
+        writer.put(size(x, y) == TxSize::TX_4x4 ? 1 : 0, 1);
+        return;
+    }
+    if (fits(x, y, cells)) {
+        const bool split = size(x, y) != sizeOfCells(cells);
+        writer.put(split ? 1 : 0, 1);
+        if (!split) {
+            return;
+        }
+    }
+    const size_t half = cells / 2;
+    for (size_t dy = 0; dy < 2; dy++) {
+        for (size_t dx = 0; dx < 2; dx++) {
+            writeNode(writer, x + dx * half, y + dy * half, half);
+        }
+    }
+}
+
+void BlockPartition::readNode(BitReader& reader, size_t x, size_t y, size_t cells) {
+    if (x >= width || y >= height) {
+        return;
+    }
+    if (cells == 1) {
+        set(x, y, reader.get(1) ? TxSize::TX_4x4 : TxSize::TX_8x8);
+        return;
+    }
+    if (fits(x, y, cells) && reader.get(1) == 0) {
+        set(x, y, sizeOfCells(cells));
+        return;
+    }
+    const size_t half = cells / 2;
+    for (size_t dy = 0; dy < 2; dy++) {
+        for (size_t dx = 0; dx < 2; dx++) {
+            readNode(reader, x + dx * half, y + dy * half, half);
+        }
+    }
+}
+
+void BlockPartition::serialize(BitWriter& writer) const {
+    for (size_t y = 0; y < height; y += SUPERBLOCK_CELLS) {
+        for (size_t x = 0; x < width; x += SUPERBLOCK_CELLS) {
+            writeNode(writer, x, y, SUPERBLOCK_CELLS);
+        }
+    }
+}
+
+bool BlockPartition::deserialize(BitReader& reader, size_t cellsX, size_t cellsY) {
+    *this = BlockPartition(cellsX, cellsY);
+    for (size_t y = 0; y < height; y += SUPERBLOCK_CELLS) {
+        for (size_t x = 0; x < width; x += SUPERBLOCK_CELLS) {
+            readNode(reader, x, y, SUPERBLOCK_CELLS);
+        }
+    }
+    return !reader.overrun();
+}
+
+double BlockPartition::forwardUnit(TxSize size, const uint16_t* samples, int16_t* unit) {
+    switch (size) {
+        case TxSize::TX_4x4:
+            forwardQuad(samples, unit);
+            return 0.0;
+        case TxSize::TX_16x16:
+            return forwardCorner<TxSize::TX_16x16>(samples, unit);
+        case TxSize::TX_32x32:
+            return forwardCorner<TxSize::TX_32x32>(samples, unit);
+        default:
+            return 0.0;
+    }
+}
+
+void BlockPartition::inverseUnit(TxSize size, const int16_t* unit, int16_t* samples) {
+    switch (size) {
+        case TxSize::TX_4x4:
+            inverseQuad(unit, samples);
+            break;
+        case TxSize::TX_16x16:
+            inverseCorner<TxSize::TX_16x16>(unit, samples);
+            break;
+        case TxSize::TX_32x32:
+            inverseCorner<TxSize::TX_32x32>(unit, samples);
+            break;
+        default:
+            break;
+    }
+}
@@ -1,86 +1,940 @@
 #include "ezcodec/Codec.h"
 #include "ezcodec/Picture.h"
 #include "ezcodec/DCT.h"
+#include "ezcodec/BlockPartition.h"
 #include "ezcodec/Quantization.h"
 #include "ezcodec/ThreadPool.h"
 #include "ezcodec/EzcFormat.h"
+#include "ezcodec/Kernels.h"
+#include "ezcodec/PgmStream.h"
+#include "ezcodec/ColorConversion.h"
+#include "ezcodec/Trace.h"
 
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include <thread>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 
 #include "stb/stb_image_write.h"
 
+namespace {
+
+// Process-wide totals behind inverseTransformCounts()
+std::atomic<uint64_t> totalDCOnly{0};
+std::atomic<uint64_t> totalLowBand{0};
+std::atomic<uint64_t> totalFull{0};
+
+// Extent of the non-zero coefficients of a quantized block, which picks the
+// inverse transform
+enum class BlockSupport {
+    DCOnly,  // only the DC coefficient can be non-zero
+    LowBand, // everything outside the top-left 4x4 corner is zero
+    Full
+};
+
+BlockSupport blockSupport(const int16_t* block) {
+    // Each row is two 64-bit words: columns 0-3, then columns 4-7
+    uint64_t words[16];
+    std::memcpy(words, block, sizeof(words));
+    uint64_t outside = words[1] | words[3] | words[5] | words[7];
+    for (int w = 8; w < 16; w++) {
+        outside |= words[w];
+    }
+    if (outside != 0) {
+        return BlockSupport::Full;
+    }
+    const uint64_t ac = words[2] | words[4] | words[6] |
+                        static_cast<uint16_t>(block[1] | block[2] | block[3]);
+    return ac != 0 ? BlockSupport::LowBand : BlockSupport::DCOnly;
+}
+
+// Transforms of each size over the partitions of an adaptive header
+void printTransformSizes(const EzcHeader& header) {
+    uint64_t counts[4] = {};
+    for (const BlockPartition& partition : header.partitions) {
+        for (size_t y = 0; y < partition.cellsY(); y++) {
+            for (size_t x = 0; x < partition.cellsX(); x++) {
+                if (!partition.isCoded(x, y)) {
+                    continue;
+                }
+                switch (partition.size(x, y)) {
+                    case TxSize::TX_4x4:   counts[0] += 4; break;
+                    case TxSize::TX_8x8:   counts[1]++; break;
+                    case TxSize::TX_16x16: counts[2]++; break;
+                    default:               counts[3]++; break;
+                }
+            }
+        }
+    }
+    std::cout << "Transforms: " << counts[0] << " 4x4, " << counts[1] << " 8x8, " << counts[2]
+              << " 16x16, " << counts[3] << " 32x32" << std::endl;
+}
+
+void printInverseTransformCounts(const InverseTransformCounts& counts) {
+    std::cout << "Inverse transforms: " << counts.dcOnly << " DC-only, " << counts.lowBand
+              << " low-band, " << counts.full << " full" << std::endl;
+}
+
+OutputFile::Options outputFileOptions(const EncodeOptions& options) {
+    OutputFile::Options fileOptions;
+    fileOptions.atomicReplace = options.atomicWrite;
+    fileOptions.sync          = options.sync;
+    return fileOptions;
+}
+
+// Destination of reconstructed pixels: the image rectangle
+// [x, x + width) x [y, y + height), stored row by row
+struct PixelWindow {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+    unsigned char* pixels;
+};
+
+// Dequantization and inverse transform shared by the decoders
+struct BlockReconstructor {
+    const Kernels8x8& kernels;
+    std::array<uint16_t, 64> steps;
+    bool fixedPoint;
+    void (*inverseDCT)(const int16_t*, int16_t*);
+    size_t width;
+    size_t height;
+    size_t blocksPerRow;
+
+    // Blocks per inverse transform path, for this reconstructor
+    mutable std::atomic<uint64_t> dcOnlyCount{0};
+    mutable std::atomic<uint64_t> lowBandCount{0};
+    mutable std::atomic<uint64_t> fullCount{0};
+
+    explicit BlockReconstructor(const EzcHeader& header, size_t plane = 0)
+        : kernels(kernels8x8())
+        , steps(header.quantTable(plane).steps())
+        , fixedPoint((header.flags & EZC_FLAG_FIXED_POINT) != 0)
+        , inverseDCT(fixedPoint ? DCT::inverseDCT8x8Fixed : kernels.inverseDCT)
+        , width(header.plane(plane).width)
+        , height(header.plane(plane).height)
+        , blocksPerRow(header.plane(plane).blockCountX) {}
+
+    InverseTransformCounts counts() const {
+        InverseTransformCounts result;
+        result.dcOnly  = dcOnlyCount.load();
+        result.lowBand = lowBandCount.load();
+        result.full    = fullCount.load();
+        return result;
+    }
+
+    void resetCounts() {
+        dcOnlyCount = 0;
+        lowBandCount = 0;
+        fullCount = 0;
+    }
+
+    // Add blocks tallied by run() calls to this reconstructor's counts and
+    // the process totals. Callers tally per slice and add once, so the
+    // shared counters stay off the per-block path.
+    void addCounts(const InverseTransformCounts& tally) const {
+        dcOnlyCount.fetch_add(tally.dcOnly, std::memory_order_relaxed);
+        lowBandCount.fetch_add(tally.lowBand, std::memory_order_relaxed);
+        fullCount.fetch_add(tally.full, std::memory_order_relaxed);
+        totalDCOnly.fetch_add(tally.dcOnly, std::memory_order_relaxed);
+        totalLowBand.fetch_add(tally.lowBand, std::memory_order_relaxed);
+        totalFull.fetch_add(tally.full, std::memory_order_relaxed);
+    }
+
+    // Dequantize, inverse-transform and clamp blocks [first, first + count)
+    // into the part of `window` they cover; blocks outside it are skipped
+    // before any arithmetic. Each block writes its own pixel rectangle, so
+    // disjoint block ranges can run in parallel.
+    //
+    // The transform is picked from the extent of the non-zero
+    // coefficients: a constant fill for DC-only blocks, the 4x4-input
+    // transform for low-band blocks and the full kernel otherwise; the
+    // blocks taking each path are added to `tally`.
+    void run(const int16_t* blocks, size_t first, size_t count, const PixelWindow& window,
+             InverseTransformCounts& tally) const {
+        alignas(32) int16_t coefficients[64];
+        alignas(32) int16_t samples[64];
+        uint64_t dcOnly = 0;
+        uint64_t lowBand = 0;
+        uint64_t full = 0;
+        for (size_t b = 0; b < count; b++) {
+            const size_t index = first + b;
+            const size_t x0 = (index % blocksPerRow) * 8;
+            const size_t y0 = (index / blocksPerRow) * 8;
+            const size_t xBegin = std::max(x0, window.x);
+            const size_t yBegin = std::max(y0, window.y);
+            const size_t xEnd = std::min(x0 + 8, window.x + window.width);
+            const size_t yEnd = std::min(y0 + 8, window.y + window.height);
+            if (xBegin >= xEnd || yBegin >= yEnd) {
+                continue;
+            }
+
+            const int16_t* block = blocks + b * 64;
+            const BlockSupport support = blockSupport(block);
+            if (support == BlockSupport::DCOnly) {
+                const auto dc = static_cast<int16_t>(block[0] * static_cast<int>(steps[0]));
+                const int value = fixedPoint ? DCT::inverseDCT8x8DCOnlyFixed(dc) : DCT::inverseDCT8x8DCOnly(dc);
+                const auto pixel = static_cast<unsigned char>(std::clamp(value, 0, 255));
+                for (size_t y = yBegin; y < yEnd; y++) {
+                    unsigned char* row = window.pixels + (y - window.y) * window.width + (xBegin - window.x);
+                    std::fill(row, row + (xEnd - xBegin), pixel);
+                }
+                dcOnly++;
+                continue;
+            }
+
+            if (support == BlockSupport::LowBand) {
+                kernels.dequantize(block, coefficients, steps.data());
+                if (fixedPoint) {
+                    DCT::inverseDCT8x8LowBandFixed(coefficients, samples);
+                } else {
+                    kernels.inverseDCTLowBand(coefficients, samples);
+                }
+                lowBand++;
+            } else {
+                kernels.dequantize(block, coefficients, steps.data());
+                inverseDCT(coefficients, samples);
+                full++;
+            }
+
+            for (size_t y = yBegin; y < yEnd; y++) {
+                unsigned char* row = window.pixels + (y - window.y) * window.width + (xBegin - window.x);
+                const int16_t* source = samples + (y - y0) * 8 + (xBegin - x0);
+                for (size_t x = 0; x < xEnd - xBegin; x++) {
+                    row[x] = static_cast<unsigned char>(std::clamp<int>(source[x], 0, 255));
+                }
+            }
+        }
+
+        tally.dcOnly += dcOnly;
+        tally.lowBand += lowBand;
+        tally.full += full;
+    }
+
+    // Adaptive-block variant of run() for the units of block rows
+    // [rowBegin, rowEnd) of `partition`, packed in coding order. Runs of
+    // 8x8 cells go through run(); a larger node or a cell of 4x4
+    // transforms is dequantized, inverse-transformed as a whole and
+    // clamped into the part of `window` it covers.
+    void runAdaptive(const int16_t* units, const BlockPartition& partition, size_t rowBegin, size_t rowEnd,
+                     const PixelWindow& window, InverseTransformCounts& tally) const {
+        alignas(32) int16_t coefficients[64];
+        alignas(32) int16_t samples[1024];
+        for (size_t y = rowBegin; y < rowEnd; y++) {
+            size_t x = 0;
+            while (x < blocksPerRow) {
+                const TxSize size = partition.size(x, y);
+                if (size == TxSize::TX_8x8) {
+                    size_t runEnd = x + 1;
+                    while (runEnd < blocksPerRow && partition.size(runEnd, y) == TxSize::TX_8x8) {
+                        runEnd++;
+                    }
+                    run(units, y * blocksPerRow + x, runEnd - x, window, tally);
+                    units += (runEnd - x) * 64;
+                    x = runEnd;
+                    continue;
+                }
+
+                const size_t cells = BlockPartition::cellsOf(size);
+                if (partition.isCoded(x, y)) {
+                    kernels.dequantize(units, coefficients, steps.data());
+                    BlockPartition::inverseUnit(size, coefficients, samples);
+                    units += 64;
+
+                    const size_t dim = cells * 8;
+                    const size_t x0 = x * 8;
+                    const size_t y0 = y * 8;
+                    const size_t xBegin = std::max(x0, window.x);
+                    const size_t yBegin = std::max(y0, window.y);
+                    const size_t xEnd = std::min({x0 + dim, window.x + window.width, width});
+                    const size_t yEnd = std::min({y0 + dim, window.y + window.height, height});
+                    for (size_t py = yBegin; py < yEnd; py++) {
+                        unsigned char* row = window.pixels + (py - window.y) * window.width + (xBegin - window.x);
+                        const int16_t* source = samples + (py - y0) * dim + (xBegin - x0);
+                        for (size_t px = 0; px < xEnd - xBegin; px++) {
+                            row[px] = static_cast<unsigned char>(std::clamp<int>(source[px], 0, 255));
+                        }
+                    }
+                }
+                x += cells;
+            }
+        }
+    }
+
+    // Scaled variant of run(): each block becomes a dim x dim tile of an
+    // image downscaled by 8 / dim (`pixels`, `scaledWidth` wide). Only the
+    // dim x dim low-frequency coefficients are dequantized and transformed.
+    void runScaled(const int16_t* blocks, size_t first, size_t count, int dim,
+                   size_t scaledWidth, size_t scaledHeight, unsigned char* pixels) const {
+        alignas(32) int16_t coefficients[64];
+        int16_t samples[16];
+        for (size_t b = 0; b < count; b++) {
+            const int16_t* block = blocks + b * 64;
+            for (int v = 0; v < dim; v++) {
+                for (int u = 0; u < dim; u++) {
+                    coefficients[v * 8 + u] = static_cast<int16_t>(block[v * 8 + u] * static_cast<int>(steps[v * 8 + u]));
+                }
+            }
+            DCT::inverseDCT8x8Scaled(coefficients, samples, dim);
+
+            const size_t index = first + b;
+            const size_t x0 = (index % blocksPerRow) * dim;
+            const size_t y0 = (index / blocksPerRow) * dim;
+            const size_t w = std::min<size_t>(dim, scaledWidth - x0);
+            const size_t h = std::min<size_t>(dim, scaledHeight - y0);
+            for (size_t y = 0; y < h; y++) {
+                unsigned char* row = pixels + (y0 + y) * scaledWidth + x0;
+                for (size_t x = 0; x < w; x++) {
+                    row[x] = static_cast<unsigned char>(std::clamp<int>(samples[y * dim + x], 0, 255));
+                }
+            }
+        }
+    }
+};
+
+using Reconstructors = std::vector<std::unique_ptr<BlockReconstructor>>;
+
+// One reconstructor per plane of the file
+Reconstructors makeReconstructors(const EzcHeader& header) {
+    Reconstructors reconstructors;
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        reconstructors.push_back(std::make_unique<BlockReconstructor>(header, p));
+    }
+    return reconstructors;
+}
+
+InverseTransformCounts sumCounts(const Reconstructors& reconstructors) {
+    InverseTransformCounts total;
+    for (const auto& reconstructor : reconstructors) {
+        const InverseTransformCounts counts = reconstructor->counts();
+        total.dcOnly  += counts.dcOnly;
+        total.lowBand += counts.lowBand;
+        total.full    += counts.full;
+    }
+    return total;
+}
+
+// Entropy decode + dequantize + inverse DCT + clamp of every slice of
+// `reader`, fused per slice and split across the shared pool; slices of
+// plane p land in windows[p]. v1 coefficients are used in place, other
+// slices decode into a scratch buffer kept per thread, so repeated decodes
+// do not allocate. Returns false if a slice is corrupt.
+bool reconstructSlices(const EzcReader& reader, const Reconstructors& reconstructors,
+                       const std::vector<PixelWindow>& windows) {
+    TraceScope stage("decode.slices");
+    std::atomic<bool> corrupt{false};
+    ThreadPool::shared().parallelFor(0, reader.sliceCount(), 1,
+        [&](size_t sliceBegin, size_t sliceEnd) {
+            thread_local std::vector<int16_t> scratch;
+            for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                TraceScope sliceStage("decode.slice");
+                const int16_t* blocks = reader.sliceCoefficients(slice, scratch);
+                if (!blocks) {
+                    corrupt = true;
+                    continue;
+                }
+
+                size_t first = 0;
+                size_t count = 0;
+                reader.sliceBlocks(slice, first, count);
+                const size_t plane = reader.slicePlane(slice);
+                const BlockReconstructor& reconstructor = *reconstructors[plane];
+                InverseTransformCounts tally;
+                if (reader.header().flags & EZC_FLAG_ADAPTIVE_BLOCKS) {
+                    const size_t rowBegin = first / reconstructor.blocksPerRow;
+                    reconstructor.runAdaptive(blocks, reader.header().partitions[plane], rowBegin,
+                                              rowBegin + count / reconstructor.blocksPerRow, windows[plane],
+                                              tally);
+                } else {
+                    reconstructor.run(blocks, first, count, windows[plane], tally);
+                }
+                reconstructor.addCounts(tally);
+            }
+        });
+    return !corrupt;
+}
+
+// Forward DCT + quantization of blocks [first, first + count) of a plane
+// `width` pixels wide and `rows` rows high, stored `stride` bytes per row
+// and read through StridedBlockView, so blocks past the right or bottom
+// edge replicate it. Null `table` keeps the DCT coefficients unquantized.
+void transformBlocks(const unsigned char* pixels, size_t width, size_t rows, size_t stride,
+                     size_t blocksPerRow, size_t first, size_t count,
+                     void (*forwardDCT)(const uint16_t*, int16_t*),
+                     const Kernels8x8& kernels, const QuantTable* table, int16_t* out) {
+    alignas(32) uint16_t samples[64];
+    alignas(32) int16_t transformed[64];
+    for (size_t b = first; b < first + count; b++) {
+        const StridedBlockView<unsigned char> block(pixels, width, rows, stride, static_cast<int>(b % blocksPerRow),
+                                                    static_cast<int>(b / blocksPerRow));
+        block.copyTo(samples);
+        if (table == nullptr) {
+            forwardDCT(samples, out + (b - first) * 64);
+            continue;
+        }
+        forwardDCT(samples, transformed);
+        kernels.quantize(transformed, out + (b - first) * 64, table->steps().data(), table->reciprocals());
+    }
+}
+
+// Pixels of the node of `size` at cell (x, y) of a plane laid out as in
+// transformBlocks(), with the same edge replication
+void gatherSamples(const unsigned char* pixels, size_t width, size_t rows, size_t stride,
+                   size_t x, size_t y, TxSize size, uint16_t* samples) {
+    const int cells = static_cast<int>(BlockPartition::cellsOf(size));
+    const int nodeX = static_cast<int>(x) / cells;
+    const int nodeY = static_cast<int>(y) / cells;
+    switch (size) {
+        case TxSize::TX_16x16:
+            StridedBlockView<unsigned char, TxSize::TX_16x16>(pixels, width, rows, stride, nodeX, nodeY)
+                .copyTo(samples);
+            break;
+        case TxSize::TX_32x32:
+            StridedBlockView<unsigned char, TxSize::TX_32x32>(pixels, width, rows, stride, nodeX, nodeY)
+                .copyTo(samples);
+            break;
+        default:
+            StridedBlockView<unsigned char>(pixels, width, rows, stride, nodeX, nodeY).copyTo(samples);
+            break;
+    }
+}
+
+// Rough size in bits of a quantized unit in the entropy coder: a small DC
+// difference and the end of block, then a run/size code plus the
+// magnitude bits of every non-zero AC coefficient
+double unitBits(const int16_t* quantized) {
+    double bits = 5.0;
+    for (size_t i = 1; i < 64; i++) {
+        if (quantized[i] != 0) {
+            int magnitude = std::abs(static_cast<int>(quantized[i]));
+            int category = 0;
+            while (magnitude > 0) {
+                category++;
+                magnitude >>= 1;
+            }
+            bits += 4.0 + category;
+        }
+    }
+    return bits;
+}
+
+// Rate-distortion trade-off of the adaptive block sizes: squared pixel
+// error per estimated bit, proportional to the square of the first AC
+// steps. Calibrated on scanned documents, where anything from 0.3 to 1
+// gives the same size/PSNR curve.
+constexpr double LAMBDA_FACTOR = 0.5;
+
+double lambdaOf(const QuantTable& table) {
+    const double step = (table.steps()[1] + table.steps()[8]) / 2.0;
+    return LAMBDA_FACTOR * step * step;
+}
+
+// Transform of one node of `size` into `unit` and its quantization into
+// `quantized`; returns the cost D + lambda * R, with D the squared pixel
+// error (quantization error of the unit plus what it leaves out)
+double codeNode(TxSize size, const uint16_t* samples, const Kernels8x8& kernels, const QuantTable& table,
+                double lambda, int16_t* unit, int16_t* quantized) {
+    double distortion = 0.0;
+    if (size == TxSize::TX_8x8) {
+        kernels.forwardDCT(samples, unit);
+    } else {
+        distortion = BlockPartition::forwardUnit(size, samples, unit);
+    }
+    kernels.quantize(unit, quantized, table.steps().data(), table.reciprocals());
+
+    const double scale = BlockPartition::unitScale(size);
+    double unitError = 0.0;
+    for (size_t i = 0; i < 64; i++) {
+        const double error = unit[i] - static_cast<double>(quantized[i]) * table.steps()[i];
+        unitError += error * error;
+    }
+    return distortion + unitError * scale * scale + lambda * unitBits(quantized);
+}
+
+// Transform sizes and units of the superblock at cell (sx, sy) of a plane
+// laid out as in transformBlocks(). Bottom up, each cell takes an 8x8 or
+// four 4x4 transforms, then every 16x16 and 32x32 node that fits the grid
+// replaces its children when it costs less than they do together. Each
+// unit goes to the top-left cell of its node in `out` (cell-indexed,
+// quantized unless `quantize` is false).
+void transformSuperblock(const unsigned char* pixels, const EzcPlane& plane, size_t stride,
+                         size_t sx, size_t sy, const Kernels8x8& kernels, const QuantTable& table,
+                         bool quantize, BlockPartition& partition, int16_t* out) {
+    constexpr size_t superblock = BlockPartition::SUPERBLOCK_CELLS;
+    const double lambda = lambdaOf(table);
+    alignas(32) uint16_t samples[1024];
+    alignas(32) int16_t unit[64];
+    alignas(32) int16_t quantized[64];
+    auto cost = [&](TxSize size, size_t x, size_t y) {
+        gatherSamples(pixels, plane.width, plane.height, stride, x, y, size, samples);
+        return codeNode(size, samples, kernels, table, lambda, unit, quantized);
+    };
+
+    double superblockCost = 0.0;
+    for (size_t qy = sy; qy < std::min<size_t>(sy + superblock, plane.blockCountY); qy += 2) {
+        for (size_t qx = sx; qx < std::min<size_t>(sx + superblock, plane.blockCountX); qx += 2) {
+            double nodeCost = 0.0;
+            for (size_t y = qy; y < std::min<size_t>(qy + 2, plane.blockCountY); y++) {
+                for (size_t x = qx; x < std::min<size_t>(qx + 2, plane.blockCountX); x++) {
+                    const double cost8 = cost(TxSize::TX_8x8, x, y);
+                    const double cost4 = cost(TxSize::TX_4x4, x, y);
+                    partition.set(x, y, cost4 < cost8 ? TxSize::TX_4x4 : TxSize::TX_8x8);
+                    nodeCost += std::min(cost4, cost8);
+                }
+            }
+            if (partition.fits(qx, qy, 2)) {
+                const double cost16 = cost(TxSize::TX_16x16, qx, qy);
+                if (cost16 < nodeCost) {
+                    partition.set(qx, qy, TxSize::TX_16x16);
+                    nodeCost = cost16;
+                }
+            }
+            superblockCost += nodeCost;
+        }
+    }
+    if (partition.fits(sx, sy, superblock) && cost(TxSize::TX_32x32, sx, sy) < superblockCost) {
+        partition.set(sx, sy, TxSize::TX_32x32);
+    }
+
+    for (size_t y = sy; y < std::min<size_t>(sy + superblock, plane.blockCountY); y++) {
+        for (size_t x = sx; x < std::min<size_t>(sx + superblock, plane.blockCountX); x++) {
+            if (!partition.isCoded(x, y)) {
+                continue;
+            }
+            const TxSize size = partition.size(x, y);
+            int16_t* dst = out + (y * plane.blockCountX + x) * 64;
+            cost(size, x, y);
+            std::copy_n(quantize ? quantized : unit, 64, dst);
+        }
+    }
+}
+
+// Adaptive variant of the per-plane transform in transformImage(): picks
+// the partition superblock row by superblock row on the pool, then packs
+// the units of every slice (`sliceRows` block rows, a multiple of the
+// superblock) at the start of its range, in coding order
+void transformPlaneAdaptive(const unsigned char* pixels, const EzcPlane& plane, size_t stride,
+                            size_t sliceRows, const Kernels8x8& kernels, const QuantTable& table,
+                            bool quantize, BlockPartition& partition, BlockPlane8x8i16& out) {
+    constexpr size_t superblock = BlockPartition::SUPERBLOCK_CELLS;
+    const size_t cellsX = plane.blockCountX;
+    const size_t cellsY = plane.blockCountY;
+    partition = BlockPartition(cellsX, cellsY);
+    int16_t* units = out.data();
+    const size_t superblockRows = (cellsY + superblock - 1) / superblock;
+    ThreadPool::shared().parallelFor(0, superblockRows, 1, [&](size_t rowBegin, size_t rowEnd) {
+        for (size_t row = rowBegin; row < rowEnd; row++) {
+            for (size_t x = 0; x < cellsX; x += superblock) {
+                transformSuperblock(pixels, plane, stride, x, row * superblock, kernels, table, quantize,
+                                    partition, units);
+            }
+        }
+    });
+
+    const size_t slices = (cellsY + sliceRows - 1) / sliceRows;
+    ThreadPool::shared().parallelFor(0, slices, 1, [&](size_t sliceBegin, size_t sliceEnd) {
+        for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+            const size_t rowBegin = slice * sliceRows;
+            size_t packed = rowBegin * cellsX;
+            for (size_t y = rowBegin; y < std::min(rowBegin + sliceRows, cellsY); y++) {
+                for (size_t x = 0; x < cellsX; x++) {
+                    if (!partition.isCoded(x, y)) {
+                        continue;
+                    }
+                    const size_t cell = y * cellsX + x;
+                    if (cell != packed) {
+                        std::memcpy(units + packed * 64, units + cell * 64, 64 * sizeof(int16_t));
+                    }
+                    packed++;
+                }
+            }
+        }
+    });
+}
+
+// Quantizers: luma, then chroma
+using QuantTables = std::array<QuantTable, 2>;
+
+// Quantizers of `options` at `quality`: its custom base tables scaled like
+// the JPEG ones (one table serves both), or the JPEG tables themselves
+QuantTables makeQuantTables(const EncodeOptions& options, int quality) {
+    const std::vector<uint16_t>& custom = options.quantTables;
+    if (custom.size() >= 64) {
+        QuantTable::Steps luma{};
+        QuantTable::Steps chroma{};
+        std::copy(custom.begin(), custom.begin() + 64, luma.begin());
+        std::copy(custom.end() - 64, custom.end(), chroma.begin());
+        return {Quantization::makeQuantTable(quality, luma), Quantization::makeQuantTable(quality, chroma)};
+    }
+    return {Quantization::makeQuantTable(quality, Quantization::Component::Luma),
+            Quantization::makeQuantTable(quality, Quantization::Component::Chroma)};
+}
+
+// Custom tables must be one 64-entry table or a luma and a chroma one
+bool checkQuantTables(const EncodeOptions& options) {
+    const size_t count = options.quantTables.size();
+    if (count != 0 && count != 64 && count != 128) {
+        std::cerr << "Custom quantization tables need 64 or 128 step sizes, got " << count << std::endl;
+        return false;
+    }
+    if (options.adaptiveBlocks && options.fixedPoint) {
+        std::cerr << "Adaptive block sizes need the float transform (no fixed point)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Files with adaptive block sizes only decode at full size
+bool checkFixedBlocks(const EzcHeader& header, const char* mode) {
+    if (header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) {
+        std::cerr << mode << " does not support .ezc files with adaptive block sizes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Records the quality and tables a file is coded with; the steps are only
+// written when the header has EZC_FLAG_QUANT_TABLES
+void setQuantization(EzcHeader& header, int quality, const QuantTables& tables) {
+    header.quality = static_cast<uint8_t>(quality);
+    header.quantSteps = {tables[0].steps(), tables[1].steps()};
+}
+
+// Header of a v2 file for a width x height image coded with `options`;
+// `color` codes the three planes of options.chroma, otherwise gray
+EzcHeader makeHeader(uint32_t width, uint32_t height, const EncodeOptions& options, bool color) {
+    const int blockDim = 8;
+    EzcHeader header;
+    header.version     = EZC_VERSION_LATEST;
+    header.width       = width;
+    header.height      = height;
+    header.quality     = static_cast<uint8_t>(options.quality);
+    header.blockDim    = static_cast<uint8_t>(blockDim);
+    header.blockCountX = (width + blockDim - 1) / blockDim;
+    header.blockCountY = (height + blockDim - 1) / blockDim;
+    header.flags       = (options.fixedPoint ? EZC_FLAG_FIXED_POINT : 0) |
+                         (options.quantTables.empty() ? 0 : EZC_FLAG_QUANT_TABLES) |
+                         (options.adaptiveBlocks ? EZC_FLAG_ADAPTIVE_BLOCKS : 0) |
+                         ezcChromaFlags(color ? options.chroma : ChromaFormat::Gray);
+    if (options.sliceRows > 0) {
+        header.flags    |= EZC_FLAG_SLICED;
+        header.sliceRows = static_cast<uint32_t>(std::min(options.sliceRows, 65535));
+    } else if (color) {
+        // Color v2 files are always sliced; one slice per plane
+        header.flags    |= EZC_FLAG_SLICED;
+        header.sliceRows = std::max<uint32_t>(header.blockCountY, 1);
+    }
+    if (options.adaptiveBlocks && (header.flags & EZC_FLAG_SLICED)) {
+        // Slices hold whole superblock rows
+        constexpr uint32_t superblock = BlockPartition::SUPERBLOCK_CELLS;
+        header.sliceRows = std::min<uint32_t>((header.sliceRows + superblock - 1) / superblock * superblock,
+                                              65535 / superblock * superblock);
+    }
+    return header;
+}
+
+// Forward DCT + quantization of `image` into one block plane per plane of
+// `header`, fused per block and split across the shared pool by block
+// rows. The coefficients only ever live in a stack buffer. RGB images are
+// converted to Y, Cb and Cr planes in `samples` first (chroma subsampled),
+// and each plane is transformed on its own grid with its own table; a gray
+// header keeps only the luma. Without `quantize` the unquantized DCT
+// coefficients are stored instead, for quantizePlanes() to quantize later.
+//
+// With EZC_FLAG_ADAPTIVE_BLOCKS the transform sizes are chosen with
+// `tables` and stored in header.partitions, and the planes hold the packed
+// units of each slice.
+void transformImage(const ImageView& image, EzcHeader& header, const QuantTables& tables, bool quantize,
+                    std::vector<unsigned char> (&samples)[3], std::vector<BlockPlane8x8i16>& planes) {
+    const bool fixedPoint = (header.flags & EZC_FLAG_FIXED_POINT) != 0;
+    const Kernels8x8& kernels = kernels8x8();
+    const auto forwardDCT = fixedPoint ? DCT::forwardDCT8x8Fixed : kernels.forwardDCT;
+    const size_t stride = image.stride != 0 ? image.stride
+                                            : static_cast<size_t>(image.width) * image.channels;
+
+    if (image.channels == 3) {
+        TraceScope stage("encode.color");
+        const ChromaFormat format = header.chromaFormat();
+        rgbToPlanes(image.pixels, image.width, image.height, stride,
+                    format == ChromaFormat::Gray ? ChromaFormat::YCbCr444 : format,
+                    samples[0], samples[1], samples[2]);
+    }
+
+    planes.resize(header.planeCount());
+    const bool adaptive = (header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) != 0;
+    header.partitions.resize(adaptive ? planes.size() : 0);
+    for (size_t p = 0; p < planes.size(); p++) {
+        TraceScope stage("encode.transform");
+        const EzcPlane plane = header.plane(p);
+        const unsigned char* pixels = image.channels == 3 ? samples[p].data() : image.pixels;
+        const size_t rowStride = image.channels == 3 ? plane.width : stride;
+        const QuantTable* table = quantize ? &tables[p == 0 ? 0 : 1] : nullptr;
+        planes[p].resize(static_cast<int>(plane.blockCountX), static_cast<int>(plane.blockCountY));
+        if (adaptive) {
+            const size_t sliceRows = (header.flags & EZC_FLAG_SLICED) ? header.sliceRows
+                                                                      : std::max<size_t>(plane.blockCountY, 1);
+            transformPlaneAdaptive(pixels, plane, rowStride, sliceRows, kernels, tables[p == 0 ? 0 : 1],
+                                   quantize, header.partitions[p], planes[p]);
+            continue;
+        }
+        const size_t blocksPerRow = plane.blockCountX;
+        ThreadPool::shared().parallelFor(0, plane.blockCountY, 1, [&](size_t rowBegin, size_t rowEnd) {
+            transformBlocks(pixels, plane.width, plane.height, rowStride, blocksPerRow,
+                            rowBegin * blocksPerRow, (rowEnd - rowBegin) * blocksPerRow,
+                            forwardDCT, kernels, table,
+                            planes[p].data() + rowBegin * blocksPerRow * 64);
+        });
+    }
+}
+
+// Quantization of the DCT coefficient planes kept by transformImage()
+// into `planes`, split across the shared pool by block rows
+void quantizePlanes(const std::vector<BlockPlane8x8i16>& coefficients, const QuantTables& tables,
+                    std::vector<BlockPlane8x8i16>& planes) {
+    const Kernels8x8& kernels = kernels8x8();
+    planes.resize(coefficients.size());
+    for (size_t p = 0; p < planes.size(); p++) {
+        const int16_t* src = coefficients[p].data();
+        const size_t blocksPerRow = static_cast<size_t>(coefficients[p].blockCountX());
+        const QuantTable& table = tables[p == 0 ? 0 : 1];
+        planes[p].resize(coefficients[p].blockCountX(), coefficients[p].blockCountY());
+        int16_t* dst = planes[p].data();
+        ThreadPool::shared().parallelFor(0, static_cast<size_t>(coefficients[p].blockCountY()), 1,
+            [&](size_t rowBegin, size_t rowEnd) {
+                for (size_t b = rowBegin * blocksPerRow; b < rowEnd * blocksPerRow; b++) {
+                    kernels.quantize(src + b * 64, dst + b * 64, table.steps().data(), table.reciprocals());
+                }
+            });
+    }
+}
+
+// Size in bytes of the file `header` codes to with `tables`, from the DCT
+// coefficient planes: every slice is requantized into a per-thread buffer
+// and only its symbols are counted. `buffers` holds the slices of
+// collectEzcSlices().
+uint64_t estimateCodedSize(const EzcHeader& header, const QuantTables& tables, EzcWriteBuffers& buffers) {
+    TraceScope stage("rate.estimate");
+    const Kernels8x8& kernels = kernels8x8();
+    const std::vector<EzcWriteBuffers::Slice>& slices = buffers.slices;
+    buffers.sliceStats.resize(slices.size());
+    ThreadPool::shared().parallelFor(0, slices.size(), 1, [&](size_t sliceBegin, size_t sliceEnd) {
+        thread_local std::vector<int16_t> quantized;
+        for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+            const EzcWriteBuffers::Slice& range = slices[slice];
+            const QuantTable& table = tables[range.plane == 0 ? 0 : 1];
+            Trace::countGrowth(quantized, range.count * 64);
+            quantized.resize(range.count * 64);
+            for (size_t b = 0; b < range.count; b++) {
+                kernels.quantize(range.blocks + b * 64, quantized.data() + b * 64,
+                                 table.steps().data(), table.reciprocals());
+            }
+
+            EntropyCoder::Statistics& stats = buffers.sliceStats[slice];
+            std::fill(stats.dc.begin(), stats.dc.end(), 0);
+            std::fill(stats.ac.begin(), stats.ac.end(), 0);
+            EntropyCoder::gatherStatistics(quantized.data(), range.count, stats);
+        }
+    });
+    return ezcCodedSize(header, buffers);
+}
+
+// Outcome of the quality search for a byte budget
+struct RateSearch {
+    int quality = 1;
+    uint64_t bytes = 0; // exact file size at `quality`
+    int passes = 0;
+    bool fits = false;  // false: even quality 1 is over the budget
+};
+
+// Highest quality whose file fits in `targetBytes`, by binary search over
+// 1-100 on DCT coefficients computed once. A pass costs one requantization
+// and symbol count of the image, never a transform or entropy coding run;
+// seven passes narrow 100 qualities down to one, plus one more for quality 1
+// when nothing above it fits. Coded size is not strictly monotonic in
+// quality, so a higher quality than the one found may occasionally fit too.
+// Custom tables of `options` are scaled by each quality tried.
+RateSearch searchQuality(const EzcHeader& header, const EncodeOptions& options,
+                         const std::vector<BlockPlane8x8i16>& coefficients,
+                         uint64_t targetBytes, EzcWriteBuffers& buffers) {
+    TraceScope stage("rate.search");
+    RateSearch result;
+    if (!collectEzcSlices(header, coefficients, buffers)) {
+        return result;
+    }
+
+    int low = 1;
+    int high = 100;
+    while (low < high) {
+        const int mid = (low + high + 1) / 2;
+        const uint64_t bytes = estimateCodedSize(header, makeQuantTables(options, mid), buffers);
+        result.passes++;
+        if (bytes <= targetBytes) {
+            low = mid;
+            result.quality = mid;
+            result.bytes = bytes;
+            result.fits = true;
+        } else {
+            high = mid - 1;
+        }
+    }
+    if (!result.fits) {
+        result.bytes = estimateCodedSize(header, makeQuantTables(options, 1), buffers);
+        result.passes++;
+        result.fits = result.bytes <= targetBytes;
+    }
+    return result;
+}
+
+// Byte budget of `options` for a width x height image, 0 for none
+uint64_t targetBytesOf(const EncodeOptions& options, uint32_t width, uint32_t height) {
+    if (options.targetSize > 0) {
+        return options.targetSize;
+    }
+    if (options.targetBpp > 0.0) {
+        const double pixels = static_cast<double>(width) * height;
+        return std::max<uint64_t>(static_cast<uint64_t>(options.targetBpp * pixels / 8.0), 1);
+    }
+    return 0;
+}
+
+// Transform of `image` for a byte budget: forward DCT once into
+// `coefficients`, quality search, then quantization into `planes` at the
+// quality found, which is stored in the header with its tables. Adaptive
+// block sizes are chosen once, at options.quality.
+RateSearch transformForTarget(const ImageView& image, EzcHeader& header, const EncodeOptions& options,
+                              uint64_t targetBytes,
+                              std::vector<unsigned char> (&samples)[3],
+                              std::vector<BlockPlane8x8i16>& coefficients,
+                              std::vector<BlockPlane8x8i16>& planes, EzcWriteBuffers& buffers) {
+    transformImage(image, header, makeQuantTables(options, options.quality), false, samples, coefficients);
+    const RateSearch search = searchQuality(header, options, coefficients, targetBytes, buffers);
+    const QuantTables tables = makeQuantTables(options, search.quality);
+    setQuantization(header, search.quality, tables);
+    TraceScope stage("rate.quantize");
+    quantizePlanes(coefficients, tables, planes);
+    return search;
+}
+
+// Writes one 8-bit plane as a gray PNG, or three as RGB after chroma
+// upsampling
+bool writePlanesPng(const std::string& path, const EzcHeader& header, size_t width, size_t height,
+                    const std::vector<std::vector<unsigned char>>& planes) {
+    const ChromaFormat format = header.chromaFormat();
+    std::vector<unsigned char> rgb;
+    if (format != ChromaFormat::Gray) {
+        TraceScope stage("decode.color");
+        Trace::countGrowth(rgb, width * height * 3);
+        rgb.resize(width * height * 3);
+        planesToRgb(planes[0].data(), planes[1].data(), planes[2].data(), width, height, format, rgb.data());
+    }
+
+    TraceScope stage("decode.write_png", path);
+    const int channels = format == ChromaFormat::Gray ? 1 : 3;
+    const unsigned char* pixels = format == ChromaFormat::Gray ? planes[0].data() : rgb.data();
+    if (!stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), channels,
+                        pixels, static_cast<int>(width) * channels)) {
+        return false;
+    }
+    Trace::countFile(Trace::Counter::BytesWritten, path);
+    return true;
+}
+
+// Strip buffer of the streaming coders: `batch` strips of `stripRows` rows,
+// but never more strips than there are slices nor more rows than the image,
+// so an unsliced file or a large slice height costs one image at most
+std::vector<unsigned char> makeStripBuffer(size_t batch, size_t slices, size_t stripRows,
+                                           size_t width, size_t height) {
+    std::vector<unsigned char> pixels;
+    const size_t size = std::min(std::min(batch, slices) * stripRows, height) * width;
+    Trace::countGrowth(pixels, size);
+    pixels.resize(size);
+    return pixels;
+}
+
+} // namespace
+
 int encode(const std::string& inputPng,
            const std::string& outputEzc,
            int quality) {
+    EncodeOptions options;
+    options.quality = quality;
+    return encode(inputPng, outputEzc, options);
+}
 
-    // Load image (grayscale)
-    Picture picture(inputPng.c_str());
+int encode(const std::string& inputPng,
+           const std::string& outputEzc,
+           const EncodeOptions& options) {
+    TraceScope stage("encode", inputPng);
+    const int quality = options.quality;
+    const bool color = options.chroma != ChromaFormat::Gray;
+    if (!checkQuantTables(options)) {
+        return 1;
+    }
+
+    // Load image (grayscale, or RGB for color planes)
+    Picture picture(inputPng.c_str(), color ? 3 : 1);
     if (!picture.isValid()) {
         std::cerr << "Failed to load image: " << inputPng << std::endl;
         return 1;
     }
 
-    auto& dataBlocks = picture.getBlocks();
     const int imageWidth = picture.getWidth();
     const int imageHeight = picture.getHeight();
+    EzcHeader header = makeHeader(static_cast<uint32_t>(imageWidth),
+                                        static_cast<uint32_t>(imageHeight), options, color);
 
-    std::cout << "Image: " << imageWidth << "x" << imageHeight << std::endl;
-    std::cout << "Blocks: " << dataBlocks.size() << std::endl;
-
-    // Prepare DCT output blocks
-    std::vector<Block8x8i16> dctBlocks;
-    dctBlocks.reserve(dataBlocks.size());
-    for (const auto& block : dataBlocks) {
-        dctBlocks.emplace_back(block.getBlockX(), block.getBlockY());
+    size_t blockCount = 0;
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        blockCount += static_cast<size_t>(header.plane(p).blockCountX) * header.plane(p).blockCountY;
     }
-
-    // Forward DCT (multi-threaded)
-    {
-        ThreadPool pool(std::thread::hardware_concurrency());
-        std::vector<std::future<void>> futures;
-        for (size_t i = 0; i < dataBlocks.size(); i++) {
-            futures.emplace_back(pool.enqueue([&, i] {
-                DCT::forwardDCT(dataBlocks[i], dctBlocks[i]);
-            }));
-        }
-        for (auto& f : futures) f.get();
+    std::cout << "Image: " << imageWidth << "x" << imageHeight << std::endl;
+    if (color) {
+        std::cout << "Chroma: YCbCr " << chromaFormatName(options.chroma) << std::endl;
     }
-    std::cout << "Forward DCT completed." << std::endl;
-
-    // Quantize (multi-threaded)
-    std::vector<Block8x8i16> quantizedBlocks;
-    quantizedBlocks.reserve(dctBlocks.size());
-    for (const auto& block : dctBlocks) {
-        quantizedBlocks.emplace_back(block.getBlockX(), block.getBlockY());
+    std::cout << "Blocks: " << blockCount << std::endl;
+    std::cout << "Kernels: " << (options.fixedPoint ? "fixed-point" : kernels8x8().name) << std::endl;
+    if (!options.quantTables.empty()) {
+        std::cout << "Quantization: custom tables" << std::endl;
     }
 
-    {
-        ThreadPool pool(std::thread::hardware_concurrency());
-        std::vector<std::future<void>> futures;
-        for (size_t i = 0; i < dctBlocks.size(); i++) {
-            futures.emplace_back(pool.enqueue([&, i] {
-                Quantization::quantize(dctBlocks[i], quantizedBlocks[i], quality);
-            }));
+    ImageView image;
+    image.pixels   = picture.getData();
+    image.width    = header.width;
+    image.height   = header.height;
+    image.channels = picture.getChannels();
+    std::vector<BlockPlane8x8i16> planes;
+    std::vector<unsigned char> samples[3];
+    const uint64_t targetBytes = targetBytesOf(options, header.width, header.height);
+    if (targetBytes > 0) {
+        std::vector<BlockPlane8x8i16> coefficients;
+        EzcWriteBuffers buffers;
+        const RateSearch search = transformForTarget(image, header, options, targetBytes, samples,
+                                                     coefficients, planes, buffers);
+        std::cout << "Rate control: quality=" << search.quality << ", " << search.bytes
+                  << " bytes for a target of " << targetBytes << " (" << search.passes
+                  << " passes)" << std::endl;
+        if (!search.fits) {
+            std::cerr << "Warning: target of " << targetBytes << " bytes is below the smallest file ("
+                      << search.bytes << " bytes at quality 1)" << std::endl;
         }
-        for (auto& f : futures) f.get();
+    } else {
+        const QuantTables tables = makeQuantTables(options, quality);
+        setQuantization(header, quality, tables);
+        transformImage(image, header, tables, true, samples, planes);
+    }
+    std::cout << "Forward DCT and quantization completed (quality="
+              << static_cast<int>(header.quality) << ")." << std::endl;
+    if (options.adaptiveBlocks) {
+        printTransformSizes(header);
     }
-    std::cout << "Quantization completed (quality=" << quality << ")." << std::endl;
 
     // Write .ezc file
-    const int blockDim = 8;
-    EzcHeader header;
-    header.version     = 1;
-    header.width       = static_cast<uint16_t>(imageWidth);
-    header.height      = static_cast<uint16_t>(imageHeight);
-    header.quality     = static_cast<uint8_t>(quality);
-    header.blockDim    = static_cast<uint8_t>(blockDim);
-    header.blockCountX = static_cast<uint16_t>((imageWidth + blockDim - 1) / blockDim);
-    header.blockCountY = static_cast<uint16_t>((imageHeight + blockDim - 1) / blockDim);
-
-    if (!writeEzc(outputEzc, header, quantizedBlocks)) {
+    if (!writeEzc(outputEzc, header, planes, outputFileOptions(options))) {
         std::cerr << "Failed to write output file: " << outputEzc << std::endl;
         return 1;
     }
@@ -89,91 +943,609 @@ int encode(const std::string& inputPng,
     return 0;
 }
 
+InverseTransformCounts inverseTransformCounts() {
+    InverseTransformCounts counts;
+    counts.dcOnly  = totalDCOnly.load();
+    counts.lowBand = totalLowBand.load();
+    counts.full    = totalFull.load();
+    return counts;
+}
+
 int decode(const std::string& inputEzc,
            const std::string& outputPng) {
+    TraceScope stage("decode", inputEzc);
 
-    // Read .ezc file
-    EzcHeader header;
-    std::vector<Block8x8i16> quantizedBlocks;
-    if (!readEzc(inputEzc, header, quantizedBlocks)) {
+    // Map the .ezc file; coefficients are read from the mapped pages
+    EzcReader reader;
+    if (!reader.open(inputEzc)) {
         std::cerr << "Failed to read input file: " << inputEzc << std::endl;
         return 1;
     }
+    const EzcHeader& header = reader.header();
 
     const int imageWidth  = header.width;
     const int imageHeight = header.height;
     const int quality     = header.quality;
+    const bool fixedPoint = (header.flags & EZC_FLAG_FIXED_POINT) != 0;
 
+    size_t blockCount = 0;
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        blockCount += static_cast<size_t>(header.plane(p).blockCountX) * header.plane(p).blockCountY;
+    }
     std::cout << "Image: " << imageWidth << "x" << imageHeight
               << ", quality=" << quality << std::endl;
-    std::cout << "Blocks: " << quantizedBlocks.size() << std::endl;
+    if (header.planeCount() > 1) {
+        std::cout << "Chroma: YCbCr " << chromaFormatName(header.chromaFormat()) << std::endl;
+    }
+    std::cout << "Blocks: " << blockCount << std::endl;
+
+    const auto reconstructors = makeReconstructors(header);
+    std::cout << "Kernels: " << (fixedPoint ? "fixed-point" : reconstructors[0]->kernels.name) << std::endl;
 
-    // Dequantize (multi-threaded)
-    std::vector<Block8x8i16> dequantizedBlocks;
-    dequantizedBlocks.reserve(quantizedBlocks.size());
-    for (const auto& block : quantizedBlocks) {
-        dequantizedBlocks.emplace_back(block.getBlockX(), block.getBlockY());
+    // Every plane decodes into its own pixel buffer
+    std::vector<std::vector<unsigned char>> pixels(header.planeCount());
+    std::vector<PixelWindow> windows;
+    for (size_t p = 0; p < pixels.size(); p++) {
+        const EzcPlane plane = header.plane(p);
+        Trace::countGrowth(pixels[p], static_cast<size_t>(plane.width) * plane.height);
+        pixels[p].assign(static_cast<size_t>(plane.width) * plane.height, 0);
+        windows.push_back({0, 0, plane.width, plane.height, pixels[p].data()});
+    }
+    if (!reconstructSlices(reader, reconstructors, windows)) {
+        std::cerr << "Corrupt .ezc block data: " << inputEzc << std::endl;
+        return 1;
     }
+    std::cout << "Dequantization and inverse DCT completed." << std::endl;
+    printInverseTransformCounts(sumCounts(reconstructors));
 
-    {
-        ThreadPool pool(std::thread::hardware_concurrency());
-        std::vector<std::future<void>> futures;
-        for (size_t i = 0; i < quantizedBlocks.size(); i++) {
-            futures.emplace_back(pool.enqueue([&, i] {
-                Quantization::dequantize(quantizedBlocks[i], dequantizedBlocks[i], quality);
-            }));
-        }
-        for (auto& f : futures) f.get();
+    // Save as PNG
+    if (!writePlanesPng(outputPng, header, header.width, header.height, pixels)) {
+        std::cerr << "Failed to write PNG: " << outputPng << std::endl;
+        return 1;
     }
-    std::cout << "Dequantization completed." << std::endl;
 
-    // Inverse DCT (multi-threaded)
-    std::vector<Block8x8ui16> reconstructedBlocks;
-    reconstructedBlocks.reserve(dequantizedBlocks.size());
-    for (const auto& block : dequantizedBlocks) {
-        reconstructedBlocks.emplace_back(block.getBlockX(), block.getBlockY());
+    std::cout << "Decoded to: " << outputPng << std::endl;
+    return 0;
+}
+
+int decodeScaled(const std::string& inputEzc,
+                 const std::string& outputPng,
+                 int denominator) {
+    if (denominator == 1) {
+        return decode(inputEzc, outputPng);
+    }
+    if (denominator != 2 && denominator != 4 && denominator != 8) {
+        std::cerr << "Unsupported scale 1/" << denominator << " (expected 1/2, 1/4 or 1/8)" << std::endl;
+        return 1;
     }
+    const int dim = 8 / denominator;
+    TraceScope stage("decode.scaled", inputEzc);
 
-    {
-        ThreadPool pool(std::thread::hardware_concurrency());
-        std::vector<std::future<void>> futures;
-        for (size_t i = 0; i < dequantizedBlocks.size(); i++) {
-            futures.emplace_back(pool.enqueue([&, i] {
-                DCT::inverseDCT(dequantizedBlocks[i], reconstructedBlocks[i]);
-            }));
-        }
-        for (auto& f : futures) f.get();
+    EzcReader reader;
+    if (!reader.open(inputEzc)) {
+        std::cerr << "Failed to read input file: " << inputEzc << std::endl;
+        return 1;
+    }
+    const EzcHeader& header = reader.header();
+    if (!checkFixedBlocks(header, "Scaled decoding")) {
+        return 1;
     }
-    std::cout << "Inverse DCT completed." << std::endl;
 
-    // Reconstruct pixel buffer
-    std::vector<unsigned char> pixels(imageWidth * imageHeight, 0);
+    // Partial edge blocks round up, like the block grid itself
+    auto scaled = [&](uint32_t size) { return (static_cast<size_t>(size) + denominator - 1) / denominator; };
+    const size_t scaledWidth = scaled(header.width);
+    const size_t scaledHeight = scaled(header.height);
 
-    for (const auto& block : reconstructedBlocks) {
-        int bx = block.getBlockX();
-        int by = block.getBlockY();
+    std::cout << "Image: " << header.width << "x" << header.height
+              << ", quality=" << static_cast<int>(header.quality) << std::endl;
+    std::cout << "Scale: 1/" << denominator << " (" << scaledWidth << "x" << scaledHeight << ", "
+              << dim << "x" << dim << " inverse transform)" << std::endl;
 
-        for (int y = 0; y < 8; y++) {
-            for (int x = 0; x < 8; x++) {
-                int imgX = bx * 8 + x;
-                int imgY = by * 8 + y;
+    // Chroma planes scale by the same factor, which keeps them at
+    // ceil(scaledWidth / 2) etc. for planesToRgb()
+    const auto reconstructors = makeReconstructors(header);
+    std::vector<std::vector<unsigned char>> pixels(header.planeCount());
+    for (size_t p = 0; p < pixels.size(); p++) {
+        const EzcPlane plane = header.plane(p);
+        Trace::countGrowth(pixels[p], scaled(plane.width) * scaled(plane.height));
+        pixels[p].assign(scaled(plane.width) * scaled(plane.height), 0);
+    }
 
-                if (imgX < imageWidth && imgY < imageHeight) {
-                    int value = static_cast<int>(block.at(y, x));
-                    value = std::clamp(value, 0, 255);
-                    pixels[imgY * imageWidth + imgX] = static_cast<unsigned char>(value);
+    std::atomic<bool> corrupt{false};
+    ThreadPool::shared().parallelFor(0, reader.sliceCount(), 1,
+        [&](size_t sliceBegin, size_t sliceEnd) {
+            std::vector<int16_t> scratch;
+            for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                TraceScope sliceStage("decode.slice");
+                const int16_t* blocks = reader.sliceCoefficients(slice, scratch);
+                if (!blocks) {
+                    corrupt = true;
+                    continue;
                 }
+
+                size_t first = 0;
+                size_t count = 0;
+                reader.sliceBlocks(slice, first, count);
+                const size_t p = reader.slicePlane(slice);
+                const EzcPlane plane = header.plane(p);
+                reconstructors[p]->runScaled(blocks, first, count, dim, scaled(plane.width),
+                                             scaled(plane.height), pixels[p].data());
             }
+        });
+    if (corrupt) {
+        std::cerr << "Corrupt .ezc block data: " << inputEzc << std::endl;
+        return 1;
+    }
+
+    if (!writePlanesPng(outputPng, header, scaledWidth, scaledHeight, pixels)) {
+        std::cerr << "Failed to write PNG: " << outputPng << std::endl;
+        return 1;
+    }
+
+    std::cout << "Decoded to: " << outputPng << std::endl;
+    return 0;
+}
+
+int decodeRegion(const std::string& inputEzc,
+                 const std::string& outputPng,
+                 const Region& region) {
+    TraceScope stage("decode.region", inputEzc);
+    EzcReader reader;
+    if (!reader.open(inputEzc)) {
+        std::cerr << "Failed to read input file: " << inputEzc << std::endl;
+        return 1;
+    }
+    const EzcHeader& header = reader.header();
+    const bool fixedPoint = (header.flags & EZC_FLAG_FIXED_POINT) != 0;
+    if (header.planeCount() > 1) {
+        std::cerr << "Region decoding supports gray .ezc files only" << std::endl;
+        return 1;
+    }
+    if (!checkFixedBlocks(header, "Region decoding")) {
+        return 1;
+    }
+
+    // Clip the crop to the image
+    if (region.x >= header.width || region.y >= header.height || region.width == 0 || region.height == 0) {
+        std::cerr << "Region " << region.x << "," << region.y << "," << region.width << "," << region.height
+                  << " is outside the " << header.width << "x" << header.height << " image" << std::endl;
+        return 1;
+    }
+    const size_t cropX = region.x;
+    const size_t cropY = region.y;
+    const size_t cropWidth = std::min<size_t>(region.width, header.width - region.x);
+    const size_t cropHeight = std::min<size_t>(region.height, header.height - region.y);
+
+    // Blocks of the grid that intersect the crop
+    const size_t blocksPerRow = header.blockCountX;
+    const size_t blockXBegin = cropX / 8;
+    const size_t blockXEnd = (cropX + cropWidth + 7) / 8;
+    const size_t blockYBegin = cropY / 8;
+    const size_t blockYEnd = (cropY + cropHeight + 7) / 8;
+    const size_t rowsPerSlice = reader.sliceRows();
+    const size_t sliceBegin = blockYBegin / rowsPerSlice;
+    const size_t sliceEnd = (blockYEnd - 1) / rowsPerSlice + 1;
+
+    std::cout << "Image: " << header.width << "x" << header.height
+              << ", quality=" << static_cast<int>(header.quality) << std::endl;
+    std::cout << "Region: " << cropWidth << "x" << cropHeight << " at " << cropX << "," << cropY << std::endl;
+    std::cout << "Blocks: " << (blockXEnd - blockXBegin) * (blockYEnd - blockYBegin) << " of "
+              << blocksPerRow * header.blockCountY << std::endl;
+
+    const BlockReconstructor reconstructor(header);
+    std::cout << "Kernels: " << (fixedPoint ? "fixed-point" : reconstructor.kernels.name) << std::endl;
+
+    // Only the slices covering the crop are touched. Inside a slice the
+    // entropy decoder stops after the last needed block, and only the
+    // intersecting blocks of each block row are dequantized and transformed.
+    std::vector<unsigned char> pixels(cropWidth * cropHeight, 0);
+    const PixelWindow window{cropX, cropY, cropWidth, cropHeight, pixels.data()};
+    std::atomic<bool> corrupt{false};
+    ThreadPool::shared().parallelFor(sliceBegin, sliceEnd, 1, [&](size_t begin, size_t end) {
+        std::vector<int16_t> scratch;
+        for (size_t slice = begin; slice < end; slice++) {
+            TraceScope sliceStage("decode.slice");
+            const size_t sliceRowBegin = slice * rowsPerSlice;
+            const size_t rowBegin = std::max(blockYBegin, sliceRowBegin);
+            const size_t rowEnd = std::min(blockYEnd, sliceRowBegin + rowsPerSlice);
+            const size_t blockLimit = (rowEnd - 1 - sliceRowBegin) * blocksPerRow + blockXEnd;
+
+            const int16_t* blocks = reader.sliceCoefficients(slice, scratch, blockLimit);
+            if (!blocks) {
+                corrupt = true;
+                continue;
+            }
+            InverseTransformCounts tally;
+            for (size_t row = rowBegin; row < rowEnd; row++) {
+                const size_t offset = (row - sliceRowBegin) * blocksPerRow + blockXBegin;
+                reconstructor.run(blocks + offset * 64, row * blocksPerRow + blockXBegin,
+                                  blockXEnd - blockXBegin, window, tally);
+            }
+            reconstructor.addCounts(tally);
         }
+    });
+    if (corrupt) {
+        std::cerr << "Corrupt .ezc block data: " << inputEzc << std::endl;
+        return 1;
     }
 
-    // Save as PNG
-    if (!stbi_write_png(outputPng.c_str(), imageWidth, imageHeight, 1,
-                        pixels.data(), imageWidth)) {
+    printInverseTransformCounts(reconstructor.counts());
+
+    TraceScope writeStage("decode.write_png", outputPng);
+    if (!stbi_write_png(outputPng.c_str(), static_cast<int>(cropWidth), static_cast<int>(cropHeight), 1,
+                        pixels.data(), static_cast<int>(cropWidth))) {
         std::cerr << "Failed to write PNG: " << outputPng << std::endl;
         return 1;
     }
+    Trace::countFile(Trace::Counter::BytesWritten, outputPng);
 
     std::cout << "Decoded to: " << outputPng << std::endl;
     return 0;
 }
+
+int encodeStream(const std::string& inputPgm,
+                 const std::string& outputEzc,
+                 const EncodeOptions& options) {
+    TraceScope stage("encode.stream", inputPgm);
+    const int quality = options.quality;
+    if (options.chroma != ChromaFormat::Gray) {
+        std::cerr << "Streaming encode supports gray images only" << std::endl;
+        return 1;
+    }
+
+    if (options.targetSize > 0 || options.targetBpp > 0.0) {
+        std::cerr << "Streaming encode cannot search for a target size; use a fixed quality" << std::endl;
+        return 1;
+    }
+    if (options.adaptiveBlocks) {
+        std::cerr << "Streaming encode supports 8x8 blocks only" << std::endl;
+        return 1;
+    }
+    if (!checkQuantTables(options)) {
+        return 1;
+    }
+
+    PgmReader input;
+    if (!input.open(inputPgm)) {
+        return 1;
+    }
+
+    const int blockDim = 8;
+    EzcHeader header;
+    header.version     = EZC_VERSION_STRIPED;
+    header.width       = input.width();
+    header.height      = input.height();
+    header.quality     = static_cast<uint8_t>(quality);
+    header.blockDim    = static_cast<uint8_t>(blockDim);
+    header.blockCountX = static_cast<uint32_t>((static_cast<uint64_t>(header.width) + blockDim - 1) / blockDim);
+    header.blockCountY = static_cast<uint32_t>((static_cast<uint64_t>(header.height) + blockDim - 1) / blockDim);
+    header.flags       = EZC_FLAG_SLICED | (options.fixedPoint ? EZC_FLAG_FIXED_POINT : 0) |
+                         (options.quantTables.empty() ? 0 : EZC_FLAG_QUANT_TABLES);
+    header.sliceRows   = static_cast<uint32_t>(std::max(options.sliceRows, 1));
+    const QuantTables tables = makeQuantTables(options, quality);
+    setQuantization(header, quality, tables);
+
+    const size_t width = header.width;
+    const size_t height = header.height;
+    const size_t blocksPerRow = header.blockCountX;
+    const size_t stripRows = static_cast<size_t>(header.sliceRows) * blockDim;
+    const size_t slices = (header.blockCountY + header.sliceRows - 1) / header.sliceRows;
+
+    std::cout << "Image: " << width << "x" << height << std::endl;
+    std::cout << "Slices: " << slices << " of " << stripRows << " rows" << std::endl;
+
+    const Kernels8x8& kernels = kernels8x8();
+    const auto forwardDCT = options.fixedPoint ? DCT::forwardDCT8x8Fixed : kernels.forwardDCT;
+    std::cout << "Kernels: " << (options.fixedPoint ? "fixed-point" : kernels.name) << std::endl;
+
+    EzcStripWriter writer;
+    if (!writer.open(outputEzc, header, outputFileOptions(options))) {
+        std::cerr << "Failed to write output file: " << outputEzc << std::endl;
+        return 1;
+    }
+
+    // One batch of strips per round: read the rows, transform and entropy
+    // code every strip on the pool, then append them in order. Memory is
+    // bounded by the batch, not the image.
+    const size_t batch = ThreadPool::shared().size() + 1;
+    std::vector<unsigned char> pixels = makeStripBuffer(batch, slices, stripRows, width, height);
+    std::vector<std::vector<int16_t>> coefficients(batch);
+    std::vector<std::vector<uint8_t>> encoded(batch);
+
+    for (size_t firstSlice = 0; firstSlice < slices; firstSlice += batch) {
+        const size_t sliceCount = std::min(batch, slices - firstSlice);
+        const size_t rowBegin = firstSlice * stripRows;
+        const size_t rowEnd = std::min(height, (firstSlice + sliceCount) * stripRows);
+        {
+            TraceScope readStage("stream.read");
+            if (!input.readRows(pixels.data(), rowEnd - rowBegin)) {
+                return 1;
+            }
+        }
+
+        ThreadPool::shared().parallelFor(0, sliceCount, 1, [&](size_t stripBegin, size_t stripEnd) {
+            for (size_t strip = stripBegin; strip < stripEnd; strip++) {
+                TraceScope stripStage("stream.encode_strip");
+                const unsigned char* stripPixels = pixels.data() + strip * stripRows * width;
+                const size_t rows = std::min(stripRows, rowEnd - rowBegin - strip * stripRows);
+                const size_t blockRows = (rows + blockDim - 1) / blockDim;
+                const size_t count = blockRows * blocksPerRow;
+                Trace::countGrowth(coefficients[strip], count * 64);
+                coefficients[strip].resize(count * 64);
+                transformBlocks(stripPixels, width, rows, width, blocksPerRow, 0, count, forwardDCT,
+                                kernels, &tables[0], coefficients[strip].data());
+
+                EzcStripWriter::encodeSlice(coefficients[strip].data(), count, encoded[strip]);
+            }
+        });
+
+        TraceScope writeStage("stream.write");
+        for (size_t strip = 0; strip < sliceCount; strip++) {
+            if (!writer.writeSlice(encoded[strip])) {
+                std::cerr << "Failed to write output file: " << outputEzc << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    if (!writer.finish()) {
+        std::cerr << "Failed to write output file: " << outputEzc << std::endl;
+        return 1;
+    }
+
+    std::cout << "Encoded to: " << outputEzc << std::endl;
+    return 0;
+}
+
+int decodeStream(const std::string& inputEzc,
+                 const std::string& outputPgm) {
+    TraceScope stage("decode.stream", inputEzc);
+    EzcReader reader;
+    if (!reader.open(inputEzc)) {
+        std::cerr << "Failed to read input file: " << inputEzc << std::endl;
+        return 1;
+    }
+    const EzcHeader& header = reader.header();
+    const bool fixedPoint = (header.flags & EZC_FLAG_FIXED_POINT) != 0;
+    if (header.planeCount() > 1) {
+        std::cerr << "Streaming decode supports gray .ezc files only" << std::endl;
+        return 1;
+    }
+    if (!checkFixedBlocks(header, "Streaming decode")) {
+        return 1;
+    }
+
+    const size_t width = header.width;
+    const size_t height = header.height;
+    const size_t stripRows = reader.sliceRows() * 8;
+    const size_t slices = reader.sliceCount();
+
+    std::cout << "Image: " << width << "x" << height
+              << ", quality=" << static_cast<int>(header.quality) << std::endl;
+    std::cout << "Slices: " << slices << " of " << stripRows << " rows" << std::endl;
+
+    const BlockReconstructor reconstructor(header);
+    std::cout << "Kernels: " << (fixedPoint ? "fixed-point" : reconstructor.kernels.name) << std::endl;
+
+    PgmWriter output;
+    if (!output.open(outputPgm, header.width, header.height)) {
+        return 1;
+    }
+
+    // Decode a batch of slices on the pool into a strip buffer, then append
+    // the rows in order
+    const size_t batch = ThreadPool::shared().size() + 1;
+    std::vector<unsigned char> pixels = makeStripBuffer(batch, slices, stripRows, width, height);
+    std::vector<std::vector<int16_t>> scratch(batch);
+    std::atomic<bool> corrupt{false};
+
+    for (size_t firstSlice = 0; firstSlice < slices; firstSlice += batch) {
+        const size_t sliceCount = std::min(batch, slices - firstSlice);
+        const size_t rowBegin = firstSlice * stripRows;
+        const size_t rowEnd = std::min(height, (firstSlice + sliceCount) * stripRows);
+        const PixelWindow window{0, rowBegin, width, rowEnd - rowBegin, pixels.data()};
+
+        ThreadPool::shared().parallelFor(0, sliceCount, 1, [&](size_t stripBegin, size_t stripEnd) {
+            for (size_t strip = stripBegin; strip < stripEnd; strip++) {
+                TraceScope sliceStage("decode.slice");
+                const int16_t* blocks = reader.sliceCoefficients(firstSlice + strip, scratch[strip]);
+                if (!blocks) {
+                    corrupt = true;
+                    continue;
+                }
+                size_t first = 0;
+                size_t count = 0;
+                reader.sliceBlocks(firstSlice + strip, first, count);
+                InverseTransformCounts tally;
+                reconstructor.run(blocks, first, count, window, tally);
+                reconstructor.addCounts(tally);
+            }
+        });
+
+        if (corrupt) {
+            std::cerr << "Corrupt .ezc block data: " << inputEzc << std::endl;
+            return 1;
+        }
+        TraceScope writeStage("stream.write");
+        if (!output.writeRows(pixels.data(), rowEnd - rowBegin)) {
+            return 1;
+        }
+    }
+
+    if (!output.finish()) {
+        std::cerr << "Failed to write PGM: " << outputPgm << std::endl;
+        return 1;
+    }
+    printInverseTransformCounts(reconstructor.counts());
+
+    std::cout << "Decoded to: " << outputPgm << std::endl;
+    return 0;
+}
+
+struct Encoder::State {
+    EncodeOptions options;
+
+    // Quantizers for `tableQuality`, rebuilt when the options change
+    int tableQuality = -1;
+    QuantTables tables{};
+
+    // Scratch kept between calls; coefficients only with a size target
+    std::vector<unsigned char> samples[3];
+    std::vector<BlockPlane8x8i16> coefficients;
+    std::vector<BlockPlane8x8i16> planes;
+    EzcWriteBuffers buffers;
+
+    int lastQuality = 0;
+};
+
+Encoder::Encoder(const EncodeOptions& options)
+    : state(std::make_unique<State>()) {
+    setOptions(options);
+}
+
+Encoder::~Encoder() = default;
+Encoder::Encoder(Encoder&&) noexcept = default;
+Encoder& Encoder::operator=(Encoder&&) noexcept = default;
+
+const EncodeOptions& Encoder::options() const {
+    return state->options;
+}
+
+void Encoder::setOptions(const EncodeOptions& options) {
+    state->options = options;
+    state->options.quality = std::clamp(options.quality, 1, 100);
+    state->tableQuality = -1;
+}
+
+bool Encoder::encode(const ImageView& image, std::vector<uint8_t>& out) {
+    TraceScope stage("encoder.encode");
+    State& s = *state;
+    if (image.pixels == nullptr || image.width == 0 || image.height == 0) {
+        std::cerr << "Empty image" << std::endl;
+        return false;
+    }
+    if (image.channels != 1 && image.channels != 3) {
+        std::cerr << "Unsupported channel count: " << image.channels << " (expected 1 or 3)" << std::endl;
+        return false;
+    }
+    if (image.stride != 0 && image.stride < static_cast<size_t>(image.width) * image.channels) {
+        std::cerr << "Image stride " << image.stride << " is shorter than a row" << std::endl;
+        return false;
+    }
+    if (image.width > 0xFFFF || image.height > 0xFFFF) {
+        std::cerr << "Image too large for an in-memory .ezc file: " << image.width << "x"
+                  << image.height << std::endl;
+        return false;
+    }
+
+    if (!checkQuantTables(s.options)) {
+        return false;
+    }
+    if (s.tableQuality != s.options.quality) {
+        s.tables = makeQuantTables(s.options, s.options.quality);
+        s.tableQuality = s.options.quality;
+    }
+
+    const bool color = image.channels == 3 && s.options.chroma != ChromaFormat::Gray;
+    EzcHeader header = makeHeader(image.width, image.height, s.options, color);
+    const uint64_t targetBytes = targetBytesOf(s.options, image.width, image.height);
+    if (targetBytes > 0) {
+        transformForTarget(image, header, s.options, targetBytes, s.samples, s.coefficients, s.planes,
+                           s.buffers);
+    } else {
+        setQuantization(header, s.options.quality, s.tables);
+        transformImage(image, header, s.tables, true, s.samples, s.planes);
+    }
+    s.lastQuality = header.quality;
+    return writeEzcBuffer(out, header, s.planes, s.buffers);
+}
+
+int Encoder::lastQuality() const {
+    return state->lastQuality;
+}
+
+struct Decoder::State {
+    EzcReader reader;
+
+    // Reconstructors and the header they were built for; reused while the
+    // quality, flags, tables and size stay the same
+    EzcHeader reconstructorHeader;
+    Reconstructors reconstructors;
+
+    // Y, Cb and Cr pixels of color files
+    std::vector<std::vector<unsigned char>> planes;
+    std::vector<PixelWindow> windows;
+
+    InverseTransformCounts counts;
+};
+
+Decoder::Decoder()
+    : state(std::make_unique<State>()) {}
+
+Decoder::~Decoder() = default;
+Decoder::Decoder(Decoder&&) noexcept = default;
+Decoder& Decoder::operator=(Decoder&&) noexcept = default;
+
+bool Decoder::decode(const uint8_t* data, size_t size, std::vector<uint8_t>& pixels, ImageInfo& info) {
+    TraceScope stage("decoder.decode");
+    State& s = *state;
+    s.counts = InverseTransformCounts();
+    if (!s.reader.openBuffer(data, size)) {
+        return false;
+    }
+    const EzcHeader& header = s.reader.header();
+
+    const EzcHeader& cached = s.reconstructorHeader;
+    if (s.reconstructors.empty() || cached.quality != header.quality || cached.flags != header.flags ||
+        cached.quantSteps != header.quantSteps ||
+        cached.width != header.width || cached.height != header.height) {
+        s.reconstructors = makeReconstructors(header);
+        s.reconstructorHeader = header;
+    }
+    for (auto& reconstructor : s.reconstructors) {
+        reconstructor->resetCounts();
+    }
+
+    // Gray files decode straight into `pixels`; color planes go through
+    // the kept plane buffers and are converted at the end. Every pixel is
+    // written, so nothing is cleared first.
+    const bool color = header.planeCount() > 1;
+    const size_t width = header.width;
+    const size_t height = header.height;
+    Trace::countGrowth(pixels, width * height * (color ? 3 : 1));
+    pixels.resize(width * height * (color ? 3 : 1));
+    s.windows.clear();
+    if (color) {
+        s.planes.resize(header.planeCount());
+        for (size_t p = 0; p < s.planes.size(); p++) {
+            const EzcPlane plane = header.plane(p);
+            Trace::countGrowth(s.planes[p], static_cast<size_t>(plane.width) * plane.height);
+            s.planes[p].resize(static_cast<size_t>(plane.width) * plane.height);
+            s.windows.push_back({0, 0, plane.width, plane.height, s.planes[p].data()});
+        }
+    } else {
+        s.windows.push_back({0, 0, width, height, pixels.data()});
+    }
+
+    if (!reconstructSlices(s.reader, s.reconstructors, s.windows)) {
+        std::cerr << "Corrupt .ezc block data" << std::endl;
+        return false;
+    }
+    if (color) {
+        TraceScope colorStage("decode.color");
+        planesToRgb(s.planes[0].data(), s.planes[1].data(), s.planes[2].data(),
+                    width, height, header.chromaFormat(), pixels.data());
+    }
+    s.counts = sumCounts(s.reconstructors);
+
+    info.width    = header.width;
+    info.height   = header.height;
+    info.channels = color ? 3 : 1;
+    info.quality  = header.quality;
+    info.chroma   = header.chromaFormat();
+    return true;
+}
+
+InverseTransformCounts Decoder::lastCounts() const {
+    return state->counts;
+}
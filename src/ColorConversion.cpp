@@ -0,0 +1,211 @@
+#include "ezcodec/ColorConversion.h"
+#include "ezcodec/ThreadPool.h"
+#include "simd/SimdKernels.h"
+
+#include <algorithm>
+
+namespace {
+
+// Full-range BT.601 (JFIF) coefficients scaled by 2^14. Each row of the
+// forward matrix sums to exactly 2^14 (luma) or 0 (chroma), so gray pixels
+// map to Cb = Cr = 128 and back without drift.
+constexpr int COLOR_BITS = 14;
+constexpr int COLOR_ROUND = 1 << (COLOR_BITS - 1);
+constexpr int CHROMA_BIAS = (128 << COLOR_BITS) + COLOR_ROUND;
+
+inline uint8_t saturate(int value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : std::min(value >> COLOR_BITS, 255));
+}
+
+void rgbToYCbCrScalar(const uint8_t* rgb, uint8_t* y, uint8_t* cb, uint8_t* cr, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const int r = rgb[3 * i];
+        const int g = rgb[3 * i + 1];
+        const int b = rgb[3 * i + 2];
+        y[i]  = saturate( 4899 * r + 9617 * g + 1868 * b + COLOR_ROUND);
+        cb[i] = saturate(-2765 * r - 5427 * g + 8192 * b + CHROMA_BIAS);
+        cr[i] = saturate( 8192 * r - 6860 * g - 1332 * b + CHROMA_BIAS);
+    }
+}
+
+void yCbCrToRgbScalar(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const int luma = y[i] << COLOR_BITS;
+        const int u = cb[i] - 128;
+        const int v = cr[i] - 128;
+        rgb[3 * i]     = saturate(luma + 22970 * v + COLOR_ROUND);
+        rgb[3 * i + 1] = saturate(luma - 5638 * u - 11700 * v + COLOR_ROUND);
+        rgb[3 * i + 2] = saturate(luma + 29032 * u + COLOR_ROUND);
+    }
+}
+
+void upsampleRow2xScalar(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst, size_t dstCount) {
+    simd::upsampleColumns2x(nearRow, farRow, dst, dstCount, 0, (dstCount + 1) / 2);
+}
+
+// Mean of the 2x2 pixels (the same row twice for 4:2:2) each chroma sample
+// covers; a pixel past the right edge repeats the last column.
+void downsampleRow(const uint8_t* top, const uint8_t* bottom, size_t width,
+                   uint8_t* dst, size_t dstCount) {
+    for (size_t x = 0; x < dstCount; x++) {
+        const size_t left = 2 * x;
+        const size_t right = std::min(left + 1, width - 1);
+        dst[x] = static_cast<uint8_t>((top[left] + top[right] + bottom[left] + bottom[right] + 2) >> 2);
+    }
+}
+
+// Rows per parallelFor chunk of the whole-image conversions
+constexpr size_t ROW_GRAIN = 16;
+
+} // namespace
+
+namespace simd {
+
+void upsampleColumns2x(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                       size_t dstCount, size_t first, size_t last) {
+    const size_t count = (dstCount + 1) / 2;
+    auto column = [&](size_t i) { return 3 * nearRow[i] + farRow[i]; };
+    for (size_t i = first; i < last; i++) {
+        const int center = 3 * column(i);
+        const int left = column(i > 0 ? i - 1 : 0);
+        const int right = column(i + 1 < count ? i + 1 : count - 1);
+        dst[2 * i] = static_cast<uint8_t>((center + left + 8) >> 4);
+        if (2 * i + 1 < dstCount) {
+            dst[2 * i + 1] = static_cast<uint8_t>((center + right + 8) >> 4);
+        }
+    }
+}
+
+const ColorKernels& scalarColorKernels() {
+    static const ColorKernels table = {
+        SimdLevel::Scalar, "scalar",
+        rgbToYCbCrScalar, yCbCrToRgbScalar, upsampleRow2xScalar
+    };
+    return table;
+}
+
+} // namespace simd
+
+int chromaFactorX(ChromaFormat format) {
+    return (format == ChromaFormat::YCbCr422 || format == ChromaFormat::YCbCr420) ? 2 : 1;
+}
+
+int chromaFactorY(ChromaFormat format) {
+    return format == ChromaFormat::YCbCr420 ? 2 : 1;
+}
+
+const char* chromaFormatName(ChromaFormat format) {
+    switch (format) {
+        case ChromaFormat::YCbCr444: return "4:4:4";
+        case ChromaFormat::YCbCr422: return "4:2:2";
+        case ChromaFormat::YCbCr420: return "4:2:0";
+        default:                     return "gray";
+    }
+}
+
+const ColorKernels* colorKernelsFor(SimdLevel level) {
+    // Same availability as the block kernels
+    if (kernels8x8For(level) == nullptr) {
+        return nullptr;
+    }
+
+    switch (level) {
+#if defined(EZCODEC_HAVE_AVX2)
+        case SimdLevel::AVX2:  return &simd::avx2ColorKernels();
+#endif
+#if defined(EZCODEC_HAVE_SSE41)
+        case SimdLevel::SSE41: return &simd::sse41ColorKernels();
+#endif
+        case SimdLevel::Scalar: return &simd::scalarColorKernels();
+        default: return nullptr;
+    }
+}
+
+const ColorKernels& colorKernels() {
+    static const ColorKernels& selected = *colorKernelsFor(detectSimdLevel());
+    return selected;
+}
+
+void rgbToPlanes(const uint8_t* rgb, size_t width, size_t height, size_t stride, ChromaFormat format,
+                 std::vector<uint8_t>& y, std::vector<uint8_t>& cb, std::vector<uint8_t>& cr) {
+    const ColorKernels& kernels = colorKernels();
+    const int factorX = chromaFactorX(format);
+    const int factorY = chromaFactorY(format);
+    const size_t chromaWidth = (width + factorX - 1) / factorX;
+    const size_t chromaHeight = (height + factorY - 1) / factorY;
+
+    y.resize(width * height);
+    cb.resize(chromaWidth * chromaHeight);
+    cr.resize(chromaWidth * chromaHeight);
+
+    if (factorX == 1 && factorY == 1) {
+        ThreadPool::shared().parallelFor(0, height, ROW_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; row++) {
+                const size_t offset = row * width;
+                kernels.rgbToYCbCr(rgb + row * stride, y.data() + offset,
+                                   cb.data() + offset, cr.data() + offset, width);
+            }
+        });
+        return;
+    }
+
+    // Subsampled formats halve the width; convert factorY full-resolution
+    // chroma rows, then average them down. The row buffers are kept per
+    // thread, so repeated conversions do not allocate.
+    ThreadPool::shared().parallelFor(0, chromaHeight, ROW_GRAIN, [&](size_t begin, size_t end) {
+        thread_local std::vector<uint8_t> fullCb;
+        thread_local std::vector<uint8_t> fullCr;
+        fullCb.resize(width * 2);
+        fullCr.resize(width * 2);
+        for (size_t chromaRow = begin; chromaRow < end; chromaRow++) {
+            for (int k = 0; k < factorY; k++) {
+                const size_t row = std::min(chromaRow * factorY + k, height - 1);
+                kernels.rgbToYCbCr(rgb + row * stride, y.data() + row * width,
+                                   fullCb.data() + k * width, fullCr.data() + k * width, width);
+            }
+            const size_t bottom = (factorY == 2) ? width : 0;
+            uint8_t* cbRow = cb.data() + chromaRow * chromaWidth;
+            uint8_t* crRow = cr.data() + chromaRow * chromaWidth;
+            downsampleRow(fullCb.data(), fullCb.data() + bottom, width, cbRow, chromaWidth);
+            downsampleRow(fullCr.data(), fullCr.data() + bottom, width, crRow, chromaWidth);
+        }
+    });
+}
+
+void planesToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+                 size_t width, size_t height, ChromaFormat format, uint8_t* rgb) {
+    const ColorKernels& kernels = colorKernels();
+    const int factorX = chromaFactorX(format);
+    const int factorY = chromaFactorY(format);
+    const size_t chromaWidth = (width + factorX - 1) / factorX;
+    const size_t chromaHeight = (height + factorY - 1) / factorY;
+
+    ThreadPool::shared().parallelFor(0, height, ROW_GRAIN, [&](size_t begin, size_t end) {
+        thread_local std::vector<uint8_t> cbRow;
+        thread_local std::vector<uint8_t> crRow;
+        cbRow.resize(factorX == 1 ? 0 : width);
+        crRow.resize(factorX == 1 ? 0 : width);
+        for (size_t row = begin; row < end; row++) {
+            const uint8_t* cbOut = cb + row * chromaWidth;
+            const uint8_t* crOut = cr + row * chromaWidth;
+            if (factorX == 2) {
+                // Output row 2c sits between chroma rows c - 1 and c, row
+                // 2c + 1 between c and c + 1
+                size_t nearRow = row;
+                size_t farRow = row;
+                if (factorY == 2) {
+                    nearRow = row / 2;
+                    farRow = (row % 2 == 0) ? (nearRow > 0 ? nearRow - 1 : 0)
+                                            : std::min(nearRow + 1, chromaHeight - 1);
+                }
+                kernels.upsampleRow2x(cb + nearRow * chromaWidth, cb + farRow * chromaWidth,
+                                      cbRow.data(), width);
+                kernels.upsampleRow2x(cr + nearRow * chromaWidth, cr + farRow * chromaWidth,
+                                      crRow.data(), width);
+                cbOut = cbRow.data();
+                crOut = crRow.data();
+            }
+            kernels.yCbCrToRgb(y + row * width, cbOut, crOut, rgb + row * width * 3, width);
+        }
+    });
+}
@@ -0,0 +1,387 @@
+#include "ezcodec/DCT.h"
+#include <array>
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// AAN scale factors: a[0] = 1, a[k] = cos(k*pi/16) * sqrt(2)
+std::array<double, 8> aanFactors() {
+    const double pi = 3.14159265358979323846;
+    std::array<double, 8> a{};
+    a[0] = 1.0;
+    for (int k = 1; k < 8; k++) {
+        a[k] = std::cos(k * pi / 16.0) * std::sqrt(2.0);
+    }
+    return a;
+}
+
+// 1D forward AAN transform of 8 values spaced `stride` apart.
+// Outputs carry a per-frequency AAN factor; the product of both passes is
+// undone by aanForwardScale().
+inline void fdct8(double* d, int stride) {
+    double tmp0 = d[0 * stride] + d[7 * stride];
+    double tmp7 = d[0 * stride] - d[7 * stride];
+    double tmp1 = d[1 * stride] + d[6 * stride];
+    double tmp6 = d[1 * stride] - d[6 * stride];
+    double tmp2 = d[2 * stride] + d[5 * stride];
+    double tmp5 = d[2 * stride] - d[5 * stride];
+    double tmp3 = d[3 * stride] + d[4 * stride];
+    double tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    double tmp10 = tmp0 + tmp3;
+    double tmp13 = tmp0 - tmp3;
+    double tmp11 = tmp1 + tmp2;
+    double tmp12 = tmp1 - tmp2;
+
+    d[0 * stride] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    double z1 = (tmp12 + tmp13) * 0.707106781186547524;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    double z5 = (tmp10 - tmp12) * 0.382683432365089772;
+    double z2 = 0.541196100146196984 * tmp10 + z5;
+    double z4 = 1.306562964876376527 * tmp12 + z5;
+    double z3 = tmp11 * 0.707106781186547524;
+
+    double z11 = tmp7 + z3;
+    double z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[1 * stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+// 1D inverse AAN transform of 8 prescaled values spaced `stride` apart.
+inline void idct8(double* d, int stride) {
+    // Even part
+    double tmp0 = d[0 * stride];
+    double tmp1 = d[2 * stride];
+    double tmp2 = d[4 * stride];
+    double tmp3 = d[6 * stride];
+
+    double tmp10 = tmp0 + tmp2;
+    double tmp11 = tmp0 - tmp2;
+
+    double tmp13 = tmp1 + tmp3;
+    double tmp12 = (tmp1 - tmp3) * 1.414213562373095049 - tmp13;
+
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    // Odd part
+    double tmp4 = d[1 * stride];
+    double tmp5 = d[3 * stride];
+    double tmp6 = d[5 * stride];
+    double tmp7 = d[7 * stride];
+
+    double z13 = tmp6 + tmp5;
+    double z10 = tmp6 - tmp5;
+    double z11 = tmp4 + tmp7;
+    double z12 = tmp4 - tmp7;
+
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562373095049;
+
+    double z5 = (z10 + z12) * 1.847759065022573512;
+    tmp10 = 1.082392200292393968 * z12 - z5;
+    tmp12 = -2.613125929752753055 * z10 + z5;
+
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
+
+    d[0 * stride] = tmp0 + tmp7;
+    d[7 * stride] = tmp0 - tmp7;
+    d[1 * stride] = tmp1 + tmp6;
+    d[6 * stride] = tmp1 - tmp6;
+    d[2 * stride] = tmp2 + tmp5;
+    d[5 * stride] = tmp2 - tmp5;
+    d[4 * stride] = tmp3 + tmp4;
+    d[3 * stride] = tmp3 - tmp4;
+}
+
+// Fixed-point basis: round(DCTBasis<TX_8x8>::matrix * 2^13). Spelled out
+// rather than derived so the bit-exact pipeline cannot depend on how a
+// compiler evaluates floating-point constants.
+constexpr int FIX_BITS = 13;
+constexpr int FIX_PASS1_FRAC_BITS = 2;
+constexpr int32_t FIX_BASIS[64] = {
+    2896,  2896,  2896,  2896,  2896,  2896,  2896,  2896,
+    4017,  3406,  2276,   799,  -799, -2276, -3406, -4017,
+    3784,  1567, -1567, -3784, -3784, -1567,  1567,  3784,
+    3406,  -799, -4017, -2276,  2276,  4017,   799, -3406,
+    2896, -2896, -2896,  2896,  2896, -2896, -2896,  2896,
+    2276, -4017,   799,  3406, -3406,  -799,  4017, -2276,
+    1567, -3784,  3784, -1567, -1567,  3784, -3784,  1567,
+     799, -2276,  3406, -4017,  4017, -3406,  2276,  -799,
+};
+
+// Same for the 4-point transform used by scaled decoding:
+// round(DCTBasis<TX_4x4>::matrix * 2^13)
+constexpr int32_t FIX_BASIS_4[16] = {
+    4096,  4096,  4096,  4096,
+    5352,  2217, -2217, -5352,
+    4096, -4096, -4096,  4096,
+    2217, -5352,  5352, -2217,
+};
+
+// floor(x / 2^n + 1/2) without relying on the sign behaviour of >>
+inline int64_t descale(int64_t x, int n) {
+    const int64_t biased = x + (int64_t(1) << (n - 1));
+    if (biased >= 0) {
+        return biased >> n;
+    }
+    return -((-biased + (int64_t(1) << n) - 1) >> n);
+}
+
+inline int16_t saturateToInt16(int64_t x) {
+    return static_cast<int16_t>(std::clamp<int64_t>(x, INT16_MIN, INT16_MAX));
+}
+
+} // namespace
+
+const double* DCT::aanForwardScale() {
+    static const std::array<double, 64> table = [] {
+        const auto a = aanFactors();
+        std::array<double, 64> t{};
+        for (int v = 0; v < 8; v++) {
+            for (int u = 0; u < 8; u++) {
+                t[v * 8 + u] = 1.0 / (8.0 * a[u] * a[v]);
+            }
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+const double* DCT::aanInverseScale() {
+    static const std::array<double, 64> table = [] {
+        const auto a = aanFactors();
+        std::array<double, 64> t{};
+        for (int v = 0; v < 8; v++) {
+            for (int u = 0; u < 8; u++) {
+                t[v * 8 + u] = a[u] * a[v] / 8.0;
+            }
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+void DCT::forwardDCT8x8Raw(const double* in, double* out) {
+    if (out != in) {
+        std::copy_n(in, 64, out);
+    }
+    for (int row = 0; row < 8; row++) {
+        fdct8(out + row * 8, 1);
+    }
+    for (int col = 0; col < 8; col++) {
+        fdct8(out + col, 8);
+    }
+}
+
+void DCT::inverseDCT8x8Prescaled(const double* in, double* out) {
+    if (out != in) {
+        std::copy_n(in, 64, out);
+    }
+    for (int col = 0; col < 8; col++) {
+        idct8(out + col, 8);
+    }
+    for (int row = 0; row < 8; row++) {
+        idct8(out + row * 8, 1);
+    }
+}
+
+void DCT::forwardDCT8x8(const double* in, double* out) {
+    forwardDCT8x8Raw(in, out);
+    const double* scale = aanForwardScale();
+    for (int i = 0; i < 64; i++) {
+        out[i] *= scale[i];
+    }
+}
+
+void DCT::inverseDCT8x8(const double* in, double* out) {
+    const double* scale = aanInverseScale();
+    for (int i = 0; i < 64; i++) {
+        out[i] = in[i] * scale[i];
+    }
+    inverseDCT8x8Prescaled(out, out);
+}
+
+void DCT::forwardDCT8x8Fixed(const uint16_t* src, int16_t* dst) {
+    // Columns: T[v][x] = sum_y C[v][y] * X[y][x]
+    int64_t temp[64];
+    for (int v = 0; v < 8; v++) {
+        for (int x = 0; x < 8; x++) {
+            int64_t acc = 0;
+            for (int y = 0; y < 8; y++) {
+                acc += static_cast<int64_t>(FIX_BASIS[v * 8 + y]) * src[y * 8 + x];
+            }
+            temp[v * 8 + x] = descale(acc, FIX_BITS - FIX_PASS1_FRAC_BITS);
+        }
+    }
+
+    // Rows: Y[v][u] = sum_x T[v][x] * C[u][x]
+    for (int v = 0; v < 8; v++) {
+        for (int u = 0; u < 8; u++) {
+            int64_t acc = 0;
+            for (int x = 0; x < 8; x++) {
+                acc += temp[v * 8 + x] * FIX_BASIS[u * 8 + x];
+            }
+            dst[v * 8 + u] = saturateToInt16(descale(acc, FIX_BITS + FIX_PASS1_FRAC_BITS));
+        }
+    }
+}
+
+void DCT::inverseDCT8x8Fixed(const int16_t* src, int16_t* dst) {
+    // Columns: T[y][u] = sum_v C[v][y] * Y[v][u]
+    int64_t temp[64];
+    for (int y = 0; y < 8; y++) {
+        for (int u = 0; u < 8; u++) {
+            int64_t acc = 0;
+            for (int v = 0; v < 8; v++) {
+                acc += static_cast<int64_t>(FIX_BASIS[v * 8 + y]) * src[v * 8 + u];
+            }
+            temp[y * 8 + u] = descale(acc, FIX_BITS - FIX_PASS1_FRAC_BITS);
+        }
+    }
+
+    // Rows: X[y][x] = sum_u T[y][u] * C[u][x]
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            int64_t acc = 0;
+            for (int u = 0; u < 8; u++) {
+                acc += temp[y * 8 + u] * FIX_BASIS[u * 8 + x];
+            }
+            dst[y * 8 + x] = saturateToInt16(descale(acc, FIX_BITS + FIX_PASS1_FRAC_BITS));
+        }
+    }
+}
+
+int16_t DCT::inverseDCT8x8DCOnly(int16_t dc) {
+    // The float kernels scale the DC coefficient by the first basis value
+    // once per pass; rounding each product the same way keeps the fill
+    // identical to their output
+    const float b0 = static_cast<float>(DCTBasis<TxSize::TX_8x8>::matrix[0]);
+    const float column = static_cast<float>(dc) * b0;
+    return static_cast<int16_t>(column * b0);
+}
+
+int16_t DCT::inverseDCT8x8DCOnlyFixed(int16_t dc) {
+    // inverseDCT8x8Fixed() with a single non-zero input: both passes
+    // multiply by FIX_BASIS[0] and descale exactly the same way
+    const int64_t column = descale(static_cast<int64_t>(FIX_BASIS[0]) * dc, FIX_BITS - FIX_PASS1_FRAC_BITS);
+    return saturateToInt16(descale(column * FIX_BASIS[0], FIX_BITS + FIX_PASS1_FRAC_BITS));
+}
+
+void DCT::inverseDCT8x8LowBand(const int16_t* src, int16_t* dst) {
+    static const std::array<float, 64> basis = [] {
+        std::array<float, 64> b{};
+        for (int i = 0; i < 64; i++) {
+            b[i] = static_cast<float>(DCTBasis<TxSize::TX_8x8>::matrix[i]);
+        }
+        return b;
+    }();
+
+    // Rows of the 4 non-zero coefficient rows: T[v][x] = sum_u Y[v][u] * B[u][x]
+    float temp[4][8];
+    for (int v = 0; v < 4; v++) {
+        for (int x = 0; x < 8; x++) {
+            temp[v][x] = src[v * 8 + 0] * basis[0 * 8 + x] + src[v * 8 + 1] * basis[1 * 8 + x] +
+                         src[v * 8 + 2] * basis[2 * 8 + x] + src[v * 8 + 3] * basis[3 * 8 + x];
+        }
+    }
+
+    // Columns: X[y][x] = sum_v B[v][y] * T[v][x]
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            const float value = basis[0 * 8 + y] * temp[0][x] + basis[1 * 8 + y] * temp[1][x] +
+                                basis[2 * 8 + y] * temp[2][x] + basis[3 * 8 + y] * temp[3][x];
+            dst[y * 8 + x] = static_cast<int16_t>(value);
+        }
+    }
+}
+
+void DCT::inverseDCT8x8LowBandFixed(const int16_t* src, int16_t* dst) {
+    // inverseDCT8x8Fixed() with the zero terms left out. Column pass over
+    // the 4 non-zero columns: T[y][u] = sum_v C[v][y] * Y[v][u]
+    int64_t temp[8][4];
+    for (int y = 0; y < 8; y++) {
+        for (int u = 0; u < 4; u++) {
+            int64_t acc = 0;
+            for (int v = 0; v < 4; v++) {
+                acc += static_cast<int64_t>(FIX_BASIS[v * 8 + y]) * src[v * 8 + u];
+            }
+            temp[y][u] = descale(acc, FIX_BITS - FIX_PASS1_FRAC_BITS);
+        }
+    }
+
+    // Rows: X[y][x] = sum_u T[y][u] * C[u][x]
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            int64_t acc = 0;
+            for (int u = 0; u < 4; u++) {
+                acc += temp[y][u] * FIX_BASIS[u * 8 + x];
+            }
+            dst[y * 8 + x] = saturateToInt16(descale(acc, FIX_BITS + FIX_PASS1_FRAC_BITS));
+        }
+    }
+}
+
+void DCT::inverseDCT8x8Scaled(const int16_t* src, int16_t* dst, int dim) {
+    // An orthonormal dim-point inverse transform of the low-frequency
+    // coefficients, scaled by dim / 8 overall, keeps the mean level of the
+    // block: a flat block of value p has DC 8p and comes out as p.
+    if (dim == 1) {
+        dst[0] = saturateToInt16(descale(src[0], 3));
+        return;
+    }
+
+    if (dim == 2) {
+        // The 2-point basis is +-1/sqrt(2): every output is a signed sum of
+        // the four coefficients, times 1/2 for the basis and 1/4 for the scale
+        const int64_t dc = src[0];
+        const int64_t horizontal = src[1];
+        const int64_t vertical = src[8];
+        const int64_t diagonal = src[9];
+        dst[0] = saturateToInt16(descale(dc + horizontal + vertical + diagonal, 3));
+        dst[1] = saturateToInt16(descale(dc - horizontal + vertical - diagonal, 3));
+        dst[2] = saturateToInt16(descale(dc + horizontal - vertical - diagonal, 3));
+        dst[3] = saturateToInt16(descale(dc - horizontal - vertical + diagonal, 3));
+        return;
+    }
+
+    // dim == 4: fixed-point 4x4 inverse transform; the extra descale bit is
+    // the 1/2 scale
+    int64_t temp[16];
+    for (int y = 0; y < 4; y++) {
+        for (int u = 0; u < 4; u++) {
+            int64_t acc = 0;
+            for (int v = 0; v < 4; v++) {
+                acc += static_cast<int64_t>(FIX_BASIS_4[v * 4 + y]) * src[v * 8 + u];
+            }
+            temp[y * 4 + u] = descale(acc, FIX_BITS - FIX_PASS1_FRAC_BITS);
+        }
+    }
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int64_t acc = 0;
+            for (int u = 0; u < 4; u++) {
+                acc += temp[y * 4 + u] * FIX_BASIS_4[u * 4 + x];
+            }
+            dst[y * 4 + x] = saturateToInt16(descale(acc, FIX_BITS + FIX_PASS1_FRAC_BITS + 1));
+        }
+    }
+}
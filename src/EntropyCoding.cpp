@@ -0,0 +1,371 @@
+#include "ezcodec/EntropyCoding.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace {
+
+// Number of bits needed for |value| (JPEG "SSSS" category)
+int magnitudeCategory(int value) {
+    unsigned magnitude = static_cast<unsigned>(std::abs(value));
+    int category = 0;
+    while (magnitude != 0) {
+        category++;
+        magnitude >>= 1;
+    }
+    return category;
+}
+
+// Magnitude bits of a value: the value itself when positive, its ones'
+// complement when negative
+uint32_t magnitudeBits(int value, int category) {
+    return static_cast<uint32_t>(value < 0 ? value + (1 << category) - 1 : value);
+}
+
+int extendMagnitude(uint32_t bits, int category) {
+    if (category == 0) {
+        return 0;
+    }
+    const int value = static_cast<int>(bits);
+    return value < (1 << (category - 1)) ? value - (1 << category) + 1 : value;
+}
+
+// Unbounded Huffman code lengths; 0 for unused symbols
+std::vector<int> huffmanCodeLengths(const std::vector<uint32_t>& frequencies) {
+    struct Node {
+        uint64_t weight;
+        int parent;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> leafOf(frequencies.size(), -1);
+    using Entry = std::pair<uint64_t, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    for (size_t symbol = 0; symbol < frequencies.size(); symbol++) {
+        if (frequencies[symbol] != 0) {
+            leafOf[symbol] = static_cast<int>(nodes.size());
+            queue.emplace(frequencies[symbol], static_cast<int>(nodes.size()));
+            nodes.push_back({frequencies[symbol], -1});
+        }
+    }
+
+    std::vector<int> lengths(frequencies.size(), 0);
+    if (nodes.size() == 1) {
+        lengths[std::find_if(leafOf.begin(), leafOf.end(), [](int n) { return n >= 0; }) - leafOf.begin()] = 1;
+        return lengths;
+    }
+
+    while (queue.size() > 1) {
+        const Entry a = queue.top();
+        queue.pop();
+        const Entry b = queue.top();
+        queue.pop();
+        const int parent = static_cast<int>(nodes.size());
+        nodes.push_back({a.first + b.first, -1});
+        nodes[a.second].parent = parent;
+        nodes[b.second].parent = parent;
+        queue.emplace(a.first + b.first, parent);
+    }
+
+    for (size_t symbol = 0; symbol < frequencies.size(); symbol++) {
+        int depth = 0;
+        for (int n = leafOf[symbol]; n >= 0 && nodes[n].parent >= 0; n = nodes[n].parent) {
+            depth++;
+        }
+        lengths[symbol] = depth;
+    }
+    return lengths;
+}
+
+void writeU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value & 0xFF));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+bool readU16(const uint8_t*& data, const uint8_t* end, uint16_t& value) {
+    if (end - data < 2) {
+        return false;
+    }
+    value = static_cast<uint16_t>(data[0] | (data[1] << 8));
+    data += 2;
+    return true;
+}
+
+} // namespace
+
+HuffmanTable HuffmanTable::fromFrequencies(const std::vector<uint32_t>& frequencies) {
+    const std::vector<int> lengths = huffmanCodeLengths(frequencies);
+    const int longest = lengths.empty() ? 0 : *std::max_element(lengths.begin(), lengths.end());
+
+    // Symbols ordered by code length, then by value
+    std::vector<uint16_t> ordered;
+    for (int length = 1; length <= longest; length++) {
+        for (size_t symbol = 0; symbol < lengths.size(); symbol++) {
+            if (lengths[symbol] == length) {
+                ordered.push_back(static_cast<uint16_t>(symbol));
+            }
+        }
+    }
+
+    // Limit code lengths to 16 bits (JPEG Annex K.2, Figure K.3): move pairs
+    // of the longest codes up while splitting a shorter code.
+    std::vector<int> bits(std::max(longest, MAX_CODE_LENGTH) + 1, 0);
+    for (int length : lengths) {
+        if (length > 0) {
+            bits[length]++;
+        }
+    }
+    for (int i = longest; i > MAX_CODE_LENGTH; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) {
+                j--;
+            }
+            bits[i] -= 2;
+            bits[i - 1] += 1;
+            bits[j + 1] += 2;
+            bits[j] -= 1;
+        }
+    }
+
+    std::array<uint16_t, MAX_CODE_LENGTH> counts{};
+    for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+        counts[length - 1] = static_cast<uint16_t>(bits[length]);
+    }
+
+    HuffmanTable table;
+    table.assign(counts, ordered);
+    return table;
+}
+
+bool HuffmanTable::assign(const std::array<uint16_t, MAX_CODE_LENGTH>& newCounts,
+                          const std::vector<uint16_t>& newSymbols) {
+    lengthCounts = newCounts;
+    codeSymbols = newSymbols;
+    return build();
+}
+
+bool HuffmanTable::build() {
+    codes.fill(0);
+    codeLengths.fill(0);
+    lookup.assign(size_t{1} << LOOKUP_BITS, 0);
+    maxCode.fill(-1);
+    valueOffset.fill(0);
+
+    size_t total = 0;
+    for (uint16_t count : lengthCounts) {
+        total += count;
+    }
+    if (total != codeSymbols.size() || total > MAX_SYMBOLS) {
+        return false;
+    }
+
+    uint32_t code = 0;
+    size_t index = 0;
+    for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+        const uint16_t count = lengthCounts[length - 1];
+        if (count > 0) {
+            valueOffset[length] = static_cast<int32_t>(index) - static_cast<int32_t>(code);
+        }
+        for (uint16_t n = 0; n < count; n++, index++, code++) {
+            const uint16_t symbol = codeSymbols[index];
+            if (symbol >= MAX_SYMBOLS || codeLengths[symbol] != 0) {
+                return false;
+            }
+            codes[symbol] = static_cast<uint16_t>(code);
+            codeLengths[symbol] = static_cast<uint8_t>(length);
+
+            if (length <= LOOKUP_BITS) {
+                const int shift = LOOKUP_BITS - length;
+                const uint32_t entry = (static_cast<uint32_t>(length) << 16) | symbol;
+                std::fill(lookup.begin() + (code << shift), lookup.begin() + ((code + 1) << shift), entry);
+            }
+        }
+        if (count > 0) {
+            maxCode[length] = static_cast<int32_t>(code) - 1;
+        }
+        // Kraft inequality: the codes of this length must fit
+        if (code > (1u << length)) {
+            return false;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+int HuffmanTable::decodeSlow(BitReader& reader) const {
+    const uint32_t bits = reader.peek(MAX_CODE_LENGTH);
+    for (int length = LOOKUP_BITS + 1; length <= MAX_CODE_LENGTH; length++) {
+        const int32_t code = static_cast<int32_t>(bits >> (MAX_CODE_LENGTH - length));
+        if (code <= maxCode[length]) {
+            reader.skip(length);
+            return codeSymbols[static_cast<size_t>(valueOffset[length] + code)];
+        }
+    }
+    return -1;
+}
+
+void HuffmanTable::serialize(std::vector<uint8_t>& out) const {
+    for (uint16_t count : lengthCounts) {
+        writeU16(out, count);
+    }
+    for (uint16_t symbol : codeSymbols) {
+        writeU16(out, symbol);
+    }
+}
+
+bool HuffmanTable::deserialize(const uint8_t*& data, const uint8_t* end) {
+    std::array<uint16_t, MAX_CODE_LENGTH> newCounts{};
+    size_t total = 0;
+    for (uint16_t& count : newCounts) {
+        if (!readU16(data, end, count)) {
+            return false;
+        }
+        total += count;
+    }
+    if (total > MAX_SYMBOLS) {
+        return false;
+    }
+
+    std::vector<uint16_t> newSymbols(total);
+    for (uint16_t& symbol : newSymbols) {
+        if (!readU16(data, end, symbol)) {
+            return false;
+        }
+    }
+    return assign(newCounts, newSymbols);
+}
+
+void EntropyCoder::gatherStatistics(const int16_t* blocks, size_t count, Statistics& stats) {
+    int previousDC = 0;
+    for (size_t b = 0; b < count; b++) {
+        const int16_t* block = blocks + b * 64;
+
+        stats.dc[magnitudeCategory(block[0] - previousDC)]++;
+        previousDC = block[0];
+
+        int run = 0;
+        for (int k = 1; k < 64; k++) {
+            const int value = block[ZIGZAG_8x8[k]];
+            if (value == 0) {
+                run++;
+                continue;
+            }
+            while (run > 15) {
+                stats.ac[ZRL]++;
+                run -= 16;
+            }
+            stats.ac[(run << 5) | magnitudeCategory(value)]++;
+            run = 0;
+        }
+        if (run > 0) {
+            stats.ac[EOB]++;
+        }
+    }
+}
+
+uint64_t EntropyCoder::codedBits(const Statistics& stats,
+                                 const HuffmanTable& dcTable, const HuffmanTable& acTable) {
+    // Every symbol is followed by as many magnitude bits as its category:
+    // the DC symbol is the category, AC symbols keep it in the low 5 bits
+    uint64_t bits = 0;
+    for (size_t symbol = 0; symbol < HuffmanTable::MAX_SYMBOLS; symbol++) {
+        if (stats.dc[symbol] != 0) {
+            bits += static_cast<uint64_t>(stats.dc[symbol]) *
+                    static_cast<uint64_t>(dcTable.codeLength(static_cast<uint16_t>(symbol)) + symbol);
+        }
+        if (stats.ac[symbol] != 0) {
+            bits += static_cast<uint64_t>(stats.ac[symbol]) *
+                    static_cast<uint64_t>(acTable.codeLength(static_cast<uint16_t>(symbol)) + (symbol & 31));
+        }
+    }
+    return bits;
+}
+
+void EntropyCoder::encodeBlocks(const int16_t* blocks, size_t count,
+                                const HuffmanTable& dcTable, const HuffmanTable& acTable,
+                                std::vector<uint8_t>& out) {
+    BitWriter writer(out);
+    int previousDC = 0;
+    for (size_t b = 0; b < count; b++) {
+        const int16_t* block = blocks + b * 64;
+
+        const int diff = block[0] - previousDC;
+        previousDC = block[0];
+        const int dcCategory = magnitudeCategory(diff);
+        dcTable.encode(writer, static_cast<uint16_t>(dcCategory));
+        writer.put(magnitudeBits(diff, dcCategory), dcCategory);
+
+        int run = 0;
+        for (int k = 1; k < 64; k++) {
+            const int value = block[ZIGZAG_8x8[k]];
+            if (value == 0) {
+                run++;
+                continue;
+            }
+            while (run > 15) {
+                acTable.encode(writer, ZRL);
+                run -= 16;
+            }
+            const int category = magnitudeCategory(value);
+            acTable.encode(writer, static_cast<uint16_t>((run << 5) | category));
+            writer.put(magnitudeBits(value, category), category);
+            run = 0;
+        }
+        if (run > 0) {
+            acTable.encode(writer, EOB);
+        }
+    }
+    writer.flush();
+}
+
+bool EntropyCoder::decodeBlocks(const uint8_t* data, size_t size,
+                                const HuffmanTable& dcTable, const HuffmanTable& acTable,
+                                int16_t* blocks, size_t count) {
+    BitReader reader(data, size);
+    int previousDC = 0;
+    for (size_t b = 0; b < count; b++) {
+        int16_t* block = blocks + b * 64;
+        std::fill_n(block, 64, int16_t{0});
+
+        const int dcCategory = dcTable.decode(reader);
+        if (dcCategory < 0 || dcCategory > 16) {
+            return false;
+        }
+        previousDC = static_cast<int16_t>(previousDC + extendMagnitude(reader.get(dcCategory), dcCategory));
+        block[0] = static_cast<int16_t>(previousDC);
+
+        for (int k = 1; k < 64; k++) {
+            const int symbol = acTable.decode(reader);
+            if (symbol < 0) {
+                return false;
+            }
+            const int run = symbol >> 5;
+            const int category = symbol & 31;
+            if (category == 0) {
+                if (symbol == EOB) {
+                    break;
+                }
+                if (symbol != ZRL) {
+                    return false;
+                }
+                k += 15;
+                continue;
+            }
+            k += run;
+            if (k > 63 || category > 16) {
+                return false;
+            }
+            block[ZIGZAG_8x8[k]] = static_cast<int16_t>(extendMagnitude(reader.get(category), category));
+        }
+
+        if (reader.overrun()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,64 +1,535 @@
 #include "ezcodec/EzcFormat.h"
-#include <fstream>
+#include "ezcodec/EntropyCoding.h"
+#include "ezcodec/ThreadPool.h"
+#include "ezcodec/Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <cstring>
+#include <utility>
+#include <vector>
 
 static constexpr uint8_t EZC_MAGIC[4] = { 'E', 'Z', 'C', '\0' };
-static constexpr uint8_t EZC_VERSION = 1;
+static constexpr size_t EZC_HEADER_SIZE = 16;
+static constexpr size_t EZC_STRIPED_HEADER_SIZE = 32;
 
-// Helper: write a little-endian uint16_t
-static void writeU16(std::ofstream& out, uint16_t val) {
-    uint8_t buf[2];
-    buf[0] = static_cast<uint8_t>(val & 0xFF);
-    buf[1] = static_cast<uint8_t>((val >> 8) & 0xFF);
-    out.write(reinterpret_cast<const char*>(buf), 2);
+// Helper: store a little-endian uint16_t into a byte buffer
+static void storeU16(uint8_t* data, uint16_t val) {
+    data[0] = static_cast<uint8_t>(val & 0xFF);
+    data[1] = static_cast<uint8_t>((val >> 8) & 0xFF);
 }
 
-// Helper: read a little-endian uint16_t
-static uint16_t readU16(std::ifstream& in) {
-    uint8_t buf[2];
-    in.read(reinterpret_cast<char*>(buf), 2);
-    return static_cast<uint16_t>(buf[0]) | (static_cast<uint16_t>(buf[1]) << 8);
+// Helper: read a little-endian uint16_t from a byte buffer
+static uint16_t loadU16(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
 }
 
-// Helper: write a little-endian int16_t
-static void writeI16(std::ofstream& out, int16_t val) {
-    writeU16(out, static_cast<uint16_t>(val));
+// Helper: store a little-endian uint32_t into a byte buffer
+static void storeU32(uint8_t* data, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = static_cast<uint8_t>((val >> (8 * i)) & 0xFF);
+    }
 }
 
-// Helper: read a little-endian int16_t
-static int16_t readI16(std::ifstream& in) {
-    return static_cast<int16_t>(readU16(in));
+// Helper: read a little-endian uint32_t from a byte buffer
+static uint32_t loadU32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
 }
 
-bool writeEzc(const std::string& path,
-              const EzcHeader& header,
-              const std::vector<Block8x8i16>& quantizedBlocks) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out) {
-        std::cerr << "Failed to open file for writing: " << path << std::endl;
-        return false;
-    }
-
-    // Write 16-byte header
-    out.write(reinterpret_cast<const char*>(EZC_MAGIC), 4);
-    out.put(static_cast<char>(header.version));
-    writeU16(out, header.width);
-    writeU16(out, header.height);
-    out.put(static_cast<char>(header.quality));
-    out.put(static_cast<char>(header.blockDim));
-    writeU16(out, header.blockCountX);
-    writeU16(out, header.blockCountY);
-    out.put(0); // reserved
-
-    // Write block data: 64 x int16_t per block
-    for (const auto& block : quantizedBlocks) {
+// Helper: read a little-endian uint64_t from a byte buffer
+static uint64_t loadU64(const uint8_t* data) {
+    return static_cast<uint64_t>(loadU32(data)) | (static_cast<uint64_t>(loadU32(data + 4)) << 32);
+}
+
+// Helper: append a little-endian uint32_t to a byte buffer
+static void appendU32(std::vector<uint8_t>& out, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>((val >> (8 * i)) & 0xFF));
+    }
+}
+
+// Helper: parse a little-endian uint32_t from a byte buffer
+static bool parseU32(const uint8_t*& data, const uint8_t* end, uint32_t& val) {
+    if (end - data < 4) {
+        return false;
+    }
+    val = loadU32(data);
+    data += 4;
+    return true;
+}
+
+// Helper: true when int16_t values can be read or written in place
+static bool hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    uint8_t firstByte = 0;
+    std::memcpy(&firstByte, &probe, 1);
+    return firstByte == 1;
+}
+
+// Helper: block rows per independently coded slice. Unsliced files are a
+// single slice covering every row.
+static size_t rowsPerSliceOf(const EzcHeader& header) {
+    if (header.flags & EZC_FLAG_SLICED) {
+        return header.sliceRows;
+    }
+    return std::max<size_t>(header.blockCountY, 1);
+}
+
+// Helper: call fn(plane, first, count, units, offset) for every slice in
+// file order. Planes are cut into slices of `rows` block rows
+// independently; `units` is the number of coded units (`count`, or the
+// transforms of the rows with EZC_FLAG_ADAPTIVE_BLOCKS) and `offset` the
+// index of the first block counting earlier planes.
+template<typename F>
+static void forEachSlice(const EzcHeader& header, size_t rows, F&& fn) {
+    const bool adaptive = (header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) != 0;
+    size_t offset = 0;
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        const EzcPlane plane = header.plane(p);
+        const size_t blocksPerRow = plane.blockCountX;
+        for (size_t row = 0; row < plane.blockCountY; row += rows) {
+            const size_t rowEnd = std::min<size_t>(row + rows, plane.blockCountY);
+            const size_t first = row * blocksPerRow;
+            const size_t count = (rowEnd - row) * blocksPerRow;
+            const size_t units = adaptive ? header.partitions[p].codedCount(row, rowEnd) : count;
+            fn(p, first, count, units, offset + first);
+        }
+        offset += static_cast<size_t>(plane.blockCountX) * plane.blockCountY;
+    }
+}
+
+static size_t sliceCountOf(const EzcHeader& header) {
+    const size_t rows = rowsPerSliceOf(header);
+    size_t count = 0;
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        count += (header.plane(p).blockCountY + rows - 1) / rows;
+    }
+    return count;
+}
+
+// Bytes of step tables after the header: one table for gray files, two
+// for color, none without EZC_FLAG_QUANT_TABLES
+static size_t quantTablesSizeOf(const EzcHeader& header) {
+    if (!(header.flags & EZC_FLAG_QUANT_TABLES)) {
+        return 0;
+    }
+    return ((header.flags & EZC_FLAG_COLOR) ? 2 : 1) * 64 * sizeof(uint16_t);
+}
+
+// Helper: the stored step tables of `header`, quantTablesSizeOf() bytes
+static void storeQuantTables(const EzcHeader& header, uint8_t* data) {
+    const size_t tables = quantTablesSizeOf(header) / (64 * sizeof(uint16_t));
+    for (size_t t = 0; t < tables; t++) {
         for (size_t i = 0; i < 64; i++) {
-            writeI16(out, static_cast<int16_t>(block[i]));
+            storeU16(data + (t * 64 + i) * 2, header.quantSteps[t][i]);
+        }
+    }
+}
+
+// Helper: read the step tables at `data` into `header`; steps must be in
+// [1, QuantTable::MAX_STEP]
+static bool loadQuantTables(EzcHeader& header, const uint8_t* data) {
+    header.quantSteps = {};
+    const size_t tables = quantTablesSizeOf(header) / (64 * sizeof(uint16_t));
+    for (size_t t = 0; t < tables; t++) {
+        for (size_t i = 0; i < 64; i++) {
+            const uint16_t step = loadU16(data + (t * 64 + i) * 2);
+            if (step == 0 || step > QuantTable::MAX_STEP) {
+                return false;
+            }
+            header.quantSteps[t][i] = step;
+        }
+    }
+    return true;
+}
+
+// Helper: the partition section of an adaptive file, the uint32 byte
+// count included; empty without EZC_FLAG_ADAPTIVE_BLOCKS
+static void storePartitions(const EzcHeader& header, std::vector<uint8_t>& out) {
+    out.clear();
+    if (!(header.flags & EZC_FLAG_ADAPTIVE_BLOCKS)) {
+        return;
+    }
+    std::vector<uint8_t> bits;
+    BitWriter writer(bits);
+    for (const BlockPartition& partition : header.partitions) {
+        partition.serialize(writer);
+    }
+    writer.flush();
+    appendU32(out, static_cast<uint32_t>(bits.size()));
+    out.insert(out.end(), bits.begin(), bits.end());
+}
+
+// Helper: parse the partition section at `cursor` into `header`
+static bool parsePartitions(EzcHeader& header, const uint8_t*& cursor, const uint8_t* end) {
+    header.partitions.clear();
+    if (!(header.flags & EZC_FLAG_ADAPTIVE_BLOCKS)) {
+        return true;
+    }
+    uint32_t size = 0;
+    if (!parseU32(cursor, end, size) || size > static_cast<size_t>(end - cursor)) {
+        return false;
+    }
+    BitReader reader(cursor, size);
+    header.partitions.resize(header.planeCount());
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        const EzcPlane plane = header.plane(p);
+        if (!header.partitions[p].deserialize(reader, plane.blockCountX, plane.blockCountY)) {
+            return false;
+        }
+    }
+    cursor += size;
+    return true;
+}
+
+uint8_t ezcChromaFlags(ChromaFormat format) {
+    switch (format) {
+        case ChromaFormat::YCbCr444: return EZC_FLAG_COLOR;
+        case ChromaFormat::YCbCr422: return EZC_FLAG_COLOR | EZC_FLAG_CHROMA_H2;
+        case ChromaFormat::YCbCr420: return EZC_FLAG_COLOR | EZC_FLAG_CHROMA_H2 | EZC_FLAG_CHROMA_V2;
+        default:                     return 0;
+    }
+}
+
+ChromaFormat EzcHeader::chromaFormat() const {
+    if (!(flags & EZC_FLAG_COLOR)) {
+        return ChromaFormat::Gray;
+    }
+    if (!(flags & EZC_FLAG_CHROMA_H2)) {
+        return ChromaFormat::YCbCr444;
+    }
+    return (flags & EZC_FLAG_CHROMA_V2) ? ChromaFormat::YCbCr420 : ChromaFormat::YCbCr422;
+}
+
+size_t EzcHeader::planeCount() const {
+    return (flags & EZC_FLAG_COLOR) ? 3 : 1;
+}
+
+QuantTable EzcHeader::quantTable(size_t index) const {
+    if (flags & EZC_FLAG_QUANT_TABLES) {
+        return QuantTable(quantSteps[index == 0 ? 0 : 1]);
+    }
+    return Quantization::makeQuantTable(quality, index == 0 ? Quantization::Component::Luma
+                                                           : Quantization::Component::Chroma);
+}
+
+EzcPlane EzcHeader::plane(size_t index) const {
+    EzcPlane result;
+    if (index == 0) {
+        result.width       = width;
+        result.height      = height;
+        result.blockCountX = blockCountX;
+        result.blockCountY = blockCountY;
+        return result;
+    }
+    const ChromaFormat format = chromaFormat();
+    const uint32_t factorX = static_cast<uint32_t>(chromaFactorX(format));
+    const uint32_t factorY = static_cast<uint32_t>(chromaFactorY(format));
+    result.width       = static_cast<uint32_t>((static_cast<uint64_t>(width) + factorX - 1) / factorX);
+    result.height      = static_cast<uint32_t>((static_cast<uint64_t>(height) + factorY - 1) / factorY);
+    result.blockCountX = static_cast<uint32_t>((static_cast<uint64_t>(result.width) + blockDim - 1) / blockDim);
+    result.blockCountY = static_cast<uint32_t>((static_cast<uint64_t>(result.height) + blockDim - 1) / blockDim);
+    return result;
+}
+
+// Helper: check that planes[p] holds the blocks of header.plane(p)
+static bool checkPlanes(const EzcHeader& header, const BlockPlane8x8i16* const* planes, size_t planeCount) {
+    if (planeCount != header.planeCount()) {
+        std::cerr << "Expected " << header.planeCount() << " planes for .ezc image, got "
+                  << planeCount << std::endl;
+        return false;
+    }
+    for (size_t p = 0; p < planeCount; p++) {
+        const EzcPlane plane = header.plane(p);
+        if (static_cast<uint32_t>(planes[p]->blockCountX()) != plane.blockCountX ||
+            static_cast<uint32_t>(planes[p]->blockCountY()) != plane.blockCountY) {
+            std::cerr << "Block plane " << p << " does not match the .ezc header" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Helper: check a v1/v2 header before writing it
+static bool checkSingleBufferHeader(const EzcHeader& header) {
+    if (header.version != EZC_VERSION_RAW && header.version != EZC_VERSION_HUFFMAN) {
+        std::cerr << "Unsupported .ezc version: " << static_cast<int>(header.version) << std::endl;
+        return false;
+    }
+
+    if ((header.flags & EZC_FLAG_SLICED) &&
+        (header.version == EZC_VERSION_RAW || header.sliceRows == 0)) {
+        std::cerr << "Sliced .ezc files need version 2 and a non-zero slice height" << std::endl;
+        return false;
+    }
+
+    if ((header.flags & EZC_FLAG_COLOR) && header.version == EZC_VERSION_HUFFMAN &&
+        !(header.flags & EZC_FLAG_SLICED)) {
+        std::cerr << "Color .ezc version 2 files must be sliced" << std::endl;
+        return false;
+    }
+
+    if (header.width > 0xFFFF || header.height > 0xFFFF || header.sliceRows > 0xFFFF) {
+        std::cerr << "Image too large for .ezc version " << static_cast<int>(header.version)
+                  << "; use version 3" << std::endl;
+        return false;
+    }
+
+    if (header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) {
+        bool partitionsMatch = header.partitions.size() == header.planeCount();
+        for (size_t p = 0; partitionsMatch && p < header.partitions.size(); p++) {
+            const EzcPlane plane = header.plane(p);
+            partitionsMatch = header.partitions[p].cellsX() == plane.blockCountX &&
+                              header.partitions[p].cellsY() == plane.blockCountY;
+        }
+        if (header.version != EZC_VERSION_HUFFMAN || (header.flags & EZC_FLAG_FIXED_POINT) ||
+            ((header.flags & EZC_FLAG_SLICED) && header.sliceRows % BlockPartition::SUPERBLOCK_CELLS != 0) ||
+            !partitionsMatch) {
+            std::cerr << "Adaptive block sizes need version 2, the float transform, slices of a "
+                      << "multiple of " << BlockPartition::SUPERBLOCK_CELLS
+                      << " block rows and one partition per plane" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Helper: every slice of every plane in file order
+static void collectSlices(const EzcHeader& header, const BlockPlane8x8i16* const* planes,
+                          std::vector<EzcWriteBuffers::Slice>& slices) {
+    slices.clear();
+    forEachSlice(header, rowsPerSliceOf(header), [&](size_t plane, size_t first, size_t, size_t units, size_t) {
+        slices.push_back({plane, planes[plane]->data() + first * 64, units});
+    });
+}
+
+// Helper: optimized Huffman tables for the slice statistics of `buffers`,
+// luma slices in set 0 and chroma slices in set 1. Returns the number of
+// table sets the file stores.
+static size_t buildTables(const EzcWriteBuffers& buffers, size_t planeCount,
+                          HuffmanTable (&dcTables)[2], HuffmanTable (&acTables)[2]) {
+    const std::vector<EzcWriteBuffers::Slice>& ranges = buffers.slices;
+    EntropyCoder::Statistics stats[2];
+    for (size_t slice = 0; slice < ranges.size(); slice++) {
+        EntropyCoder::Statistics& total = stats[ranges[slice].plane == 0 ? 0 : 1];
+        for (size_t i = 0; i < HuffmanTable::MAX_SYMBOLS; i++) {
+            total.dc[i] += buffers.sliceStats[slice].dc[i];
+            total.ac[i] += buffers.sliceStats[slice].ac[i];
+        }
+    }
+    const size_t tableSets = planeCount > 1 ? 2 : 1;
+    for (size_t t = 0; t < tableSets; t++) {
+        dcTables[t] = HuffmanTable::fromFrequencies(stats[t].dc);
+        acTables[t] = HuffmanTable::fromFrequencies(stats[t].ac);
+    }
+    return tableSets;
+}
+
+// Byte sink of writeEzcBuffer(), shaped like OutputFile::write()
+struct BufferSink {
+    std::vector<uint8_t>& bytes;
+
+    bool write(const void* data, size_t size) {
+        const auto* begin = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+        return true;
+    }
+};
+
+// Helper: false, after printing why, when a v2 payload of `payloadSize`
+// bytes does not fit its 32-bit offsets
+static bool checkPayloadSize(uint64_t payloadSize) {
+    if (payloadSize > UINT32_MAX) {
+        std::cerr << "The .ezc payload is " << payloadSize << " bytes, more than the 4 GiB version 2"
+                  << " allows; use the streaming version 3 layout (--stream) for this image" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Helper: entropy code a checked v2 image into buffers.tables (Huffman
+// tables and slice index) and buffers.payloads, before anything is
+// written. The slices of `buffers` must already be collected. Returns
+// false, after printing why, if the payload is too large for version 2.
+static bool codeSingleBuffer(const EzcHeader& header, size_t planeCount, EzcWriteBuffers& buffers) {
+    const std::vector<EzcWriteBuffers::Slice>& ranges = buffers.slices;
+
+    // Luma slices share the first pair of tables, Cb and Cr slices the second
+    std::vector<EntropyCoder::Statistics>& sliceStats = buffers.sliceStats;
+    sliceStats.resize(ranges.size());
+    {
+        TraceScope stage("ezc.statistics");
+        ThreadPool::shared().parallelFor(0, ranges.size(), 1, [&](size_t sliceBegin, size_t sliceEnd) {
+            for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                std::fill(sliceStats[slice].dc.begin(), sliceStats[slice].dc.end(), 0);
+                std::fill(sliceStats[slice].ac.begin(), sliceStats[slice].ac.end(), 0);
+                EntropyCoder::gatherStatistics(ranges[slice].blocks, ranges[slice].count, sliceStats[slice]);
+            }
+        });
+    }
+
+    HuffmanTable dcTables[2];
+    HuffmanTable acTables[2];
+    const size_t tableSets = buildTables(buffers, planeCount, dcTables, acTables);
+
+    std::vector<std::vector<uint8_t>>& payloads = buffers.payloads;
+    payloads.resize(ranges.size());
+    {
+        TraceScope stage("ezc.entropy_code");
+        ThreadPool::shared().parallelFor(0, ranges.size(), 1, [&](size_t sliceBegin, size_t sliceEnd) {
+            for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                const size_t t = ranges[slice].plane == 0 ? 0 : 1;
+                payloads[slice].clear();
+                EntropyCoder::encodeBlocks(ranges[slice].blocks, ranges[slice].count,
+                                           dcTables[t], acTables[t], payloads[slice]);
+            }
+        });
+    }
+
+    std::vector<uint8_t>& tables = buffers.tables;
+    tables.clear();
+    for (size_t t = 0; t < tableSets; t++) {
+        dcTables[t].serialize(tables);
+        acTables[t].serialize(tables);
+    }
+
+    // Slice ends and the payload size are stored as uint32
+    uint64_t payloadSize = 0;
+    for (const auto& payload : payloads) {
+        payloadSize += payload.size();
+    }
+    if (!checkPayloadSize(payloadSize)) {
+        return false;
+    }
+
+    if (header.flags & EZC_FLAG_SLICED) {
+        tables.push_back(static_cast<uint8_t>(header.sliceRows & 0xFF));
+        tables.push_back(static_cast<uint8_t>((header.sliceRows >> 8) & 0xFF));
+        uint64_t sliceEnd = 0;
+        for (size_t slice = 0; slice < ranges.size(); slice++) {
+            sliceEnd += payloads[slice].size();
+            appendU32(tables, static_cast<uint32_t>(sliceEnd));
+        }
+    }
+    appendU32(tables, static_cast<uint32_t>(payloadSize));
+    return true;
+}
+
+// Helper: write a checked v1/v2 image to `out` (an OutputFile or a
+// BufferSink). v2 images must already be coded with codeSingleBuffer().
+template<typename Sink>
+static void writeSingleBuffer(Sink& out, const EzcHeader& header,
+                              const BlockPlane8x8i16* const* planes, size_t planeCount,
+                              const EzcWriteBuffers& buffers) {
+    // 16-byte header
+    uint8_t headerBytes[EZC_HEADER_SIZE];
+    std::memcpy(headerBytes, EZC_MAGIC, 4);
+    headerBytes[4] = header.version;
+    storeU16(headerBytes + 5, static_cast<uint16_t>(header.width));
+    storeU16(headerBytes + 7, static_cast<uint16_t>(header.height));
+    headerBytes[9] = header.quality;
+    headerBytes[10] = header.blockDim;
+    storeU16(headerBytes + 11, static_cast<uint16_t>(header.blockCountX));
+    storeU16(headerBytes + 13, static_cast<uint16_t>(header.blockCountY));
+    headerBytes[15] = header.flags;
+    out.write(headerBytes, sizeof(headerBytes));
+    if (const size_t tablesSize = quantTablesSizeOf(header)) {
+        uint8_t quantTables[2 * 64 * sizeof(uint16_t)];
+        storeQuantTables(header, quantTables);
+        out.write(quantTables, tablesSize);
+    }
+    if (header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) {
+        std::vector<uint8_t> partitions;
+        storePartitions(header, partitions);
+        out.write(partitions.data(), partitions.size());
+    }
+
+    if (header.version == EZC_VERSION_RAW) {
+        // Block data: 64 x little-endian int16_t per block, plane after
+        // plane, written straight from the planes on little-endian hosts
+        for (size_t p = 0; p < planeCount; p++) {
+            const int16_t* data = planes[p]->data();
+            const size_t values = planes[p]->size() * 64;
+            if (hostIsLittleEndian()) {
+                out.write(data, values * sizeof(int16_t));
+                continue;
+            }
+            uint8_t chunk[4096];
+            for (size_t i = 0; i < values; i += sizeof(chunk) / 2) {
+                const size_t n = std::min(values - i, sizeof(chunk) / 2);
+                for (size_t k = 0; k < n; k++) {
+                    storeU16(chunk + 2 * k, static_cast<uint16_t>(data[i + k]));
+                }
+                out.write(chunk, n * 2);
+            }
         }
+        return;
     }
 
-    if (!out) {
+    // v2: DC table, AC table, [chroma DC table, chroma AC table],
+    // [slice rows (uint16), slice end offsets (uint32 each)], payload
+    // size (uint32), payload
+    out.write(buffers.tables.data(), buffers.tables.size());
+    for (const auto& payload : buffers.payloads) {
+        out.write(payload.data(), payload.size());
+    }
+}
+
+// Shared by the writeEzc() overloads: planes[p] holds the blocks of
+// header.plane(p)
+static bool writePlanes(const std::string& path,
+                        const EzcHeader& header,
+                        const BlockPlane8x8i16* const* planes,
+                        size_t planeCount,
+                        const OutputFile::Options& fileOptions) {
+    if (!checkPlanes(header, planes, planeCount)) {
+        return false;
+    }
+
+    TraceScope stage("ezc.write", path);
+    EzcWriteBuffers buffers;
+    collectSlices(header, planes, buffers.slices);
+    const std::vector<EzcWriteBuffers::Slice>& ranges = buffers.slices;
+
+    if (header.version == EZC_VERSION_STRIPED) {
+        EzcStripWriter writer;
+        if (!writer.open(path, header, fileOptions)) {
+            return false;
+        }
+
+        // Slices are independent, so they are encoded in parallel
+        std::vector<std::vector<uint8_t>> encoded(ranges.size());
+        {
+            TraceScope entropyStage("ezc.entropy_code");
+            ThreadPool::shared().parallelFor(0, ranges.size(), 1, [&](size_t sliceBegin, size_t sliceEnd) {
+                for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+                    EzcStripWriter::encodeSlice(ranges[slice].blocks, ranges[slice].count, encoded[slice]);
+                }
+            });
+        }
+
+        for (const auto& slice : encoded) {
+            if (!writer.writeSlice(slice)) {
+                return false;
+            }
+        }
+        return writer.finish();
+    }
+
+    if (!checkSingleBufferHeader(header) ||
+        (header.version != EZC_VERSION_RAW && !codeSingleBuffer(header, planeCount, buffers))) {
+        return false;
+    }
+
+    OutputFile out;
+    if (!out.open(path, fileOptions)) {
+        return false;
+    }
+    writeSingleBuffer(out, header, planes, planeCount, buffers);
+
+    if (!out.commit()) {
         std::cerr << "Error writing to file: " << path << std::endl;
         return false;
     }
@@ -66,63 +537,488 @@ bool writeEzc(const std::string& path,
     return true;
 }
 
-bool readEzc(const std::string& path,
-             EzcHeader& header,
-             std::vector<Block8x8i16>& quantizedBlocks) {
-    std::ifstream in(path, std::ios::binary);
-    if (!in) {
+bool writeEzc(const std::string& path,
+              const EzcHeader& header,
+              const BlockPlane8x8i16& quantizedBlocks,
+              const OutputFile::Options& fileOptions) {
+    const BlockPlane8x8i16* planes[] = { &quantizedBlocks };
+    return writePlanes(path, header, planes, 1, fileOptions);
+}
+
+bool writeEzc(const std::string& path,
+              const EzcHeader& header,
+              const std::vector<BlockPlane8x8i16>& planes,
+              const OutputFile::Options& fileOptions) {
+    std::vector<const BlockPlane8x8i16*> pointers;
+    for (const auto& plane : planes) {
+        pointers.push_back(&plane);
+    }
+    return writePlanes(path, header, pointers.data(), pointers.size(), fileOptions);
+}
+
+bool writeEzcBuffer(std::vector<uint8_t>& out,
+                    const EzcHeader& header,
+                    const std::vector<BlockPlane8x8i16>& planes,
+                    EzcWriteBuffers& buffers) {
+    buffers.planes.clear();
+    for (const auto& plane : planes) {
+        buffers.planes.push_back(&plane);
+    }
+    if (!checkPlanes(header, buffers.planes.data(), buffers.planes.size())) {
+        return false;
+    }
+    if (header.version == EZC_VERSION_STRIPED) {
+        std::cerr << "In-memory .ezc files must be version 1 or 2" << std::endl;
+        return false;
+    }
+    if (!checkSingleBufferHeader(header)) {
+        return false;
+    }
+
+    TraceScope stage("ezc.write_buffer");
+    collectSlices(header, buffers.planes.data(), buffers.slices);
+    if (header.version != EZC_VERSION_RAW && !codeSingleBuffer(header, buffers.planes.size(), buffers)) {
+        return false;
+    }
+    out.clear();
+    BufferSink sink{out};
+    writeSingleBuffer(sink, header, buffers.planes.data(), buffers.planes.size(), buffers);
+    return true;
+}
+
+bool collectEzcSlices(const EzcHeader& header,
+                      const std::vector<BlockPlane8x8i16>& planes,
+                      EzcWriteBuffers& buffers) {
+    buffers.planes.clear();
+    for (const auto& plane : planes) {
+        buffers.planes.push_back(&plane);
+    }
+    if (!checkPlanes(header, buffers.planes.data(), buffers.planes.size()) ||
+        !checkSingleBufferHeader(header)) {
+        return false;
+    }
+    collectSlices(header, buffers.planes.data(), buffers.slices);
+    return true;
+}
+
+uint64_t ezcCodedSize(const EzcHeader& header, const EzcWriteBuffers& buffers) {
+    // Same layout as writeSingleBuffer(): header, tables, [slice rows and
+    // index], payload size, then every slice padded to whole bytes
+    HuffmanTable dcTables[2];
+    HuffmanTable acTables[2];
+    const size_t tableSets = buildTables(buffers, buffers.planes.size(), dcTables, acTables);
+    std::vector<uint8_t> partitions;
+    storePartitions(header, partitions);
+    uint64_t size = EZC_HEADER_SIZE + quantTablesSizeOf(header) + partitions.size() + 4;
+    for (size_t t = 0; t < tableSets; t++) {
+        size += dcTables[t].serializedSize() + acTables[t].serializedSize();
+    }
+    if (header.flags & EZC_FLAG_SLICED) {
+        size += 2 + 4 * static_cast<uint64_t>(buffers.slices.size());
+    }
+    uint64_t payloadSize = 0;
+    for (size_t slice = 0; slice < buffers.slices.size(); slice++) {
+        const size_t t = buffers.slices[slice].plane == 0 ? 0 : 1;
+        payloadSize += (EntropyCoder::codedBits(buffers.sliceStats[slice], dcTables[t], acTables[t]) + 7) / 8;
+    }
+    // A payload beyond the 32-bit offsets cannot be written at all
+    if (payloadSize > UINT32_MAX) {
+        return UINT64_MAX;
+    }
+    return size + payloadSize;
+}
+
+bool EzcStripWriter::open(const std::string& path,
+                          const EzcHeader& header,
+                          const OutputFile::Options& fileOptions) {
+    if (header.version != EZC_VERSION_STRIPED || !(header.flags & EZC_FLAG_SLICED) ||
+        header.sliceRows == 0 || (header.flags & EZC_FLAG_ADAPTIVE_BLOCKS)) {
+        std::cerr << "EzcStripWriter needs a sliced version 3 header without adaptive blocks" << std::endl;
+        return false;
+    }
+
+    fileHeader = header;
+    expectedSlices = sliceCountOf(header);
+    sliceBytes = 0;
+    sliceEnds.clear();
+    sliceEnds.reserve(expectedSlices);
+
+    if (!out.open(path, fileOptions)) {
+        return false;
+    }
+
+    // 32-byte header
+    uint8_t headerBytes[EZC_STRIPED_HEADER_SIZE] = {};
+    std::memcpy(headerBytes, EZC_MAGIC, 4);
+    headerBytes[4] = header.version;
+    headerBytes[5] = header.quality;
+    headerBytes[6] = header.blockDim;
+    headerBytes[7] = header.flags;
+    storeU32(headerBytes + 8, header.width);
+    storeU32(headerBytes + 12, header.height);
+    storeU32(headerBytes + 16, header.blockCountX);
+    storeU32(headerBytes + 20, header.blockCountY);
+    storeU32(headerBytes + 24, header.sliceRows);
+    // Bytes 28-31 are reserved (zero)
+    if (!out.write(headerBytes, sizeof(headerBytes))) {
+        return false;
+    }
+    uint8_t quantTables[2 * 64 * sizeof(uint16_t)];
+    storeQuantTables(header, quantTables);
+    return out.write(quantTables, quantTablesSizeOf(header));
+}
+
+void EzcStripWriter::encodeSlice(const int16_t* blocks, size_t count, std::vector<uint8_t>& out) {
+    EntropyCoder::Statistics stats;
+    EntropyCoder::gatherStatistics(blocks, count, stats);
+    const HuffmanTable dcTable = HuffmanTable::fromFrequencies(stats.dc);
+    const HuffmanTable acTable = HuffmanTable::fromFrequencies(stats.ac);
+
+    out.clear();
+    dcTable.serialize(out);
+    acTable.serialize(out);
+    EntropyCoder::encodeBlocks(blocks, count, dcTable, acTable, out);
+}
+
+bool EzcStripWriter::writeSlice(const std::vector<uint8_t>& encoded) {
+    if (sliceEnds.size() >= expectedSlices) {
+        std::cerr << "Too many slices for .ezc image" << std::endl;
+        return false;
+    }
+    sliceBytes += encoded.size();
+    sliceEnds.push_back(sliceBytes);
+    return out.write(encoded.data(), encoded.size());
+}
+
+bool EzcStripWriter::finish() {
+    if (sliceEnds.size() != expectedSlices) {
+        std::cerr << "Incomplete .ezc image: " << sliceEnds.size() << " of "
+                  << expectedSlices << " slices written" << std::endl;
+        return false;
+    }
+
+    // Footer: end offset of every slice, relative to the end of the header
+    // (and step tables)
+    std::vector<uint8_t> index(sliceEnds.size() * 8);
+    for (size_t i = 0; i < sliceEnds.size(); i++) {
+        storeU32(index.data() + 8 * i, static_cast<uint32_t>(sliceEnds[i] & 0xFFFFFFFFu));
+        storeU32(index.data() + 8 * i + 4, static_cast<uint32_t>(sliceEnds[i] >> 32));
+    }
+    if (!out.write(index.data(), index.size()) || !out.commit()) {
+        std::cerr << "Error writing .ezc file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EzcReader::open(const std::string& path) {
+    if (!file.open(path)) {
         std::cerr << "Failed to open file for reading: " << path << std::endl;
         return false;
     }
+    return parse(file.data(), file.size());
+}
+
+bool EzcReader::openBuffer(const uint8_t* data, size_t size) {
+    file.close();
+    return parse(data, size);
+}
 
-    // Read and validate magic number
-    uint8_t magic[4];
-    in.read(reinterpret_cast<char*>(magic), 4);
-    if (std::memcmp(magic, EZC_MAGIC, 4) != 0) {
+bool EzcReader::parse(const uint8_t* data, size_t size) {
+    TraceScope stage("ezc.parse");
+    inPlace = nullptr;
+    rawBlocks = nullptr;
+    payload = nullptr;
+    sliceEnds.clear();
+    slices.clear();
+
+    const uint8_t* end = data + size;
+    if (size < EZC_HEADER_SIZE) {
+        std::cerr << "Error reading .ezc header" << std::endl;
+        return false;
+    }
+
+    // Validate magic number
+    if (std::memcmp(data, EZC_MAGIC, 4) != 0) {
         std::cerr << "Invalid .ezc file: bad magic number" << std::endl;
         return false;
     }
 
-    // Read header fields
-    header.version = static_cast<uint8_t>(in.get());
-    if (header.version != EZC_VERSION) {
+    EzcHeader& header = fileHeader;
+    header.version = data[4];
+    if (header.version != EZC_VERSION_RAW && header.version != EZC_VERSION_HUFFMAN &&
+        header.version != EZC_VERSION_STRIPED) {
         std::cerr << "Unsupported .ezc version: " << static_cast<int>(header.version) << std::endl;
         return false;
     }
 
-    header.width       = readU16(in);
-    header.height      = readU16(in);
-    header.quality     = static_cast<uint8_t>(in.get());
-    header.blockDim    = static_cast<uint8_t>(in.get());
-    header.blockCountX = readU16(in);
-    header.blockCountY = readU16(in);
-    in.get(); // reserved byte
+    if (header.version == EZC_VERSION_STRIPED) {
+        if (size < EZC_STRIPED_HEADER_SIZE) {
+            std::cerr << "Error reading .ezc header" << std::endl;
+            return false;
+        }
+        header.quality     = data[5];
+        header.blockDim    = data[6];
+        header.flags       = data[7];
+        header.width       = loadU32(data + 8);
+        header.height      = loadU32(data + 12);
+        header.blockCountX = loadU32(data + 16);
+        header.blockCountY = loadU32(data + 20);
+        header.sliceRows   = loadU32(data + 24);
+    } else {
+        header.width       = loadU16(data + 5);
+        header.height      = loadU16(data + 7);
+        header.quality     = data[9];
+        header.blockDim    = data[10];
+        header.blockCountX = loadU16(data + 11);
+        header.blockCountY = loadU16(data + 13);
+        header.flags       = data[15];
+        header.sliceRows   = 0;
+    }
 
-    if (!in) {
-        std::cerr << "Error reading .ezc header" << std::endl;
+    const bool color = (header.flags & EZC_FLAG_COLOR) != 0;
+    if ((header.flags & ~EZC_KNOWN_FLAGS) ||
+        ((header.flags & EZC_FLAG_SLICED) && header.version == EZC_VERSION_RAW) ||
+        (!(header.flags & EZC_FLAG_SLICED) && header.version != EZC_VERSION_RAW &&
+         (color || header.version == EZC_VERSION_STRIPED)) ||
+        ((header.flags & EZC_FLAG_CHROMA_H2) && !color) ||
+        ((header.flags & EZC_FLAG_CHROMA_V2) && !(header.flags & EZC_FLAG_CHROMA_H2)) ||
+        ((header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) &&
+         (header.version != EZC_VERSION_HUFFMAN || (header.flags & EZC_FLAG_FIXED_POINT)))) {
+        std::cerr << "Unsupported .ezc flags: " << static_cast<int>(header.flags) << std::endl;
+        return false;
+    }
+
+    if (header.blockDim != 8 ||
+        header.blockCountX != (static_cast<uint64_t>(header.width) + 7) / 8 ||
+        header.blockCountY != (static_cast<uint64_t>(header.height) + 7) / 8) {
+        std::cerr << "Invalid .ezc block layout" << std::endl;
+        return false;
+    }
+
+    size_t blockCount = 0;
+    for (size_t p = 0; p < header.planeCount(); p++) {
+        const EzcPlane plane = header.plane(p);
+        blockCount += static_cast<size_t>(plane.blockCountX) * plane.blockCountY;
+    }
+    const size_t headerSize = header.version == EZC_VERSION_STRIPED ? EZC_STRIPED_HEADER_SIZE
+                                                                    : EZC_HEADER_SIZE;
+    const size_t tablesSize = quantTablesSizeOf(header);
+    if (size - headerSize < tablesSize || !loadQuantTables(header, data + headerSize)) {
+        std::cerr << "Invalid .ezc quantization tables" << std::endl;
+        return false;
+    }
+    const uint8_t* cursor = data + headerSize + tablesSize;
+    if (!parsePartitions(header, cursor, end)) {
+        std::cerr << "Invalid .ezc block partition" << std::endl;
         return false;
     }
 
-    // Read block data
-    size_t totalBlocks = static_cast<size_t>(header.blockCountX) * header.blockCountY;
-    quantizedBlocks.clear();
-    quantizedBlocks.reserve(totalBlocks);
+    // Builds the slice table once rowsPerSlice is known
+    auto layoutSlices = [&]() {
+        forEachSlice(header, rowsPerSlice, [&](size_t plane, size_t first, size_t count, size_t units,
+                                               size_t offset) {
+            slices.push_back({plane, first, count, units, offset});
+        });
+        sliceTotal = slices.size();
+    };
 
-    for (size_t b = 0; b < totalBlocks; b++) {
-        int blockX = static_cast<int>(b % header.blockCountX);
-        int blockY = static_cast<int>(b / header.blockCountX);
-        quantizedBlocks.emplace_back(blockX, blockY);
-        auto& block = quantizedBlocks.back();
+    if (header.version == EZC_VERSION_RAW) {
+        if (static_cast<size_t>(end - cursor) < blockCount * 64 * sizeof(int16_t)) {
+            std::cerr << "Error reading .ezc block data" << std::endl;
+            return false;
+        }
+        rawBlocks = cursor;
+        // Mappings are page aligned and the payload starts at an even
+        // offset; a caller's buffer may not be aligned
+        if (hostIsLittleEndian() && reinterpret_cast<uintptr_t>(cursor) % alignof(int16_t) == 0) {
+            inPlace = reinterpret_cast<const int16_t*>(cursor);
+        }
+        rowsPerSlice = 1;
+        layoutSlices();
+        return true;
+    }
 
-        for (size_t i = 0; i < 64; i++) {
-            block[i] = readI16(in);
+    if (header.version == EZC_VERSION_STRIPED) {
+        // Footer: one 64-bit end offset per slice
+        if (header.sliceRows == 0) {
+            std::cerr << "Invalid .ezc slice index" << std::endl;
+            return false;
+        }
+        // Every slice takes its 8-byte index entry and at least its two
+        // Huffman tables, so the file bounds the slice count before the
+        // 32-bit dimensions are trusted with an allocation
+        const uint64_t dataSize = static_cast<uint64_t>(end - cursor);
+        const uint64_t minSliceSize = 8 + 2 * HuffmanTable::MIN_SERIALIZED_SIZE;
+        if (dataSize / minSliceSize < sliceCountOf(header)) {
+            std::cerr << "Invalid .ezc slice index" << std::endl;
+            return false;
+        }
+        rowsPerSlice = header.sliceRows;
+        layoutSlices();
+        const uint64_t payloadSize = dataSize - sliceTotal * 8;
+        const uint8_t* index = cursor + payloadSize;
+        sliceEnds.resize(sliceTotal);
+        for (size_t i = 0; i < sliceTotal; i++) {
+            sliceEnds[i] = loadU64(index + 8 * i);
+        }
+        if (!std::is_sorted(sliceEnds.begin(), sliceEnds.end()) ||
+            (!sliceEnds.empty() && sliceEnds.back() != payloadSize)) {
+            std::cerr << "Invalid .ezc slice index" << std::endl;
+            return false;
+        }
+
+        payload = cursor;
+        return true;
+    }
+
+    if (!dcTable.deserialize(cursor, end) || !acTable.deserialize(cursor, end) ||
+        (color && (!chromaDCTable.deserialize(cursor, end) || !chromaACTable.deserialize(cursor, end)))) {
+        std::cerr << "Invalid .ezc Huffman tables" << std::endl;
+        return false;
+    }
+
+    // Slice index: end offset of every slice within the payload
+    if (header.flags & EZC_FLAG_SLICED) {
+        if (end - cursor < 2) {
+            std::cerr << "Invalid .ezc slice index" << std::endl;
+            return false;
+        }
+        header.sliceRows = loadU16(cursor);
+        cursor += 2;
+        if (header.sliceRows == 0 || ((header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) &&
+                                      header.sliceRows % BlockPartition::SUPERBLOCK_CELLS != 0)) {
+            std::cerr << "Invalid .ezc slice index" << std::endl;
+            return false;
         }
     }
+    rowsPerSlice = rowsPerSliceOf(header);
+    layoutSlices();
 
-    if (!in) {
-        std::cerr << "Error reading .ezc block data" << std::endl;
+    if (header.flags & EZC_FLAG_SLICED) {
+        sliceEnds.resize(sliceTotal);
+        for (uint64_t& sliceEnd : sliceEnds) {
+            uint32_t value = 0;
+            if (!parseU32(cursor, end, value)) {
+                std::cerr << "Invalid .ezc slice index" << std::endl;
+                return false;
+            }
+            sliceEnd = value;
+        }
+    }
+
+    uint32_t payloadSize = 0;
+    if (!parseU32(cursor, end, payloadSize) || payloadSize > static_cast<size_t>(end - cursor)) {
+        std::cerr << "Invalid .ezc payload size" << std::endl;
+        return false;
+    }
+    if (sliceEnds.empty()) {
+        sliceEnds.assign(sliceTotal, payloadSize);
+    }
+    if (!std::is_sorted(sliceEnds.begin(), sliceEnds.end()) ||
+        (!sliceEnds.empty() && sliceEnds.back() != payloadSize)) {
+        std::cerr << "Invalid .ezc slice index" << std::endl;
         return false;
     }
 
+    payload = cursor;
+    return true;
+}
+
+void EzcReader::sliceBlocks(size_t slice, size_t& first, size_t& count) const {
+    first = slices[slice].first;
+    count = slices[slice].count;
+}
+
+bool EzcReader::readSlice(size_t slice, int16_t* dst, size_t blockLimit) const {
+    const size_t offset = slices[slice].offset;
+    // Blocks are coded in order, so a prefix decodes on its own
+    const size_t count = std::min(slices[slice].units, blockLimit);
+
+    if (fileHeader.version == EZC_VERSION_RAW) {
+        if (inPlace) {
+            std::memcpy(dst, inPlace + offset * 64, count * 64 * sizeof(int16_t));
+        } else {
+            const uint8_t* src = rawBlocks + offset * 64 * sizeof(int16_t);
+            for (size_t i = 0; i < count * 64; i++) {
+                dst[i] = static_cast<int16_t>(loadU16(src + 2 * i));
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* cursor = payload + (slice == 0 ? 0 : sliceEnds[slice - 1]);
+    const uint8_t* end = payload + sliceEnds[slice];
+
+    if (fileHeader.version == EZC_VERSION_STRIPED) {
+        HuffmanTable sliceDC;
+        HuffmanTable sliceAC;
+        if (!sliceDC.deserialize(cursor, end) || !sliceAC.deserialize(cursor, end)) {
+            return false;
+        }
+        return EntropyCoder::decodeBlocks(cursor, static_cast<size_t>(end - cursor),
+                                          sliceDC, sliceAC, dst, count);
+    }
+
+    const bool chroma = slices[slice].plane != 0;
+    return EntropyCoder::decodeBlocks(cursor, static_cast<size_t>(end - cursor),
+                                      chroma ? chromaDCTable : dcTable,
+                                      chroma ? chromaACTable : acTable, dst, count);
+}
+
+const int16_t* EzcReader::sliceCoefficients(size_t slice, std::vector<int16_t>& scratch,
+                                            size_t blockLimit) const {
+    if (inPlace) {
+        return inPlace + slices[slice].offset * 64;
+    }
+
+    Trace::countGrowth(scratch, std::min(slices[slice].units, blockLimit) * 64);
+    scratch.resize(std::min(slices[slice].units, blockLimit) * 64);
+    return readSlice(slice, scratch.data(), blockLimit) ? scratch.data() : nullptr;
+}
+
+bool readEzc(const std::string& path,
+             EzcHeader& header,
+             std::vector<BlockPlane8x8i16>& planes) {
+    EzcReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    header = reader.header();
+    planes.resize(header.planeCount());
+    for (size_t p = 0; p < planes.size(); p++) {
+        const EzcPlane plane = header.plane(p);
+        planes[p].resize(plane.blockCountX, plane.blockCountY);
+    }
+
+    // Slices are independent, so they are copied or decoded in parallel
+    std::atomic<bool> corrupt{false};
+    ThreadPool::shared().parallelFor(0, reader.sliceCount(), 1, [&](size_t sliceBegin, size_t sliceEnd) {
+        for (size_t slice = sliceBegin; slice < sliceEnd; slice++) {
+            size_t first = 0;
+            size_t count = 0;
+            reader.sliceBlocks(slice, first, count);
+            if (!reader.readSlice(slice, planes[reader.slicePlane(slice)].data() + first * 64)) {
+                corrupt = true;
+            }
+        }
+    });
+
+    if (corrupt) {
+        std::cerr << "Corrupt .ezc block data" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool readEzc(const std::string& path,
+             EzcHeader& header,
+             BlockPlane8x8i16& quantizedBlocks) {
+    std::vector<BlockPlane8x8i16> planes;
+    if (!readEzc(path, header, planes)) {
+        return false;
+    }
+    quantizedBlocks = std::move(planes[0]);
     return true;
 }
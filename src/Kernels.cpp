@@ -0,0 +1,222 @@
+#include "ezcodec/Kernels.h"
+#include "ezcodec/DCT.h"
+#include "ezcodec/Quantization.h"
+#include "simd/SimdKernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define EZCODEC_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+// Scalar kernels: the double-precision AAN transform and the same integer
+// quantization arithmetic as the Quantization templates.
+
+void forwardDCTScalar(const uint16_t* src, int16_t* dst) {
+    double in[64];
+    double out[64];
+    for (int i = 0; i < 64; i++) {
+        in[i] = static_cast<double>(src[i]);
+    }
+    DCT::forwardDCT8x8(in, out);
+    for (int i = 0; i < 64; i++) {
+        dst[i] = static_cast<int16_t>(out[i]);
+    }
+}
+
+void inverseDCTScalar(const int16_t* src, int16_t* dst) {
+    double in[64];
+    double out[64];
+    for (int i = 0; i < 64; i++) {
+        in[i] = static_cast<double>(src[i]);
+    }
+    DCT::inverseDCT8x8(in, out);
+    for (int i = 0; i < 64; i++) {
+        dst[i] = static_cast<int16_t>(out[i]);
+    }
+}
+
+void quantizeScalar(const int16_t* src, int16_t* dst, const uint16_t* steps, const uint32_t* reciprocals) {
+    for (int i = 0; i < 64; i++) {
+        const int value = src[i];
+        const uint64_t numerator = static_cast<uint32_t>(std::abs(value)) + steps[i] / 2;
+        const int quotient = static_cast<int>((numerator * reciprocals[i]) >> QuantTable::RECIPROCAL_SHIFT);
+        dst[i] = static_cast<int16_t>(value < 0 ? -quotient : quotient);
+    }
+}
+
+void dequantizeScalar(const int16_t* src, int16_t* dst, const uint16_t* steps) {
+    for (int i = 0; i < 64; i++) {
+        dst[i] = static_cast<int16_t>(src[i] * static_cast<int>(steps[i]));
+    }
+}
+
+#if defined(EZCODEC_X86)
+
+void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<unsigned>(r[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t readXcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax = 0;
+    uint32_t edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+SimdLevel cpuSimdLevel() {
+    unsigned regs[4] = {};
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+    if (maxLeaf < 1) {
+        return SimdLevel::Scalar;
+    }
+
+    cpuid(1, 0, regs);
+    const unsigned ecx1 = regs[2];
+    const bool sse41   = (ecx1 & (1u << 19)) != 0;
+    const bool fma     = (ecx1 & (1u << 12)) != 0;
+    const bool osxsave = (ecx1 & (1u << 27)) != 0;
+    const bool avx     = (ecx1 & (1u << 28)) != 0;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && fma) {
+        // The OS must save the YMM state (XCR0 bits 1 and 2).
+        if ((readXcr0() & 0x6) == 0x6) {
+            cpuid(7, 0, regs);
+            avx2 = (regs[1] & (1u << 5)) != 0;
+        }
+    }
+
+    if (avx2) {
+        return SimdLevel::AVX2;
+    }
+    if (sse41) {
+        return SimdLevel::SSE41;
+    }
+    return SimdLevel::Scalar;
+}
+
+#else
+
+SimdLevel cpuSimdLevel() {
+    return SimdLevel::Scalar;
+}
+
+#endif
+
+SimdLevel compiledSimdLevel() {
+#if defined(EZCODEC_HAVE_AVX2)
+    return SimdLevel::AVX2;
+#elif defined(EZCODEC_HAVE_SSE41)
+    return SimdLevel::SSE41;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel supportedSimdLevel() {
+    static const SimdLevel level = [] {
+        SimdLevel cpu = cpuSimdLevel();
+        SimdLevel compiled = compiledSimdLevel();
+        return static_cast<int>(cpu) < static_cast<int>(compiled) ? cpu : compiled;
+    }();
+    return level;
+}
+
+} // namespace
+
+namespace simd {
+
+const FloatBasis8x8& floatBasis8x8() {
+    static const FloatBasis8x8 basis = [] {
+        using Basis = DCTBasis<TxSize::TX_8x8>;
+        FloatBasis8x8 b{};
+        for (int i = 0; i < 64; i++) {
+            b.matrix[i] = static_cast<float>(Basis::matrix[i]);
+            b.transposed[i] = static_cast<float>(Basis::transposed[i]);
+        }
+        return b;
+    }();
+    return basis;
+}
+
+const Kernels8x8& scalarKernels() {
+    static const Kernels8x8 table = {
+        SimdLevel::Scalar, "scalar",
+        forwardDCTScalar, inverseDCTScalar, DCT::inverseDCT8x8LowBand, quantizeScalar, dequantizeScalar
+    };
+    return table;
+}
+
+} // namespace simd
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2:  return "avx2";
+        case SimdLevel::SSE41: return "sse4.1";
+        default:               return "scalar";
+    }
+}
+
+SimdLevel detectSimdLevel() {
+    SimdLevel level = supportedSimdLevel();
+
+    if (const char* env = std::getenv("EZCODEC_SIMD")) {
+        SimdLevel requested = level;
+        if (std::strcmp(env, "scalar") == 0) {
+            requested = SimdLevel::Scalar;
+        } else if (std::strcmp(env, "sse4.1") == 0) {
+            requested = SimdLevel::SSE41;
+        } else if (std::strcmp(env, "avx2") == 0) {
+            requested = SimdLevel::AVX2;
+        }
+        if (static_cast<int>(requested) < static_cast<int>(level)) {
+            level = requested;
+        }
+    }
+
+    return level;
+}
+
+const Kernels8x8* kernels8x8For(SimdLevel level) {
+    if (static_cast<int>(level) > static_cast<int>(supportedSimdLevel())) {
+        return nullptr;
+    }
+
+    switch (level) {
+#if defined(EZCODEC_HAVE_AVX2)
+        case SimdLevel::AVX2:  return &simd::avx2Kernels();
+#endif
+#if defined(EZCODEC_HAVE_SSE41)
+        case SimdLevel::SSE41: return &simd::sse41Kernels();
+#endif
+        case SimdLevel::Scalar: return &simd::scalarKernels();
+        default: return nullptr;
+    }
+}
+
+const Kernels8x8& kernels8x8() {
+    static const Kernels8x8& selected = *kernels8x8For(detectSimdLevel());
+    return selected;
+}
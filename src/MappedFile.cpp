@@ -0,0 +1,133 @@
+#include "ezcodec/MappedFile.h"
+#include "ezcodec/Trace.h"
+
+#include <fstream>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Map the whole file read-only; nullptr on failure or for empty files
+void* mapFile(const std::string& path, size_t& size) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    void* view = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (section != nullptr) {
+            view = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(section);
+            size = static_cast<size_t>(fileSize.QuadPart);
+        }
+    }
+    CloseHandle(file);
+    return view;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info {};
+    void* view = nullptr;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            view = nullptr;
+        } else {
+            size = static_cast<size_t>(info.st_size);
+            // The decoder reads the whole file right away
+            madvise(view, size, MADV_WILLNEED);
+        }
+    }
+    ::close(fd);
+    return view;
+#endif
+}
+
+void unmapFile(void* view, size_t size) {
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr))
+    , length(std::exchange(other.length, 0))
+    , mapping(std::exchange(other.mapping, nullptr))
+    , fallback(std::move(other.fallback)) {
+    if (!mapping) {
+        bytes = fallback.data();
+    }
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+        mapping = std::exchange(other.mapping, nullptr);
+        fallback = std::move(other.fallback);
+        if (!mapping) {
+            bytes = fallback.data();
+        }
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    size_t mappedSize = 0;
+    mapping = mapFile(path, mappedSize);
+    if (mapping) {
+        bytes = static_cast<const uint8_t*>(mapping);
+        length = mappedSize;
+        Trace::count(Trace::Counter::BytesRead, length);
+        return true;
+    }
+
+    // Empty files, pipes, or platforms without mmap
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    bytes = fallback.data();
+    length = fallback.size();
+    Trace::count(Trace::Counter::BytesRead, length);
+    return !in.bad();
+}
+
+void MappedFile::close() {
+    if (mapping) {
+        unmapFile(mapping, length);
+        mapping = nullptr;
+    }
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+}
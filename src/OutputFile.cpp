@@ -0,0 +1,206 @@
+#include "ezcodec/OutputFile.h"
+#include "ezcodec/Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(_WIN32)
+
+int openForWrite(const std::string& path) {
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+long long writeSome(int fd, const uint8_t* data, size_t size) {
+    const unsigned chunk = static_cast<unsigned>(std::min<size_t>(size, 1u << 30));
+    return _write(fd, data, chunk);
+}
+
+bool syncFile(int fd) { return _commit(fd) == 0; }
+int closeFile(int fd) { return _close(fd); }
+int processId() { return _getpid(); }
+
+bool replaceFile(const std::string& from, const std::string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+// MOVEFILE_WRITE_THROUGH already makes the rename durable
+bool syncDirectoryOf(const std::string&) { return true; }
+
+#else
+
+int openForWrite(const std::string& path) {
+    return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+long long writeSome(int fd, const uint8_t* data, size_t size) {
+    return ::write(fd, data, size);
+}
+
+bool syncFile(int fd) { return ::fsync(fd) == 0; }
+int closeFile(int fd) { return ::close(fd); }
+int processId() { return static_cast<int>(::getpid()); }
+
+bool replaceFile(const std::string& from, const std::string& to) {
+    return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+// A rename is only durable once the directory entry is synced
+bool syncDirectoryOf(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    const std::string directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    const int dirFd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return false;
+    }
+    const bool ok = ::fsync(dirFd) == 0;
+    ::close(dirFd);
+    return ok;
+}
+
+#endif
+
+std::string temporaryPathFor(const std::string& path) {
+    static std::atomic<unsigned> counter{0};
+    return path + ".tmp-" + std::to_string(processId()) + "-" + std::to_string(counter++);
+}
+
+} // namespace
+
+OutputFile::~OutputFile() {
+    discard();
+}
+
+bool OutputFile::open(const std::string& path, const Options& openOptions) {
+    discard();
+
+    options = openOptions;
+    finalPath = path;
+    writePath = options.atomicReplace ? temporaryPathFor(path) : path;
+    failed = false;
+    buffer.clear();
+    buffer.reserve(BUFFER_SIZE);
+
+    fd = openForWrite(writePath);
+    if (fd < 0) {
+        std::cerr << "Failed to open file for writing: " << writePath
+                  << " (" << std::strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFile::write(const void* data, size_t size) {
+    if (fd < 0 || failed) {
+        return false;
+    }
+
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    if (buffer.size() + size <= BUFFER_SIZE) {
+        buffer.insert(buffer.end(), bytes, bytes + size);
+        return true;
+    }
+
+    if (!flushBuffer()) {
+        return false;
+    }
+    if (size >= BUFFER_SIZE) {
+        return writeAll(bytes, size);
+    }
+    buffer.insert(buffer.end(), bytes, bytes + size);
+    return true;
+}
+
+bool OutputFile::flushBuffer() {
+    if (buffer.empty()) {
+        return true;
+    }
+    const bool ok = writeAll(buffer.data(), buffer.size());
+    buffer.clear();
+    return ok;
+}
+
+bool OutputFile::writeAll(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        const long long written = writeSome(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error writing to file: " << writePath
+                      << " (" << std::strerror(errno) << ")" << std::endl;
+            failed = true;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        Trace::count(Trace::Counter::BytesWritten, static_cast<uint64_t>(written));
+    }
+    return true;
+}
+
+bool OutputFile::commit() {
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = !failed && flushBuffer();
+    if (ok && options.sync && !syncFile(fd)) {
+        std::cerr << "Failed to sync file: " << writePath << std::endl;
+        ok = false;
+    }
+    if (closeFile(fd) != 0) {
+        ok = false;
+    }
+    fd = -1;
+
+    if (!ok) {
+        if (options.atomicReplace) {
+            std::remove(writePath.c_str());
+        }
+        return false;
+    }
+
+    if (options.atomicReplace) {
+        if (!replaceFile(writePath, finalPath)) {
+            std::cerr << "Failed to rename " << writePath << " to " << finalPath << std::endl;
+            std::remove(writePath.c_str());
+            return false;
+        }
+        if (options.sync && !syncDirectoryOf(finalPath)) {
+            std::cerr << "Failed to sync directory of: " << finalPath << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void OutputFile::discard() {
+    if (fd < 0) {
+        return;
+    }
+    closeFile(fd);
+    fd = -1;
+    if (options.atomicReplace) {
+        std::remove(writePath.c_str());
+    }
+}
@@ -0,0 +1,120 @@
+#include "ezcodec/PgmStream.h"
+#include "ezcodec/Trace.h"
+
+#include <cctype>
+#include <iostream>
+
+namespace {
+
+// Next header token of a PNM file, skipping whitespace and # comments
+bool readToken(std::FILE* file, std::string& token) {
+    token.clear();
+    int c = std::fgetc(file);
+    while (c != EOF) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') {
+                c = std::fgetc(file);
+            }
+        } else if (!std::isspace(c)) {
+            break;
+        }
+        c = std::fgetc(file);
+    }
+    while (c != EOF && !std::isspace(c)) {
+        token.push_back(static_cast<char>(c));
+        c = std::fgetc(file);
+    }
+    // The single whitespace after the last token has been consumed
+    return !token.empty();
+}
+
+bool parseDimension(const std::string& token, uint32_t& value) {
+    if (token.empty() || token.size() > 10) {
+        return false;
+    }
+    uint64_t parsed = 0;
+    for (char c : token) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        parsed = parsed * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (parsed == 0 || parsed > 0xFFFFFFFFu) {
+        return false;
+    }
+    value = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+} // namespace
+
+PgmReader::~PgmReader() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool PgmReader::open(const std::string& path) {
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Failed to open file for reading: " << path << std::endl;
+        return false;
+    }
+    // Large stdio buffer so rows arrive in a few big reads
+    std::setvbuf(file, nullptr, _IOFBF, size_t{1} << 20);
+
+    std::string magic;
+    std::string widthToken;
+    std::string heightToken;
+    std::string maxToken;
+    uint32_t maxValue = 0;
+    if (!readToken(file, magic) || magic != "P5" ||
+        !readToken(file, widthToken) || !parseDimension(widthToken, imageWidth) ||
+        !readToken(file, heightToken) || !parseDimension(heightToken, imageHeight) ||
+        !readToken(file, maxToken) || !parseDimension(maxToken, maxValue) || maxValue > 255) {
+        std::cerr << "Not an 8-bit binary PGM (P5) file: " << path << std::endl;
+        return false;
+    }
+    // Samples are coded as read, so a smaller range would come out dark
+    if (maxValue != 255) {
+        std::cerr << "Unsupported PGM maximum value " << maxValue << " (expected 255): " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool PgmReader::readRows(uint8_t* dst, size_t rows) {
+    const size_t bytes = rows * imageWidth;
+    if (std::fread(dst, 1, bytes, file) != bytes) {
+        std::cerr << "Unexpected end of PGM data" << std::endl;
+        return false;
+    }
+    Trace::count(Trace::Counter::BytesRead, bytes);
+    return true;
+}
+
+bool PgmWriter::open(const std::string& path, uint32_t width, uint32_t height,
+                     const OutputFile::Options& fileOptions) {
+    imageWidth = width;
+    imageHeight = height;
+    rowsWritten = 0;
+    if (!out.open(path, fileOptions)) {
+        return false;
+    }
+    const std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    return out.write(header.data(), header.size());
+}
+
+bool PgmWriter::writeRows(const uint8_t* src, size_t rows) {
+    rowsWritten += rows;
+    return out.write(src, rows * imageWidth);
+}
+
+bool PgmWriter::finish() {
+    if (rowsWritten != imageHeight) {
+        std::cerr << "Incomplete PGM image: " << rowsWritten << " of " << imageHeight
+                  << " rows written" << std::endl;
+        return false;
+    }
+    return out.commit();
+}
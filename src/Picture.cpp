@@ -1,15 +1,21 @@
 #include "ezcodec/Picture.h"
+#include "ezcodec/Trace.h"
 #include <iostream>
 #include "stb/stb_image.h"
 
-Picture::Picture(const char* filename) {
-    data = stbi_load(filename, &width, &height, &bitdepth, 1);
+Picture::Picture(const char* filename, int channels)
+    : channels(channels) {
+    {
+        TraceScope scope("picture.load", filename);
+        data = stbi_load(filename, &width, &height, &bitdepth, channels);
+    }
     if (data == nullptr) {
         std::cerr << "Failed to load image: " << filename << std::endl;
         return;
     }
-
-    dataBlocks = splitIntoBlocks<uint16_t, TxSize::TX_8x8>();
+    Trace::countFile(Trace::Counter::BytesRead, filename);
+    Trace::count(Trace::Counter::Allocations);
+    Trace::count(Trace::Counter::AllocatedBytes, static_cast<uint64_t>(width) * height * channels);
 }
 
 Picture::~Picture() {
@@ -1,4 +1,5 @@
 #include "ezcodec/Quantization.h"
+#include "ezcodec/DCT.h"
 #include <algorithm>
 
 int Quantization::getScaleFactor(int quality) {
@@ -16,16 +17,64 @@ int Quantization::getScaleFactor(int quality) {
     return std::max(scale, 1);
 }
 
-int Quantization::getQuantizationValue(int index, int quality) {
-    // Get base value from the quantization table
-    int baseValue = JPEG_LUMINANCE_QUANTIZATION_TABLE[index];
+// Base table entries scaled by the factor of getScaleFactor():
+// (baseValue * scale + 50) / 100, kept within [1, QuantTable::MAX_STEP]
+template<typename Table>
+static QuantTable::Steps scaleTable(const Table& baseTable, int scale) {
+    QuantTable::Steps steps{};
+    for (size_t i = 0; i < 64; i++) {
+        const int quantValue = (static_cast<int>(baseTable[i]) * scale + 50) / 100;
+        steps[i] = static_cast<uint16_t>(std::clamp(quantValue, 1, static_cast<int>(QuantTable::MAX_STEP)));
+    }
+    return steps;
+}
+
+static const std::array<int, 64>& baseTableOf(Quantization::Component component) {
+    return (component == Quantization::Component::Chroma)
+        ? Quantization::JPEG_CHROMINANCE_QUANTIZATION_TABLE
+        : Quantization::JPEG_LUMINANCE_QUANTIZATION_TABLE;
+}
+
+QuantTable::QuantTable()
+    : QuantTable(Steps{}) {}
+
+QuantTable::QuantTable(const Steps& steps) {
+    for (size_t i = 0; i < 64; i++) {
+        const uint32_t step = std::clamp<uint32_t>(steps[i], 1, MAX_STEP);
+        stepSizes[i] = static_cast<uint16_t>(step);
+        reciprocalValues[i] = static_cast<uint32_t>(((uint64_t{1} << RECIPROCAL_SHIFT) + step - 1) / step);
+    }
+}
 
-    // Scale based on quality
-    int scale = getScaleFactor(quality);
+Quantization::FoldedTable Quantization::makeFoldedQuantTable(int quality, Component component) {
+    const double* scale = DCT::aanForwardScale();
+    const std::array<uint16_t, 64> steps = makeStepTable(quality, component);
+    FoldedTable table{};
+    for (int i = 0; i < 64; i++) {
+        table[i] = scale[i] / steps[i];
+    }
+    return table;
+}
+
+Quantization::FoldedTable Quantization::makeFoldedDequantTable(int quality, Component component) {
+    const double* scale = DCT::aanInverseScale();
+    const std::array<uint16_t, 64> steps = makeStepTable(quality, component);
+    FoldedTable table{};
+    for (int i = 0; i < 64; i++) {
+        table[i] = scale[i] * steps[i];
+    }
+    return table;
+}
+
+std::array<uint16_t, 64> Quantization::makeStepTable(int quality, Component component) {
+    // The scale factor is computed once per table, not per coefficient
+    return scaleTable(baseTableOf(component), getScaleFactor(quality));
+}
 
-    // Apply scaling: (baseValue * scale + 50) / 100
-    int quantValue = (baseValue * scale + 50) / 100;
+QuantTable Quantization::makeQuantTable(int quality, Component component) {
+    return QuantTable(makeStepTable(quality, component));
+}
 
-    // Minimum quantization value = 1
-    return std::max(quantValue, 1);
+QuantTable Quantization::makeQuantTable(int quality, const QuantTable::Steps& baseTable) {
+    return QuantTable(scaleTable(baseTable, getScaleFactor(quality)));
 }
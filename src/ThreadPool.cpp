@@ -1,27 +1,393 @@
 #include "ezcodec/ThreadPool.h"
+#include "ezcodec/Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <limits>
+#include <string>
 
-ThreadPool::ThreadPool(size_t numThreads) : stop(false) {
-    for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back([this] {
-            while (true) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(this->queueMutex);
+namespace {
+
+constexpr size_t NOT_A_WORKER = std::numeric_limits<size_t>::max();
+
+// Pool and worker index of the current thread, if it is a pool worker
+thread_local const void* currentPool = nullptr;
+thread_local size_t currentWorker = NOT_A_WORKER;
 
-                    this->condition.wait(lock, [this] {
-                        return this->stop || !this->tasks.empty();
-                    });
+// Per-call parallelFor bookkeeping, shared by both schedulers
+struct ParallelJob {
+    size_t begin = 0;
+    size_t end = 0;
+    size_t grain = 1;
+    size_t chunks = 0;
+    void* context = nullptr;
+    void (*invoke)(void*, size_t, size_t) = nullptr;
 
-                    if (this->stop && this->tasks.empty())
-                        return;
+    std::atomic<size_t> nextChunk{0};  // shared-queue scheduler only
+    std::atomic<size_t> remaining{0};  // chunks not yet finished
 
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
-                }
+    std::mutex errorMutex;
+    std::exception_ptr error;
 
-                task();
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    bool done = false;
+
+    [[nodiscard]] size_t chunksIn(size_t first, size_t last) const {
+        return (last - first + grain - 1) / grain;
+    }
+
+    void run(size_t chunkBegin, size_t chunkEnd) {
+        try {
+            invoke(context, chunkBegin, chunkEnd);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
             }
-        });
+        }
+    }
+
+    // Run [first, last) one chunk at a time
+    void runSequential(size_t first, size_t last) {
+        for (size_t chunkBegin = first; chunkBegin < last; chunkBegin += grain) {
+            run(chunkBegin, std::min(chunkBegin + grain, last));
+        }
+        finished(chunksIn(first, last));
+    }
+
+    void finished(size_t count) {
+        if (remaining.fetch_sub(count, std::memory_order_acq_rel) == count) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done = true;
+            doneCondition.notify_all();
+        }
+    }
+
+    // Always called before the job is destroyed, even when remaining has
+    // already been seen as zero: the last finisher may still hold doneMutex.
+    void wait() {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [this] { return done; });
+    }
+
+    bool waitFor(std::chrono::microseconds timeout) {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        return doneCondition.wait_for(lock, timeout, [this] { return done; });
+    }
+};
+
+// A sub-range of a parallelFor job. Stored in a per-job arena so
+// splitting never allocates.
+struct RangeTask {
+    ParallelJob* job = nullptr;
+    size_t begin = 0;
+    size_t end = 0;
+    // Counted in StealingState::queued when pushed (tracing was on)
+    bool counted = false;
+};
+
+// Fixed-capacity Chase-Lev deque (Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models", PPoPP 2013). The owner pushes
+// and pops at the bottom; thieves steal from the top with a CAS.
+class WorkStealingDeque {
+public:
+    static constexpr int64_t CAPACITY = 4096;
+
+    WorkStealingDeque() {
+        for (auto& slot : slots) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // Owner only. Returns false when full.
+    bool push(RangeTask* task) {
+        const int64_t b = bottom.load(std::memory_order_relaxed);
+        const int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY) {
+            return false;
+        }
+        slots[b & (CAPACITY - 1)].store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only
+    RangeTask* pop() {
+        const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        RangeTask* task = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last element: race against thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread. Returns nullptr when empty or when another thief won.
+    RangeTask* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+
+        RangeTask* task = slots[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    alignas(64) std::atomic<RangeTask*> slots[CAPACITY];
+};
+
+uint64_t nextRandom(uint64_t& state) {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+} // namespace
+
+struct ThreadPool::StealingState {
+    ThreadPool& pool;
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+    std::vector<uint64_t> randomState;
+
+    // Ranges pushed by threads that are not workers of this pool
+    std::mutex injectedMutex;
+    std::deque<RangeTask*> injected;
+    std::atomic<size_t> injectedCount{0};
+
+    // Ranges pushed while tracing and not yet taken. Such a range is
+    // taken off again even if tracing has stopped meanwhile, so the depth
+    // does not drift when a session starts or stops with ranges queued.
+    std::atomic<int64_t> queued{0};
+
+    // Sleeping: a worker records the epoch, looks for work once more and
+    // then waits for the epoch to change. signal() bumps the epoch before
+    // checking for sleepers, so a wakeup cannot be lost.
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<bool> stopping{false};
+
+    StealingState(ThreadPool& owner, size_t numWorkers)
+        : pool(owner) {
+        for (size_t i = 0; i < numWorkers; i++) {
+            deques.push_back(std::make_unique<WorkStealingDeque>());
+            randomState.push_back(0x9E3779B97F4A7C15ull * (i + 1));
+        }
+    }
+
+    [[nodiscard]] size_t selfIndex() const {
+        return currentPool == &pool ? currentWorker : NOT_A_WORKER;
+    }
+
+    void signal() {
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCondition.notify_one();
+        }
+    }
+
+    // Returns false if the range could not be queued (own deque full)
+    bool push(RangeTask* task) {
+        task->counted = Trace::enabled();
+        const size_t self = selfIndex();
+        if (self != NOT_A_WORKER) {
+            if (!deques[self]->push(task)) {
+                return false;
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(injectedMutex);
+            injected.push_back(task);
+            injectedCount.fetch_add(1, std::memory_order_release);
+        }
+        if (task->counted) {
+            Trace::queueDepth(queued.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+        signal();
+        return true;
+    }
+
+    RangeTask* takeInjected() {
+        if (injectedCount.load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(injectedMutex);
+        if (injected.empty()) {
+            return nullptr;
+        }
+        RangeTask* task = injected.front();
+        injected.pop_front();
+        injectedCount.fetch_sub(1, std::memory_order_release);
+        return task;
+    }
+
+    RangeTask* stealFromRandomVictim(size_t self) {
+        static thread_local uint64_t externalRandom =
+            0xD1B54A32D192ED03ull ^ reinterpret_cast<uintptr_t>(&externalRandom);
+        uint64_t& random = (self != NOT_A_WORKER) ? randomState[self] : externalRandom;
+
+        const size_t count = deques.size();
+        if (count == 0) {
+            return nullptr;
+        }
+        const size_t start = static_cast<size_t>(nextRandom(random) % count);
+        for (size_t k = 0; k < count; k++) {
+            const size_t victim = (start + k) % count;
+            if (victim == self) {
+                continue;
+            }
+            if (RangeTask* task = deques[victim]->steal()) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    RangeTask* findRange(size_t self) {
+        RangeTask* task = self != NOT_A_WORKER ? deques[self]->pop() : nullptr;
+        if (task == nullptr) {
+            task = takeInjected();
+        }
+        if (task == nullptr) {
+            task = stealFromRandomVictim(self);
+        }
+        if (task != nullptr && task->counted) {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Split the range in halves, queueing the right half each time, until
+    // one chunk is left; then run it.
+    void execute(RangeTask* task) {
+        ParallelJob& job = *task->job;
+        const size_t first = task->begin;
+        size_t last = task->end;
+
+        while (job.chunksIn(first, last) > 1) {
+            const size_t total = job.chunksIn(first, last);
+            const size_t mid = first + (total - total / 2) * job.grain;
+
+            RangeTask* right = allocate(job, mid, last);
+            if (right == nullptr || !push(right)) {
+                // No room to queue more work; finish this range here
+                break;
+            }
+            last = mid;
+        }
+
+        job.runSequential(first, last);
+    }
+
+    // Bump allocation from the job's arena; one slot per split suffices
+    // because every split removes at least one chunk from the splitter.
+    static RangeTask* allocate(ParallelJob& job, size_t first, size_t last);
+
+    bool runRange(size_t self) {
+        if (RangeTask* task = findRange(self)) {
+            execute(task);
+            return true;
+        }
+        return false;
+    }
+
+    bool runQueuedTask() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(pool.queueMutex);
+            if (pool.tasks.empty()) {
+                return false;
+            }
+            task = std::move(pool.tasks.front());
+            pool.tasks.pop();
+        }
+        task();
+        return true;
+    }
+
+    bool runOne(size_t self) {
+        return runRange(self) || runQueuedTask();
+    }
+
+    // runOne() on a worker, counted as busy time while tracing
+    bool runOneTraced(size_t self) {
+        if (!Trace::enabled()) {
+            return runOne(self);
+        }
+        const uint64_t begin = Trace::now();
+        if (!runOne(self)) {
+            return false;
+        }
+        Trace::workerBusy(begin, Trace::now());
+        return true;
+    }
+};
+
+namespace {
+
+// Arena storage lives next to the job on the parallelFor caller's stack
+struct StealingJob : ParallelJob {
+    std::unique_ptr<RangeTask[]> arena;
+    std::atomic<size_t> arenaNext{0};
+};
+
+} // namespace
+
+RangeTask* ThreadPool::StealingState::allocate(ParallelJob& job, size_t first, size_t last) {
+    auto& owner = static_cast<StealingJob&>(job);
+    const size_t slot = owner.arenaNext.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= owner.chunks) {
+        return nullptr;
+    }
+    RangeTask* task = &owner.arena[slot];
+    task->job = &job;
+    task->begin = first;
+    task->end = last;
+    return task;
+}
+
+ThreadPool::ThreadPool(size_t numThreads, Scheduler scheduler)
+    : scheduler(scheduler)
+    , stop(false) {
+    if (scheduler == Scheduler::WorkStealing) {
+        stealing = std::make_unique<StealingState>(*this, numThreads);
+    }
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        if (scheduler == Scheduler::WorkStealing) {
+            workers.emplace_back([this, i] { stealingWorkerLoop(i); });
+        } else {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
     }
 }
 
@@ -31,7 +397,209 @@ ThreadPool::~ThreadPool() {
         stop = true;
     }
     condition.notify_all();
+    if (stealing) {
+        stealing->stopping.store(true, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(stealing->sleepMutex);
+        stealing->sleepCondition.notify_all();
+    }
     for (std::thread& worker : workers) {
         worker.join();
     }
 }
+
+namespace {
+
+// Workers of the shared pool for `threads` threads in total (0 = default)
+size_t sharedWorkerCount(size_t threads) {
+    if (threads == 0) {
+        if (const char* env = std::getenv("EZCODEC_THREADS")) {
+            threads = std::strtoul(env, nullptr, 10);
+        }
+    }
+    if (threads == 0) {
+        size_t hardwareThreads = std::thread::hardware_concurrency();
+        return hardwareThreads > 1 ? hardwareThreads - 1 : size_t{1};
+    }
+    return threads - 1;
+}
+
+std::unique_ptr<ThreadPool>& sharedPool() {
+    static std::unique_ptr<ThreadPool> pool =
+        std::make_unique<ThreadPool>(sharedWorkerCount(0), ThreadPool::Scheduler::WorkStealing);
+    return pool;
+}
+
+} // namespace
+
+ThreadPool& ThreadPool::shared() {
+    return *sharedPool();
+}
+
+void ThreadPool::setSharedThreads(size_t threads) {
+    std::unique_ptr<ThreadPool>& pool = sharedPool();
+    pool.reset();
+    pool = std::make_unique<ThreadPool>(sharedWorkerCount(threads), Scheduler::WorkStealing);
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    Trace::setThreadName("worker " + std::to_string(index));
+    while (true) {
+        std::function<void()> task;
+        size_t depth = 0;
+        {
+            std::unique_lock<std::mutex> lock(this->queueMutex);
+
+            this->condition.wait(lock, [this] {
+                return this->stop || !this->tasks.empty();
+            });
+
+            if (this->stop && this->tasks.empty())
+                return;
+
+            depth = this->tasks.size();
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+        }
+
+        if (Trace::enabled()) {
+            // Depth as this task leaves the queue, counting itself
+            Trace::queueDepth(static_cast<int64_t>(depth));
+            const uint64_t begin = Trace::now();
+            task();
+            Trace::workerBusy(begin, Trace::now());
+        } else {
+            task();
+        }
+    }
+}
+
+void ThreadPool::stealingWorkerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+    Trace::setThreadName("worker " + std::to_string(index));
+    StealingState& state = *stealing;
+
+    while (true) {
+        if (state.runOneTraced(index)) {
+            continue;
+        }
+
+        // Spin briefly before going to sleep; new ranges usually follow soon
+        bool found = false;
+        for (int spin = 0; spin < 64 && !found; spin++) {
+            std::this_thread::yield();
+            found = state.runOneTraced(index);
+        }
+        if (found) {
+            continue;
+        }
+
+        const uint64_t seen = state.epoch.load(std::memory_order_seq_cst);
+        if (state.runOneTraced(index)) {
+            continue;
+        }
+        if (state.stopping.load(std::memory_order_seq_cst)) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(state.sleepMutex);
+        state.sleepers.fetch_add(1, std::memory_order_seq_cst);
+        state.sleepCondition.wait(lock, [&] {
+            return state.stopping.load(std::memory_order_seq_cst) ||
+                   state.epoch.load(std::memory_order_seq_cst) != seen;
+        });
+        state.sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+void ThreadPool::post(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (stop) {
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+
+        if (!workers.empty()) {
+            tasks.emplace(std::move(task));
+        }
+    }
+    // Without workers nobody would take the task off the queue
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    if (stealing) {
+        stealing->signal();
+    } else {
+        condition.notify_one();
+    }
+}
+
+void ThreadPool::parallelForShared(const ParallelForRange& range) {
+    // Helper tasks can start after the caller has returned, so the job is
+    // reference counted; late helpers find no chunk left and exit.
+    auto job = std::make_shared<ParallelJob>();
+    job->begin = range.begin;
+    job->end = range.end;
+    job->grain = range.grain;
+    job->chunks = job->chunksIn(range.begin, range.end);
+    job->context = range.context;
+    job->invoke = range.invoke;
+    job->remaining.store(job->chunks, std::memory_order_relaxed);
+
+    auto runChunks = [](ParallelJob& j) {
+        while (true) {
+            const size_t chunk = j.nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= j.chunks) {
+                return;
+            }
+            const size_t chunkBegin = j.begin + chunk * j.grain;
+            j.run(chunkBegin, std::min(chunkBegin + j.grain, j.end));
+            j.finished(1);
+        }
+    };
+
+    const size_t helpers = std::min(workers.size(), job->chunks - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        post([job, runChunks] { runChunks(*job); });
+    }
+
+    runChunks(*job);
+    job->wait();
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void ThreadPool::parallelForStealing(const ParallelForRange& range) {
+    StealingState& state = *stealing;
+
+    StealingJob job;
+    job.begin = range.begin;
+    job.end = range.end;
+    job.grain = range.grain;
+    job.chunks = job.chunksIn(range.begin, range.end);
+    job.context = range.context;
+    job.invoke = range.invoke;
+    job.remaining.store(job.chunks, std::memory_order_relaxed);
+    job.arena = std::make_unique<RangeTask[]>(job.chunks);
+
+    // Work on the root range directly; its right halves go to this
+    // thread's deque (or the injection queue) for others to steal.
+    RangeTask* root = StealingState::allocate(job, range.begin, range.end);
+    state.execute(root);
+
+    // Help with any queued ranges until every chunk of this job is done
+    const size_t self = state.selfIndex();
+    while (job.remaining.load(std::memory_order_acquire) != 0) {
+        if (!state.runRange(self)) {
+            job.waitFor(std::chrono::microseconds(50));
+        }
+    }
+    job.wait();
+
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
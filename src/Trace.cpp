@@ -0,0 +1,353 @@
+#include "ezcodec/Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+enum class EventKind : uint8_t {
+    Stage,
+    WorkerTask,
+    QueueDepth
+};
+
+struct TraceEvent {
+    const char* name;
+    EventKind kind;
+    uint64_t begin;
+    uint64_t duration; // QueueDepth: the depth
+    std::string detail;
+};
+
+// Events of one thread. Only that thread appends; the mutex is there for
+// the reports, which may run while a worker finishes its last task.
+struct ThreadBuffer {
+    std::string name;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t busyNs = 0;
+    uint64_t tasks = 0;
+};
+
+struct Session {
+    std::mutex mutex;
+    // Buffers live until the process exits, so a thread can keep a plain
+    // pointer to its own even after start() clears them
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    uint64_t stopped = 0;
+    bool running = false;
+    std::atomic<uint64_t> counters[static_cast<size_t>(Trace::Counter::Count)] = {};
+};
+
+Session& session() {
+    static Session instance;
+    return instance;
+}
+
+thread_local std::string threadName;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& currentBuffer() {
+    if (threadBuffer == nullptr) {
+        Session& s = session();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->name = threadName.empty() ? "thread " + std::to_string(s.buffers.size() + 1) : threadName;
+        threadBuffer = buffer.get();
+        s.buffers.push_back(std::move(buffer));
+    }
+    return *threadBuffer;
+}
+
+void append(TraceEvent event) {
+    ThreadBuffer& buffer = currentBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(std::move(event));
+}
+
+// End of the session so far, in now() nanoseconds
+uint64_t sessionEnd() {
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.running ? Trace::now() : s.stopped;
+}
+
+void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':  out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+double milliseconds(uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+} // namespace
+
+void Trace::start() {
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto& buffer : s.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+        buffer->busyNs = 0;
+        buffer->tasks = 0;
+    }
+    for (auto& value : s.counters) {
+        value.store(0, std::memory_order_relaxed);
+    }
+    s.origin = std::chrono::steady_clock::now();
+    s.stopped = 0;
+    s.running = true;
+    active.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop() {
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.running) {
+        s.stopped = now();
+        s.running = false;
+    }
+    active.store(false, std::memory_order_relaxed);
+}
+
+uint64_t Trace::now() {
+    const auto elapsed = std::chrono::steady_clock::now() - session().origin;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void Trace::add(Counter counter, uint64_t value) {
+    session().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+void Trace::countFile(Counter counter, const std::string& path) {
+    if (!enabled()) {
+        return;
+    }
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if (!error) {
+        add(counter, static_cast<uint64_t>(size));
+    }
+}
+
+void Trace::record(const char* name, uint64_t begin, uint64_t end, const std::string& detail) {
+    append({name, EventKind::Stage, begin, end - begin, detail});
+}
+
+void Trace::workerBusy(uint64_t begin, uint64_t end) {
+    ThreadBuffer& buffer = currentBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({"pool.task", EventKind::WorkerTask, begin, end - begin, {}});
+    buffer.busyNs += end - begin;
+    buffer.tasks++;
+}
+
+void Trace::queueDepth(int64_t depth) {
+    append({"pool.queue", EventKind::QueueDepth, now(), static_cast<uint64_t>(std::max<int64_t>(depth, 0)), {}});
+}
+
+void Trace::setThreadName(const std::string& name) {
+    threadName = name;
+    if (threadBuffer != nullptr) {
+        std::lock_guard<std::mutex> lock(session().mutex);
+        threadBuffer->name = name;
+    }
+}
+
+uint64_t Trace::counter(Counter counter) {
+    return session().counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+std::vector<Trace::Stage> Trace::stages() {
+    // Ordered by first start time, which reads like the pipeline
+    std::map<std::string, std::pair<uint64_t, Stage>> byName;
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto& buffer : s.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        for (const TraceEvent& event : buffer->events) {
+            if (event.kind != EventKind::Stage) {
+                continue;
+            }
+            auto [it, inserted] = byName.try_emplace(event.name, event.begin, Stage{});
+            Stage& stage = it->second.second;
+            if (inserted) {
+                stage.name = event.name;
+            }
+            it->second.first = std::min(it->second.first, event.begin);
+            stage.calls++;
+            stage.totalNs += event.duration;
+            stage.maxNs = std::max(stage.maxNs, event.duration);
+        }
+    }
+
+    std::vector<std::pair<uint64_t, Stage>> ordered;
+    for (auto& entry : byName) {
+        ordered.push_back(std::move(entry.second));
+    }
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<Stage> result;
+    for (auto& entry : ordered) {
+        result.push_back(std::move(entry.second));
+    }
+    return result;
+}
+
+std::vector<Trace::Worker> Trace::workers() {
+    const uint64_t end = sessionEnd();
+    std::vector<Worker> result;
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto& buffer : s.buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        if (buffer->tasks == 0) {
+            continue;
+        }
+        Worker worker;
+        worker.name = buffer->name;
+        worker.busyNs = buffer->busyNs;
+        worker.idleNs = end > buffer->busyNs ? end - buffer->busyNs : 0;
+        worker.tasks = buffer->tasks;
+        result.push_back(worker);
+    }
+    return result;
+}
+
+void Trace::printStats(std::ostream& out) {
+    const uint64_t end = sessionEnd();
+    const std::vector<Stage> stageList = stages();
+    const std::vector<Worker> workerList = workers();
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+    out << "Trace: " << milliseconds(end) << " ms\n";
+
+    out << std::left << std::setw(28) << "Stage" << std::right << std::setw(8) << "calls"
+        << std::setw(12) << "total ms" << std::setw(12) << "mean ms" << std::setw(12) << "max ms" << "\n";
+    for (const Stage& stage : stageList) {
+        out << "  " << std::left << std::setw(26) << stage.name << std::right << std::setw(8) << stage.calls
+            << std::setw(12) << milliseconds(stage.totalNs)
+            << std::setw(12) << milliseconds(stage.totalNs / stage.calls)
+            << std::setw(12) << milliseconds(stage.maxNs) << "\n";
+    }
+
+    if (!workerList.empty()) {
+        out << std::left << std::setw(28) << "Worker" << std::right << std::setw(8) << "tasks"
+            << std::setw(12) << "busy ms" << std::setw(12) << "idle ms" << std::setw(12) << "busy %" << "\n";
+        for (const Worker& worker : workerList) {
+            const double busy = end > 0 ? 100.0 * static_cast<double>(worker.busyNs) / static_cast<double>(end) : 0.0;
+            out << "  " << std::left << std::setw(26) << worker.name << std::right << std::setw(8) << worker.tasks
+                << std::setw(12) << milliseconds(worker.busyNs) << std::setw(12) << milliseconds(worker.idleNs)
+                << std::setw(12) << busy << "\n";
+        }
+    }
+
+    uint64_t samples = 0;
+    uint64_t maxDepth = 0;
+    uint64_t depthSum = 0;
+    {
+        Session& s = session();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (auto& buffer : s.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            for (const TraceEvent& event : buffer->events) {
+                if (event.kind == EventKind::QueueDepth) {
+                    samples++;
+                    depthSum += event.duration;
+                    maxDepth = std::max(maxDepth, event.duration);
+                }
+            }
+        }
+    }
+    if (samples > 0) {
+        out << "Pool queue: " << samples << " ranges queued, depth max " << maxDepth << ", mean "
+            << static_cast<double>(depthSum) / static_cast<double>(samples) << "\n";
+    }
+
+    out << "Bytes read: " << counter(Counter::BytesRead)
+        << ", written: " << counter(Counter::BytesWritten) << "\n";
+    out << "Allocations: " << counter(Counter::Allocations) << " buffers, "
+        << static_cast<double>(counter(Counter::AllocatedBytes)) / (1024.0 * 1024.0) << " MiB" << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool Trace::writeChromeTrace(const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot write trace file: " << path << std::endl;
+        return false;
+    }
+
+    // Timestamps are microseconds; tid is the buffer's position
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ezcodec\"}}";
+
+    Session& s = session();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (size_t t = 0; t < s.buffers.size(); t++) {
+        ThreadBuffer& buffer = *s.buffers[t];
+        std::lock_guard<std::mutex> bufferLock(buffer.mutex);
+        const size_t tid = t + 1;
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+        writeJsonString(out, buffer.name);
+        out << "}}";
+
+        for (const TraceEvent& event : buffer.events) {
+            out << ",\n{\"name\":";
+            writeJsonString(out, event.name);
+            const double ts = static_cast<double>(event.begin) / 1e3;
+            if (event.kind == EventKind::QueueDepth) {
+                out << ",\"cat\":\"pool\",\"ph\":\"C\",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << tid
+                    << ",\"args\":{\"ranges\":" << event.duration << "}}";
+                continue;
+            }
+            out << ",\"cat\":\"" << (event.kind == EventKind::WorkerTask ? "pool" : "codec")
+                << "\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << static_cast<double>(event.duration) / 1e3
+                << ",\"pid\":1,\"tid\":" << tid;
+            if (!event.detail.empty()) {
+                out << ",\"args\":{\"detail\":";
+                writeJsonString(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        std::cerr << "Cannot write trace file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
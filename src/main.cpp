@@ -1,19 +1,109 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include "ezcodec/Codec.h"
+#include "ezcodec/Batch.h"
+#include "ezcodec/Trace.h"
 
 static void printUsage(const char* progName) {
     std::cout << "Usage:\n"
-              << "  " << progName << " encode -i <input.png> -o <output.ezc> [-q <quality>]\n"
-              << "  " << progName << " decode -i <input.ezc> -o <output.png>\n"
+              << "  " << progName << " encode -i <input.png> -o <output.ezc> [-q <quality>] [--fixed-point] [--slice-rows <n>]\n"
+              << "         [--target-size <bytes> | --target-bpp <bits>] [--chroma <gray|444|422|420>]\n"
+              << "         [--quant-table <table.txt>] [--adaptive-blocks] [--atomic] [--fsync] [--stream]\n"
+              << "  " << progName << " decode -i <input.ezc> -o <output.png> [--stream | --roi <x,y,w,h> | --scale <n>]\n"
+              << "  " << progName << " batch encode|decode -i <directory|list.txt> -o <output-directory> [--jobs <n>]\n"
+              << "         [encode options]\n"
+              << "  Every command also takes [--stats] [--trace <trace.json>]\n"
               << "  " << progName << " --help\n"
               << "  " << progName << " --version\n"
               << "\n"
               << "Options:\n"
               << "  -i, --input    Input file path (required)\n"
               << "  -o, --output   Output file path (required)\n"
-              << "  -q, --quality  Compression quality 1-100 (encode only, default: 50)\n";
+              << "  -q, --quality  Compression quality 1-100 (encode only, default: 50)\n"
+              << "  --target-size  Highest quality whose file fits in this many bytes, instead of -q\n"
+              << "                 (encode only)\n"
+              << "  --target-bpp   Highest quality whose file fits in this many bits per pixel (encode only)\n"
+              << "  --fixed-point  Integer-only transform; output is bit-exact on every host (encode only)\n"
+              << "  --slice-rows   Block rows per independently decodable slice, 0 = one bitstream\n"
+              << "                 (encode only, default: 16)\n"
+              << "  --chroma       gray codes luma only; 444, 422 and 420 code YCbCr with full, half-width\n"
+              << "                 or half-size chroma planes (encode only, default: gray)\n"
+              << "  --quant-table  Text file of 64 step sizes (luma) or 128 (luma, then chroma) in row-major\n"
+              << "                 order, replacing the JPEG tables; scaled by -q, used as given at 50\n"
+              << "                 (encode only)\n"
+              << "  --adaptive-blocks\n"
+              << "                 Pick 32x32, 16x16, 8x8 or 4x4 transforms per region by rate-distortion\n"
+              << "                 cost; smaller files for flat content (encode only; full decode only)\n"
+              << "  --atomic       Write to a temporary file and rename it over the output (encode only)\n"
+              << "  --fsync        Flush the output to disk before exiting (encode only)\n"
+              << "  --stream       Encode from / decode to an 8-bit binary PGM strip by strip, for images\n"
+              << "                 larger than memory (default slice rows: 1)\n"
+              << "  --roi          Decode only the crop rectangle x,y,w,h in pixels (decode only)\n"
+              << "  --scale        Decode at 1/n of the size, n = 1, 2, 4 or 8 (decode only)\n"
+              << "  --jobs         Images in flight at once (batch only, default: one per core)\n"
+              << "  --stats        Print time per stage, pool worker busy/idle time, queue depth,\n"
+              << "                 bytes read/written and buffer allocations when done\n"
+              << "  --trace        Write a Chrome trace-event timeline of the run (chrome://tracing,\n"
+              << "                 Perfetto)\n";
+}
+
+// Parses "gray", "444", "422" or "420"
+static bool parseChroma(const std::string& text, ChromaFormat& format) {
+    if (text == "gray") {
+        format = ChromaFormat::Gray;
+    } else if (text == "444") {
+        format = ChromaFormat::YCbCr444;
+    } else if (text == "422") {
+        format = ChromaFormat::YCbCr422;
+    } else if (text == "420") {
+        format = ChromaFormat::YCbCr420;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parses "x,y,w,h"
+static bool parseRegion(const std::string& text, Region& region) {
+    char trailing = 0;
+    return std::sscanf(text.c_str(), "%u,%u,%u,%u%c",
+                       &region.x, &region.y, &region.width, &region.height, &trailing) == 4;
+}
+
+// Reads whitespace-separated step sizes in [1, 32767]; '#' starts a comment
+static bool loadQuantTables(const std::string& path, std::vector<uint16_t>& steps) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open quantization table: " << path << std::endl;
+        return false;
+    }
+    steps.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string word;
+        while (words >> word) {
+            char* end = nullptr;
+            const long step = std::strtol(word.c_str(), &end, 10);
+            if (*end != '\0' || step < 1 || step > 32767) {
+                std::cerr << "Invalid step size in " << path << ": " << word << std::endl;
+                return false;
+            }
+            steps.push_back(static_cast<uint16_t>(step));
+        }
+    }
+    if (steps.size() != 64 && steps.size() != 128) {
+        std::cerr << "Quantization table " << path << " has " << steps.size()
+                  << " step sizes (expected 64 or 128)" << std::endl;
+        return false;
+    }
+    return true;
 }
 
 static void printVersion() {
@@ -37,27 +127,83 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    // "batch encode" and "batch decode" take the same options plus --jobs
+    const bool isBatch = (cmd == "batch");
+    const int firstOption = isBatch ? 3 : 2;
+    if (isBatch) {
+        cmd = argc > 2 ? argv[2] : "";
+    }
     bool isEncode = (cmd == "encode");
     bool isDecode = (cmd == "decode");
 
     if (!isEncode && !isDecode) {
-        std::cerr << "Unknown command: " << cmd << std::endl;
+        std::cerr << "Unknown command: " << (isBatch ? "batch " : "") << cmd << std::endl;
         printUsage(argv[0]);
         return 1;
     }
 
     std::string inputPath;
     std::string outputPath;
-    int quality = 50;
+    EncodeOptions options;
+    bool stream = false;
+    bool sliceRowsGiven = false;
+    bool qualityGiven = false;
+    bool hasRegion = false;
+    int scale = 1;
+    Region region;
+    BatchOptions batchOptions;
+    bool stats = false;
+    std::string tracePath;
 
-    for (int i = 2; i < argc; i++) {
+    for (int i = firstOption; i < argc; i++) {
         std::string arg = argv[i];
         if ((arg == "-i" || arg == "--input") && i + 1 < argc) {
             inputPath = argv[++i];
         } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
             outputPath = argv[++i];
         } else if ((arg == "-q" || arg == "--quality") && i + 1 < argc) {
-            quality = std::stoi(argv[++i]);
+            options.quality = std::stoi(argv[++i]);
+            qualityGiven = true;
+        } else if (arg == "--target-size" && i + 1 < argc) {
+            options.targetSize = std::stoull(argv[++i]);
+        } else if (arg == "--target-bpp" && i + 1 < argc) {
+            options.targetBpp = std::stod(argv[++i]);
+        } else if (arg == "--quant-table" && i + 1 < argc) {
+            if (!loadQuantTables(argv[++i], options.quantTables)) {
+                return 1;
+            }
+        } else if (arg == "--adaptive-blocks") {
+            options.adaptiveBlocks = true;
+        } else if (arg == "--fixed-point") {
+            options.fixedPoint = true;
+        } else if (arg == "--atomic") {
+            options.atomicWrite = true;
+        } else if (arg == "--fsync") {
+            options.sync = true;
+        } else if (arg == "--slice-rows" && i + 1 < argc) {
+            options.sliceRows = std::max(std::stoi(argv[++i]), 0);
+            sliceRowsGiven = true;
+        } else if (arg == "--chroma" && i + 1 < argc) {
+            if (!parseChroma(argv[++i], options.chroma)) {
+                std::cerr << "Invalid chroma format (expected gray, 444, 422 or 420): " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--roi" && i + 1 < argc) {
+            if (!parseRegion(argv[++i], region)) {
+                std::cerr << "Invalid region (expected x,y,w,h): " << argv[i] << std::endl;
+                return 1;
+            }
+            hasRegion = true;
+        } else if (arg == "--scale" && i + 1 < argc) {
+            scale = std::stoi(argv[++i]);
+        } else if (arg == "--jobs" && isBatch && i + 1 < argc) {
+            batchOptions.maxInFlight = static_cast<size_t>(std::max(std::stoi(argv[++i]), 0));
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
         } else {
             std::cerr << "Unknown argument: " << arg << std::endl;
             printUsage(argv[0]);
@@ -73,11 +219,67 @@ int main(int argc, char* argv[]) {
         std::cerr << "Missing required argument: -o <output>" << std::endl;
         return 1;
     }
+    const bool hasTarget = options.targetSize > 0 || options.targetBpp > 0.0;
+    if (hasTarget && (qualityGiven || (options.targetSize > 0 && options.targetBpp > 0.0))) {
+        std::cerr << "Use only one of -q, --target-size and --target-bpp" << std::endl;
+        return 1;
+    }
 
-    if (isEncode) {
-        quality = std::clamp(quality, 1, 100);
-        return encode(inputPath, outputPath, quality);
-    } else {
-        return decode(inputPath, outputPath);
+    const auto run = [&]() -> int {
+        if (isBatch) {
+            if (stream || hasRegion || scale != 1) {
+                std::cerr << "--stream, --roi and --scale cannot be used in batch mode" << std::endl;
+                return 1;
+            }
+            std::vector<std::string> inputs;
+            if (!collectBatchInputs(inputPath, isDecode, inputs)) {
+                return 1;
+            }
+            options.quality = std::clamp(options.quality, 1, 100);
+            batchOptions.encode = options;
+            return isEncode ? encodeBatch(inputs, outputPath, batchOptions)
+                            : decodeBatch(inputs, outputPath, batchOptions);
+        }
+
+        if (isEncode) {
+            options.quality = std::clamp(options.quality, 1, 100);
+            if (stream) {
+                // One 8-row block strip in memory at a time unless asked otherwise
+                if (!sliceRowsGiven) {
+                    options.sliceRows = 1;
+                }
+                return encodeStream(inputPath, outputPath, options);
+            }
+            return encode(inputPath, outputPath, options);
+        } else if (hasRegion + stream + (scale != 1) > 1) {
+            std::cerr << "Only one of --stream, --roi and --scale can be used" << std::endl;
+            return 1;
+        } else if (hasRegion) {
+            return decodeRegion(inputPath, outputPath, region);
+        } else if (scale != 1) {
+            return decodeScaled(inputPath, outputPath, scale);
+        } else {
+            return stream ? decodeStream(inputPath, outputPath) : decode(inputPath, outputPath);
+        }
+    };
+
+    if (!stats && tracePath.empty()) {
+        return run();
+    }
+
+    Trace::setThreadName("main");
+    Trace::start();
+    int result = run();
+    Trace::stop();
+    if (stats) {
+        Trace::printStats(std::cout);
+    }
+    if (!tracePath.empty()) {
+        if (!Trace::writeChromeTrace(tracePath)) {
+            result = 1;
+        } else {
+            std::cout << "Trace written to: " << tracePath << std::endl;
+        }
     }
+    return result;
 }
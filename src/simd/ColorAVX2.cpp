@@ -0,0 +1,172 @@
+#include "SimdKernels.h"
+
+#if defined(EZCODEC_HAVE_AVX2)
+
+#include <immintrin.h>
+
+namespace {
+
+// Same pshufb masks as ColorSSE41.cpp: 16 interleaved RGB pixels <-> one
+// vector per channel.
+alignas(16) const int8_t DEINTERLEAVE[3][3][16] = {
+    {{ 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13}},
+    {{ 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14}},
+    {{ 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15}}
+};
+
+alignas(16) const int8_t INTERLEAVE[3][3][16] = {
+    {{ 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+     {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+     {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1}},
+    {{-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+     { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+     {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1}},
+    {{-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+     {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+     {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15}}
+};
+
+inline __m128i loadMask(const int8_t* mask) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+inline __m128i gather(__m128i a, __m128i b, __m128i c, const int8_t (*masks)[16]) {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, loadMask(masks[0])),
+                                     _mm_shuffle_epi8(b, loadMask(masks[1]))),
+                        _mm_shuffle_epi8(c, loadMask(masks[2])));
+}
+
+inline __m256i weightPair(int even, int odd) {
+    return _mm256_set1_epi32(static_cast<int>((static_cast<uint32_t>(odd) << 16) |
+                                              (static_cast<uint32_t>(even) & 0xFFFF)));
+}
+
+// See weigh() in ColorSSE41.cpp; sixteen lanes. unpack and packs both work
+// per 128-bit lane, so the element order comes out unchanged.
+inline __m256i weigh(__m256i a, __m256i b, __m256i c, __m256i ab, __m256i c0, __m256i bias) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lo = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), ab),
+                                                         _mm256_madd_epi16(_mm256_unpacklo_epi16(c, zero), c0)),
+                                        bias);
+    const __m256i hi = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), ab),
+                                                         _mm256_madd_epi16(_mm256_unpackhi_epi16(c, zero), c0)),
+                                        bias);
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, 14), _mm256_srai_epi32(hi, 14));
+}
+
+// Sixteen 16-bit lanes -> sixteen bytes with unsigned saturation
+inline __m128i narrow(__m256i v) {
+    return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+void rgbToYCbCr(const uint8_t* rgb, uint8_t* y, uint8_t* cb, uint8_t* cr, size_t count) {
+    const __m256i lumaRG = weightPair(4899, 9617);
+    const __m256i lumaB = weightPair(1868, 0);
+    const __m256i blueRG = weightPair(-2765, -5427);
+    const __m256i blueB = weightPair(8192, 0);
+    const __m256i redRG = weightPair(8192, -6860);
+    const __m256i redB = weightPair(-1332, 0);
+    const __m256i lumaBias = _mm256_set1_epi32(1 << 13);
+    const __m256i chromaBias = _mm256_set1_epi32((128 << 14) + (1 << 13));
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i* src = reinterpret_cast<const __m128i*>(rgb + 3 * i);
+        const __m128i a = _mm_loadu_si128(src);
+        const __m128i b = _mm_loadu_si128(src + 1);
+        const __m128i c = _mm_loadu_si128(src + 2);
+        const __m256i r16 = _mm256_cvtepu8_epi16(gather(a, b, c, DEINTERLEAVE[0]));
+        const __m256i g16 = _mm256_cvtepu8_epi16(gather(a, b, c, DEINTERLEAVE[1]));
+        const __m256i b16 = _mm256_cvtepu8_epi16(gather(a, b, c, DEINTERLEAVE[2]));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i),
+                         narrow(weigh(r16, g16, b16, lumaRG, lumaB, lumaBias)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cb + i),
+                         narrow(weigh(r16, g16, b16, blueRG, blueB, chromaBias)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cr + i),
+                         narrow(weigh(r16, g16, b16, redRG, redB, chromaBias)));
+    }
+    simd::scalarColorKernels().rgbToYCbCr(rgb + 3 * i, y + i, cb + i, cr + i, count - i);
+}
+
+void yCbCrToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i center = _mm256_set1_epi16(128);
+    const __m256i redYV = weightPair(1 << 14, 22970);
+    const __m256i greenYU = weightPair(1 << 14, -5638);
+    const __m256i greenV = weightPair(-11700, 0);
+    const __m256i blueYU = weightPair(1 << 14, 29032);
+    const __m256i bias = _mm256_set1_epi32(1 << 13);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i y16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i)));
+        const __m256i u16 = _mm256_sub_epi16(
+            _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cb + i))), center);
+        const __m256i v16 = _mm256_sub_epi16(
+            _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cr + i))), center);
+
+        const __m128i r = narrow(weigh(y16, v16, zero, redYV, zero, bias));
+        const __m128i g = narrow(weigh(y16, u16, v16, greenYU, greenV, bias));
+        const __m128i b = narrow(weigh(y16, u16, zero, blueYU, zero, bias));
+
+        __m128i* dst = reinterpret_cast<__m128i*>(rgb + 3 * i);
+        _mm_storeu_si128(dst,     gather(r, g, b, INTERLEAVE[0]));
+        _mm_storeu_si128(dst + 1, gather(r, g, b, INTERLEAVE[1]));
+        _mm_storeu_si128(dst + 2, gather(r, g, b, INTERLEAVE[2]));
+    }
+    simd::scalarColorKernels().yCbCrToRgb(y + i, cb + i, cr + i, rgb + 3 * i, count - i);
+}
+
+// 3 * near + far for sixteen columns starting at `offset`
+inline __m256i columnSums(const uint8_t* nearRow, const uint8_t* farRow, size_t offset) {
+    const __m256i n = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nearRow + offset)));
+    const __m256i f = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(farRow + offset)));
+    return _mm256_add_epi16(_mm256_add_epi16(_mm256_add_epi16(n, n), n), f);
+}
+
+void upsampleRow2x(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst, size_t dstCount) {
+    const size_t count = (dstCount + 1) / 2;
+    if (count == 0) {
+        return;
+    }
+
+    const __m256i round = _mm256_set1_epi16(8);
+    size_t i = 1;
+    for (; i + 16 < count; i += 16) {
+        const __m256i left = columnSums(nearRow, farRow, i - 1);
+        const __m256i mid = columnSums(nearRow, farRow, i);
+        const __m256i right = columnSums(nearRow, farRow, i + 1);
+        const __m256i center = _mm256_add_epi16(_mm256_add_epi16(mid, mid), _mm256_add_epi16(mid, round));
+        const __m256i even = _mm256_srli_epi16(_mm256_add_epi16(center, left), 4);
+        const __m256i odd = _mm256_srli_epi16(_mm256_add_epi16(center, right), 4);
+        // In-lane unpack then in-lane pack keeps the interleaved order
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i),
+                            _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd),
+                                                _mm256_unpackhi_epi16(even, odd)));
+    }
+    simd::upsampleColumns2x(nearRow, farRow, dst, dstCount, 0, 1);
+    simd::upsampleColumns2x(nearRow, farRow, dst, dstCount, i, count);
+}
+
+} // namespace
+
+namespace simd {
+
+const ColorKernels& avx2ColorKernels() {
+    static const ColorKernels table = {
+        SimdLevel::AVX2, "avx2",
+        rgbToYCbCr, yCbCrToRgb, upsampleRow2x
+    };
+    return table;
+}
+
+} // namespace simd
+
+#endif
@@ -0,0 +1,185 @@
+#include "SimdKernels.h"
+
+#if defined(EZCODEC_HAVE_SSE41)
+
+#include <smmintrin.h>
+
+namespace {
+
+// pshufb masks splitting 16 interleaved RGB pixels (three vectors) into one
+// vector per channel: channel = shuffle(a, MASK[c][0]) | shuffle(b, MASK[c][1])
+// | shuffle(c, MASK[c][2]). -1 selects zero.
+alignas(16) const int8_t DEINTERLEAVE[3][3][16] = {
+    {{ 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13}},
+    {{ 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14}},
+    {{ 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15}}
+};
+
+// The inverse: output vector v = shuffle(r, MASK[v][0]) | shuffle(g, MASK[v][1])
+// | shuffle(b, MASK[v][2]).
+alignas(16) const int8_t INTERLEAVE[3][3][16] = {
+    {{ 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+     {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+     {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1}},
+    {{-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+     { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+     {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1}},
+    {{-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+     {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+     {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15}}
+};
+
+inline __m128i loadMask(const int8_t* mask) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+inline __m128i gather(__m128i a, __m128i b, __m128i c, const int8_t (*masks)[16]) {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, loadMask(masks[0])),
+                                     _mm_shuffle_epi8(b, loadMask(masks[1]))),
+                        _mm_shuffle_epi8(c, loadMask(masks[2])));
+}
+
+// Packs two 16-bit weights into the (even, odd) lanes madd multiplies with
+inline __m128i weightPair(int even, int odd) {
+    return _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(odd) << 16) |
+                                           (static_cast<uint32_t>(even) & 0xFFFF)));
+}
+
+// (wa * a + wb * b + wc * c + bias) >> 14 for eight 16-bit lanes, as 16-bit
+// values with signed saturation. ab holds (wa, wb), c0 holds (wc, 0).
+inline __m128i weigh(__m128i a, __m128i b, __m128i c, __m128i ab, __m128i c0, __m128i bias) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), ab),
+                                                   _mm_madd_epi16(_mm_unpacklo_epi16(c, zero), c0)),
+                                     bias);
+    const __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), ab),
+                                                   _mm_madd_epi16(_mm_unpackhi_epi16(c, zero), c0)),
+                                     bias);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, 14), _mm_srai_epi32(hi, 14));
+}
+
+void rgbToYCbCr(const uint8_t* rgb, uint8_t* y, uint8_t* cb, uint8_t* cr, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lumaRG = weightPair(4899, 9617);
+    const __m128i lumaB = weightPair(1868, 0);
+    const __m128i blueRG = weightPair(-2765, -5427);
+    const __m128i blueB = weightPair(8192, 0);
+    const __m128i redRG = weightPair(8192, -6860);
+    const __m128i redB = weightPair(-1332, 0);
+    const __m128i lumaBias = _mm_set1_epi32(1 << 13);
+    const __m128i chromaBias = _mm_set1_epi32((128 << 14) + (1 << 13));
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i* src = reinterpret_cast<const __m128i*>(rgb + 3 * i);
+        const __m128i a = _mm_loadu_si128(src);
+        const __m128i b = _mm_loadu_si128(src + 1);
+        const __m128i c = _mm_loadu_si128(src + 2);
+        const __m128i r8 = gather(a, b, c, DEINTERLEAVE[0]);
+        const __m128i g8 = gather(a, b, c, DEINTERLEAVE[1]);
+        const __m128i b8 = gather(a, b, c, DEINTERLEAVE[2]);
+
+        const __m128i rLo = _mm_cvtepu8_epi16(r8), rHi = _mm_unpackhi_epi8(r8, zero);
+        const __m128i gLo = _mm_cvtepu8_epi16(g8), gHi = _mm_unpackhi_epi8(g8, zero);
+        const __m128i bLo = _mm_cvtepu8_epi16(b8), bHi = _mm_unpackhi_epi8(b8, zero);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i),
+                         _mm_packus_epi16(weigh(rLo, gLo, bLo, lumaRG, lumaB, lumaBias),
+                                          weigh(rHi, gHi, bHi, lumaRG, lumaB, lumaBias)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cb + i),
+                         _mm_packus_epi16(weigh(rLo, gLo, bLo, blueRG, blueB, chromaBias),
+                                          weigh(rHi, gHi, bHi, blueRG, blueB, chromaBias)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cr + i),
+                         _mm_packus_epi16(weigh(rLo, gLo, bLo, redRG, redB, chromaBias),
+                                          weigh(rHi, gHi, bHi, redRG, redB, chromaBias)));
+    }
+    simd::scalarColorKernels().rgbToYCbCr(rgb + 3 * i, y + i, cb + i, cr + i, count - i);
+}
+
+void yCbCrToRgb(const uint8_t* y, const uint8_t* cb, const uint8_t* cr, uint8_t* rgb, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i center = _mm_set1_epi16(128);
+    const __m128i redYV = weightPair(1 << 14, 22970);
+    const __m128i greenYU = weightPair(1 << 14, -5638);
+    const __m128i greenV = weightPair(-11700, 0);
+    const __m128i blueYU = weightPair(1 << 14, 29032);
+    const __m128i bias = _mm_set1_epi32(1 << 13);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+        const __m128i u8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cb + i));
+        const __m128i v8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cr + i));
+
+        const __m128i yLo = _mm_cvtepu8_epi16(y8), yHi = _mm_unpackhi_epi8(y8, zero);
+        const __m128i uLo = _mm_sub_epi16(_mm_cvtepu8_epi16(u8), center);
+        const __m128i uHi = _mm_sub_epi16(_mm_unpackhi_epi8(u8, zero), center);
+        const __m128i vLo = _mm_sub_epi16(_mm_cvtepu8_epi16(v8), center);
+        const __m128i vHi = _mm_sub_epi16(_mm_unpackhi_epi8(v8, zero), center);
+
+        const __m128i r = _mm_packus_epi16(weigh(yLo, vLo, zero, redYV, zero, bias),
+                                           weigh(yHi, vHi, zero, redYV, zero, bias));
+        const __m128i g = _mm_packus_epi16(weigh(yLo, uLo, vLo, greenYU, greenV, bias),
+                                           weigh(yHi, uHi, vHi, greenYU, greenV, bias));
+        const __m128i b = _mm_packus_epi16(weigh(yLo, uLo, zero, blueYU, zero, bias),
+                                           weigh(yHi, uHi, zero, blueYU, zero, bias));
+
+        __m128i* dst = reinterpret_cast<__m128i*>(rgb + 3 * i);
+        _mm_storeu_si128(dst,     gather(r, g, b, INTERLEAVE[0]));
+        _mm_storeu_si128(dst + 1, gather(r, g, b, INTERLEAVE[1]));
+        _mm_storeu_si128(dst + 2, gather(r, g, b, INTERLEAVE[2]));
+    }
+    simd::scalarColorKernels().yCbCrToRgb(y + i, cb + i, cr + i, rgb + 3 * i, count - i);
+}
+
+// 3 * near + far for eight columns starting at `offset`
+inline __m128i columnSums(const uint8_t* nearRow, const uint8_t* farRow, size_t offset) {
+    const __m128i n = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(nearRow + offset)));
+    const __m128i f = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(farRow + offset)));
+    return _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(n, n), n), f);
+}
+
+void upsampleRow2x(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst, size_t dstCount) {
+    const size_t count = (dstCount + 1) / 2;
+    if (count == 0) {
+        return;
+    }
+
+    const __m128i round = _mm_set1_epi16(8);
+    size_t i = 1;
+    // Columns i - 1 .. i + 8 must exist, so the last one stays scalar
+    for (; i + 8 < count; i += 8) {
+        const __m128i left = columnSums(nearRow, farRow, i - 1);
+        const __m128i mid = columnSums(nearRow, farRow, i);
+        const __m128i right = columnSums(nearRow, farRow, i + 1);
+        const __m128i center = _mm_add_epi16(_mm_add_epi16(mid, mid), _mm_add_epi16(mid, round));
+        const __m128i even = _mm_srli_epi16(_mm_add_epi16(center, left), 4);
+        const __m128i odd = _mm_srli_epi16(_mm_add_epi16(center, right), 4);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i),
+                         _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd)));
+    }
+    simd::upsampleColumns2x(nearRow, farRow, dst, dstCount, 0, 1);
+    simd::upsampleColumns2x(nearRow, farRow, dst, dstCount, i, count);
+}
+
+} // namespace
+
+namespace simd {
+
+const ColorKernels& sse41ColorKernels() {
+    static const ColorKernels table = {
+        SimdLevel::SSE41, "sse4.1",
+        rgbToYCbCr, yCbCrToRgb, upsampleRow2x
+    };
+    return table;
+}
+
+} // namespace simd
+
+#endif
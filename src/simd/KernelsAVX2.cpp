@@ -0,0 +1,158 @@
+#include "SimdKernels.h"
+
+#if defined(EZCODEC_HAVE_AVX2)
+
+#include <immintrin.h>
+
+namespace {
+
+// out[r] = sum_k left[r][k] * right[k], over the first Terms values of k
+template<int Terms = 8>
+inline void multiply(const float* left, const __m256* right, __m256* out) {
+    for (int r = 0; r < 8; r++) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int k = 0; k < Terms; k++) {
+            acc = _mm256_fmadd_ps(_mm256_broadcast_ss(left + r * 8 + k), right[k], acc);
+        }
+        out[r] = acc;
+    }
+}
+
+inline void storeRowsTruncated(const __m256* rows, int16_t* dst) {
+    for (int r = 0; r < 8; r++) {
+        const __m256i v = _mm256_cvttps_epi32(rows[r]);
+        const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(v),
+                                               _mm256_extracti128_si256(v, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + r * 8), packed);
+    }
+}
+
+void forwardDCT(const uint16_t* src, int16_t* dst) {
+    const simd::FloatBasis8x8& basis = simd::floatBasis8x8();
+
+    __m256 pixels[8];
+    for (int r = 0; r < 8; r++) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + r * 8));
+        pixels[r] = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v));
+    }
+
+    // Columns: T = B * X, then rows: Y = T * B^T
+    __m256 temp[8];
+    multiply(basis.matrix, pixels, temp);
+    alignas(32) float tempScalar[64];
+    for (int r = 0; r < 8; r++) {
+        _mm256_store_ps(tempScalar + r * 8, temp[r]);
+    }
+
+    __m256 basisT[8];
+    for (int r = 0; r < 8; r++) {
+        basisT[r] = _mm256_load_ps(basis.transposed + r * 8);
+    }
+    __m256 result[8];
+    multiply(tempScalar, basisT, result);
+    storeRowsTruncated(result, dst);
+}
+
+void inverseDCT(const int16_t* src, int16_t* dst) {
+    const simd::FloatBasis8x8& basis = simd::floatBasis8x8();
+
+    __m256 coefficients[8];
+    for (int r = 0; r < 8; r++) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + r * 8));
+        coefficients[r] = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+    }
+
+    // Columns: T = B^T * Y, then rows: X = T * B
+    __m256 temp[8];
+    multiply(basis.transposed, coefficients, temp);
+    alignas(32) float tempScalar[64];
+    for (int r = 0; r < 8; r++) {
+        _mm256_store_ps(tempScalar + r * 8, temp[r]);
+    }
+
+    __m256 basisRows[8];
+    for (int r = 0; r < 8; r++) {
+        basisRows[r] = _mm256_load_ps(basis.matrix + r * 8);
+    }
+    __m256 result[8];
+    multiply(tempScalar, basisRows, result);
+    storeRowsTruncated(result, dst);
+}
+
+// inverseDCT() with the terms of the zero rows and columns left out. Those
+// terms only ever add zero, so the result is identical.
+void inverseDCTLowBand(const int16_t* src, int16_t* dst) {
+    const simd::FloatBasis8x8& basis = simd::floatBasis8x8();
+
+    __m256 coefficients[4];
+    for (int r = 0; r < 4; r++) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + r * 8));
+        coefficients[r] = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+    }
+
+    // Columns over the 4 non-zero coefficient rows: T = B^T * Y
+    __m256 temp[8];
+    multiply<4>(basis.transposed, coefficients, temp);
+    alignas(32) float tempScalar[64];
+    for (int r = 0; r < 8; r++) {
+        _mm256_store_ps(tempScalar + r * 8, temp[r]);
+    }
+
+    // Rows over the 4 non-zero columns of T: X = T * B
+    __m256 basisRows[4];
+    for (int r = 0; r < 4; r++) {
+        basisRows[r] = _mm256_load_ps(basis.matrix + r * 8);
+    }
+    __m256 result[8];
+    multiply<4>(tempScalar, basisRows, result);
+    storeRowsTruncated(result, dst);
+}
+
+// See quantize4 in KernelsSSE41.cpp for the reciprocal arithmetic.
+inline __m256i quantize8(__m256i s, __m256i q, __m256i r) {
+    const __m256i num = _mm256_add_epi32(_mm256_abs_epi32(s), _mm256_srli_epi32(q, 1));
+    const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(num, r), 31);
+    const __m256i odd = _mm256_slli_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(num, 32), _mm256_srli_epi64(r, 32)), 1);
+    return _mm256_sign_epi32(_mm256_blend_epi32(even, odd, 0xAA), s);
+}
+
+void quantize(const int16_t* src, int16_t* dst, const uint16_t* steps, const uint32_t* reciprocals) {
+    for (int i = 0; i < 64; i += 16) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(steps + i));
+        const __m256i rLo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reciprocals + i));
+        const __m256i rHi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reciprocals + i + 8));
+        const __m256i lo = quantize8(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(s)),
+                                     _mm256_cvtepu16_epi32(_mm256_castsi256_si128(q)), rLo);
+        const __m256i hi = quantize8(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1)),
+                                     _mm256_cvtepu16_epi32(_mm256_extracti128_si256(q, 1)), rHi);
+        // packs works per 128-bit lane; restore element order afterwards
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+}
+
+void dequantize(const int16_t* src, int16_t* dst, const uint16_t* steps) {
+    for (int i = 0; i < 64; i += 16) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(steps + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_mullo_epi16(s, q));
+    }
+}
+
+} // namespace
+
+namespace simd {
+
+const Kernels8x8& avx2Kernels() {
+    static const Kernels8x8 table = {
+        SimdLevel::AVX2, "avx2",
+        forwardDCT, inverseDCT, inverseDCTLowBand, quantize, dequantize
+    };
+    return table;
+}
+
+} // namespace simd
+
+#endif
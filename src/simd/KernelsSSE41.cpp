@@ -0,0 +1,172 @@
+#include "SimdKernels.h"
+
+#if defined(EZCODEC_HAVE_SSE41)
+
+#include <smmintrin.h>
+
+namespace {
+
+// 8-float rows are held as (lo, hi) pairs of __m128.
+struct Rows8x8 {
+    __m128 lo[8];
+    __m128 hi[8];
+};
+
+// out.row[r] = sum_k left[r][k] * right.row[k], over the first Terms values
+// of k
+template<int Terms = 8>
+inline void multiply(const float* left, const Rows8x8& right, Rows8x8& out) {
+    for (int r = 0; r < 8; r++) {
+        __m128 accLo = _mm_setzero_ps();
+        __m128 accHi = _mm_setzero_ps();
+        for (int k = 0; k < Terms; k++) {
+            const __m128 w = _mm_set1_ps(left[r * 8 + k]);
+            accLo = _mm_add_ps(accLo, _mm_mul_ps(w, right.lo[k]));
+            accHi = _mm_add_ps(accHi, _mm_mul_ps(w, right.hi[k]));
+        }
+        out.lo[r] = accLo;
+        out.hi[r] = accHi;
+    }
+}
+
+inline void loadConstRows(const float* matrix, Rows8x8& rows) {
+    for (int r = 0; r < 8; r++) {
+        rows.lo[r] = _mm_load_ps(matrix + r * 8);
+        rows.hi[r] = _mm_load_ps(matrix + r * 8 + 4);
+    }
+}
+
+inline void storeRows(const Rows8x8& rows, float* dst) {
+    for (int r = 0; r < 8; r++) {
+        _mm_store_ps(dst + r * 8, rows.lo[r]);
+        _mm_store_ps(dst + r * 8 + 4, rows.hi[r]);
+    }
+}
+
+inline void storeRowsTruncated(const Rows8x8& rows, int16_t* dst) {
+    for (int r = 0; r < 8; r++) {
+        const __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(rows.lo[r]),
+                                               _mm_cvttps_epi32(rows.hi[r]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + r * 8), packed);
+    }
+}
+
+void forwardDCT(const uint16_t* src, int16_t* dst) {
+    const simd::FloatBasis8x8& basis = simd::floatBasis8x8();
+
+    Rows8x8 pixels;
+    for (int r = 0; r < 8; r++) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + r * 8));
+        pixels.lo[r] = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(v));
+        pixels.hi[r] = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+    }
+
+    // Columns: T = B * X, then rows: Y = T * B^T
+    Rows8x8 temp;
+    multiply(basis.matrix, pixels, temp);
+    alignas(16) float tempScalar[64];
+    storeRows(temp, tempScalar);
+
+    Rows8x8 basisT;
+    loadConstRows(basis.transposed, basisT);
+    Rows8x8 result;
+    multiply(tempScalar, basisT, result);
+    storeRowsTruncated(result, dst);
+}
+
+void inverseDCT(const int16_t* src, int16_t* dst) {
+    const simd::FloatBasis8x8& basis = simd::floatBasis8x8();
+
+    Rows8x8 coefficients;
+    for (int r = 0; r < 8; r++) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + r * 8));
+        coefficients.lo[r] = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(v));
+        coefficients.hi[r] = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8)));
+    }
+
+    // Columns: T = B^T * Y, then rows: X = T * B
+    Rows8x8 temp;
+    multiply(basis.transposed, coefficients, temp);
+    alignas(16) float tempScalar[64];
+    storeRows(temp, tempScalar);
+
+    Rows8x8 basisRows;
+    loadConstRows(basis.matrix, basisRows);
+    Rows8x8 result;
+    multiply(tempScalar, basisRows, result);
+    storeRowsTruncated(result, dst);
+}
+
+// inverseDCT() with the terms of the zero rows and columns left out. Those
+// terms only ever add zero, so the result is identical.
+void inverseDCTLowBand(const int16_t* src, int16_t* dst) {
+    const simd::FloatBasis8x8& basis = simd::floatBasis8x8();
+
+    Rows8x8 coefficients;
+    for (int r = 0; r < 4; r++) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + r * 8));
+        coefficients.lo[r] = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(v));
+        coefficients.hi[r] = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8)));
+    }
+
+    // Columns over the 4 non-zero coefficient rows: T = B^T * Y
+    Rows8x8 temp;
+    multiply<4>(basis.transposed, coefficients, temp);
+    alignas(16) float tempScalar[64];
+    storeRows(temp, tempScalar);
+
+    // Rows over the 4 non-zero columns of T: X = T * B
+    Rows8x8 basisRows;
+    loadConstRows(basis.matrix, basisRows);
+    Rows8x8 result;
+    multiply<4>(tempScalar, basisRows, result);
+    storeRowsTruncated(result, dst);
+}
+
+// sign(s) * ((|s| + q/2) * r >> 31) with r = ceil(2^31 / q) from a
+// QuantTable, which equals the integer quotient (|s| + q/2) / q. The
+// 47-bit products are formed for the even and odd lanes separately.
+inline __m128i quantize4(__m128i s, __m128i q, __m128i r) {
+    const __m128i num = _mm_add_epi32(_mm_abs_epi32(s), _mm_srli_epi32(q, 1));
+    const __m128i even = _mm_srli_epi64(_mm_mul_epu32(num, r), 31);
+    // Odd lanes: product << 1 puts the quotient in the high 32 bits
+    const __m128i odd = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(num, 32), _mm_srli_epi64(r, 32)), 1);
+    return _mm_sign_epi32(_mm_blend_epi16(even, odd, 0xCC), s);
+}
+
+void quantize(const int16_t* src, int16_t* dst, const uint16_t* steps, const uint32_t* reciprocals) {
+    for (int i = 0; i < 64; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(steps + i));
+        const __m128i rLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reciprocals + i));
+        const __m128i rHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reciprocals + i + 4));
+        const __m128i lo = quantize4(_mm_cvtepi16_epi32(s), _mm_cvtepu16_epi32(q), rLo);
+        const __m128i hi = quantize4(_mm_cvtepi16_epi32(_mm_srli_si128(s, 8)),
+                                     _mm_cvtepu16_epi32(_mm_srli_si128(q, 8)), rHi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+}
+
+void dequantize(const int16_t* src, int16_t* dst, const uint16_t* steps) {
+    for (int i = 0; i < 64; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(steps + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_mullo_epi16(s, q));
+    }
+}
+
+} // namespace
+
+namespace simd {
+
+const Kernels8x8& sse41Kernels() {
+    static const Kernels8x8 table = {
+        SimdLevel::SSE41, "sse4.1",
+        forwardDCT, inverseDCT, inverseDCTLowBand, quantize, dequantize
+    };
+    return table;
+}
+
+} // namespace simd
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+// Per-ISA kernel tables. Each table lives in its own translation unit so it
+// can be compiled with the matching -m flags; only kernels8x8() decides
+// which one runs.
+
+#include "ezcodec/Kernels.h"
+#include "ezcodec/ColorConversion.h"
+
+namespace simd {
+
+const Kernels8x8& scalarKernels();
+#if defined(EZCODEC_HAVE_SSE41)
+const Kernels8x8& sse41Kernels();
+#endif
+#if defined(EZCODEC_HAVE_AVX2)
+const Kernels8x8& avx2Kernels();
+#endif
+
+const ColorKernels& scalarColorKernels();
+#if defined(EZCODEC_HAVE_SSE41)
+const ColorKernels& sse41ColorKernels();
+#endif
+#if defined(EZCODEC_HAVE_AVX2)
+const ColorKernels& avx2ColorKernels();
+#endif
+
+// Scalar upsampleRow2x() restricted to the source columns [first, last).
+// Defined in ColorConversion.cpp; the vector kernels use it for the row
+// edges, which need repeated samples.
+void upsampleColumns2x(const uint8_t* nearRow, const uint8_t* farRow, uint8_t* dst,
+                       size_t dstCount, size_t first, size_t last);
+
+// 8x8 DCT basis and its transpose in single precision for the vector kernels.
+struct FloatBasis8x8 {
+    alignas(32) float matrix[64];
+    alignas(32) float transposed[64];
+};
+
+// Defined in Kernels.cpp. Shared code must not be inline in this header:
+// an inline function compiled into an -mavx2 unit could be the copy the
+// linker keeps and then run on a CPU without AVX2.
+const FloatBasis8x8& floatBasis8x8();
+
+} // namespace simd
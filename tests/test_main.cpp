@@ -3,14 +3,31 @@
 #include <chrono>
 #include <thread>
 #include <cstring>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iterator>
+#include <sstream>
 
 #include "ezcodec/Picture.h"
 #include "ezcodec/Block.h"
+#include "ezcodec/BlockPartition.h"
 #include "ezcodec/DCT.h"
 #include "ezcodec/Quantization.h"
 #include "ezcodec/ThreadPool.h"
 #include "ezcodec/EzcFormat.h"
+#include "ezcodec/EntropyCoding.h"
 #include "ezcodec/Codec.h"
+#include "ezcodec/Batch.h"
+#include "ezcodec/Kernels.h"
+#include "ezcodec/ColorConversion.h"
+#include "ezcodec/Trace.h"
+
+static constexpr uint32_t FIXED_POINT_GOLDEN_CHECKSUM = 3368724161u;
 
 static int testsPassed = 0;
 static int testsFailed = 0;
@@ -39,6 +56,84 @@ static void testBlockCreation() {
     testsPassed++;
 }
 
+static void testBlockPlane() {
+    std::cout << "  BlockPlane storage... ";
+    BlockPlane8x8i16 plane(3, 2);
+    ASSERT_TRUE(plane.size() == 6, "Plane should hold blockCountX * blockCountY blocks");
+    ASSERT_TRUE(reinterpret_cast<uintptr_t>(plane.data()) % BlockPlane8x8i16::alignment == 0,
+                "Plane storage should be aligned");
+
+    auto block = plane.at(2, 1);
+    ASSERT_TRUE(block.getBlockX() == 2 && block.getBlockY() == 1, "View should know its block position");
+    ASSERT_TRUE(block[0] == 0, "Plane should be zero-initialized");
+
+    block.at(3, 4) = 42;
+    ASSERT_TRUE(plane[5][3 * 8 + 4] == 42, "Views should alias the plane storage");
+    ASSERT_TRUE(plane.data()[5 * 64 + 3 * 8 + 4] == 42, "Blocks should be stored contiguously in raster order");
+
+    // Transforms work directly on views
+    BlockPlane8x8ui16 pixels(1, 1);
+    pixels[0].fill(128);
+    DCT::forwardDCT(pixels[0], plane[0]);
+    ASSERT_TRUE(plane[0][0] == 1024 && plane[0][1] == 0, "DCT of a flat view should be DC only");
+
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testStridedBlockView() {
+    std::cout << "  Strided block views... ";
+    // 19x11 image: one interior block, partial blocks on the right and
+    // bottom borders
+    const int width = 19;
+    const int height = 11;
+    const std::string inputFile = "test_view_input.pgm";
+    {
+        std::ofstream out(inputFile, std::ios::binary);
+        out << "P5\n" << width << " " << height << "\n255\n";
+        for (int i = 0; i < width * height; i++) {
+            out.put(static_cast<char>(i % 251));
+        }
+    }
+    Picture picture(inputFile.c_str());
+    ASSERT_TRUE(picture.isValid() && picture.blockCountX() == 3 && picture.blockCountY() == 2,
+                "Picture should have a 3x2 block grid");
+
+    // Views read the loaded pixels in place
+    const auto interior = picture.blockView(1, 0);
+    ASSERT_TRUE(!interior.isBorder() && interior.at(2, 3) == picture.getData()[2 * width + 8 + 3],
+                "Interior views should read the image directly");
+
+    // Border views repeat the last column and row
+    const auto corner = picture.blockView(2, 1);
+    ASSERT_TRUE(corner.isBorder(), "The corner block should be a border block");
+    const unsigned char last = picture.getData()[(height - 1) * width + width - 1];
+    ASSERT_TRUE(corner.at(2, 2) == last && corner.at(7, 7) == last, "Border views should replicate the edge");
+    ASSERT_TRUE(corner.at(0, 5) == picture.getData()[8 * width + width - 1], "Rows should replicate their last column");
+
+    // Copies and transforms see the same values
+    const BlockPlane8x8ui16 blocks = picture.splitIntoBlocks<uint16_t, TxSize::TX_8x8>();
+    uint16_t samples[64];
+    Block8x8d fromView(2, 1);
+    Block8x8d fromCopy(2, 1);
+    for (int b = 0; b < 6; b++) {
+        picture.blockView(b % 3, b / 3).copyTo(samples);
+        for (int i = 0; i < 64; i++) {
+            ASSERT_TRUE(samples[i] == blocks[b][i] && samples[i] == picture.blockView(b % 3, b / 3)[i],
+                        "copyTo(), operator[] and splitIntoBlocks() should agree");
+        }
+    }
+    DCT::forwardDCT(corner, fromView);
+    DCT::forwardDCT(blocks[5], fromCopy);
+    for (int i = 0; i < 64; i++) {
+        ASSERT_TRUE(fromView[i] == fromCopy[i], "The DCT should read views like blocks");
+    }
+
+    std::remove(inputFile.c_str());
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
 static void testDCTRoundTrip() {
     std::cout << "  DCT round-trip... ";
     Block8x8ui16 original(0, 0);
@@ -69,6 +164,185 @@ static void testDCTRoundTrip() {
     testsPassed++;
 }
 
+static void testFastDCTMatchesReference() {
+    std::cout << "  Fast 8x8 DCT vs reference... ";
+    uint32_t seed = 12345;
+    int maxForwardDiff = 0;
+    int maxInverseDiff = 0;
+
+    for (int trial = 0; trial < 50; trial++) {
+        Block8x8ui16 pixels(0, 0);
+        for (size_t i = 0; i < 64; i++) {
+            seed = seed * 1103515245u + 12345u;
+            pixels[i] = static_cast<uint16_t>((seed >> 16) % 256);
+        }
+
+        Block8x8i16 fast(0, 0);
+        Block8x8i16 reference(0, 0);
+        DCT::forwardDCT(pixels, fast);
+        DCT::referenceForwardDCT(pixels, reference);
+        for (size_t i = 0; i < 64; i++) {
+            maxForwardDiff = std::max(maxForwardDiff, std::abs(fast[i] - reference[i]));
+        }
+
+        Block8x8i16 fastPixels(0, 0);
+        Block8x8i16 referencePixels(0, 0);
+        DCT::inverseDCT(reference, fastPixels);
+        DCT::referenceInverseDCT(reference, referencePixels);
+        for (size_t i = 0; i < 64; i++) {
+            maxInverseDiff = std::max(maxInverseDiff, std::abs(fastPixels[i] - referencePixels[i]));
+        }
+    }
+
+    ASSERT_TRUE(maxForwardDiff <= 1, "Fast forward DCT should be within 1 of the reference");
+    ASSERT_TRUE(maxInverseDiff <= 1, "Fast inverse DCT should be within 1 of the reference");
+    std::cout << "PASS (max diff: " << maxForwardDiff << "/" << maxInverseDiff << ")" << std::endl;
+    testsPassed++;
+}
+
+template<TxSize Size>
+static int maxSeparableDCTDiff() {
+    constexpr size_t count = getTxElementCount(Size);
+    uint32_t seed = 777;
+    Block<uint16_t, Size> pixels(0, 0);
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        pixels[i] = static_cast<uint16_t>((seed >> 16) % 256);
+    }
+
+    Block<int16_t, Size> fast(0, 0);
+    Block<int16_t, Size> reference(0, 0);
+    DCT::forwardDCT(pixels, fast);
+    DCT::referenceForwardDCT(pixels, reference);
+
+    Block<int16_t, Size> fastPixels(0, 0);
+    Block<int16_t, Size> referencePixels(0, 0);
+    DCT::inverseDCT(reference, fastPixels);
+    DCT::referenceInverseDCT(reference, referencePixels);
+
+    int maxDiff = 0;
+    for (size_t i = 0; i < count; i++) {
+        maxDiff = std::max(maxDiff, std::abs(fast[i] - reference[i]));
+        maxDiff = std::max(maxDiff, std::abs(fastPixels[i] - referencePixels[i]));
+    }
+    return maxDiff;
+}
+
+static void testSeparableDCTAllSizes() {
+    std::cout << "  Separable DCT (4/16/32) vs reference... ";
+
+    using Basis16 = DCTBasis<TxSize::TX_16x16>;
+    double maxBasisError = 0.0;
+    for (int k = 0; k < 16; k++) {
+        for (int n = 0; n < 16; n++) {
+            double expected = (k == 0 ? std::sqrt(1.0 / 16) : std::sqrt(2.0 / 16)) *
+                              std::cos((2 * n + 1) * k * 3.14159265358979323846 / 32.0);
+            maxBasisError = std::max(maxBasisError, std::abs(Basis16::matrix[k * 16 + n] - expected));
+        }
+    }
+    ASSERT_TRUE(maxBasisError < 1e-12, "constexpr basis should match std::cos");
+
+    ASSERT_TRUE(maxSeparableDCTDiff<TxSize::TX_4x4>() <= 1, "4x4 separable DCT should be within 1 of the reference");
+    ASSERT_TRUE(maxSeparableDCTDiff<TxSize::TX_16x16>() <= 1, "16x16 separable DCT should be within 1 of the reference");
+    ASSERT_TRUE(maxSeparableDCTDiff<TxSize::TX_32x32>() <= 1, "32x32 separable DCT should be within 1 of the reference");
+
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testFoldedQuantization() {
+    std::cout << "  Folded AAN quantization... ";
+    Block8x8ui16 pixels(0, 0);
+    for (size_t i = 0; i < 64; i++) {
+        pixels[i] = static_cast<uint16_t>((i * 37) % 256);
+    }
+
+    const int quality = 75;
+    Block8x8i16 coefficients(0, 0);
+    Block8x8i16 expected(0, 0);
+    DCT::forwardDCT(pixels, coefficients);
+    Quantization::quantize(coefficients, expected, quality);
+
+    double in[64];
+    double raw[64];
+    for (size_t i = 0; i < 64; i++) {
+        in[i] = pixels[i];
+    }
+    DCT::forwardDCT8x8Raw(in, raw);
+
+    Block8x8i16 folded(0, 0);
+    Quantization::quantizeFolded(raw, folded, Quantization::makeFoldedQuantTable(quality));
+    for (size_t i = 0; i < 64; i++) {
+        ASSERT_TRUE(std::abs(folded[i] - expected[i]) <= 1, "Folded quantization should match within 1");
+    }
+
+    double prescaled[64];
+    double restored[64];
+    Quantization::dequantizeFolded(folded, prescaled, Quantization::makeFoldedDequantTable(quality));
+    DCT::inverseDCT8x8Prescaled(prescaled, restored);
+
+    Block8x8i16 dequantized(0, 0);
+    Block8x8i16 reference(0, 0);
+    Quantization::dequantize(folded, dequantized, quality);
+    DCT::referenceInverseDCT(dequantized, reference);
+    for (size_t i = 0; i < 64; i++) {
+        ASSERT_TRUE(std::abs(static_cast<int>(restored[i]) - reference[i]) <= 1,
+                    "Folded dequantization + IDCT should match the reference within 1");
+    }
+
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testFixedPointDCT() {
+    std::cout << "  Fixed-point 8x8 DCT... ";
+    uint32_t seed = 99;
+    uint32_t checksum = 0;
+    int maxForwardDiff = 0;
+    int maxInverseDiff = 0;
+
+    for (int trial = 0; trial < 50; trial++) {
+        uint16_t pixels[64];
+        double in[64];
+        for (int i = 0; i < 64; i++) {
+            seed = seed * 1103515245u + 12345u;
+            pixels[i] = static_cast<uint16_t>((seed >> 16) % 256);
+            in[i] = pixels[i];
+        }
+
+        int16_t coefficients[64];
+        double expected[64];
+        DCT::forwardDCT8x8Fixed(pixels, coefficients);
+        DCT::forwardDCT8x8(in, expected);
+        for (int i = 0; i < 64; i++) {
+            maxForwardDiff = std::max(maxForwardDiff,
+                                      static_cast<int>(std::abs(coefficients[i] - std::round(expected[i]))));
+        }
+
+        int16_t restored[64];
+        double coefficientsIn[64];
+        double restoredExpected[64];
+        DCT::inverseDCT8x8Fixed(coefficients, restored);
+        for (int i = 0; i < 64; i++) {
+            coefficientsIn[i] = coefficients[i];
+        }
+        DCT::inverseDCT8x8(coefficientsIn, restoredExpected);
+        for (int i = 0; i < 64; i++) {
+            maxInverseDiff = std::max(maxInverseDiff,
+                                      static_cast<int>(std::abs(restored[i] - std::round(restoredExpected[i]))));
+            checksum = checksum * 31u + static_cast<uint16_t>(coefficients[i]);
+            checksum = checksum * 31u + static_cast<uint16_t>(restored[i]);
+        }
+    }
+
+    ASSERT_TRUE(maxForwardDiff <= 1, "Fixed-point forward DCT should be within 1 of the float transform");
+    ASSERT_TRUE(maxInverseDiff <= 1, "Fixed-point inverse DCT should be within 1 of the float transform");
+    // Golden value: any change to the fixed-point arithmetic changes the bitstream.
+    ASSERT_TRUE(checksum == FIXED_POINT_GOLDEN_CHECKSUM, "Fixed-point DCT output should be bit-exact");
+    std::cout << "PASS (max diff: " << maxForwardDiff << "/" << maxInverseDiff << ")" << std::endl;
+    testsPassed++;
+}
+
 static void testQuantizationRoundTrip() {
     std::cout << "  Quantization round-trip... ";
     Block8x8i16 original(0, 0);
@@ -98,53 +372,1430 @@ static void testQuantizationRoundTrip() {
     testsPassed++;
 }
 
+static void testChromaStepTable() {
+    std::cout << "  Chroma step table... ";
+    // Quality 50 uses the base tables unscaled
+    const auto luma = Quantization::makeStepTable(50);
+    const auto chroma = Quantization::makeStepTable(50, Quantization::Component::Chroma);
+    for (int i = 0; i < 64; i++) {
+        ASSERT_TRUE(luma[i] == Quantization::JPEG_LUMINANCE_QUANTIZATION_TABLE[i], "Luma steps should be the luminance table");
+        ASSERT_TRUE(chroma[i] == Quantization::JPEG_CHROMINANCE_QUANTIZATION_TABLE[i], "Chroma steps should be the chrominance table");
+    }
+
+    // Quality scaling applies to both tables alike
+    const auto fine = Quantization::makeStepTable(90, Quantization::Component::Chroma);
+    ASSERT_TRUE(fine[0] == 3 && fine[63] == 20, "Chroma steps should scale with quality");
+
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testQuantTable() {
+    std::cout << "  Reciprocal quantization table... ";
+    // The multiply-and-shift quotient equals the division for every int16_t
+    // input, over small steps and a spread of large ones up to the maximum
+    std::vector<int> steps;
+    for (int step = 1; step <= 256; step++) {
+        steps.push_back(step);
+    }
+    for (int step = 257; step < QuantTable::MAX_STEP; step = step * 5 / 4 + 1) {
+        steps.push_back(step);
+    }
+    steps.push_back(QuantTable::MAX_STEP);
+    for (int step : steps) {
+        QuantTable::Steps stepTable{};
+        stepTable.fill(static_cast<uint16_t>(step));
+        const QuantTable table(stepTable);
+        for (int value = -32768; value <= 32767; value++) {
+            const int expected = (value >= 0) ? (value + step / 2) / step : (value - step / 2) / step;
+            ASSERT_TRUE(table.quantize(value, 0) == static_cast<int16_t>(expected),
+                        "Reciprocal quantization should equal the division");
+        }
+    }
+
+    // Out-of-range steps are clamped; quality tables are the step tables
+    QuantTable::Steps zero{};
+    ASSERT_TRUE(QuantTable(zero).steps()[0] == 1, "Zero steps should be clamped to 1");
+    const QuantTable jpeg = Quantization::makeQuantTable(75, Quantization::Component::Chroma);
+    ASSERT_TRUE(jpeg.steps() == Quantization::makeStepTable(75, Quantization::Component::Chroma),
+                "Quality tables should hold the quality-scaled steps");
+
+    // A custom base table scales like the JPEG ones and is unchanged at 50
+    QuantTable::Steps base{};
+    for (size_t i = 0; i < 64; i++) {
+        base[i] = static_cast<uint16_t>(Quantization::JPEG_LUMINANCE_QUANTIZATION_TABLE[i]);
+    }
+    ASSERT_TRUE(Quantization::makeQuantTable(50, base).steps() == base, "Quality 50 should keep a custom table");
+    ASSERT_TRUE(Quantization::makeQuantTable(20, base) == Quantization::makeQuantTable(20),
+                "A custom copy of the JPEG table should scale like it");
+
+    // Every kernel agrees with the block template, extremes included
+    QuantTable::Steps mixed{};
+    for (size_t i = 0; i < 64; i++) {
+        mixed[i] = static_cast<uint16_t>(i % 4 == 0 ? 1 : (i % 4 == 1 ? QuantTable::MAX_STEP : 3 + i * 97));
+    }
+    const QuantTable table(mixed);
+    Block8x8i16 coefficients(0, 0);
+    for (size_t i = 0; i < 64; i++) {
+        coefficients[i] = static_cast<int16_t>(i % 3 == 0 ? -32768 : (i % 3 == 1 ? 32767 : i * 331 - 9000));
+    }
+    Block8x8i16 expected(0, 0);
+    Quantization::quantize(coefficients, expected, table);
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2 }) {
+        const Kernels8x8* kernels = kernels8x8For(level);
+        if (kernels == nullptr) {
+            continue;
+        }
+        int16_t actual[64];
+        kernels->quantize(coefficients.getData(), actual, table.steps().data(), table.reciprocals());
+        ASSERT_TRUE(std::memcmp(expected.getData(), actual, sizeof(actual)) == 0,
+                    "Quantize kernels should match the block template");
+    }
+
+    std::cout << "PASS (" << steps.size() << " step sizes)" << std::endl;
+    testsPassed++;
+}
+
+static void testSimdKernelsMatchScalar() {
+    std::cout << "  SIMD kernels vs scalar... ";
+    const Kernels8x8* scalar = kernels8x8For(SimdLevel::Scalar);
+    ASSERT_TRUE(scalar != nullptr, "Scalar kernels should always be available");
+
+    const QuantTable table = Quantization::makeQuantTable(80);
+    const auto& steps = table.steps();
+    int variantsChecked = 0;
+
+    for (SimdLevel level : { SimdLevel::SSE41, SimdLevel::AVX2 }) {
+        const Kernels8x8* simd = kernels8x8For(level);
+        if (simd == nullptr) {
+            continue;
+        }
+
+        uint32_t seed = 4242;
+        for (int trial = 0; trial < 200; trial++) {
+            uint16_t pixels[64];
+            int16_t coefficients[64];
+            for (int i = 0; i < 64; i++) {
+                seed = seed * 1103515245u + 12345u;
+                pixels[i] = static_cast<uint16_t>((seed >> 16) % 256);
+                coefficients[i] = static_cast<int16_t>(static_cast<int>((seed >> 8) % 2048) - 1024);
+            }
+
+            int16_t expected[64];
+            int16_t actual[64];
+
+            scalar->forwardDCT(pixels, expected);
+            simd->forwardDCT(pixels, actual);
+            for (int i = 0; i < 64; i++) {
+                ASSERT_TRUE(std::abs(expected[i] - actual[i]) <= 1, "SIMD forward DCT should be within 1 of scalar");
+            }
+
+            scalar->inverseDCT(coefficients, expected);
+            simd->inverseDCT(coefficients, actual);
+            for (int i = 0; i < 64; i++) {
+                ASSERT_TRUE(std::abs(expected[i] - actual[i]) <= 1, "SIMD inverse DCT should be within 1 of scalar");
+            }
+
+            scalar->quantize(coefficients, expected, steps.data(), table.reciprocals());
+            simd->quantize(coefficients, actual, steps.data(), table.reciprocals());
+            ASSERT_TRUE(std::memcmp(expected, actual, sizeof(expected)) == 0, "SIMD quantize should match scalar exactly");
+
+            scalar->dequantize(expected, coefficients, steps.data());
+            simd->dequantize(expected, actual, steps.data());
+            ASSERT_TRUE(std::memcmp(coefficients, actual, sizeof(actual)) == 0, "SIMD dequantize should match scalar exactly");
+        }
+        variantsChecked++;
+    }
+
+    std::cout << "PASS (" << variantsChecked << " SIMD variants, selected: "
+              << kernels8x8().name << ")" << std::endl;
+    testsPassed++;
+}
+
+static void testColorKernelsMatchScalar() {
+    std::cout << "  Color kernels vs scalar... ";
+    const ColorKernels* scalar = colorKernelsFor(SimdLevel::Scalar);
+    ASSERT_TRUE(scalar != nullptr, "Scalar color kernels should always be available");
+
+    // Gray pixels map to neutral chroma and back unchanged
+    for (int v = 0; v < 256; v++) {
+        const uint8_t rgb[3] = { static_cast<uint8_t>(v), static_cast<uint8_t>(v), static_cast<uint8_t>(v) };
+        uint8_t y = 0, cb = 0, cr = 0;
+        uint8_t back[3] = {};
+        scalar->rgbToYCbCr(rgb, &y, &cb, &cr, 1);
+        ASSERT_TRUE(y == v && cb == 128 && cr == 128, "Gray should convert to Y = value, Cb = Cr = 128");
+        scalar->yCbCrToRgb(&y, &cb, &cr, back, 1);
+        ASSERT_TRUE(std::memcmp(rgb, back, 3) == 0, "Gray should convert back exactly");
+    }
+
+    // Upsampling a constant row keeps it constant
+    const std::vector<uint8_t> flat(20, 77);
+    std::vector<uint8_t> wide(39, 0);
+    scalar->upsampleRow2x(flat.data(), flat.data(), wide.data(), wide.size());
+    ASSERT_TRUE(std::all_of(wide.begin(), wide.end(), [](uint8_t v) { return v == 77; }),
+                "Upsampling a flat row should keep its value");
+
+    int variantsChecked = 0;
+    for (SimdLevel level : { SimdLevel::SSE41, SimdLevel::AVX2 }) {
+        const ColorKernels* simd = colorKernelsFor(level);
+        if (simd == nullptr) {
+            continue;
+        }
+
+        uint32_t seed = 1234;
+        auto next = [&seed]() {
+            seed = seed * 1103515245u + 12345u;
+            return static_cast<uint8_t>(seed >> 16);
+        };
+        // Lengths around the 8/16-pixel vector widths exercise the tails
+        for (size_t count : { 0, 1, 2, 7, 15, 16, 17, 33, 64, 101, 257 }) {
+            std::vector<uint8_t> rgb(count * 3), planes(count * 3 + 2);
+            for (auto& v : rgb) v = next();
+            for (auto& v : planes) v = next();
+
+            std::vector<uint8_t> expected(count * 3), actual(count * 3);
+            scalar->rgbToYCbCr(rgb.data(), expected.data(), expected.data() + count,
+                               expected.data() + 2 * count, count);
+            simd->rgbToYCbCr(rgb.data(), actual.data(), actual.data() + count,
+                             actual.data() + 2 * count, count);
+            ASSERT_TRUE(expected == actual, "SIMD RGB -> YCbCr should match scalar exactly");
+
+            scalar->yCbCrToRgb(planes.data(), planes.data() + count, planes.data() + 2 * count,
+                               expected.data(), count);
+            simd->yCbCrToRgb(planes.data(), planes.data() + count, planes.data() + 2 * count,
+                             actual.data(), count);
+            ASSERT_TRUE(expected == actual, "SIMD YCbCr -> RGB should match scalar exactly");
+
+            for (size_t dstCount : { 2 * count, 2 * count + 1 }) {
+                const size_t srcCount = (dstCount + 1) / 2;
+                std::vector<uint8_t> upExpected(dstCount), upActual(dstCount);
+                scalar->upsampleRow2x(planes.data(), planes.data() + srcCount, upExpected.data(), dstCount);
+                simd->upsampleRow2x(planes.data(), planes.data() + srcCount, upActual.data(), dstCount);
+                ASSERT_TRUE(upExpected == upActual, "SIMD upsampling should match scalar exactly");
+            }
+        }
+        variantsChecked++;
+    }
+
+    std::cout << "PASS (" << variantsChecked << " SIMD variants, selected: "
+              << colorKernels().name << ")" << std::endl;
+    testsPassed++;
+}
+
 static void testEzcFormatRoundTrip() {
     std::cout << "  EZC format round-trip... ";
 
-    EzcHeader headerOut;
-    headerOut.version     = 1;
-    headerOut.width       = 16;
-    headerOut.height      = 16;
-    headerOut.quality     = 75;
-    headerOut.blockDim    = 8;
-    headerOut.blockCountX = 2;
-    headerOut.blockCountY = 2;
-
-    std::vector<Block8x8i16> blocksOut;
-    for (int b = 0; b < 4; b++) {
-        blocksOut.emplace_back(b % 2, b / 2);
-        for (size_t i = 0; i < 64; i++) {
-            blocksOut.back()[i] = static_cast<int16_t>(b * 64 + i - 128);
+    struct Layout {
+        uint8_t  version;
+        uint16_t sliceRows; // 0 = unsliced
+    };
+    for (Layout layout : {Layout{EZC_VERSION_RAW, 0}, Layout{EZC_VERSION_HUFFMAN, 0},
+                          Layout{EZC_VERSION_HUFFMAN, 1}, Layout{EZC_VERSION_HUFFMAN, 2},
+                          Layout{EZC_VERSION_STRIPED, 2}}) {
+        const uint8_t version = layout.version;
+        EzcHeader headerOut;
+        headerOut.version     = version;
+        headerOut.width       = 16;
+        headerOut.height      = 24;
+        headerOut.quality     = 75;
+        headerOut.blockDim    = 8;
+        headerOut.blockCountX = 2;
+        headerOut.blockCountY = 3;
+        headerOut.flags       = EZC_FLAG_FIXED_POINT;
+        if (layout.sliceRows > 0) {
+            headerOut.flags    |= EZC_FLAG_SLICED;
+            headerOut.sliceRows = layout.sliceRows;
         }
+
+        BlockPlane8x8i16 blocksOut(2, 3);
+        for (int b = 0; b < 6; b++) {
+            auto block = blocksOut[b];
+            for (size_t i = 0; i < 64; i++) {
+                block[i] = static_cast<int16_t>(b * 64 + i - 128);
+            }
+        }
+        // Extremes and long zero runs
+        blocksOut[1][0] = INT16_MIN;
+        blocksOut[2][0] = INT16_MAX;
+        blocksOut[2][63] = INT16_MIN;
+        blocksOut[3].fill(0);
+        blocksOut[3][63] = -1;
+
+        const std::string testFile = "test_format.ezc";
+        bool writeOk = writeEzc(testFile, headerOut, blocksOut);
+        ASSERT_TRUE(writeOk, "writeEzc should succeed");
+
+        EzcHeader headerIn;
+        BlockPlane8x8i16 blocksIn;
+        bool readOk = readEzc(testFile, headerIn, blocksIn);
+        ASSERT_TRUE(readOk, "readEzc should succeed");
+
+        ASSERT_TRUE(headerIn.version == version, "Version should match");
+        ASSERT_TRUE(headerIn.width == headerOut.width, "Width should match");
+        ASSERT_TRUE(headerIn.height == headerOut.height, "Height should match");
+        ASSERT_TRUE(headerIn.quality == headerOut.quality, "Quality should match");
+        ASSERT_TRUE(headerIn.blockCountX == headerOut.blockCountX, "BlockCountX should match");
+        ASSERT_TRUE(headerIn.blockCountY == headerOut.blockCountY, "BlockCountY should match");
+        ASSERT_TRUE(headerIn.flags == headerOut.flags, "Flags should match");
+        ASSERT_TRUE(headerIn.sliceRows == headerOut.sliceRows, "Slice height should match");
+        ASSERT_TRUE(blocksIn.size() == blocksOut.size(), "Block count should match");
+
+        for (size_t b = 0; b < blocksIn.size(); b++) {
+            for (size_t i = 0; i < 64; i++) {
+                ASSERT_TRUE(blocksIn[b][i] == blocksOut[b][i], "Block data should match");
+            }
+        }
+
+        std::remove(testFile.c_str());
     }
 
-    const std::string testFile = "test_format.ezc";
-    bool writeOk = writeEzc(testFile, headerOut, blocksOut);
-    ASSERT_TRUE(writeOk, "writeEzc should succeed");
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
 
-    EzcHeader headerIn;
-    std::vector<Block8x8i16> blocksIn;
-    bool readOk = readEzc(testFile, headerIn, blocksIn);
-    ASSERT_TRUE(readOk, "readEzc should succeed");
+static void testEzcReader() {
+    std::cout << "  Memory-mapped reader... ";
 
-    ASSERT_TRUE(headerIn.width == headerOut.width, "Width should match");
-    ASSERT_TRUE(headerIn.height == headerOut.height, "Height should match");
-    ASSERT_TRUE(headerIn.quality == headerOut.quality, "Quality should match");
-    ASSERT_TRUE(headerIn.blockCountX == headerOut.blockCountX, "BlockCountX should match");
-    ASSERT_TRUE(headerIn.blockCountY == headerOut.blockCountY, "BlockCountY should match");
-    ASSERT_TRUE(blocksIn.size() == blocksOut.size(), "Block count should match");
+    EzcHeader header;
+    header.width       = 24;
+    header.height      = 20;
+    header.blockCountX = 3;
+    header.blockCountY = 3;
 
-    for (size_t b = 0; b < blocksIn.size(); b++) {
-        for (size_t i = 0; i < 64; i++) {
-            ASSERT_TRUE(blocksIn[b][i] == blocksOut[b][i], "Block data should match");
+    BlockPlane8x8i16 blocks(3, 3);
+    for (size_t i = 0; i < blocks.size() * 64; i++) {
+        blocks.data()[i] = static_cast<int16_t>((i % 7 == 0) ? static_cast<int>(i) - 300 : 0);
+    }
+
+    const std::string testFile = "test_reader.ezc";
+    for (uint8_t version : {EZC_VERSION_RAW, EZC_VERSION_HUFFMAN}) {
+        header.version   = version;
+        header.flags     = (version == EZC_VERSION_HUFFMAN) ? EZC_FLAG_SLICED : 0;
+        header.sliceRows = (version == EZC_VERSION_HUFFMAN) ? 2 : 0;
+        ASSERT_TRUE(writeEzc(testFile, header, blocks), "writeEzc should succeed");
+
+        EzcReader reader;
+        ASSERT_TRUE(reader.open(testFile), "EzcReader should open the file");
+        ASSERT_TRUE(reader.header().blockCountY == 3, "Header should be parsed");
+        ASSERT_TRUE(reader.sliceCount() == (version == EZC_VERSION_RAW ? 3u : 2u),
+                    "v1 should have one slice per row, v2 the stored slices");
+
+        if (version == EZC_VERSION_RAW) {
+            const uint16_t probe = 1;
+            const bool littleEndian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+            ASSERT_TRUE(reader.hasInPlaceBlocks() == littleEndian, "v1 blocks should be used in place");
+            if (littleEndian) {
+                ASSERT_TRUE(reader.block(4).getBlockX() == 1 && reader.block(4).getBlockY() == 1,
+                            "In-place view should know its position");
+                ASSERT_TRUE(reader.block(4)[0] == blocks[4][0], "In-place view should match");
+            }
         }
+
+        std::vector<int16_t> scratch;
+        for (size_t slice = 0; slice < reader.sliceCount(); slice++) {
+            size_t first = 0;
+            size_t count = 0;
+            reader.sliceBlocks(slice, first, count);
+            const int16_t* coefficients = reader.sliceCoefficients(slice, scratch);
+            ASSERT_TRUE(coefficients != nullptr, "Slice should decode");
+            ASSERT_TRUE(std::equal(coefficients, coefficients + count * 64, blocks.data() + first * 64),
+                        "Slice coefficients should match");
+        }
+    }
+
+    // Truncated files are rejected when opened
+    {
+        std::ifstream in(testFile, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(testFile, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 1));
+    }
+    EzcReader truncated;
+    ASSERT_TRUE(!truncated.open(testFile), "Truncated file should be rejected");
+
+    std::remove(testFile.c_str());
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testOutputFile() {
+    std::cout << "  Buffered output file... ";
+
+    const std::string testFile = "test_output.bin";
+    {
+        std::ofstream existing(testFile, std::ios::binary);
+        existing << "old contents";
+    }
+
+    // Small writes are buffered, large ones bypass the buffer
+    std::vector<uint8_t> large(OutputFile::BUFFER_SIZE + 12345);
+    for (size_t i = 0; i < large.size(); i++) {
+        large[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    OutputFile::Options options;
+    options.atomicReplace = true;
+    options.sync = true;
+    {
+        OutputFile out;
+        ASSERT_TRUE(out.open(testFile, options), "Atomic open should succeed");
+        ASSERT_TRUE(out.write("abc", 3), "Small write should succeed");
+
+        // Until commit() the destination keeps its old contents
+        std::ifstream in(testFile, std::ios::binary);
+        std::string current((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        ASSERT_TRUE(current == "old contents", "Destination should be untouched before commit");
+
+        ASSERT_TRUE(out.write(large.data(), large.size()), "Large write should succeed");
+        ASSERT_TRUE(out.commit(), "Commit should succeed");
+    }
+
+    std::ifstream in(testFile, std::ios::binary);
+    std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    ASSERT_TRUE(written.size() == 3 + large.size(), "All bytes should be written");
+    ASSERT_TRUE(written.compare(0, 3, "abc") == 0 &&
+                std::equal(large.begin(), large.end(), reinterpret_cast<const uint8_t*>(written.data()) + 3),
+                "Bytes should be written in order");
+
+    // An uncommitted atomic write leaves the destination alone
+    {
+        OutputFile out;
+        ASSERT_TRUE(out.open(testFile, options), "Atomic open should succeed");
+        out.write("xyz", 3);
     }
+    std::ifstream again(testFile, std::ios::binary);
+    std::string kept((std::istreambuf_iterator<char>(again)), std::istreambuf_iterator<char>());
+    again.close();
+    ASSERT_TRUE(kept == written, "Abandoned write should not replace the file");
 
     std::remove(testFile.c_str());
     std::cout << "PASS" << std::endl;
     testsPassed++;
 }
 
+static void testEntropyCoding() {
+    std::cout << "  Entropy coding... ";
+
+    // Fibonacci frequencies give an unbounded Huffman depth of 29
+    std::vector<uint32_t> frequencies(HuffmanTable::MAX_SYMBOLS, 0);
+    uint32_t f0 = 1, f1 = 1;
+    for (int symbol = 0; symbol < 30; symbol++) {
+        frequencies[symbol] = f0;
+        uint32_t next = f0 + f1;
+        f0 = f1;
+        f1 = next;
+    }
+    HuffmanTable limited = HuffmanTable::fromFrequencies(frequencies);
+    ASSERT_TRUE(limited.symbols().size() == 30, "Every used symbol should get a code");
+
+    std::vector<uint8_t> bits;
+    BitWriter writer(bits);
+    for (uint16_t symbol = 0; symbol < 30; symbol++) {
+        limited.encode(writer, symbol);
+    }
+    writer.flush();
+    BitReader reader(bits.data(), bits.size());
+    for (int symbol = 0; symbol < 30; symbol++) {
+        ASSERT_TRUE(limited.decode(reader) == symbol, "Length-limited code should decode");
+    }
+
+    HuffmanTable copy;
+    std::vector<uint8_t> serialized;
+    limited.serialize(serialized);
+    const uint8_t* cursor = serialized.data();
+    ASSERT_TRUE(copy.deserialize(cursor, serialized.data() + serialized.size()), "Table should deserialize");
+    ASSERT_TRUE(copy.counts() == limited.counts() && copy.symbols() == limited.symbols(),
+                "Deserialized table should match");
+
+    // Blocks from a small LCG; mostly zeros like real quantized data
+    BlockPlane8x8i16 blocks(5, 3);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < blocks.size() * 64; i++) {
+        state = state * 1664525u + 1013904223u;
+        if ((state >> 28) == 0) {
+            blocks.data()[i] = static_cast<int16_t>(state >> 8);
+        }
+    }
+
+    EntropyCoder::Statistics stats;
+    EntropyCoder::gatherStatistics(blocks.data(), blocks.size(), stats);
+    const HuffmanTable dcTable = HuffmanTable::fromFrequencies(stats.dc);
+    const HuffmanTable acTable = HuffmanTable::fromFrequencies(stats.ac);
+    std::vector<uint8_t> payload;
+    EntropyCoder::encodeBlocks(blocks.data(), blocks.size(), dcTable, acTable, payload);
+
+    BlockPlane8x8i16 decoded(5, 3);
+    ASSERT_TRUE(EntropyCoder::decodeBlocks(payload.data(), payload.size(), dcTable, acTable,
+                                           decoded.data(), decoded.size()),
+                "Payload should decode");
+    ASSERT_TRUE(std::equal(blocks.data(), blocks.data() + blocks.size() * 64, decoded.data()),
+                "Decoded coefficients should match");
+
+    // Truncated input is rejected rather than read past the end
+    ASSERT_TRUE(!EntropyCoder::decodeBlocks(payload.data(), payload.size() / 2, dcTable, acTable,
+                                            decoded.data(), decoded.size()),
+                "Truncated payload should fail");
+
+    std::cout << "PASS (" << payload.size() << " bytes for " << blocks.size() << " blocks)" << std::endl;
+    testsPassed++;
+}
+
+static std::vector<uint8_t> readFileBytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Writes a binary PGM (stb_image reads PNM) with a smooth pattern.
+static bool writeTestImage(const std::string& path, int width, int height) {
+    std::ofstream out(path, std::ios::binary);
+    out << "P5\n" << width << " " << height << "\n255\n";
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            out.put(static_cast<char>((x * 3 + y * 2 + ((x / 16 + y / 16) % 2) * 40) % 256));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+static void testCodecRoundTrip() {
+    std::cout << "  Encode/decode round-trip... ";
+    const std::string inputFile = "test_codec_input.pgm";
+    const std::string ezcFile = "test_codec.ezc";
+    const std::string outputFile = "test_codec_output.png";
+
+    // Odd size so the right and bottom blocks are partial
+    ASSERT_TRUE(writeTestImage(inputFile, 37, 21), "Test image should be written");
+
+    EncodeOptions options;
+    options.quality = 90;
+    ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0, "encode should succeed");
+    ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "decode should succeed");
+
+    Picture original(inputFile.c_str());
+    Picture decoded(outputFile.c_str());
+    ASSERT_TRUE(decoded.isValid(), "Decoded image should load");
+    ASSERT_TRUE(decoded.getWidth() == 37 && decoded.getHeight() == 21, "Decoded size should match");
+
+    double squaredError = 0.0;
+    for (int i = 0; i < 37 * 21; i++) {
+        double diff = static_cast<double>(original.getData()[i]) - decoded.getData()[i];
+        squaredError += diff * diff;
+    }
+    double rmse = std::sqrt(squaredError / (37 * 21));
+    ASSERT_TRUE(rmse < 6.0, "Round-trip RMSE at quality 90 should be small");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(outputFile.c_str());
+    std::cout << "PASS (rmse: " << rmse << ")" << std::endl;
+    testsPassed++;
+}
+
+static void testSparseInverseTransforms() {
+    std::cout << "  Sparse inverse transforms... ";
+
+    uint32_t seed = 977;
+    for (int trial = 0; trial < 300; trial++) {
+        // DC-only block, then a low-band block with the same DC
+        alignas(32) int16_t coefficients[64] = {};
+        seed = seed * 1103515245u + 12345u;
+        coefficients[0] = static_cast<int16_t>(static_cast<int>((seed >> 8) % 4096) - 1024);
+
+        alignas(32) int16_t expected[64];
+        alignas(32) int16_t actual[64];
+        DCT::inverseDCT8x8Fixed(coefficients, expected);
+        const int16_t fixedFill = DCT::inverseDCT8x8DCOnlyFixed(coefficients[0]);
+        ASSERT_TRUE(std::all_of(expected, expected + 64, [&](int16_t v) { return v == fixedFill; }),
+                    "Fixed-point DC fill should match the full transform exactly");
+
+        const int16_t floatFill = DCT::inverseDCT8x8DCOnly(coefficients[0]);
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2 }) {
+            const Kernels8x8* kernels = kernels8x8For(level);
+            if (kernels == nullptr) {
+                continue;
+            }
+            kernels->inverseDCT(coefficients, expected);
+            const int tolerance = level == SimdLevel::Scalar ? 1 : 0;
+            ASSERT_TRUE(std::all_of(expected, expected + 64, [&](int16_t v) { return std::abs(v - floatFill) <= tolerance; }),
+                        "Float DC fill should match the float kernels");
+        }
+
+        for (int v = 0; v < 4; v++) {
+            for (int u = 0; u < 4; u++) {
+                seed = seed * 1103515245u + 12345u;
+                coefficients[v * 8 + u] = static_cast<int16_t>(static_cast<int>((seed >> 8) % 512) - 256);
+            }
+        }
+
+        DCT::inverseDCT8x8Fixed(coefficients, expected);
+        DCT::inverseDCT8x8LowBandFixed(coefficients, actual);
+        ASSERT_TRUE(std::memcmp(expected, actual, sizeof(actual)) == 0,
+                    "Fixed-point low-band transform should match the full transform exactly");
+
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2 }) {
+            const Kernels8x8* kernels = kernels8x8For(level);
+            if (kernels == nullptr) {
+                continue;
+            }
+            kernels->inverseDCT(coefficients, expected);
+            kernels->inverseDCTLowBand(coefficients, actual);
+            const int tolerance = level == SimdLevel::Scalar ? 1 : 0;
+            for (int i = 0; i < 64; i++) {
+                ASSERT_TRUE(std::abs(expected[i] - actual[i]) <= tolerance,
+                            "Low-band kernel should match the full kernel");
+            }
+        }
+    }
+
+    // Decoding reports one path per block
+    const std::string inputFile = "test_sparse_input.pgm";
+    const std::string ezcFile = "test_sparse.ezc";
+    const std::string outputFile = "test_sparse_output.png";
+    ASSERT_TRUE(writeTestImage(inputFile, 64, 40), "Test image should be written");
+    ASSERT_TRUE(encode(inputFile, ezcFile, 30) == 0, "encode should succeed");
+    const InverseTransformCounts before = inverseTransformCounts();
+    ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "decode should succeed");
+    const InverseTransformCounts after = inverseTransformCounts();
+    const uint64_t dcOnly = after.dcOnly - before.dcOnly;
+    const uint64_t lowBand = after.lowBand - before.lowBand;
+    const uint64_t full = after.full - before.full;
+    ASSERT_TRUE(dcOnly + lowBand + full == 8 * 5, "Every block should take exactly one path");
+    ASSERT_TRUE(dcOnly + lowBand > 0, "A smooth image at quality 30 should have sparse blocks");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(outputFile.c_str());
+    std::cout << "PASS (" << dcOnly << " DC-only, " << lowBand << " low-band, " << full << " full)" << std::endl;
+    testsPassed++;
+}
+
+static void testRegionDecode() {
+    std::cout << "  Region-of-interest decode... ";
+    const std::string inputFile = "test_roi_input.pgm";
+    const std::string ezcFile = "test_roi.ezc";
+    const std::string fullFile = "test_roi_full.png";
+    const std::string cropFile = "test_roi_crop.png";
+
+    ASSERT_TRUE(writeTestImage(inputFile, 77, 45), "Test image should be written");
+    EncodeOptions options;
+    options.sliceRows = 1;
+
+    struct Case {
+        Region region;
+        int width;
+        int height;
+    };
+    const Case cases[] = {
+        {{0, 0, 77, 45}, 77, 45},   // whole image
+        {{13, 9, 30, 20}, 30, 20},  // unaligned interior crop
+        {{16, 8, 8, 8}, 8, 8},      // exactly one block
+        {{70, 40, 100, 100}, 7, 5}, // clipped at the bottom-right edge
+    };
+
+    // Unsliced, single-row and multi-row slices
+    for (int sliceRows : {0, 1, 2}) {
+        EncodeOptions options;
+        options.sliceRows = sliceRows;
+        ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0, "encode should succeed");
+        ASSERT_TRUE(decode(ezcFile, fullFile) == 0, "decode should succeed");
+        Picture full(fullFile.c_str());
+
+        for (const Case& c : cases) {
+            ASSERT_TRUE(decodeRegion(ezcFile, cropFile, c.region) == 0, "decodeRegion should succeed");
+            Picture crop(cropFile.c_str());
+            ASSERT_TRUE(crop.isValid() && crop.getWidth() == c.width && crop.getHeight() == c.height,
+                        "Crop should have the clipped size");
+            bool same = true;
+            for (int y = 0; y < c.height; y++) {
+                const unsigned char* expected = full.getData() + (c.region.y + y) * 77 + c.region.x;
+                same = same && std::equal(expected, expected + c.width, crop.getData() + y * c.width);
+            }
+            ASSERT_TRUE(same, "Crop pixels should match the full decode");
+        }
+    }
+
+    ASSERT_TRUE(decodeRegion(ezcFile, cropFile, Region{77, 0, 1, 1}) != 0, "Region outside the image should fail");
+    ASSERT_TRUE(decodeRegion(ezcFile, cropFile, Region{0, 0, 0, 5}) != 0, "Empty region should fail");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(fullFile.c_str());
+    std::remove(cropFile.c_str());
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testScaledDecode() {
+    std::cout << "  Scaled decode... ";
+    const std::string inputFile = "test_scaled_input.pgm";
+    const std::string ezcFile = "test_scaled.ezc";
+    const std::string fullFile = "test_scaled_full.png";
+    const std::string scaledFile = "test_scaled.png";
+
+    const int width = 75;
+    const int height = 45;
+    ASSERT_TRUE(writeTestImage(inputFile, width, height), "Test image should be written");
+    EncodeOptions options;
+    options.quality = 90;
+    options.sliceRows = 2;
+    ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0, "encode should succeed");
+    ASSERT_TRUE(decode(ezcFile, fullFile) == 0, "decode should succeed");
+    Picture full(fullFile.c_str());
+
+    // Compare against a box downscale of the full decode. 1/8 is the block
+    // mean, so it must match closely; the 4x4 and 2x2 transforms are
+    // approximations of the area mean.
+    double worst = 0.0;
+    for (int denominator : {2, 4, 8}) {
+        ASSERT_TRUE(decodeScaled(ezcFile, scaledFile, denominator) == 0, "decodeScaled should succeed");
+        Picture scaled(scaledFile.c_str());
+        const int scaledWidth = (width + denominator - 1) / denominator;
+        const int scaledHeight = (height + denominator - 1) / denominator;
+        ASSERT_TRUE(scaled.isValid() && scaled.getWidth() == scaledWidth && scaled.getHeight() == scaledHeight,
+                    "Scaled output should be ceil(size / denominator)");
+
+        // Interior pixels only: edge blocks were zero-padded by the encoder
+        double absoluteError = 0.0;
+        int samples = 0;
+        for (int y = 0; y < height / denominator; y++) {
+            for (int x = 0; x < width / denominator; x++) {
+                double sum = 0.0;
+                for (int dy = 0; dy < denominator; dy++) {
+                    for (int dx = 0; dx < denominator; dx++) {
+                        sum += full.getData()[(y * denominator + dy) * width + x * denominator + dx];
+                    }
+                }
+                const double mean = sum / (denominator * denominator);
+                absoluteError += std::abs(mean - scaled.getData()[y * scaledWidth + x]);
+                samples++;
+            }
+        }
+        const double meanError = absoluteError / samples;
+        worst = std::max(worst, meanError);
+        ASSERT_TRUE(meanError < (denominator == 8 ? 1.0 : 4.0), "Scaled pixels should follow the area mean");
+    }
+
+    ASSERT_TRUE(decodeScaled(ezcFile, scaledFile, 3) != 0, "Unsupported scale should fail");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(fullFile.c_str());
+    std::remove(scaledFile.c_str());
+    std::cout << "PASS (worst mean error: " << worst << ")" << std::endl;
+    testsPassed++;
+}
+
+static void testStreamRoundTrip() {
+    std::cout << "  Streaming encode/decode... ";
+    const std::string inputFile = "test_stream_input.pgm";
+    const std::string ezcFile = "test_stream.ezc";
+    const std::string streamedFile = "test_stream_output.pgm";
+    const std::string referenceEzc = "test_stream_reference.ezc";
+    const std::string referenceFile = "test_stream_reference.png";
+
+    ASSERT_TRUE(writeTestImage(inputFile, 37, 21), "Test image should be written");
+
+    EncodeOptions options;
+    options.quality = 90;
+    ASSERT_TRUE(encode(inputFile, referenceEzc, options) == 0, "encode should succeed");
+    ASSERT_TRUE(decode(referenceEzc, referenceFile) == 0, "decode should succeed");
+    Picture reference(referenceFile.c_str());
+
+    // Streamed strips must reproduce the in-memory codec exactly, whatever
+    // the strip height; decodeStream also reads non-striped files
+    for (int sliceRows : {1, 2, 5}) {
+        options.sliceRows = sliceRows;
+        ASSERT_TRUE(encodeStream(inputFile, ezcFile, options) == 0, "encodeStream should succeed");
+
+        {
+            EzcReader reader;
+            ASSERT_TRUE(reader.open(ezcFile), "Streamed file should open");
+            ASSERT_TRUE(reader.header().version == EZC_VERSION_STRIPED, "Streamed file should be striped");
+        }
+
+        for (const std::string& source : {ezcFile, referenceEzc}) {
+            ASSERT_TRUE(decodeStream(source, streamedFile) == 0, "decodeStream should succeed");
+            Picture streamed(streamedFile.c_str());
+            ASSERT_TRUE(streamed.isValid() && streamed.getWidth() == 37 && streamed.getHeight() == 21,
+                        "Streamed output should load with the right size");
+            ASSERT_TRUE(std::equal(streamed.getData(), streamed.getData() + 37 * 21, reference.getData()),
+                        "Streamed pixels should match the in-memory decoder");
+        }
+    }
+
+    // The strip buffer holds at most the image: an unsliced v2 file, or a
+    // slice taller than the image, allocates the same whatever the pool size
+    options.sliceRows = 0;
+    ASSERT_TRUE(encode(inputFile, referenceEzc, options) == 0, "Unsliced encode should succeed");
+    options.sliceRows = 100;
+    auto streamAllocations = [&](size_t threads) {
+        ThreadPool::setSharedThreads(threads);
+        Trace::start();
+        const bool ok = decodeStream(referenceEzc, streamedFile) == 0 &&
+                        encodeStream(inputFile, ezcFile, options) == 0;
+        Trace::stop();
+        return ok ? Trace::counter(Trace::Counter::AllocatedBytes) : 0;
+    };
+    const uint64_t oneThread = streamAllocations(1);
+    const uint64_t eightThreads = streamAllocations(8);
+    ThreadPool::setSharedThreads(0);
+    ASSERT_TRUE(oneThread > 0 && oneThread == eightThreads,
+                "Streaming one slice should not allocate a strip per thread");
+    // Per direction: the 37x21 strip and the int16 coefficients of 5x3 blocks
+    ASSERT_TRUE(oneThread <= 2 * (37 * 21 + 15 * 64 * sizeof(int16_t)),
+                "Streaming one slice should allocate one image of pixels at most");
+
+    // A v3 header is not trusted beyond what the file can hold: a cut
+    // file, or huge dimensions with one slice per block row, are rejected
+    // before the slice table is built
+    {
+        std::vector<uint8_t> bytes = readFileBytes(ezcFile);
+        EzcReader reader;
+        ASSERT_TRUE(reader.openBuffer(bytes.data(), bytes.size()), "The streamed file should parse");
+        ASSERT_TRUE(!reader.openBuffer(bytes.data(), 48), "A cut v3 file should be rejected");
+        auto storeU32 = [&](size_t offset, uint32_t value) {
+            for (int i = 0; i < 4; i++) {
+                bytes[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        };
+        storeU32(8, 0xFFFFFFF0u);
+        storeU32(12, 0xFFFFFFF0u);
+        storeU32(16, 0x1FFFFFFEu);
+        storeU32(20, 0x1FFFFFFEu);
+        storeU32(24, 1);
+        ASSERT_TRUE(!reader.openBuffer(bytes.data(), bytes.size()), "An oversized v3 header should be rejected");
+    }
+
+    // Other maximum values would be coded unscaled, so they are rejected
+    {
+        std::ofstream out(inputFile, std::ios::binary | std::ios::trunc);
+        out << "P5\n2 2\n15\n";
+        out.write("\x0f\x0f\x0f\x0f", 4);
+    }
+    ASSERT_TRUE(encodeStream(inputFile, ezcFile, options) != 0, "A PGM with maxval 15 should be rejected");
+
+    // Widths beyond the 16-bit limit of the v1/v2 header
+    const int wideWidth = 70001;
+    ASSERT_TRUE(writeTestImage(inputFile, wideWidth, 9), "Wide test image should be written");
+    options.sliceRows = 1;
+    ASSERT_TRUE(encodeStream(inputFile, ezcFile, options) == 0, "Wide encodeStream should succeed");
+    ASSERT_TRUE(decodeStream(ezcFile, streamedFile) == 0, "Wide decodeStream should succeed");
+    Picture original(inputFile.c_str());
+    Picture wide(streamedFile.c_str());
+    ASSERT_TRUE(wide.isValid() && wide.getWidth() == wideWidth && wide.getHeight() == 9,
+                "Wide output should keep its size");
+    double squaredError = 0.0;
+    for (int i = 0; i < wideWidth * 9; i++) {
+        double diff = static_cast<double>(original.getData()[i]) - wide.getData()[i];
+        squaredError += diff * diff;
+    }
+    ASSERT_TRUE(std::sqrt(squaredError / (wideWidth * 9)) < 6.0, "Wide round-trip RMSE should be small");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(streamedFile.c_str());
+    std::remove(referenceEzc.c_str());
+    std::remove(referenceFile.c_str());
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+// Writes a binary PPM with smooth, differently oriented patterns per channel
+static bool writeColorTestImage(const std::string& path, int width, int height) {
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            out.put(static_cast<char>((x * 4 + y) % 256));
+            out.put(static_cast<char>((y * 5 + 30) % 256));
+            out.put(static_cast<char>(200 - (x + y) % 150));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+static void testColorRoundTrip() {
+    std::cout << "  Color round-trip... ";
+    const std::string inputFile = "test_color_input.ppm";
+    const std::string ezcFile = "test_color.ezc";
+    const std::string copyFile = "test_color_copy.ezc";
+    const std::string outputFile = "test_color_output.png";
+    const int width = 45;
+    const int height = 27;
+
+    ASSERT_TRUE(writeColorTestImage(inputFile, width, height), "Test image should be written");
+    Picture original(inputFile.c_str(), 3);
+    ASSERT_TRUE(original.isValid(), "Color test image should load");
+
+    const ChromaFormat formats[] = { ChromaFormat::YCbCr444, ChromaFormat::YCbCr422, ChromaFormat::YCbCr420 };
+    long previousSize = 0;
+    double worstRmse = 0.0;
+    for (ChromaFormat format : formats) {
+        EncodeOptions options;
+        options.quality = 90;
+        options.chroma = format;
+        ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0, "Color encode should succeed");
+        ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "Color decode should succeed");
+
+        Picture decoded(outputFile.c_str(), 3);
+        ASSERT_TRUE(decoded.isValid(), "Decoded color image should load");
+        ASSERT_TRUE(decoded.getWidth() == width && decoded.getHeight() == height, "Decoded size should match");
+        double squaredError = 0.0;
+        for (int i = 0; i < width * height * 3; i++) {
+            const double diff = static_cast<double>(original.getData()[i]) - decoded.getData()[i];
+            squaredError += diff * diff;
+        }
+        const double rmse = std::sqrt(squaredError / (width * height * 3));
+        ASSERT_TRUE(rmse < 8.0, "Color round-trip RMSE at quality 90 should be small");
+        worstRmse = std::max(worstRmse, rmse);
+
+        // Each subsampling step leaves fewer chroma blocks to code
+        std::ifstream file(ezcFile, std::ios::binary | std::ios::ate);
+        const long size = static_cast<long>(file.tellg());
+        ASSERT_TRUE(previousSize == 0 || size < previousSize, "Subsampled chroma should give smaller files");
+        previousSize = size;
+
+        // Plane geometry, and the same planes through the v1 and v3 layouts
+        EzcHeader header;
+        std::vector<BlockPlane8x8i16> planes;
+        ASSERT_TRUE(readEzc(ezcFile, header, planes), "readEzc should read every plane");
+        ASSERT_TRUE(header.chromaFormat() == format && planes.size() == 3, "Header should describe three planes");
+        const int chromaWidth = (format == ChromaFormat::YCbCr444) ? width : (width + 1) / 2;
+        const int chromaHeight = (format == ChromaFormat::YCbCr420) ? (height + 1) / 2 : height;
+        ASSERT_TRUE(planes[1].blockCountX() == (chromaWidth + 7) / 8 &&
+                    planes[2].blockCountY() == (chromaHeight + 7) / 8, "Chroma planes should be subsampled");
+
+        for (uint8_t version : { EZC_VERSION_RAW, EZC_VERSION_STRIPED }) {
+            EzcHeader copyHeader = header;
+            copyHeader.version = version;
+            if (version == EZC_VERSION_RAW) {
+                copyHeader.flags &= static_cast<uint8_t>(~EZC_FLAG_SLICED);
+            }
+            ASSERT_TRUE(writeEzc(copyFile, copyHeader, planes), "Color planes should write in every version");
+            EzcHeader readHeader;
+            std::vector<BlockPlane8x8i16> readPlanes;
+            ASSERT_TRUE(readEzc(copyFile, readHeader, readPlanes), "Color copy should read back");
+            for (size_t p = 0; p < 3; p++) {
+                ASSERT_TRUE(std::memcmp(planes[p].data(), readPlanes[p].data(),
+                                        planes[p].size() * 64 * sizeof(int16_t)) == 0,
+                            "Color planes should round-trip exactly");
+            }
+        }
+    }
+
+    // Scaled decode keeps color; crops and streaming are gray only
+    ASSERT_TRUE(decodeScaled(ezcFile, outputFile, 2) == 0, "Scaled color decode should succeed");
+    Picture scaled(outputFile.c_str(), 3);
+    ASSERT_TRUE(scaled.getWidth() == (width + 1) / 2 && scaled.getHeight() == (height + 1) / 2,
+                "Scaled color output should be half size");
+    Region region;
+    region.width = 8;
+    region.height = 8;
+    ASSERT_TRUE(decodeRegion(ezcFile, outputFile, region) != 0, "Region decode should reject color files");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(copyFile.c_str());
+    std::remove(outputFile.c_str());
+    std::cout << "PASS (worst rmse: " << worstRmse << ")" << std::endl;
+    testsPassed++;
+}
+
+static void testBufferCodec() {
+    std::cout << "  In-memory Encoder/Decoder... ";
+    const std::string grayFile = "test_buffer_input.pgm";
+    const std::string colorFile = "test_buffer_input.ppm";
+    const std::string ezcFile = "test_buffer.ezc";
+    const std::string outputFile = "test_buffer_output.png";
+    const int width = 37;
+    const int height = 21;
+
+    ASSERT_TRUE(writeTestImage(grayFile, width, height), "Gray test image should be written");
+    ASSERT_TRUE(writeColorTestImage(colorFile, width, height), "Color test image should be written");
+    Picture gray(grayFile.c_str());
+    Picture color(colorFile.c_str(), 3);
+    ASSERT_TRUE(gray.isValid() && color.isValid(), "Test images should load");
+
+    EncodeOptions options;
+    options.quality = 85;
+    options.sliceRows = 1;
+    Encoder encoder(options);
+    Decoder decoder;
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> pixels;
+    ImageInfo info;
+
+    // Same bytes as encode(), same pixels as decode(); the gray image also
+    // goes through a padded stride
+    ASSERT_TRUE(encode(grayFile, ezcFile, options) == 0, "File encode should succeed");
+    ImageView grayView;
+    grayView.pixels = gray.getData();
+    grayView.width = width;
+    grayView.height = height;
+    ASSERT_TRUE(encoder.encode(grayView, bytes), "Gray buffer encode should succeed");
+    ASSERT_TRUE(bytes == readFileBytes(ezcFile), "Buffer encode should match the file");
+
+    const size_t stride = width + 13;
+    std::vector<uint8_t> padded(stride * height, 0xAB);
+    for (int y = 0; y < height; y++) {
+        std::memcpy(padded.data() + y * stride, gray.getData() + y * width, width);
+    }
+    ImageView paddedView = grayView;
+    paddedView.pixels = padded.data();
+    paddedView.stride = stride;
+    std::vector<uint8_t> paddedBytes;
+    ASSERT_TRUE(encoder.encode(paddedView, paddedBytes) && paddedBytes == bytes,
+                "Strided rows should encode like packed ones");
+
+    ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "File decode should succeed");
+    Picture grayDecoded(outputFile.c_str());
+    ASSERT_TRUE(decoder.decode(bytes.data(), bytes.size(), pixels, info), "Gray buffer decode should succeed");
+    ASSERT_TRUE(info.width == static_cast<uint32_t>(width) && info.height == static_cast<uint32_t>(height) &&
+                info.channels == 1 && info.quality == 85, "Gray image info should match");
+    ASSERT_TRUE(std::memcmp(pixels.data(), grayDecoded.getData(), pixels.size()) == 0,
+                "Buffer decode should match the file decode");
+    const InverseTransformCounts counts = decoder.lastCounts();
+    ASSERT_TRUE(counts.dcOnly + counts.lowBand + counts.full == 5 * 3, "Counts should cover the last decode");
+
+    // Color through the same contexts
+    options.chroma = ChromaFormat::YCbCr420;
+    encoder.setOptions(options);
+    ASSERT_TRUE(encode(colorFile, ezcFile, options) == 0, "Color file encode should succeed");
+    ImageView colorView;
+    colorView.pixels = color.getData();
+    colorView.width = width;
+    colorView.height = height;
+    colorView.channels = 3;
+    ASSERT_TRUE(encoder.encode(colorView, bytes), "Color buffer encode should succeed");
+    ASSERT_TRUE(bytes == readFileBytes(ezcFile), "Color buffer encode should match the file");
+
+    ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "Color file decode should succeed");
+    Picture colorDecoded(outputFile.c_str(), 3);
+    ASSERT_TRUE(decoder.decode(bytes.data(), bytes.size(), pixels, info), "Color buffer decode should succeed");
+    ASSERT_TRUE(info.channels == 3 && info.chroma == ChromaFormat::YCbCr420 &&
+                pixels.size() == static_cast<size_t>(width) * height * 3, "Color image info should match");
+    ASSERT_TRUE(std::memcmp(pixels.data(), colorDecoded.getData(), pixels.size()) == 0,
+                "Color buffer decode should match the file decode");
+
+    // Repeating a call reuses the output buffers
+    const std::vector<uint8_t> first = bytes;
+    const uint8_t* bytesData = bytes.data();
+    const uint8_t* pixelData = pixels.data();
+    ASSERT_TRUE(encoder.encode(colorView, bytes) && bytes == first, "Repeated encode should be identical");
+    ASSERT_TRUE(decoder.decode(bytes.data(), bytes.size(), pixels, info), "Repeated decode should succeed");
+    ASSERT_TRUE(bytes.data() == bytesData && pixels.data() == pixelData, "Repeated calls should not reallocate");
+
+    // Invalid input is rejected
+    ImageView twoChannels = grayView;
+    twoChannels.channels = 2;
+    ASSERT_TRUE(!encoder.encode(twoChannels, bytes), "Two-channel images should be rejected");
+    ImageView shortStride = grayView;
+    shortStride.stride = width - 1;
+    ASSERT_TRUE(!encoder.encode(shortStride, bytes), "Short strides should be rejected");
+    ASSERT_TRUE(!decoder.decode(first.data(), 10, pixels, info), "Truncated data should be rejected");
+    std::vector<uint8_t> corrupt = first;
+    corrupt.resize(corrupt.size() - 40);
+    ASSERT_TRUE(!decoder.decode(corrupt.data(), corrupt.size(), pixels, info), "Cut payloads should be rejected");
+
+    std::remove(grayFile.c_str());
+    std::remove(colorFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(outputFile.c_str());
+    std::cout << "PASS (" << first.size() << " bytes)" << std::endl;
+    testsPassed++;
+}
+
+static void testRateControl() {
+    std::cout << "  Target-size rate control... ";
+    const std::string colorFile = "test_rate_input.ppm";
+    const std::string ezcFile = "test_rate.ezc";
+    const int width = 96;
+    const int height = 72;
+    ASSERT_TRUE(writeColorTestImage(colorFile, width, height), "Color test image should be written");
+    Picture color(colorFile.c_str(), 3);
+    ASSERT_TRUE(color.isValid(), "Test image should load");
+    ImageView image;
+    image.pixels = color.getData();
+    image.width = width;
+    image.height = height;
+    image.channels = 3;
+
+    EncodeOptions options;
+    options.chroma = ChromaFormat::YCbCr420;
+    options.sliceRows = 2;
+    Encoder fixed(options);
+    std::vector<uint8_t> low;
+    std::vector<uint8_t> high;
+    options.quality = 10;
+    fixed.setOptions(options);
+    ASSERT_TRUE(fixed.encode(image, low), "Quality 10 encode should succeed");
+    options.quality = 90;
+    fixed.setOptions(options);
+    ASSERT_TRUE(fixed.encode(image, high), "Quality 90 encode should succeed");
+
+    // The quality found is the highest that fits: its file is what a fixed
+    // quality encode writes, and one step up is over the budget
+    EncodeOptions targeted = options;
+    targeted.targetSize = (low.size() + high.size()) / 2;
+    Encoder encoder(targeted);
+    std::vector<uint8_t> bytes;
+    ASSERT_TRUE(encoder.encode(image, bytes), "Targeted encode should succeed");
+    const int quality = encoder.lastQuality();
+    ASSERT_TRUE(quality > 10 && quality < 90, "Quality should fall between the two bounds");
+    ASSERT_TRUE(bytes.size() <= targeted.targetSize, "File should fit the target");
+    std::vector<uint8_t> reference;
+    options.quality = quality;
+    fixed.setOptions(options);
+    ASSERT_TRUE(fixed.encode(image, reference) && reference == bytes,
+                "Targeted file should match a fixed-quality encode");
+    options.quality = quality + 1;
+    fixed.setOptions(options);
+    ASSERT_TRUE(fixed.encode(image, reference) && reference.size() > targeted.targetSize,
+                "The next quality should not fit");
+
+    // The file encoder agrees, and so does a bits-per-pixel budget
+    ASSERT_TRUE(encode(colorFile, ezcFile, targeted) == 0, "Targeted file encode should succeed");
+    ASSERT_TRUE(readFileBytes(ezcFile) == bytes, "File and buffer rate control should match");
+    EncodeOptions perPixel = options;
+    perPixel.targetBpp = static_cast<double>(targeted.targetSize) * 8.0 / (width * height);
+    encoder.setOptions(perPixel);
+    ASSERT_TRUE(encoder.encode(image, bytes) && encoder.lastQuality() == quality,
+                "The same budget in bits per pixel should pick the same quality");
+
+    // An unreachable budget codes at quality 1
+    targeted.targetSize = 16;
+    encoder.setOptions(targeted);
+    ASSERT_TRUE(encoder.encode(image, bytes) && encoder.lastQuality() == 1,
+                "An unreachable target should fall back to quality 1");
+
+    std::remove(colorFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::cout << "PASS (quality " << quality << ")" << std::endl;
+    testsPassed++;
+}
+
+static void testCustomQuantTables() {
+    std::cout << "  Custom quantization tables... ";
+    const std::string colorFile = "test_quant_input.ppm";
+    const std::string ezcFile = "test_quant.ezc";
+    const std::string stripedFile = "test_quant_striped.ezc";
+    const int width = 40;
+    const int height = 24;
+    ASSERT_TRUE(writeColorTestImage(colorFile, width, height), "Color test image should be written");
+    Picture color(colorFile.c_str(), 3);
+    ASSERT_TRUE(color.isValid(), "Test image should load");
+    ImageView image;
+    image.pixels = color.getData();
+    image.width = width;
+    image.height = height;
+    image.channels = 3;
+
+    // Flat luma steps, coarser chroma; quality 50 stores them unchanged
+    EncodeOptions options;
+    options.chroma = ChromaFormat::YCbCr444;
+    options.sliceRows = 2;
+    options.quantTables.assign(64, 6);
+    options.quantTables.insert(options.quantTables.end(), 64, 20);
+    Encoder encoder(options);
+    std::vector<uint8_t> bytes;
+    ASSERT_TRUE(encoder.encode(image, bytes), "Custom table encode should succeed");
+
+    EzcReader reader;
+    ASSERT_TRUE(reader.openBuffer(bytes.data(), bytes.size()), "Custom table file should parse");
+    const EzcHeader& header = reader.header();
+    ASSERT_TRUE((header.flags & EZC_FLAG_QUANT_TABLES) != 0, "Custom tables should be flagged");
+    ASSERT_TRUE(header.quantTable(0).steps()[0] == 6 && header.quantTable(0).steps()[63] == 6 &&
+                header.quantTable(2).steps()[0] == 20, "The file should store the custom steps");
+
+    // Decoding uses the stored steps, so the image comes back close
+    Decoder decoder;
+    std::vector<uint8_t> pixels;
+    ImageInfo info;
+    ASSERT_TRUE(decoder.decode(bytes.data(), bytes.size(), pixels, info), "Custom table decode should succeed");
+    double totalError = 0.0;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        totalError += std::abs(static_cast<int>(pixels[i]) - static_cast<int>(color.getData()[i]));
+    }
+    ASSERT_TRUE(totalError / pixels.size() < 6.0, "Custom table decode should be close to the input");
+
+    // Other qualities scale the custom table; the file encoder writes the
+    // same bytes, and a striped (v3) file carries the tables as well
+    options.quality = 75;
+    encoder.setOptions(options);
+    ASSERT_TRUE(encoder.encode(image, bytes) && reader.openBuffer(bytes.data(), bytes.size()),
+                "Scaled custom table encode should succeed");
+    QuantTable::Steps base{};
+    base.fill(6);
+    ASSERT_TRUE(reader.header().quantTable(0) == Quantization::makeQuantTable(75, base),
+                "Custom tables should scale with quality");
+    ASSERT_TRUE(encode(colorFile, ezcFile, options) == 0 && readFileBytes(ezcFile) == bytes,
+                "File and buffer encodes should match");
+
+    EzcHeader striped;
+    std::vector<BlockPlane8x8i16> planes;
+    ASSERT_TRUE(readEzc(ezcFile, striped, planes), "Custom table file should read");
+    striped.version = EZC_VERSION_STRIPED;
+    ASSERT_TRUE(writeEzc(stripedFile, striped, planes), "Striped custom table file should write");
+    EzcHeader stripedHeader;
+    std::vector<BlockPlane8x8i16> stripedPlanes;
+    ASSERT_TRUE(readEzc(stripedFile, stripedHeader, stripedPlanes) &&
+                stripedHeader.quantSteps == striped.quantSteps,
+                "Striped files should keep the tables");
+    for (size_t p = 0; p < planes.size(); p++) {
+        ASSERT_TRUE(std::memcmp(planes[p].data(), stripedPlanes[p].data(), planes[p].size() * 128) == 0,
+                    "Striped blocks should survive");
+    }
+
+    // A table of the wrong length is rejected
+    options.quantTables.resize(10);
+    encoder.setOptions(options);
+    ASSERT_TRUE(!encoder.encode(image, bytes), "A 10-entry table should be rejected");
+
+    std::remove(colorFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(stripedFile.c_str());
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+// Writes a binary PGM of a flat page with a few dark strokes, like a
+// scanned document
+static bool writeDocumentTestImage(const std::string& path, int width, int height) {
+    std::ofstream out(path, std::ios::binary);
+    out << "P5\n" << width << " " << height << "\n255\n";
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const bool stroke = (x >= 60 && x % 9 < 2 && y % 24 >= 4 && y % 24 < 18) ||
+                                (x >= 60 && y % 24 == 11);
+            out.put(static_cast<char>(stroke ? 30 : 220));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+static void testAdaptiveBlocks() {
+    std::cout << "  Adaptive block sizes... ";
+    const std::string inputFile = "test_adaptive_input.pgm";
+    const std::string colorFile = "test_adaptive_input.ppm";
+    const std::string ezcFile = "test_adaptive.ezc";
+    const std::string outputFile = "test_adaptive_output.png";
+
+    // Partitions survive their bit string; nodes past the grid are split
+    // without a flag
+    BlockPartition partition(11, 7);
+    partition.set(0, 0, TxSize::TX_32x32);
+    partition.set(4, 0, TxSize::TX_16x16);
+    partition.set(6, 2, TxSize::TX_4x4);
+    partition.set(10, 6, TxSize::TX_4x4);
+    std::vector<uint8_t> bits;
+    BitWriter writer(bits);
+    partition.serialize(writer);
+    writer.flush();
+    BitReader bitReader(bits.data(), bits.size());
+    BlockPartition parsed;
+    ASSERT_TRUE(parsed.deserialize(bitReader, 11, 7) && parsed == partition, "Partition should round-trip");
+    ASSERT_TRUE(parsed.codedCount(0, 4) == 44 - 15 - 3 && parsed.codedCount(4, 7) == 33,
+                "Large nodes should code one unit");
+
+    // Content in the kept low band comes back from a large node, and four
+    // 4x4 transforms are near lossless
+    uint16_t samples[1024];
+    int16_t unit[64];
+    int16_t restored[1024];
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 32; x++) {
+            samples[y * 32 + x] = static_cast<uint16_t>(
+                128 + 60 * std::cos(3.14159265358979 * (2 * x + 1) * 3 / 64) +
+                40 * std::cos(3.14159265358979 * (2 * y + 1) * 5 / 64));
+        }
+    }
+    const double dropped = BlockPartition::forwardUnit(TxSize::TX_32x32, samples, unit);
+    BlockPartition::inverseUnit(TxSize::TX_32x32, unit, restored);
+    int maxError = 0;
+    for (int i = 0; i < 1024; i++) {
+        maxError = std::max(maxError, std::abs(restored[i] - static_cast<int>(samples[i])));
+    }
+    ASSERT_TRUE(maxError <= 3 && dropped < 1024.0, "A low-band 32x32 node should survive its unit");
+    for (int i = 0; i < 64; i++) {
+        samples[i] = static_cast<uint16_t>((i * 37) % 256);
+    }
+    BlockPartition::forwardUnit(TxSize::TX_4x4, samples, unit);
+    BlockPartition::inverseUnit(TxSize::TX_4x4, unit, restored);
+    for (int i = 0; i < 64; i++) {
+        ASSERT_TRUE(std::abs(restored[i] - static_cast<int>(samples[i])) <= 1, "4x4 transforms should invert");
+    }
+
+    // A document-like page: large transforms on the margin, small ones on
+    // the strokes, and a smaller file than 8x8 blocks at the same quality
+    const int width = 150;
+    const int height = 100;
+    ASSERT_TRUE(writeDocumentTestImage(inputFile, width, height), "Test image should be written");
+    Picture page(inputFile.c_str());
+    ASSERT_TRUE(page.isValid(), "Test image should load");
+    ImageView image;
+    image.pixels = page.getData();
+    image.width = width;
+    image.height = height;
+
+    EncodeOptions options;
+    options.quality = 75;
+    options.sliceRows = 2;
+    std::vector<uint8_t> fixedBytes;
+    Encoder encoder(options);
+    ASSERT_TRUE(encoder.encode(image, fixedBytes), "Fixed block encode should succeed");
+    options.adaptiveBlocks = true;
+    encoder.setOptions(options);
+    std::vector<uint8_t> bytes;
+    ASSERT_TRUE(encoder.encode(image, bytes), "Adaptive encode should succeed");
+    const size_t adaptiveSize = bytes.size();
+    ASSERT_TRUE(adaptiveSize < fixedBytes.size(), "Adaptive blocks should shrink a flat page");
+
+    EzcReader reader;
+    ASSERT_TRUE(reader.openBuffer(bytes.data(), bytes.size()), "Adaptive file should parse");
+    const EzcHeader& header = reader.header();
+    ASSERT_TRUE((header.flags & EZC_FLAG_ADAPTIVE_BLOCKS) && header.sliceRows == 4 &&
+                header.partitions.size() == 1, "Adaptive files should store a partition");
+    ASSERT_TRUE(header.partitions[0].size(0, 0) == TxSize::TX_32x32 &&
+                header.partitions[0].size(header.blockCountX - 2, 1) != TxSize::TX_32x32,
+                "The margin should take a large transform, the strokes smaller ones");
+
+    Decoder decoder;
+    std::vector<uint8_t> pixels;
+    ImageInfo info;
+    ASSERT_TRUE(decoder.decode(bytes.data(), bytes.size(), pixels, info), "Adaptive decode should succeed");
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        const double diff = static_cast<double>(pixels[i]) - page.getData()[i];
+        squaredError += diff * diff;
+    }
+    const double rmse = std::sqrt(squaredError / pixels.size());
+    ASSERT_TRUE(rmse < 8.0, "Adaptive decode should be close to the input");
+
+    // The file coders agree with the buffer ones, readEzc()/writeEzc()
+    // keep the packed units, and a byte budget is met
+    ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0 && readFileBytes(ezcFile) == bytes,
+                "File and buffer encodes should match");
+    ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "Adaptive file decode should succeed");
+    EzcHeader readHeader;
+    std::vector<BlockPlane8x8i16> planes;
+    ASSERT_TRUE(readEzc(ezcFile, readHeader, planes) && readHeader.partitions == header.partitions,
+                "Adaptive file should read");
+    std::vector<uint8_t> rewritten;
+    EzcWriteBuffers buffers;
+    ASSERT_TRUE(writeEzcBuffer(rewritten, readHeader, planes, buffers) && rewritten == bytes,
+                "Rewriting the units should give the same file");
+    EncodeOptions targeted = options;
+    targeted.targetSize = bytes.size() * 3 / 4;
+    encoder.setOptions(targeted);
+    ASSERT_TRUE(encoder.encode(image, rewritten) && rewritten.size() <= targeted.targetSize,
+                "Adaptive rate control should fit the target");
+
+    // Color planes are partitioned on their own grids
+    ASSERT_TRUE(writeColorTestImage(colorFile, 70, 45), "Color test image should be written");
+    Picture color(colorFile.c_str(), 3);
+    ImageView colorImage;
+    colorImage.pixels = color.getData();
+    colorImage.width = 70;
+    colorImage.height = 45;
+    colorImage.channels = 3;
+    EncodeOptions colorOptions = options;
+    colorOptions.chroma = ChromaFormat::YCbCr420;
+    colorOptions.sliceRows = 0;
+    encoder.setOptions(colorOptions);
+    ASSERT_TRUE(encoder.encode(colorImage, bytes) && decoder.decode(bytes.data(), bytes.size(), pixels, info),
+                "Adaptive color round trip should succeed");
+    double colorError = 0.0;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        colorError += std::abs(static_cast<int>(pixels[i]) - static_cast<int>(color.getData()[i]));
+    }
+    ASSERT_TRUE(colorError / pixels.size() < 8.0, "Adaptive color decode should be close to the input");
+
+    // Fixed point and the partial decoders are refused
+    options.fixedPoint = true;
+    encoder.setOptions(options);
+    ASSERT_TRUE(!encoder.encode(image, bytes), "Fixed point adaptive encode should be rejected");
+    Region region;
+    region.width = 8;
+    region.height = 8;
+    ASSERT_TRUE(decodeRegion(ezcFile, outputFile, region) != 0 && decodeScaled(ezcFile, outputFile, 2) != 0,
+                "Partial decodes of adaptive files should be rejected");
+
+    std::remove(inputFile.c_str());
+    std::remove(colorFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(outputFile.c_str());
+    std::cout << "PASS (" << adaptiveSize << " vs " << fixedBytes.size() << " bytes, rmse: " << rmse << ")"
+              << std::endl;
+    testsPassed++;
+}
+
+static void testBatch() {
+    std::cout << "  Batch encode/decode... ";
+    const std::string inputDir = "test_batch_input";
+    const std::string codedDir = "test_batch_coded";
+    const std::string decodedDir = "test_batch_decoded";
+    const std::string listFile = "test_batch_list.txt";
+    const std::string ezcFile = "test_batch.ezc";
+    std::filesystem::create_directories(inputDir);
+
+    // Differently sized images, plus a file the directory scan must skip
+    const int sizes[][2] = { {37, 21}, {64, 64}, {9, 40}, {120, 33}, {8, 8} };
+    for (size_t i = 0; i < std::size(sizes); i++) {
+        const std::string path = inputDir + "/img" + std::to_string(i) + ".pgm";
+        ASSERT_TRUE(writeTestImage(path, sizes[i][0], sizes[i][1]), "Batch image should be written");
+    }
+    std::ofstream(inputDir + "/notes.txt") << "not an image\n";
+
+    std::vector<std::string> inputs;
+    ASSERT_TRUE(collectBatchInputs(inputDir, false, inputs) && inputs.size() == std::size(sizes),
+                "Directory scan should find the images only");
+    ASSERT_TRUE(std::is_sorted(inputs.begin(), inputs.end()), "Directory inputs should be sorted");
+
+    BatchOptions options;
+    options.encode.quality = 75;
+    options.maxInFlight = 3;
+    ASSERT_TRUE(encodeBatch(inputs, codedDir, options) == 0, "Batch encode should succeed");
+
+    // Every output is the file a single encode() writes
+    for (size_t i = 0; i < inputs.size(); i++) {
+        ASSERT_TRUE(encode(inputs[i], ezcFile, options.encode) == 0, "Single encode should succeed");
+        const std::string coded = codedDir + "/img" + std::to_string(i) + ".ezc";
+        ASSERT_TRUE(readFileBytes(coded) == readFileBytes(ezcFile), "Batch output should match encode()");
+    }
+
+    // Decode from a list file
+    {
+        std::ofstream list(listFile);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            list << codedDir << "/img" << i << ".ezc\n";
+        }
+    }
+    std::vector<std::string> coded;
+    ASSERT_TRUE(collectBatchInputs(listFile, true, coded) && coded.size() == inputs.size(),
+                "List file should give every path");
+    ASSERT_TRUE(decodeBatch(coded, decodedDir, options) == 0, "Batch decode should succeed");
+    for (size_t i = 0; i < inputs.size(); i++) {
+        Picture decoded((decodedDir + "/img" + std::to_string(i) + ".png").c_str());
+        ASSERT_TRUE(decoded.isValid() && decoded.getWidth() == sizes[i][0] && decoded.getHeight() == sizes[i][1],
+                    "Batch decode should write every image");
+    }
+
+    // A missing file fails the batch but not the other files
+    coded.push_back(codedDir + "/missing.ezc");
+    ASSERT_TRUE(decodeBatch(coded, decodedDir, options) != 0, "A missing input should fail the batch");
+    ASSERT_TRUE(std::filesystem::exists(decodedDir + "/img0.png"), "Other files should still decode");
+
+    std::filesystem::remove_all(inputDir);
+    std::filesystem::remove_all(codedDir);
+    std::filesystem::remove_all(decodedDir);
+    std::remove(listFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
 static void testThreadPool() {
     std::cout << "  ThreadPool... ";
     ThreadPool pool(4);
@@ -162,23 +1813,256 @@ static void testThreadPool() {
     testsPassed++;
 }
 
+static void testParallelFor() {
+    std::cout << "  parallelFor... ";
+
+    for (auto scheduler : {ThreadPool::Scheduler::SharedQueue, ThreadPool::Scheduler::WorkStealing}) {
+        ThreadPool pool(4, scheduler);
+
+        std::vector<std::atomic<int>> hits(1000);
+        pool.parallelFor(0, hits.size(), 7, [&](size_t begin, size_t end) {
+            ASSERT_TRUE(end - begin <= 7, "Chunks should not exceed the grain");
+            for (size_t i = begin; i < end; i++) {
+                hits[i]++;
+            }
+        });
+        for (const auto& h : hits) {
+            ASSERT_TRUE(h.load() == 1, "Every index should be visited exactly once");
+        }
+
+        // Nested use from inside a worker must not deadlock
+        std::atomic<int> nested{0};
+        pool.parallelFor(0, 8, 1, [&](size_t, size_t) {
+            pool.parallelFor(0, 8, 1, [&](size_t, size_t) { nested++; });
+        });
+        ASSERT_TRUE(nested.load() == 64, "Nested parallelFor should run every chunk");
+
+        bool thrown = false;
+        try {
+            pool.parallelFor(0, 100, 10, [](size_t begin, size_t) {
+                if (begin == 50) {
+                    throw std::runtime_error("chunk failed");
+                }
+            });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        ASSERT_TRUE(thrown, "Exceptions from chunks should reach the caller");
+    }
+
+    ASSERT_TRUE(&ThreadPool::shared() == &ThreadPool::shared(), "Shared pool should be a singleton");
+    const char* threadsVariable = std::getenv("EZCODEC_THREADS");
+    const bool singleThread = threadsVariable && std::strtoul(threadsVariable, nullptr, 10) == 1;
+    ASSERT_TRUE(ThreadPool::shared().size() >= 1 || singleThread,
+                "Shared pool should have workers unless limited to one thread");
+
+    // Resizing: n threads are n - 1 workers plus the caller
+    ThreadPool::setSharedThreads(3);
+    ASSERT_TRUE(ThreadPool::shared().size() == 2, "Shared pool should be resized");
+    std::atomic<size_t> covered{0};
+    ThreadPool::shared().parallelFor(0, 1000, 7, [&](size_t begin, size_t end) { covered += end - begin; });
+    ASSERT_TRUE(covered == 1000, "Resized shared pool should run parallelFor");
+
+    // One thread: no workers, the caller runs everything
+    ThreadPool::setSharedThreads(1);
+    ASSERT_TRUE(ThreadPool::shared().size() == 0, "One thread should leave no workers");
+    covered = 0;
+    ThreadPool::shared().parallelFor(0, 1000, 7, [&](size_t begin, size_t end) {
+        ThreadPool::shared().parallelFor(begin, end, 1, [&](size_t b, size_t e) { covered += e - b; });
+    });
+    ASSERT_TRUE(covered == 1000, "A pool without workers should run nested parallelFor");
+    ASSERT_TRUE(ThreadPool::shared().enqueue([] { return 7; }).get() == 7,
+                "A pool without workers should run enqueued tasks");
+    ThreadPool::setSharedThreads(0);
+
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testWorkStealing() {
+    std::cout << "  Work stealing... ";
+    ThreadPool pool(3, ThreadPool::Scheduler::WorkStealing);
+    ASSERT_TRUE(pool.getScheduler() == ThreadPool::Scheduler::WorkStealing, "Scheduler should be reported");
+
+    // More single-index chunks than one deque holds
+    std::atomic<size_t> sum{0};
+    pool.parallelFor(0, 20000, 1, [&](size_t begin, size_t end) {
+        ASSERT_TRUE(end == begin + 1, "Grain 1 should give single-index chunks");
+        sum += begin;
+    });
+    ASSERT_TRUE(sum.load() == size_t{20000} * 19999 / 2, "All chunks should run once");
+
+    // enqueue() and parallelFor() share the workers
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 50; i++) {
+        results.emplace_back(pool.enqueue([&pool, i] {
+            std::atomic<int> count{0};
+            pool.parallelFor(0, 16, 2, [&](size_t begin, size_t end) {
+                count += static_cast<int>(end - begin);
+            });
+            return count.load() + i;
+        }));
+    }
+    for (int i = 0; i < 50; i++) {
+        ASSERT_TRUE(results[i].get() == 16 + i, "Tasks should run nested loops to completion");
+    }
+
+    // Repeated short calls exercise the sleep/wake path
+    for (int round = 0; round < 200; round++) {
+        std::atomic<int> count{0};
+        pool.parallelFor(0, 5, 1, [&](size_t, size_t) { count++; });
+        ASSERT_TRUE(count.load() == 5, "Every round should complete");
+    }
+
+    std::cout << "PASS" << std::endl;
+    testsPassed++;
+}
+
+static void testTrace() {
+    std::cout << "  Stage tracing... ";
+    const std::string inputFile = "test_trace_input.pgm";
+    const std::string ezcFile = "test_trace.ezc";
+    const std::string outputFile = "test_trace_output.png";
+    const std::string traceFile = "test_trace.json";
+    ASSERT_TRUE(writeTestImage(inputFile, 77, 45), "Test image should be written");
+    EncodeOptions options;
+    options.sliceRows = 1;
+
+    // Nothing is recorded while tracing is off
+    Trace::start();
+    Trace::stop();
+    ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0, "Untraced encode should succeed");
+    ASSERT_TRUE(Trace::stages().empty(), "No stages should be recorded while off");
+    ASSERT_TRUE(Trace::counter(Trace::Counter::BytesWritten) == 0, "No bytes should be counted while off");
+
+    Trace::start();
+    ASSERT_TRUE(Trace::enabled(), "Tracing should be on after start()");
+    ASSERT_TRUE(encode(inputFile, ezcFile, options) == 0, "Traced encode should succeed");
+    ASSERT_TRUE(decode(ezcFile, outputFile) == 0, "Traced decode should succeed");
+    ThreadPool::shared().parallelFor(0, 256, 1, [](size_t, size_t) {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    });
+    Trace::stop();
+    ASSERT_TRUE(!Trace::enabled(), "Tracing should be off after stop()");
+
+    const std::vector<Trace::Stage> stages = Trace::stages();
+    auto findStage = [&](const std::string& name) -> const Trace::Stage* {
+        for (const Trace::Stage& stage : stages) {
+            if (stage.name == name) {
+                return &stage;
+            }
+        }
+        return nullptr;
+    };
+    for (const char* name : {"encode", "picture.load", "encode.transform", "ezc.entropy_code",
+                             "ezc.write", "decode", "ezc.parse", "decode.slices", "decode.write_png"}) {
+        ASSERT_TRUE(findStage(name) != nullptr, "Every codec stage should be recorded");
+    }
+    const Trace::Stage* encodeStage = findStage("encode");
+    const Trace::Stage* transformStage = findStage("encode.transform");
+    ASSERT_TRUE(encodeStage->calls == 1 && encodeStage->totalNs >= transformStage->totalNs,
+                "A stage should include the stages inside it");
+    ASSERT_TRUE(stages.front().name == "encode", "Stages should be listed in start order");
+    ASSERT_TRUE(findStage("decode.slice")->calls == 6, "Every slice should be recorded");
+
+    const uint64_t ezcSize = std::filesystem::file_size(ezcFile);
+    const uint64_t pngSize = std::filesystem::file_size(outputFile);
+    ASSERT_TRUE(Trace::counter(Trace::Counter::BytesWritten) == ezcSize + pngSize,
+                "Bytes written should cover the .ezc and the PNG");
+    ASSERT_TRUE(Trace::counter(Trace::Counter::BytesRead) ==
+                std::filesystem::file_size(inputFile) + ezcSize,
+                "Bytes read should cover the image and the .ezc");
+    ASSERT_TRUE(Trace::counter(Trace::Counter::Allocations) > 0 &&
+                Trace::counter(Trace::Counter::AllocatedBytes) > 0, "Buffer allocations should be counted");
+
+    uint64_t tasks = 0;
+    for (const Trace::Worker& worker : Trace::workers()) {
+        ASSERT_TRUE(worker.busyNs > 0 && worker.tasks > 0, "Listed workers should have run tasks");
+        tasks += worker.tasks;
+    }
+    ASSERT_TRUE(ThreadPool::shared().size() == 0 || tasks > 0, "Pool workers should report busy time");
+
+    ASSERT_TRUE(Trace::writeChromeTrace(traceFile), "Trace file should be written");
+    const std::vector<uint8_t> bytes = readFileBytes(traceFile);
+    const std::string json(bytes.begin(), bytes.end());
+    ASSERT_TRUE(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0 &&
+                json.find("\"name\":\"ezc.entropy_code\"") != std::string::npos &&
+                json.find("\"ph\":\"X\"") != std::string::npos &&
+                json.find("\"detail\":\"" + inputFile + "\"") != std::string::npos &&
+                json.compare(json.size() - 3, 3, "]}\n") == 0, "Trace should be Chrome trace-event JSON");
+
+    // The shared-queue scheduler records its queue depth too
+    Trace::start();
+    {
+        ThreadPool sharedQueue(2, ThreadPool::Scheduler::SharedQueue);
+        sharedQueue.parallelFor(0, 64, 1, [](size_t, size_t) {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        });
+    }
+    Trace::stop();
+    std::ostringstream summary;
+    Trace::printStats(summary);
+    ASSERT_TRUE(summary.str().find("Pool queue: ") != std::string::npos,
+                "Shared-queue workers should record the queue depth");
+
+    std::remove(inputFile.c_str());
+    std::remove(ezcFile.c_str());
+    std::remove(outputFile.c_str());
+    std::remove(traceFile.c_str());
+    std::cout << "PASS (" << stages.size() << " stages)" << std::endl;
+    testsPassed++;
+}
+
 int main() {
     std::cout << "=== EzCodec Unit Tests ===" << std::endl;
 
     std::cout << "\n[Block]" << std::endl;
     testBlockCreation();
+    testBlockPlane();
+    testStridedBlockView();
 
     std::cout << "\n[DCT]" << std::endl;
     testDCTRoundTrip();
+    testFastDCTMatchesReference();
+    testSeparableDCTAllSizes();
+    testFixedPointDCT();
 
     std::cout << "\n[Quantization]" << std::endl;
     testQuantizationRoundTrip();
+    testFoldedQuantization();
+    testChromaStepTable();
+    testQuantTable();
+
+    std::cout << "\n[Kernels]" << std::endl;
+    testSimdKernelsMatchScalar();
+    testSparseInverseTransforms();
+    testColorKernelsMatchScalar();
 
     std::cout << "\n[EZC Format]" << std::endl;
     testEzcFormatRoundTrip();
+    testEzcReader();
+    testEntropyCoding();
+    testOutputFile();
+
+    std::cout << "\n[Codec]" << std::endl;
+    testCodecRoundTrip();
+    testRegionDecode();
+    testScaledDecode();
+    testStreamRoundTrip();
+    testColorRoundTrip();
+    testBufferCodec();
+    testRateControl();
+    testCustomQuantTables();
+    testAdaptiveBlocks();
+    testBatch();
 
     std::cout << "\n[ThreadPool]" << std::endl;
     testThreadPool();
+    testParallelFor();
+    testWorkStealing();
+
+    std::cout << "\n[Trace]" << std::endl;
+    testTrace();
 
     std::cout << "\n=== Results: " << testsPassed << " passed, "
               << testsFailed << " failed ===" << std::endl;